@@ -178,7 +178,13 @@ public:
     /// lookup.
     ///
     /// Return Mask with lanes set to true if the file is found and could be
-    /// opened, otherwise return false.
+    /// opened, otherwise return false.  The default implementation makes
+    /// one batched TextureSystem call, which reports a single status: if
+    /// the lookup fails for any lane, the returned Mask is false for every
+    /// lane, and the error message is stored in every active lane of
+    /// errormessage.  (A varying file name is split by the caller into one
+    /// call per distinct name, so a failure only affects the lanes sharing
+    /// the name that failed.)
     ///
     /// If the errormessage is NULL, this method is expected to
     /// handle the errors fully, including forwarding them to the renderer
@@ -214,7 +220,8 @@ public:
     /// lookup.
     ///
     /// Return a Mask with lanes set to true if the file is found and could
-    /// be opened, otherwise return false.
+    /// be opened, otherwise return false.  As with texture(), the default
+    /// implementation fails every lane if the lookup fails for any of them.
     ///
     /// If the errormessage parameter is NULL, this method is expected to
     /// handle the errors fully, including forwarding them to the renderer
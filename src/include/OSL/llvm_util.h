@@ -8,6 +8,8 @@
 #include <OSL/oslversion.h>
 #include <OSL/oslconfig.h>
 
+#include <memory>
+#include <string>
 #include <vector>
 #include <unordered_set>
 
@@ -110,6 +112,48 @@ public:
     void jit_aggressive(bool val) { m_jit_aggressive = val; }
     bool jit_aggressive() const { return m_jit_aggressive; }
 
+    /// Persistent on-disk cache of JITed object code, for use with
+    /// use_object_cache(). Each entry is a file named by the SHA-1 of its
+    /// key that also stores the full key, so a mismatch reads as a miss.
+    /// Entries are written to a temporary and renamed into place, so one
+    /// directory may be shared by many threads and processes.
+    class OSLEXECPUBLIC ObjectCache {
+    public:
+        ObjectCache(string_view directory);
+        ~ObjectCache();
+        const std::string& directory() const;
+        long long hits() const;           ///< Objects loaded from disk
+        long long misses() const;         ///< Lookups that had to compile
+        long long bytes_read() const;     ///< Object bytes loaded
+        long long bytes_written() const;  ///< Object bytes stored
+        long long write_failures() const; ///< Entries that failed to store
+    private:
+        friend class LLVM_Util;
+        class Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    /// Generate ustring constants as loads from named external globals
+    /// that are bound to the ustring when the code is loaded, instead of
+    /// baking the string's address into the code. Code that is to be
+    /// stored in an ObjectCache must be generated this way.
+    void relocatable_strings(bool val) { m_relocatable_strings = val; }
+    bool relocatable_strings() const { return m_relocatable_strings; }
+
+    /// Does the current module embed raw addresses of this process
+    /// (constant_ptr(), non-relocatable ustrings) that would make its
+    /// object code invalid in another one?
+    bool module_has_absolute_addresses();
+
+    /// Make the current engine load the object code of the current
+    /// module from cache, or store it there once it has been compiled.
+    /// The entry is found by key, to which the caller adds everything
+    /// the IR was generated from; the IR itself, the LLVM version and
+    /// the JIT target and options are added here. Must be called after
+    /// make_jit_execengine() and before the module is optimized. Return
+    /// true for a hit, in which case optimizing the IR is pointless.
+    bool use_object_cache(ObjectCache* cache, const std::string& key);
+
     /// Return a reference to the current context.
     llvm::LLVMContext &context () const { return *m_llvm_context; }
 
@@ -909,6 +953,9 @@ public:
 
     std::string func_name (llvm::Function *f);
 
+    /// Rename the function.
+    void func_name (llvm::Function *f, const std::string &name);
+
     static size_t total_jit_memory_held ();
 
 private:
@@ -922,6 +969,7 @@ private:
     bool m_dumpasm = false;
     bool m_jit_fma = false;
     bool m_jit_aggressive = false;
+    bool m_relocatable_strings = false;
     PerThreadInfo::Impl *m_thread;
     llvm::LLVMContext *m_llvm_context;
     llvm::Module *m_llvm_module;
@@ -134,6 +134,20 @@ public:
     ///                              isconnected()? (0)
     ///    int greedyjit          Optimize and compile all shaders up front,
     ///                              versus only as needed (0).
+    ///    int async_jit          Number of background threads for JIT (0).
+    ///                              If nonzero, the first execution of a
+    ///                              group only JITs it with minimal LLVM
+    ///                              optimization; the fully optimized
+    ///                              code is built in the background and
+    ///                              swapped in when ready.
+    ///    int group_cache_size   Number of compiled group states to keep
+    ///                              in memory (0 = none). A group whose
+    ///                              layers, instance values, and settings
+    ///                              match a kept state is given its code
+    ///                              instead of being optimized and JITed
+    ///                              again. Changing an attribute that
+    ///                              affects code generation empties the
+    ///                              cache.
     ///    int llvm_target_host   Target the specific host architecture for
     ///                              LLVM IR generation. (1)
     ///    int llvm_jit_fma       Allow fused mul/add (0). This can increase
@@ -146,6 +160,13 @@ public:
     ///                              "AVX512_noFMA", or "host" means to
     ///                              figure out what the host can do. ("")
     ///    int llvm_jit_aggressive  Use LLVM "aggressive" JIT mode. (0)
+    ///    string llvm_jit_cache  Directory in which to keep the JITed code
+    ///                              of shader groups for reuse by later
+    ///                              runs; it may be shared by processes.
+    ///                              Groups whose code refers to addresses
+    ///                              in this process (texture handles,
+    ///                              closures, constant arrays) are always
+    ///                              JITed. ("" = no cache)
     ///    int vector_width       Vector width to allow for SIMD ops (4).
     ///    int llvm_debugging_symbols  When JITing, generate debug symbols
     ///                             that associate machine code with shader
@@ -177,6 +198,11 @@ public:
     ///         opt_fold_getattribute, opt_middleman, opt_texture_handle
     ///         opt_seed_bblock_aliases
     ///    int opt_passes         Number of optimization passes per layer (10)
+    ///    int opt_parallel_layers  Threads used to optimize the independent
+    ///                              parts of a single group's layer network
+    ///                              (0 = one thread, -1 = all hardware
+    ///                              threads). The result is the same for
+    ///                              any number. (0)
     ///    int llvm_optimize      Which of several LLVM optimize strategies (1)
     ///    int llvm_debug         Set LLVM extra debug level (0)
     ///    int llvm_debug_layers  Extra printfs upon entering and leaving
@@ -524,6 +550,13 @@ public:
     /// indicates that it's a parameter that may be overridden by the
     /// geometric primitive).  This call gives you a way of changing the
     /// instance value, even if it's not a geometric override.
+    /// If the "group_cache_size" attribute is nonzero, any parameter of a
+    /// group optimized while it was on may be changed: the group goes back
+    /// to being unoptimized, and its next execution either compiles it
+    /// again or reuses the code of a cached state with the same values.
+    /// A lockgeom=0 parameter is still changed in place when no other
+    /// group shares the group's code. The group must not be executing
+    /// while it is changed.
     bool ReParameter (ShaderGroup &group,
                       string_view layername, string_view paramname,
                       TypeDesc type, const void *val);
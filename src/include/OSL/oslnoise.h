@@ -100,6 +100,11 @@ struct NoiseParams;
 namespace pvt {
 using namespace OIIO::simd;
 using namespace OIIO::bjhash;
+#ifdef __OSL_WIDE_PVT
+// When built into a wide target library, sfmath.h and sfm_simplex.h place
+// sfm inside the per-ISA namespace rather than pvt.
+namespace sfm = __OSL_WIDE_PVT::sfm;
+#endif
 
 typedef void (*NoiseGenericFunc)(int outdim, float *out, bool derivs,
                                  int indim, const float *in,
@@ -183,6 +183,10 @@ public:
     ///
     static int new_struct(StructSpec* n);
 
+    /// Release a structure made by new_struct. Its index may be handed
+    /// out again, so no TypeSpec referring to it may be used afterwards.
+    static void delete_struct(int id);
+
     /// Return a reference to the structure list.
     ///
     static std::vector<std::shared_ptr<StructSpec>>& struct_list();
@@ -562,6 +566,9 @@ public:
     /// Use with care!
     ASTNode* node() const { return m_node; }
 
+    /// Set the AST node containing the declaration of this symbol.
+    void node(ASTNode* n) { m_node = n; }
+
     /// Is this symbol a function?
     ///
     bool is_function() const { return m_symtype == SymTypeFunction; }
@@ -2,6 +2,12 @@
 // Created by misha on 14/06/2021.
 //
 #include "artic.h"
+#include "oslcomp_pvt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 
 OSL_NAMESPACE_ENTER
@@ -12,6 +18,40 @@ using pvt::TypeSpec;
 
 
 
+// The fields of shader_inout (anyosl_std.art), in declaration order, with
+// the Artic type of each.
+static const struct {
+    const char* name;
+    const char* type;
+} shader_globals[] = {
+    { "P", "Point" },       { "I", "Vector" },     { "N", "Normal" },
+    { "Ng", "Normal" },     { "u", "f32" },        { "v", "f32" },
+    { "dPdu", "Vector" },   { "dPdv", "Vector" },  { "Ps", "Point" },
+    { "time", "f32" },      { "dtime", "f32" },    { "dPdtime", "Vector" },
+    { "Ci", "Closure" },
+};
+static const int nshader_globals = int(sizeof(shader_globals)
+                                       / sizeof(shader_globals[0]));
+
+
+
+// Index into shader_globals of the global this node refers to, or -1.
+static int
+shader_global_index(const ASTNode* node)
+{
+    if (!node || node->nodetype() != ASTNode::variable_ref_node)
+        return -1;
+    const Symbol* sym = ((const ASTvariable_ref*)node)->sym();
+    if (!sym || sym->symtype() != SymTypeGlobal)
+        return -1;
+    for (int i = 0; i < nshader_globals; ++i)
+        if (sym->name() == shader_globals[i].name)
+            return i;
+    return -1;
+}
+
+
+
 std::string
 artic_type_string_to_string(std::string in)
 {
@@ -93,24 +133,15 @@ get_array_size(ASTNode::ref node)
         } else if(node->nodetype() == ASTNode::NodeType::variable_ref_node){
             auto n = (ASTvariable_ref*) node.get();
             auto d = n->sym()->node();
-            if(d->nodetype() == ASTNode::NodeType::variable_declaration_node){
+            if (d && d->nodetype() == ASTNode::NodeType::variable_declaration_node) {
                 auto decl = (ASTvariable_declaration*) d;
                 if(decl->init()){
                     return get_array_size(decl->init());
-                } else {
-                    NOT_IMPLEMENTED;
                 }
-            } else {
-                NOT_IMPLEMENTED;
             }
-        } else {
-            NOT_IMPLEMENTED;
         }
-
-    } else {
-        NOT_IMPLEMENTED;
     }
-    return 0;
+    return -1;
 }
 
 const std::string
@@ -135,11 +166,237 @@ get_artic_type_string(ASTNode::ref node)
 
 
 
+// Is this one of the Artic types that have native arithmetic?
+static bool
+is_artic_scalar(const std::string& type)
+{
+    return type == "f32" || type == "i32" || type == "u32";
+}
+
+
+
+// Point, Vector or Normal. Point/Normal/Color are aliases of Vector in
+// anyosl_std, except in the names of builtins like transform() whose
+// meaning depends on the kind of triple.
+static const char*
+artic_triple_kind(const TypeSpec& ts)
+{
+    if (ts.is_point())
+        return "Point";
+    if (ts.is_normal())
+        return "Normal";
+    return "Vector";
+}
+
+
+
+// Return type as it appears in mangled function names: "()" is not
+// valid in an identifier, so void functions end in "__void".
+static std::string
+artic_return_mangling(ASTNode::ref node)
+{
+    if (node->typespec().is_void())
+        return "void";
+    return get_artic_type_string(node);
+}
+
+
+
+// Component k of a folded int, float or triple, as a float.
+static float
+constant_component(const ArticConstant& c, int k)
+{
+    if (c.type.is_int())
+        return float(c.i);
+    return c.type.is_triple() ? c.f[k] : c.f[0];
+}
+
+// The two's complement int with the same bits as u, without relying on
+// the implementation-defined unsigned to int conversion.
+static int
+wrap_int(unsigned u)
+{
+    return u <= unsigned(std::numeric_limits<int>::max())
+               ? int(u)
+               : -int(~u) - 1;
+}
+
+static bool
+is_numeric_constant(const ArticConstant& c)
+{
+    return c.type.is_int() || c.type.is_float() || c.type.is_triple();
+}
+
+bool
+convert_artic_constant(ArticConstant& value, const TypeSpec& to)
+{
+    const TypeSpec& from = value.type;
+    if (to.is_array() || from.is_array() || to.is_structure()
+        || to.is_closure())
+        return false;
+    if (to.is_string()) {
+        if (!from.is_string())
+            return false;
+    } else if (to.is_int()) {
+        if (from.is_float()) {
+            // Out of range (or NaN) is undefined, leave it to runtime
+            if (!(std::fabs(value.f[0]) < 2147483648.0f))
+                return false;
+            value.i = int(value.f[0]);
+        } else if (!from.is_int()) {
+            return false;
+        }
+    } else if (to.is_float()) {
+        if (!from.is_int() && !from.is_float())
+            return false;
+        value.f[0] = constant_component(value, 0);
+    } else if (to.is_triple()) {
+        if (!is_numeric_constant(value))
+            return false;
+        float x = constant_component(value, 0);
+        float y = constant_component(value, 1);
+        float z = constant_component(value, 2);
+        value.f[0] = x, value.f[1] = y, value.f[2] = z;
+    } else if (to.is_matrix()) {
+        if (from.is_int() || from.is_float()) {
+            float d = constant_component(value, 0);
+            for (int k = 0; k < 16; ++k)
+                value.f[k] = (k % 5 == 0) ? d : 0.0f;
+        } else if (!from.is_matrix()) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    value.type = to;
+    return true;
+}
+
+bool
+fold_artic_constant(const ASTNode* node,
+                    const std::unordered_map<const Symbol*, ArticConstant>& params,
+                    ArticConstant& value)
+{
+    value = ArticConstant();
+    switch (node->nodetype()) {
+    case ASTNode::literal_node: {
+        auto lit   = (const ASTliteral*)node;
+        value.type = lit->typespec();
+        if (value.type.is_int())
+            value.i = lit->intval();
+        else if (value.type.is_float())
+            value.f[0] = lit->floatval();
+        else if (value.type.is_string())
+            value.s = lit->ustrval();
+        else
+            return false;
+        return true;
+    }
+    case ASTNode::variable_ref_node: {
+        auto found = params.find(((const ASTvariable_ref*)node)->sym());
+        if (found == params.end())
+            return false;
+        value = found->second;
+        return true;
+    }
+    case ASTNode::unary_expression_node: {
+        auto unary = (const ASTunary_expression*)node;
+        string_view op = unary->opname();
+        if ((op != "-" && op != "+")
+            || !fold_artic_constant(unary->expr().get(), params, value)
+            || !is_numeric_constant(value))
+            return false;
+        if (op == "-") {
+            value.i = wrap_int(0u - unsigned(value.i));
+            for (int k = 0; k < 3; ++k)
+                value.f[k] = -value.f[k];
+        }
+        return true;
+    }
+    case ASTNode::binary_expression_node: {
+        auto binary = (const ASTbinary_expression*)node;
+        string_view op = binary->opname();
+        ArticConstant a, b;
+        if ((op != "+" && op != "-" && op != "*" && op != "/")
+            || !fold_artic_constant(binary->left().get(), params, a)
+            || !fold_artic_constant(binary->right().get(), params, b)
+            || !is_numeric_constant(a) || !is_numeric_constant(b))
+            return false;
+        value.type = binary->typespec();
+        if (value.type.is_int()) {
+            if (!a.type.is_int() || !b.type.is_int())
+                return false;
+            if (op == "/"
+                && (b.i == 0
+                    || (a.i == std::numeric_limits<int>::min() && b.i == -1)))
+                return false;  // Leave OSL's safe division to runtime
+            if (op == "/") {
+                value.i = a.i / b.i;
+                return true;
+            }
+            // Artic's i32 wraps on overflow, so fold in unsigned arithmetic
+            // rather than hitting signed overflow here.
+            unsigned x = unsigned(a.i), y = unsigned(b.i);
+            value.i    = wrap_int(op == "+"   ? x + y
+                                  : op == "-" ? x - y
+                                              : x * y);
+            return true;
+        }
+        if (!value.type.is_float() && !value.type.is_triple())
+            return false;
+        for (int k = 0; k < 3; ++k) {
+            float x = constant_component(a, k);
+            float y = constant_component(b, k);
+            if (op == "/" && y == 0.0f)
+                return false;
+            value.f[k] = op == "+"   ? x + y
+                         : op == "-" ? x - y
+                         : op == "*" ? x * y
+                                     : x / y;
+        }
+        return true;
+    }
+    case ASTNode::typecast_expression_node: {
+        auto cast = (const ASTtypecast_expression*)node;
+        return fold_artic_constant(cast->expr().get(), params, value)
+               && convert_artic_constant(value, cast->typespec());
+    }
+    case ASTNode::type_constructor_node: {
+        auto ctor     = (const ASTtype_constructor*)node;
+        const TypeSpec& type = ctor->typespec();
+        std::vector<ArticConstant> args;
+        for (ASTNode::ref a = ctor->args(); a; a = a->next()) {
+            args.emplace_back();
+            if (!fold_artic_constant(a.get(), params, args.back()))
+                return false;
+        }
+        if (args.size() == 1) {
+            value = args[0];
+            return convert_artic_constant(value, type);
+        }
+        // Only the component-wise forms; named spaces need the renderer
+        size_t n = type.is_triple() ? 3 : type.is_matrix() ? 16 : 0;
+        if (!n || args.size() != n)
+            return false;
+        for (size_t k = 0; k < n; ++k) {
+            if (!args[k].type.is_int() && !args[k].type.is_float())
+                return false;
+            value.f[k] = constant_component(args[k], 0);
+        }
+        value.type = type;
+        return true;
+    }
+    default: return false;
+    }
+}
+
+
+
 const std::string
 artic_simpletype(TypeDesc st)
 {
     if (st.is_unknown()) {
-        NOT_IMPLEMENTED;
+        return "()";  // typecheck has already complained
     }
 
     std::string start = "";
@@ -176,11 +433,9 @@ artic_simpletype(TypeDesc st)
 
 template<typename... Args>
 void
-ArticSource::add_source_with_indent(const std::string& code, Args... args)
+ArticSource::add_source_with_indent(string_view code, const Args&... args)
 {
-    for (int i = 0; i < m_indent; i++) {
-        m_code += m_indent_string;
-    }
+    m_code += m_indents[m_indent];
     add_source(code, args...);
 }
 
@@ -188,9 +443,9 @@ ArticSource::add_source_with_indent(const std::string& code, Args... args)
 
 template<typename... Args>
 void
-ArticSource::add_source(const std::string& code, Args... args)
+ArticSource::add_source(string_view code, const Args&... args)
 {
-    m_code += code;
+    m_code.append(code.data(), code.size());
     add_source(args...);
 }
 
@@ -199,11 +454,14 @@ ArticSource::add_source(const std::string& code, Args... args)
 int
 ArticSource::push_indent()
 {
+    if ((int)m_indents.size() <= m_indent + 1)
+        m_indents.push_back(m_indents.back() + m_indent_string);
     return m_indent++;
 }
 int
 ArticSource::pop_indent()
 {
+    OSL_DASSERT(m_indent > 0);
     return m_indent--;
 }
 std::string
@@ -220,6 +478,15 @@ void
 ArticSource::newline()
 {
     m_code += "\n";
+    maybe_flush();
+}
+void
+ArticSource::flush()
+{
+    if (m_sink && m_code.size()) {
+        m_sink->write(m_code.data(), m_code.size());
+        m_code.clear();
+    }
 }
 
 
@@ -228,8 +495,10 @@ void
 ArticTranspiler::dispatch_node(ASTNode::ref n)
 {
     auto node = n.get();
+    const ASTNode* outer = m_current_node;
+    m_current_node = node;
     switch (node->nodetype()) {
-    case ASTNode::unknown_node: NOT_IMPLEMENTED; break;
+    case ASTNode::unknown_node: unsupported("unknown node"); break;
     case ASTNode::shader_declaration_node:
         transpile_shader_declaration((ASTshader_declaration*)node);
         break;
@@ -294,8 +563,81 @@ ArticTranspiler::dispatch_node(ASTNode::ref n)
     case ASTNode::literal_node:
         transpile_literal_node((ASTliteral*)node);
         break;
-    case ASTNode::_last_node: NOT_IMPLEMENTED; break;
+    case ASTNode::_last_node: unsupported("unknown node"); break;
+    }
+    m_current_node = outer;
+}
+
+
+
+void
+ArticTranspiler::transpile_unit(ASTNode::ref decl)
+{
+    m_unit_unsupported.clear();
+    source->hold();
+    dispatch_node(decl);
+    ++m_units;
+    if (m_unit_unsupported.empty()) {
+        source->release();
+        return;
     }
+
+    std::string name = decl->nodetypename();
+    if (decl->nodetype() == ASTNode::shader_declaration_node)
+        name = ((ASTshader_declaration*)decl.get())->shadername().string();
+    else if (decl->nodetype() == ASTNode::function_declaration_node)
+        name = ((ASTfunction_declaration*)decl.get())->func()->name().string();
+    std::string why;
+    for (auto& u : m_unit_unsupported) {
+        if (why.size())
+            why += ", ";
+        why += u.first;
+        if (u.second > 1)
+            why += OIIO::Strutil::sprintf(" x%d", u.second);
+    }
+    m_failures.push_back(name + " (" + why + ")");
+    if (m_partial) {
+        // Leave the function out; its callers will be left out in turn.
+        // Otherwise the error already reported is enough.
+        m_failed_units.insert(decl.get());
+        source->rollback();
+        source->add_source("// ", name, ": not transpiled (", why, ")\n\n");
+    }
+    source->release();
+}
+
+
+
+int
+ArticTranspiler::report_summary(ustring filename)
+{
+    if (m_failures.empty())
+        return 0;
+    std::string msg = OIIO::Strutil::sprintf(
+        "Artic: %d of %d functions not transpiled: %s",
+        (int)m_failures.size(), m_units, OIIO::Strutil::join(m_failures, "; "));
+    if (m_partial)
+        m_compiler->warningf(filename, 0, "%s", msg);
+    else
+        m_compiler->infof(filename, 0, "%s", msg);
+    return (int)m_failures.size();
+}
+
+
+
+void
+ArticTranspiler::unsupported(string_view what, const ASTNode* node)
+{
+    if (!node)
+        node = m_current_node;
+    ustring file = node ? node->sourcefile() : ustring();
+    int line     = node ? node->sourceline() : 0;
+    ++m_unit_unsupported[std::string(what)];
+    if (m_partial)
+        m_compiler->warningf(file, line, "Artic: unsupported %s", what);
+    else
+        m_compiler->errorf(file, line, "Artic: unsupported %s", what);
+    source->add_source("/* unsupported ", what, " */");
 }
 void
 ArticTranspiler::transpile_shader_declaration(ASTshader_declaration* node)
@@ -320,33 +662,70 @@ ArticTranspiler::transpile_shader_declaration(ASTshader_declaration* node)
     source->pop_indent();
     source->add_source_with_indent("}\n\n");
 
+    // Literal-only defaults become struct fields as they are, like
+    // RuntimeOptimizer::simplify_params folds them for the oso path.
+    // Later defaults may refer to earlier (folded) parameters.
+    std::unordered_map<const Symbol*, ArticConstant> folded;
+    m_param_constants.clear();
+    for (auto v : inputs) {
+        ArticConstant value;
+        if (fold_artic_constant(v->init().get(), folded, value)
+            && convert_artic_constant(value, v->typespec())) {
+            std::string text = constant_source(value);
+            if (!text.empty()) {
+                folded[v->sym()]          = value;
+                m_param_constants[v->sym()] = text;
+            }
+        }
+    }
+
+    // make_X_in only sees a copy of the globals, so defaults that write
+    // any are evaluated again in X_impl, where the writes are kept.
+    GlobalUsage init_usage;
+    GlobalUsage usage = global_usage(node);
+    std::vector<ASTvariable_declaration*> rerun;
+    for (auto v : inputs) {
+        if (m_param_constants.count(v->sym()))
+            continue;
+        GlobalUsage param_usage;
+        collect_global_usage(v->init().get(), param_usage);
+        init_usage.read |= param_usage.read;
+        init_usage.written |= param_usage.written;
+        if (param_usage.written) {
+            rerun.push_back(v);
+            usage.read |= param_usage.read;
+            usage.written |= param_usage.written;
+        }
+    }
+
     source->add_source_with_indent("fn make_", shadername, "_in(inout: shader_inout) -> ",
                                    shadername, "_in {\n");
     source->push_indent();
+    m_globals_written = init_usage.written;
+    emit_shaderinout_copy(init_usage);
     for (auto v : inputs) {
+        if (m_param_constants.count(v->sym()))
+            continue;
         source->add_source_with_indent("let ", v->name().string(), ": ",
                                        get_artic_type_string(v), " = ");
-        if (v->init()->nodetype() == ASTNode::NodeType::literal_node) {
-            //TODO: wtf is happening here?
-            auto lit = new ASTtype_constructor(v->typespec(), v->init().get());
-            dispatch_node(lit);
-            //delete lit;
-        } else {
-            dispatch_node(v->init());
-        }
+        transpile_as(v->typespec(), v->init());
         source->add_source(";\n");
     }
-    emit_shaderinout_copy();
     source->add_source_with_indent(shadername, "_in{\n");
     source->push_indent();
     for (auto v : inputs) {
+        auto folded_value = m_param_constants.find(v->sym());
         source->add_source_with_indent(v->name().string(), " = ",
-                                       v->name().string(), ",\n");
+                                       folded_value != m_param_constants.end()
+                                           ? folded_value->second
+                                           : v->name().string(),
+                                       ",\n");
     }
     source->pop_indent();
     source->add_source_with_indent("}\n");
     source->pop_indent();
     source->add_source_with_indent("}\n\n");
+    m_param_constants.clear();
 
     source->add_source_with_indent("struct ", shadername, "_out {\n");
     source->push_indent();
@@ -363,11 +742,21 @@ ArticTranspiler::transpile_shader_declaration(ASTshader_declaration* node)
                                    shadername, "_out, shader_inout) {\n");
     source->push_indent();
     for (auto v : inputs) {
+        if (std::find(rerun.begin(), rerun.end(), v) != rerun.end())
+            continue;
         source->add_source_with_indent("let ", v->is_output() ? "mut " : "",
                                        v->name().string(), " = arg_in.",
                                        v->name().string(), ";\n");
     }
-    emit_shaderinout_copy();
+    m_globals_written = usage.written;
+    emit_shaderinout_copy(usage);
+    for (auto v : rerun) {
+        source->add_source_with_indent("let ", v->is_output() ? "mut " : "",
+                                       v->name().string(), ": ",
+                                       get_artic_type_string(v), " = ");
+        transpile_as(v->typespec(), v->init());
+        source->add_source(";\n");
+    }
 
     transpile_statement_list(node->statements());
 
@@ -386,9 +775,80 @@ ArticTranspiler::transpile_shader_declaration(ASTshader_declaration* node)
 
     source->pop_indent();
     source->add_source_with_indent("}\n\n");
+
+    emit_batched_entry_point(shadername, outputs, usage.written);
+    m_globals_written = 0;
     this->in_shader = false;
 }
 
+
+
+void
+ArticTranspiler::emit_batched_entry_point(
+    const std::string& shadername,
+    const std::vector<ASTvariable_declaration*>& outputs,
+    unsigned int written)
+{
+    // Outputs in structure-of-arrays form: one buffer per output (three
+    // for triples), indexed by shading point.
+    source->add_source_with_indent("struct ", shadername, "_out_soa {\n");
+    source->push_indent();
+    for (auto v : outputs) {
+        std::string type = get_artic_type_string(v);
+        source->add_source_with_indent(v->name().string(), ": ",
+                                       type == "Vector"
+                                           ? std::string("VectorSoA")
+                                           : "&mut [" + type + "]",
+                                       ",\n");
+    }
+    source->pop_indent();
+    source->add_source_with_indent("}\n\n");
+
+    // Shade 'count' points, m_vector_width lanes at a time across all
+    // cores. The width is emitted as a literal so that vectorize() gets a
+    // compile-time constant. Parameters are uniform; only the globals the
+    // shader writes are stored back.
+    source->add_source_with_indent("fn @", shadername, "_batched(arg_in: ",
+                                   shadername,
+                                   "_in, globals: shader_inout_soa, outputs: ",
+                                   shadername,
+                                   "_out_soa, count: i32) -> () {\n");
+    source->push_indent();
+    source->add_source_with_indent("for i in for_each_packet(count, ",
+                                   std::to_string(m_vector_width), ") {\n");
+    source->push_indent();
+    source->add_source_with_indent("let (", outputs.size() ? "out" : "_",
+                                   ", ", written ? "inout" : "_", ") = ",
+                                   shadername,
+                                   "_impl(arg_in, load_shader_inout(globals, "
+                                   "i));\n");
+    for (int g = 0; g < nshader_globals; ++g) {
+        if (!(written & (1u << g)))
+            continue;
+        const char* name = shader_globals[g].name;
+        if (!strcmp(shader_globals[g].type, "f32")
+            || !strcmp(shader_globals[g].type, "Closure"))
+            source->add_source_with_indent("globals.", name, "(i) = inout.",
+                                           name, ";\n");
+        else
+            source->add_source_with_indent("store_Vector_soa(globals.", name,
+                                           ", i, inout.", name, ");\n");
+    }
+    for (auto v : outputs) {
+        std::string name = v->name().string();
+        if (get_artic_type_string(v) == "Vector")
+            source->add_source_with_indent("store_Vector_soa(outputs.", name,
+                                           ", i, out.", name, ");\n");
+        else
+            source->add_source_with_indent("outputs.", name, "(i) = out.",
+                                           name, ";\n");
+    }
+    source->pop_indent();
+    source->add_source_with_indent("}\n");
+    source->pop_indent();
+    source->add_source_with_indent("}\n\n");
+}
+
 void
 ArticTranspiler::transpile_statement_list(ASTNode::ref node)
 {
@@ -415,13 +875,18 @@ ArticTranspiler::transpile_function_declaration(ASTfunction_declaration* node)
     bool is         = this->in_shader;
     this->in_shader = false;
     if (!node->is_builtin()) {
+        // Globals the function writes are returned after its result, so
+        // the caller sees them; everything else stays in inout.
+        const GlobalUsage& usage   = global_usage(node);
+        unsigned int outer_written = m_globals_written;
+        m_globals_written          = usage.written;
         source->add_source("fn @", node->func()->name().string());
         auto formal_node = node->formals();
         while (formal_node) {
             source->add_source("_", get_artic_type_string(formal_node));
             formal_node = formal_node->next();
         }
-        source->add_source("__", get_artic_type_string(node), "(");
+        source->add_source("__", artic_return_mangling(node), "(");
         formal_node = node->formals();
         while (formal_node) {
             auto decl = (ASTvariable_declaration*)formal_node.get();
@@ -434,13 +899,28 @@ ArticTranspiler::transpile_function_declaration(ASTfunction_declaration* node)
             }
             formal_node = formal_node->next();
         }
-        source->add_source(" inout: shader_inout) ->",
-                           get_artic_type_string(node), "{\n");
+        source->add_source(" inout: shader_inout) ->");
+        if (usage.written) {
+            source->add_source("(", get_artic_type_string(node));
+            for (int i = 0; i < nshader_globals; ++i)
+                if (usage.written & (1u << i))
+                    source->add_source(", ", shader_globals[i].type);
+            source->add_source(")");
+        } else {
+            source->add_source(get_artic_type_string(node));
+        }
+        source->add_source("{\n");
         source->push_indent();
-        emit_shaderinout_copy();
+        emit_shaderinout_copy(usage);
         transpile_statement_list(node->statements());
+        if (usage.written && node->typespec().is_void()) {
+            source->add_source_with_indent("(()");
+            emit_written_globals(usage.written);
+            source->add_source(")\n");
+        }
         source->pop_indent();
         source->add_source("}\n\n");
+        m_globals_written = outer_written;
     }
     this->in_shader = is;
 }
@@ -452,14 +932,7 @@ ArticTranspiler::transpile_variable_declaration(ASTvariable_declaration* node)
                        get_artic_type_string(node));
     if (node->init()) {
         source->add_source(" = ");
-        if (node->init()->nodetype()
-            != ASTNode::NodeType::type_constructor_node) {
-            auto cons = new ASTtype_constructor(node->typespec(),
-                                                node->init().get());
-            dispatch_node(cons);
-        } else {
-            dispatch_node(node->init());
-        }
+        transpile_as(node->typespec(), node->init());
     }
 }
 void
@@ -477,6 +950,11 @@ ArticTranspiler::transpile_compound_initializer(ASTcompound_initializer* node)
 void
 ArticTranspiler::transpile_variable_ref(ASTvariable_ref* node)
 {
+    auto folded = m_param_constants.find(node->sym());
+    if (folded != m_param_constants.end()) {
+        source->add_source(folded->second);  // Default of a folded param
+        return;
+    }
     source->add_source(node->name().string());
 }
 void
@@ -491,7 +969,12 @@ ArticTranspiler::transpile_preincdec(ASTpreincdec* node)
 void
 ArticTranspiler::transpile_postincdec(ASTpostincdec* node)
 {
-    NOT_IMPLEMENTED;
+    source->add_source("{let postincdec_old = ");
+    dispatch_node(node->var());
+    source->add_source("; ");
+    dispatch_node(node->var());
+    source->add_source(" ", node->is_increment() ? "+" : "-",
+                       "= 1; postincdec_old}");
 }
 void
 ArticTranspiler::transpile_index(ASTindex* node)
@@ -613,39 +1096,104 @@ ArticTranspiler::transpile_loop_statement(ASTloop_statement* node)
 void
 ArticTranspiler::transpile_loopmod_statement(ASTloopmod_statement* node)
 {
-    NOT_IMPLEMENTED;
+    unsupported(OIIO::Strutil::sprintf("'%s' statement", node->opname()));
 }
 void
 ArticTranspiler::transpile_return_statement(ASTreturn_statement* node)
 {
-    source->add_source("return(");
-    dispatch_node(node->expr());
+    bool with_globals = !this->in_shader && m_globals_written;
+    source->add_source("return(", with_globals ? "(" : "");
+    if (node->expr())
+        dispatch_node(node->expr());
+    else
+        source->add_source("()");
+    if (with_globals) {
+        emit_written_globals(m_globals_written);
+        source->add_source(")");
+    }
     source->add_source(")");
 }
 void
 ArticTranspiler::transpile_binary_expression(ASTbinary_expression* node)
 {
-    auto left  = node->left();
-    auto right = node->right();
-    if (node->is_boolean_operator()) {
+    auto left          = node->left();
+    auto right         = node->right();
+    std::string ltype  = get_artic_type_string(left);
+    std::string rtype  = get_artic_type_string(right);
+    std::string opword = node->opword();
+    bool scalars       = is_artic_scalar(ltype) && is_artic_scalar(rtype);
+    bool logical       = opword == "and" || opword == "or";
+    bool comparison    = node->is_boolean_operator() && !logical;
+    if (logical
+        || (comparison && !scalars && opword != "eq" && opword != "neq")) {
         source->add_source("(");
         dispatch_node(left);
         source->add_source(") ", node->opname(), " (");
         dispatch_node(right);
         source->add_source(")");
+    } else if (comparison && scalars) {
+        // Compare in the type OSL promotes the operands to.
+        std::string type = (ltype == "f32" || rtype == "f32") ? "f32" : ltype;
+        source->add_source("(");
+        transpile_converted(left, ltype, type);
+        source->add_source(" ", node->opname(), " ");
+        transpile_converted(right, rtype, type);
+        source->add_source(")");
+    } else if (scalars && opword != "mod" && opword != "div") {
+        // Native operator, with the operands converted to the result type
+        // the way OSL promotes them.
+        std::string type = get_artic_type_string(node);
+        source->add_source("(");
+        transpile_converted(left, ltype, type);
+        source->add_source(" ", node->opname(), " ");
+        transpile_converted(right, rtype, type);
+        source->add_source(")");
     } else {
-        source->add_source(
-            "ops_", artic_type_string_to_string(get_artic_type_string(left)),
-            "().", node->opword(), "_", get_artic_type_string(right), "(");
-        dispatch_node(left);
+        // Direct call to the monomorphic <op>_<lhs>_<rhs> of anyosl_std;
+        // integer operands of non-scalar ops are promoted to f32 first.
+        if (scalars) {
+            ltype = rtype = get_artic_type_string(node);
+        } else {
+            if (is_artic_scalar(ltype))
+                ltype = "f32";
+            if (is_artic_scalar(rtype))
+                rtype = "f32";
+        }
+        source->add_source(opword, "_", artic_type_string_to_string(ltype),
+                           "_", artic_type_string_to_string(rtype), "(");
+        transpile_converted(left, get_artic_type_string(left), ltype);
         source->add_source(", ");
-        dispatch_node(right);
+        transpile_converted(right, get_artic_type_string(right), rtype);
         source->add_source(")");
     }
 }
+
+
+
+void
+ArticTranspiler::transpile_converted(ASTNode::ref node,
+                                     const std::string& from,
+                                     const std::string& to)
+{
+    source->add_source("(");
+    dispatch_node(node);
+    source->add_source(")");
+    if (from != to)
+        source->add_source(" as ", to);
+}
+
+
+
 void
 ArticTranspiler::transpile_unary_expression(ASTunary_expression* node)
 {
+    std::string type = get_artic_type_string(node->expr());
+    if (!is_artic_scalar(type) && !strcmp(node->opname(), "-")) {
+        source->add_source("neg_", artic_type_string_to_string(type), "(");
+        dispatch_node(node->expr());
+        source->add_source(")");
+        return;
+    }
     source->add_source(node->opname(), "(");
     dispatch_node(node->expr());
     source->add_source(")");
@@ -664,9 +1212,7 @@ ArticTranspiler::transpile_assign_expression(ASTassign_expression* node)
     source->add_source(" = ");
 
     if (node->expr()->nodetype() == ASTNode::NodeType::literal_node) {
-        auto lit = new ASTtype_constructor(node->typespec(), node->expr().get());
-        dispatch_node(lit);
-        //delete lit;
+        transpile_constructor(node->typespec(), { node->expr() });
     } else {
         if(node->typespec() != node->expr()->typespec()){
             source->add_source("(");
@@ -696,64 +1242,124 @@ ArticTranspiler::transpile_ternary_expression(ASTternary_expression* node)
 void
 ArticTranspiler::transpile_comma_operator(ASTcomma_operator* node)
 {
-    NOT_IMPLEMENTED;
+    unsupported("comma operator");
 }
 void
 ArticTranspiler::transpile_typecast_expression(ASTtypecast_expression* node)
 {
-    source->add_source("ops_", get_artic_type_string(node->expr()), "().as_",
-                       get_artic_type_string(node), "(");
-    dispatch_node(node->expr());
-    source->add_source(")");
+    std::string from = get_artic_type_string(node->expr());
+    std::string to   = get_artic_type_string(node);
+    if (from == to || (is_artic_scalar(from) && is_artic_scalar(to))) {
+        transpile_converted(node->expr(), from, to);
+    } else if (is_artic_scalar(from) && node->typespec().is_triple()) {
+        source->add_source("splat_Vector(");
+        transpile_converted(node->expr(), from, "f32");
+        source->add_source(")");
+    } else {
+        source->add_source("as_", artic_type_string_to_string(to), "_",
+                           artic_type_string_to_string(from), "(");
+        dispatch_node(node->expr());
+        source->add_source(")");
+    }
 }
 void
 ArticTranspiler::transpile_type_constructor(ASTtype_constructor* node)
 {
-    if ((node->typespec() == node->args()->typespec() || (node->typespec().is_triple() && node->args()->typespec().is_triple()))
-        && !node->args()->next()) {  // copy-constructor
-        dispatch_node(node->args());
+    std::vector<ASTNode::ref> args;
+    for (ASTNode::ref a = node->args(); a; a = a->next())
+        args.push_back(a);
+    transpile_constructor(node->typespec(), args);
+}
+
+void
+ArticTranspiler::transpile_as(const TypeSpec& type, ASTNode::ref expr)
+{
+    if (expr->nodetype() == ASTNode::type_constructor_node)
+        dispatch_node(expr);
+    else
+        transpile_constructor(type, { expr });
+}
+
+void
+ArticTranspiler::transpile_constructor(const TypeSpec& type,
+                                       const std::vector<ASTNode::ref>& ctor_args)
+{
+    if (ctor_args.empty()) {
+        unsupported(OIIO::Strutil::sprintf("empty constructor of %s",
+                                           type.string()));
         return;
-    } else if (node->typespec().is_float()
-               || node->typespec()
-                      .is_int()) {
-        if(node->args()->nodetype() == ASTNode::NodeType::literal_node){
-            dispatch_node(node->args()); // initializing trivially with literal
+    }
+    const ASTNode::ref& first = ctor_args[0];
+    if ((type == first->typespec()
+         || (type.is_triple() && first->typespec().is_triple()))
+        && ctor_args.size() == 1) {  // copy-constructor
+        dispatch_node(first);
+        return;
+    } else if (type.is_float() || type.is_int()) {
+        if (first->nodetype() == ASTNode::NodeType::literal_node) {
+            dispatch_node(first);  // initializing trivially with literal
         } else {
             source->add_source("(");
-            dispatch_node(node->args());
-            source->add_source(") as ", get_artic_type_string(node));
+            dispatch_node(first);
+            source->add_source(") as ", artic_string(type, 0));
         }
-
         return;
-    } else if (node->typespec().is_closure()
-               && node->args()->typespec().is_int()) {
+    } else if (type.is_closure() && first->typespec().is_int()) {
         source->add_source("EMPTY_CLOSURE");
         return;
     }
 
-    std::vector<ASTNode::ref> args = {};
-    ASTNode::ref arg_node          = node->args();
-    while (arg_node) {
-        args.push_back(arg_node);
-        auto next = arg_node->next();
-        arg_node->detach_next();
-        arg_node = next;
+    std::vector<ASTNode::ref> args = ctor_args;
+    if (type.is_matrix() && args.size() == 1) {
+        // matrix(f) is f times the identity
+        source->add_source("diag_Matrix(");
+        transpile_converted(args[0], get_artic_type_string(args[0]), "f32");
+        source->add_source(")");
+        return;
     }
-    source->add_source(artic_string(node->typespec(), 0), "{");
-    if (node->typespec().is_triple()
+
+    // A triple in a named space, e.g. color("hsv", h, s, v) or
+    // point("object", x, y, z), is built as is and then converted to rgb
+    // or "common" space.
+    bool in_space = type.is_triple() && args.size() > 1
+                    && args[0]->typespec().is_string();
+    if (in_space) {
+        if (type.is_color()) {
+            add_string_constant("rgb");
+            source->add_source("transformc_String_String_Vector__Vector(");
+            dispatch_node(args[0]);
+            source->add_source(", String::rgb, ");
+        } else {
+            const char* kind = artic_triple_kind(type);
+            add_string_constant("common");
+            source->add_source("transform_String_String_", kind, "__", kind,
+                               "(");
+            dispatch_node(args[0]);
+            source->add_source(", String::common, ");
+        }
+        args.erase(args.begin());
+    }
+
+    source->add_source(artic_string(type, 0), "{");
+    if (type.is_triple()
         && args.size() == 1) {  // init triple with one value
         args.push_back(args[0]);
         args.push_back(args[0]);
     }
 
     for (size_t i = 0; i < args.size(); ++i) {
-        source->add_source(get_arg_name(node->typespec(), static_cast<int>(i)),
+        source->add_source(get_arg_name(type, static_cast<int>(i)),
                            " = ");
 
-        dispath_constructor_argument(node->typespec(), args[i], i);
+        dispath_constructor_argument(type, args[i], i);
         source->add_source(", ");
     }
     source->add_source("}");
+    if (in_space) {
+        source->add_source(", ");
+        emit_shaderinout_constructor();
+        source->add_source(")");
+    }
 }
 
 void
@@ -762,12 +1368,13 @@ ArticTranspiler::dispath_constructor_argument(TypeSpec ts, ASTNode::ref arg,
 {
     if (ts.is_triple()) {
         dispatch_node(arg);
+    } else if (ts.is_matrix()) {
+        transpile_converted(arg, get_artic_type_string(arg), "f32");
     } else if (ts.is_structure()) {
-        auto fs   = ts.structspec()->field(i).type;
-        auto cons = ASTtype_constructor(fs, arg.get());
-        transpile_type_constructor(&cons);
+        transpile_constructor(ts.structspec()->field(i).type, { arg });
     } else {
-        NOT_IMPLEMENTED;
+        unsupported(OIIO::Strutil::sprintf("constructor of %s",
+                                           ts.string()), arg.get());
     }
 }
 
@@ -776,18 +1383,42 @@ void
 ArticTranspiler::transpile_function_call(ASTfunction_call* node)
 {
     if (node->is_struct_ctr()) {
-        auto constructor = ASTtype_constructor(node);
-        transpile_type_constructor(&constructor);
+        std::vector<ASTNode::ref> args;
+        for (ASTNode::ref a = node->args(); a; a = a->next())
+            args.push_back(a);
+        transpile_constructor(node->typespec(), args);
     } else {
+        // A callee that writes globals returns them after its result;
+        // store them back into our (mutable) copies.
+        unsigned int callee_written = 0;
+        if (node->is_user_function()) {
+            if (m_failed_units.count(node->user_function()))
+                unsupported(OIIO::Strutil::sprintf(
+                    "call to untranspiled function %s", node->opname()));
+            callee_written = global_usage(node->user_function()).written;
+        }
+        if (callee_written) {
+            source->add_source("{ let (callee_result");
+            emit_written_globals(callee_written, "callee_");
+            source->add_source(") = ");
+        }
         std::vector<ASTNode::ref> args = {};
         auto arg_node                  = node->args();
+        bool by_kind = !node->is_user_function()
+                       && !strcmp(node->opname(), "transform");
         source->add_source(node->opname());
         while (arg_node) {
             args.push_back(arg_node);
-            source->add_source("_", get_artic_type_string(arg_node));
+            if (by_kind && arg_node->typespec().is_triple())
+                source->add_source("_", artic_triple_kind(arg_node->typespec()));
+            else
+                source->add_source("_", get_artic_type_string(arg_node));
             arg_node = arg_node->next();
         }
-        source->add_source("__", get_artic_type_string(node), "(");
+        if (by_kind && node->typespec().is_triple())
+            source->add_source("__", artic_triple_kind(node->typespec()), "(");
+        else
+            source->add_source("__", artic_return_mangling(node), "(");
 
         auto func_node                   = node->user_function();
         ASTvariable_declaration* argnode = nullptr;
@@ -807,11 +1438,22 @@ ArticTranspiler::transpile_function_call(ASTfunction_call* node)
             dispatch_node(arg);
             source->add_source(", ");
             if(arg->typespec().is_array()) {
-                source->add_source("||{", std::to_string(get_array_size(arg)), "}, ");
+                int size = get_array_size(arg);
+                if (size < 0)
+                    unsupported("array argument of unknown length", arg.get());
+                source->add_source("||{", std::to_string(size), "}, ");
             }
         }
         emit_shaderinout_constructor();
         source->add_source(")");
+        if (callee_written) {
+            source->add_source("; ");
+            for (int i = 0; i < nshader_globals; ++i)
+                if (callee_written & (1u << i))
+                    source->add_source(shader_globals[i].name, " = callee_",
+                                       shader_globals[i].name, "; ");
+            source->add_source("callee_result }");
+        }
     }
 }
 void
@@ -829,7 +1471,8 @@ ArticTranspiler::transpile_literal_node(ASTliteral* node)
         }
         source->add_source("String::", sval);
     } else {
-        NOT_IMPLEMENTED;
+        unsupported(OIIO::Strutil::sprintf("%s literal",
+                                           node->typespec().string()));
     }
 }
 
@@ -866,19 +1509,61 @@ ArticTranspiler::get_arg_name(TypeSpec typeSpec, int argnum)
         case 13: return "m4_n2";
         case 14: return "m4_n3";
         case 15: return "m4_n4";
-        default: NOT_IMPLEMENTED;
+        default: break;
         }
-    } else if (typeSpec.is_float() || typeSpec.is_int()) {
-        NOT_IMPLEMENTED;
-    } else {
-        NOT_IMPLEMENTED;
     }
+    unsupported(OIIO::Strutil::sprintf("constructor of %s with %d arguments",
+                                       typeSpec.string(), argnum + 1));
+    return "x";
 }
 void
 ArticTranspiler::add_string_constant(const std::string& s)
 {
     const_strings.insert(s);
 }
+
+// Shortest float literal that reads back as f: "0.5", "2.0", "1e-07".
+static bool
+artic_float_literal(float f, std::string& text)
+{
+    if (!std::isfinite(f))
+        return false;
+    text = OIIO::Strutil::sprintf("%.9g", f);
+    if (text.find_first_of(".e") == std::string::npos)
+        text += ".0";
+    return true;
+}
+
+std::string
+ArticTranspiler::constant_source(const ArticConstant& value)
+{
+    const TypeSpec& type = value.type;
+    std::string text, component;
+    if (type.is_int()) {
+        // Artic negates a literal after reading it, and 2147483648 is not
+        // an i32.
+        if (value.i == std::numeric_limits<int>::min())
+            return "(-2147483647 - 1)";
+        return std::to_string(value.i);
+    }
+    if (type.is_float())
+        return artic_float_literal(value.f[0], text) ? text : "";
+    if (type.is_string()) {
+        add_string_constant(value.s.string());
+        return "String::" + (value.s.empty() ? "empty_string"
+                                             : value.s.string());
+    }
+    if (!type.is_triple() && !type.is_matrix())
+        return "";
+    int n = type.is_triple() ? 3 : 16;
+    text  = artic_string(type, 0) + "{";
+    for (int k = 0; k < n; ++k) {
+        if (!artic_float_literal(value.f[k], component))
+            return "";
+        text += (k ? ", " : "") + get_arg_name(type, k) + " = " + component;
+    }
+    return text + "}";
+}
 void
 ArticTranspiler::generate_struct_definition(TypeSpec typeSpec)
 {
@@ -897,45 +1582,133 @@ ArticTranspiler::generate_struct_definition(TypeSpec typeSpec)
         source->add_source_with_indent("}\n\n");
     }
 }
+const ArticTranspiler::GlobalUsage&
+ArticTranspiler::global_usage(ASTNode* decl)
+{
+    auto found = m_global_usage.find(decl);
+    if (found != m_global_usage.end())
+        return found->second;
+    // Insert a placeholder first so that a (malformed) recursive call
+    // terminates instead of looping.
+    m_global_usage[decl] = GlobalUsage();
+    GlobalUsage usage;
+    if (decl->nodetype() == ASTNode::function_declaration_node)
+        collect_global_usage(
+            ((ASTfunction_declaration*)decl)->statements().get(), usage);
+    else if (decl->nodetype() == ASTNode::shader_declaration_node)
+        collect_global_usage(
+            ((ASTshader_declaration*)decl)->statements().get(), usage);
+    return m_global_usage[decl] = usage;
+}
+
+
+
 void
-ArticTranspiler::emit_shaderinout_copy()
+ArticTranspiler::collect_global_usage(ASTNode* node, GlobalUsage& usage)
 {
-    source->add_source_with_indent("let mut P = inout.P;\n");
-    source->add_source_with_indent("let I = inout.I;\n");
-    source->add_source_with_indent("let mut N = inout.N;\n");
-    source->add_source_with_indent("let Ng = inout.Ng;\n");
-    source->add_source_with_indent("let dPdu = inout.dPdu;\n");
-    source->add_source_with_indent("let dPdv = inout.dPdv;\n");
-    source->add_source_with_indent("let Ps = inout.Ps;\n");
-    source->add_source_with_indent("let u = inout.u;\n");
-    source->add_source_with_indent("let v = inout.v;\n");
-    source->add_source_with_indent("let time = inout.time;\n");
-    source->add_source_with_indent("let dtime = inout.dtime;\n");
-    source->add_source_with_indent("let dPdtime = inout.dPdtime;\n");
-    source->add_source_with_indent("let mut Ci = inout.Ci;\n");
+    for (; node; node = node->nextptr()) {
+        switch (node->nodetype()) {
+        case ASTNode::variable_ref_node: {
+            int g = shader_global_index(node);
+            if (g >= 0)
+                usage.read |= 1u << g;
+            break;
+        }
+        case ASTNode::assign_expression_node:
+            mark_global_write(((ASTassign_expression*)node)->var().get(),
+                              usage);
+            break;
+        case ASTNode::preincdec_node:
+            mark_global_write(((ASTpreincdec*)node)->var().get(), usage);
+            break;
+        case ASTNode::postincdec_node:
+            mark_global_write(((ASTpostincdec*)node)->var().get(), usage);
+            break;
+        case ASTNode::function_call_node: {
+            auto call = (ASTfunction_call*)node;
+            if (!call->is_user_function())
+                break;
+            auto callee = call->user_function();
+            usage.written |= global_usage(callee).written;
+            // Globals passed to output parameters are written too.
+            ASTNode* formal = callee->formals().get();
+            for (ASTNode* arg = call->args().get(); arg && formal;
+                 arg = arg->nextptr(), formal = formal->nextptr())
+                if (((ASTvariable_declaration*)formal)->is_output())
+                    mark_global_write(arg, usage);
+            break;
+        }
+        default: break;
+        }
+        for (size_t i = 0, e = node->nchildren(); i < e; ++i)
+            collect_global_usage(node->child(i), usage);
+    }
+}
+
+
+
+void
+ArticTranspiler::mark_global_write(ASTNode* lvalue, GlobalUsage& usage)
+{
+    while (lvalue) {
+        if (lvalue->nodetype() == ASTNode::index_node)
+            lvalue = ((ASTindex*)lvalue)->lvalue().get();
+        else if (lvalue->nodetype() == ASTNode::structselect_node)
+            lvalue = ((ASTstructselect*)lvalue)->lvalue().get();
+        else
+            break;
+    }
+    int g = shader_global_index(lvalue);
+    if (g >= 0)
+        usage.written |= 1u << g;
+}
+
+
+
+void
+ArticTranspiler::emit_shaderinout_copy(const GlobalUsage& usage)
+{
+    for (int i = 0; i < nshader_globals; ++i) {
+        unsigned int bit = 1u << i;
+        if (usage.written & bit)
+            source->add_source_with_indent("let mut ", shader_globals[i].name,
+                                           " = inout.",
+                                           shader_globals[i].name, ";\n");
+        else if (usage.read & bit)
+            source->add_source_with_indent("let ", shader_globals[i].name,
+                                           " = inout.",
+                                           shader_globals[i].name, ";\n");
+    }
 }
+
+
+
 void
 ArticTranspiler::emit_shaderinout_constructor()
 {
+    if (!m_globals_written) {
+        source->add_source("inout");
+        return;
+    }
     source->add_source("shader_inout {\n");
     source->push_indent();
-    source->add_source_with_indent("P = P,\n");
-    source->add_source_with_indent("I = I,\n");
-    source->add_source_with_indent("N = N,\n");
-    source->add_source_with_indent("Ng = Ng,\n");
-    source->add_source_with_indent("dPdu = dPdu,\n");
-    source->add_source_with_indent("dPdv = dPdv,\n");
-    source->add_source_with_indent("Ps = Ps,\n");
-    source->add_source_with_indent("u = u,\n");
-    source->add_source_with_indent("v = v,\n");
-    source->add_source_with_indent("time = time,\n");
-    source->add_source_with_indent("dtime = dtime,\n");
-    source->add_source_with_indent("dPdtime = dPdtime,\n");
-    source->add_source_with_indent("Ci = Ci,\n");
+    for (int i = 0; i < nshader_globals; ++i) {
+        const char* name = shader_globals[i].name;
+        if (m_globals_written & (1u << i))
+            source->add_source_with_indent(name, " = ", name, ",\n");
+        else
+            source->add_source_with_indent(name, " = inout.", name, ",\n");
+    }
     source->pop_indent();
     source->add_source_with_indent("}");
 }
 
 
 
-OSL_NAMESPACE_EXIT
\ No newline at end of file
+void
+ArticTranspiler::emit_written_globals(unsigned int written, const char* prefix)
+{
+    for (int i = 0; i < nshader_globals; ++i)
+        if (written & (1u << i))
+            source->add_source(", ", prefix, shader_globals[i].name);
+}
@@ -6,30 +6,33 @@
 #define OSL_ARTIC_H
 
 #include <iostream>
+#include <map>
 #include <string>
 #include <utility>
 #include "ast.h"
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 OSL_NAMESPACE_ENTER
 
 
-#define NOT_IMPLEMENTED                  \
-    do {                                 \
-        std::cerr << "NOT IMPLEMENTED "; \
-        OSL_ASSERT(false);               \
-        exit(3);                         \
-    } while (0)
-
-
 using namespace pvt;
 
+/// Version of anyosl_std.art that the generated code is written against.
+/// Bump it (together with the header comment of anyosl_std.art) whenever
+/// the transpiler starts relying on new or changed runtime declarations,
+/// so that cached transpilations are invalidated.
+constexpr int anyosl_std_version = 7;
+
 std::string
 artic_type_string_to_string(std::string in);
 
 const std::string
 artic_string(TypeSpec typeSpec, int array_size);
 
+/// Number of elements of an array-typed expression, or -1 if it cannot
+/// be determined at transpile time.
 int
 get_array_size(ASTNode::ref init);
 
@@ -40,23 +43,31 @@ const std::string
 artic_simpletype(TypeDesc typedesc);
 
 
+/// Accumulates generated Artic code. If a sink is given, the buffer is
+/// handed to it whenever it grows past the flush threshold (and on
+/// flush() or destruction), so memory use stays bounded no matter how
+/// large the transpiled program gets. Without a sink, get_code() returns
+/// everything emitted so far.
 class ArticSource {
 public:
-    ArticSource(std::string indent_string)
-        : m_indent(0), m_indent_string(std::move(indent_string)), m_code() {};
-
-    template <typename ... Args>
-    void add_source_with_indent(const std::string& code, Args ... args);
-
-
-
-    template <typename ... Args>
-    void add_source(const std::string& code, Args ... args);
-    inline void add_source(){};
-
-
-
-
+    ArticSource(std::string indent_string, std::ostream* sink = nullptr,
+                size_t flush_threshold = 1 << 16)
+        : m_indent(0)
+        , m_indent_string(std::move(indent_string))
+        , m_indents(1)
+        , m_sink(sink)
+        , m_flush_threshold(flush_threshold)
+    {
+        m_code.reserve(flush_threshold + flush_threshold / 4);
+    }
+    ~ArticSource() { flush(); }
+
+    template<typename... Args>
+    void add_source_with_indent(string_view code, const Args&... args);
+
+    template<typename... Args>
+    void add_source(string_view code, const Args&... args);
+    void add_source() { maybe_flush(); }
 
     void newline();
     int push_indent();
@@ -64,29 +75,104 @@ public:
     std::string get_code();
     void print();
 
+    /// Hand everything buffered so far to the sink, if there is one.
+    void flush();
+
+    /// Keep everything emitted from now on buffered, so that it can be
+    /// dropped with rollback(); release() resumes normal flushing.
+    void hold()
+    {
+        m_hold = m_code.size();
+        m_holding = true;
+    }
+    void rollback() { m_code.resize(m_hold); }
+    void release()
+    {
+        m_holding = false;
+        maybe_flush();
+    }
 
 private:
+    void maybe_flush()
+    {
+        if (m_sink && !m_holding && m_code.size() >= m_flush_threshold)
+            flush();
+    }
+
     int m_indent;
     std::string m_indent_string;
+    std::vector<std::string> m_indents;  ///< Indent string per nesting level
     std::string m_code;
+    std::ostream* m_sink;
+    size_t m_flush_threshold;
+    size_t m_hold  = 0;  ///< Start of the held code
+    bool m_holding = false;
 };
 
 
+/// Compile-time value of a literal-only expression, e.g. a shader
+/// parameter default like 0.5 * 2 or color(1, 0, 0).
+struct ArticConstant {
+    TypeSpec type;
+    float f[16] = {};  ///< Components of a float, triple or matrix
+    int i       = 0;
+    ustring s;
+};
+
+/// Fold node to a constant if it only involves literals, arithmetic,
+/// conversions and the already folded parameters in params.
+bool
+fold_artic_constant(const ASTNode* node,
+                    const std::unordered_map<const Symbol*, ArticConstant>& params,
+                    ArticConstant& value);
+
+/// Convert a folded constant to another type, as an initializer would.
+bool
+convert_artic_constant(ArticConstant& value, const TypeSpec& to);
+
+
 class ArticTranspiler {
 
 
 public:
 
-    ArticTranspiler(ArticSource* source, OSLCompiler* compiler) : source(source) {}
+    /// Constructs the transpiler cannot handle are reported through the
+    /// compiler, located at the offending node: as errors by default, or
+    /// as warnings if partial is set, in which case the functions that
+    /// contain them are left out and everything else is still emitted.
+    /// The batched entry points shade vector_width lanes per packet.
+    ArticTranspiler(ArticSource* source, OSLCompilerImpl* compiler,
+                    bool partial = false, int vector_width = 8)
+        : source(source)
+        , m_compiler(compiler)
+        , m_partial(partial)
+        , m_vector_width(vector_width)
+    {
+    }
     void dispatch_node(ASTNode::ref);
     void generate_struct_definition(TypeSpec typeSpec);
 
+    /// Transpile a top-level function or shader declaration, dropping
+    /// its code if it turns out to contain unsupported constructs.
+    void transpile_unit(ASTNode::ref decl);
+
+    /// Summarize, for the given file, which functions were left out and
+    /// why. Returns the number of functions left out.
+    int report_summary(ustring filename);
+
 private:
 
     bool in_shader = false;
 
     void transpile_shader_declaration(ASTshader_declaration* node);
 
+    /// Emit <shader>_batched, which runs <shader>_impl over buffers of
+    /// shading points using the AnyDSL parallel/vectorize combinators.
+    void emit_batched_entry_point(
+        const std::string& shadername,
+        const std::vector<ASTvariable_declaration*>& outputs,
+        unsigned int written);
+
     void transpile_function_declaration(ASTfunction_declaration* node);
 
     void transpile_variable_declaration(ASTvariable_declaration* node);
@@ -113,6 +199,10 @@ private:
 
     void transpile_binary_expression(ASTbinary_expression* node);
 
+    /// Emit node (of Artic type 'from') as a value of type 'to'.
+    void transpile_converted(ASTNode::ref node, const std::string& from,
+                             const std::string& to);
+
     void transpile_unary_expression(ASTunary_expression* node);
 
     void transpile_assign_expression(ASTassign_expression* node);
@@ -125,6 +215,16 @@ private:
 
     void transpile_type_constructor(ASTtype_constructor* node);
 
+    /// Emit a value of the given type built from args, as a type
+    /// constructor would. Works straight on the argument nodes, so no
+    /// synthetic ASTtype_constructor is needed for conversions.
+    void transpile_constructor(const TypeSpec& type,
+                               const std::vector<ASTNode::ref>& args);
+
+    /// Emit expr converted to the given type, as initializers and
+    /// assignments do.
+    void transpile_as(const TypeSpec& type, ASTNode::ref expr);
+
     void transpile_function_call(ASTfunction_call* node);
 
     void transpile_literal_node(ASTliteral* node);
@@ -133,12 +233,40 @@ private:
 
     void dispath_constructor_argument(TypeSpec ts, ASTNode::ref arg, int i);
 
-    void emit_shaderinout_copy();
+    /// Which shader_inout fields a function (or shader) touches, one bit
+    /// per entry of the shader globals table in artic.cpp.
+    struct GlobalUsage {
+        unsigned int read    = 0;  ///< Referenced directly in the body
+        unsigned int written = 0;  ///< Written by the body or a user callee
+    };
+
+    /// Usage of the user function or shader declaration, computed once
+    /// and cached.
+    const GlobalUsage& global_usage(ASTNode* decl);
 
+    void collect_global_usage(ASTNode* node, GlobalUsage& usage);
+
+    void mark_global_write(ASTNode* lvalue, GlobalUsage& usage);
+
+    /// Copy only the used globals out of inout; written ones are mutable.
+    void emit_shaderinout_copy(const GlobalUsage& usage);
+
+    /// The shader_inout to hand to a callee: inout itself unless the
+    /// current function has written some globals.
     void emit_shaderinout_constructor();
 
+    /// ", P, N" -- the written globals that follow a function's result.
+    void emit_written_globals(unsigned int written, const char* prefix = "");
+
     std::string get_arg_name(TypeSpec typeSpec, int argnum);
 
+    /// Artic literal for a folded constant, or "" if it has none.
+    std::string constant_source(const ArticConstant& value);
+
+    /// Report a construct the transpiler cannot express in Artic, at node
+    /// (or the node being transpiled), and emit a placeholder for it.
+    void unsupported(string_view what, const ASTNode* node = nullptr);
+
     void add_string_constant(const std::string& s);
 
 
@@ -148,6 +276,20 @@ private:
     ArticSource* source;
 
     std::unordered_set<std::string> const_strings = {};
+
+    std::unordered_map<const ASTNode*, GlobalUsage> m_global_usage;
+    unsigned int m_globals_written = 0;  ///< Mutable globals in scope
+
+    OSLCompilerImpl* m_compiler;
+    bool m_partial;
+    int m_vector_width;  ///< Lanes per packet, a literal in the output
+    const ASTNode* m_current_node = nullptr;  ///< Innermost node dispatched
+    std::map<std::string, int> m_unit_unsupported;  ///< Construct -> count
+    int m_units = 0;                                 ///< Units transpiled
+    std::unordered_set<const ASTNode*> m_failed_units;
+    std::vector<std::string> m_failures;  ///< "name (what x2, ...)"
+    /// Literals of the folded parameters, while make_<shader>_in is emitted
+    std::unordered_map<const Symbol*, std::string> m_param_constants;
 };
 
 OSL_NAMESPACE_EXIT
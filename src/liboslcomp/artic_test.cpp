@@ -0,0 +1,634 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/timer.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/oslcomp.h>
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#    include <psapi.h>
+#else
+#    include <sys/resource.h>
+#endif
+
+using namespace OSL;
+
+static bool verbose   = false;
+static int nfunctions = 200;
+static int ntrials    = 1;
+static std::string stdoslpath = OSL_SHADER_SOURCE_DIR "/stdosl.h";
+
+
+
+static void
+getargs(int argc, char* argv[])
+{
+    bool help = false;
+    OIIO::ArgParse ap;
+    ap.options("artic_test\n" OIIO_INTRO_STRING "\n"
+               "Usage:  artic_test [options]",
+               "--help", &help, "Print help message",
+               "-v", &verbose, "Verbose mode",
+               "--functions %d", &nfunctions,
+               "Number of functions in the generated shader (default: 200)",
+               "--trials %d", &ntrials, "Number of trials",
+               "--stdosl %s", &stdoslpath, "Path to stdosl.h",
+               NULL);
+    if (ap.parse(argc, (const char**)argv) < 0) {
+        std::cerr << ap.geterror() << std::endl;
+        ap.usage();
+        exit(EXIT_FAILURE);
+    }
+    if (help) {
+        ap.usage();
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+
+// Generate a shader with a long chain of user functions, each with a
+// loop, a conditional and a call to its predecessor -- the shape of the
+// big shader libraries whose transpile time we care about.
+static std::string
+make_big_shader(int nfuncs)
+{
+    std::string src;
+    for (int i = 0; i < nfuncs; ++i) {
+        src += OIIO::Strutil::sprintf(
+            "float bench_f%d(float x, color c)\n"
+            "{\n"
+            "    float r = x * %d.0 + c[%d];\n"
+            "    for (int k = 0; k < 4; ++k) {\n"
+            "        if (r > 1.0) {\n"
+            "            r = r * 0.5;\n"
+            "        } else {\n"
+            "            r = r + %s;\n"
+            "        }\n"
+            "    }\n"
+            "    return r;\n"
+            "}\n\n",
+            i, i + 1, i % 3,
+            i ? OIIO::Strutil::sprintf("bench_f%d(x, c)", i - 1) : "x");
+    }
+    src += OIIO::Strutil::sprintf(
+        "shader artic_bench(float Kd = 0.5, color Cs = color(1, 0.5, 0.25),\n"
+        "                   output float result = 0)\n"
+        "{\n"
+        "    result = bench_f%d(Kd, Cs);\n"
+        "}\n",
+        nfuncs - 1);
+    return src;
+}
+
+
+
+// Peak resident set size of the process so far, in bytes.
+static size_t
+peak_memory_used()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                             sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#    ifdef __APPLE__
+    return size_t(usage.ru_maxrss);  // already in bytes
+#    else
+    return size_t(usage.ru_maxrss) * 1024;  // in kilobytes
+#    endif
+#endif
+}
+
+
+
+// Compile the source file for the given target into a file, as oslc
+// does, returning the wall time of the best trial and the size of the
+// generated output.
+static double
+time_compile(const std::string& srcfile, const char* target, size_t& outsize)
+{
+    std::string outfile = OIIO::Filesystem::replace_extension(
+        srcfile, strcmp(target, "artic") ? ".oso" : ".art");
+    std::vector<std::string> options { "-q", "-t", target, "-o", outfile };
+    double best = 1.0e30;
+    for (int t = 0; t < ntrials; ++t) {
+        OSLCompiler compiler;
+        OIIO::Timer timer;
+        bool ok = compiler.compile(srcfile, options, stdoslpath);
+        best = std::min(best, timer());
+        OIIO_CHECK_ASSERT(ok);
+        outsize = OIIO::Filesystem::file_size(outfile);
+    }
+    if (verbose && !strcmp(target, "artic")) {
+        std::string output;
+        OIIO::Filesystem::read_text_file(outfile, output);
+        std::cout << output << "\n";
+    }
+    OIIO::Filesystem::remove(outfile);
+    return best;
+}
+
+
+
+// Functions only receive the shader globals they use, and hand the ones
+// they write back to the caller.
+static void
+test_global_usage()
+{
+    const char* source
+        = "float scale(float x) { return x * 2; }\n"
+          "void displace(float amount) { P += N * amount; }\n"
+          "shader globals_test(float Kd = 0.5, output float result = 0)\n"
+          "{\n"
+          "    displace(scale(Kd));\n"
+          "    result = u;\n"
+          "}\n";
+    std::vector<std::string> options { "-q", "-t", "artic" };
+    OSLCompiler compiler;
+    std::string output;
+    bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                      "globals_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    if (verbose)
+        std::cout << output << "\n";
+
+    // scale() touches no globals: no copies, inout passed straight on.
+    size_t scale    = output.find("fn @scale_f32__f32(");
+    size_t displace = output.find("fn @displace_f32__void(");
+    OIIO_CHECK_ASSERT(scale != std::string::npos);
+    OIIO_CHECK_ASSERT(displace != std::string::npos);
+    std::string scale_body = output.substr(scale, displace - scale);
+    OIIO_CHECK_EQUAL(scale_body.find("inout."), std::string::npos);
+    OIIO_CHECK_ASSERT(scale_body.find(") ->f32{") != std::string::npos);
+
+    // displace() writes P and reads N, and returns the new P.
+    std::string displace_body = output.substr(displace);
+    OIIO_CHECK_ASSERT(displace_body.find("let mut P = inout.P;")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(displace_body.find("let N = inout.N;")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(displace_body.find(") ->((), Point){")
+                      != std::string::npos);
+    OIIO_CHECK_EQUAL(displace_body.find("let Ng = inout.Ng;"),
+                     std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("P = callee_P;") != std::string::npos);
+
+    // The batched entry point stores back only what the shader writes.
+    OIIO_CHECK_ASSERT(output.find("fn @globals_test_batched(")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("store_Vector_soa(globals.P, i, inout.P);")
+                      != std::string::npos);
+    OIIO_CHECK_EQUAL(output.find("store_Vector_soa(globals.N"),
+                     std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("outputs.result(i) = out.result;")
+                      != std::string::npos);
+
+    // The packet width is a literal, so vectorize() sees a constant.
+    OIIO_CHECK_ASSERT(output.find("_out_soa, count: i32) -> () {")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("for_each_packet(count, 8)")
+                      != std::string::npos);
+    options.insert(options.end(), { "-artic-vector-width", "16" });
+    ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                 "globals_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    OIIO_CHECK_ASSERT(output.find("for_each_packet(count, 16)")
+                      != std::string::npos);
+}
+
+
+
+// A parameter default that writes a global is evaluated in the shader
+// body too, so that the write isn't lost with make_X_in's copy.
+static void
+test_default_writes_global()
+{
+    const char* source
+        = "float grow() { P *= 2; return 1; }\n"
+          "shader default_test(float k = grow(), output float result = 0)\n"
+          "{\n"
+          "    result = k;\n"
+          "}\n";
+    std::vector<std::string> options { "-q", "-t", "artic" };
+    OSLCompiler compiler;
+    std::string output;
+    bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                      "default_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    if (verbose)
+        std::cout << output << "\n";
+    size_t impl = output.find("fn @default_test_impl(");
+    OIIO_CHECK_ASSERT(impl != std::string::npos);
+    std::string impl_body = output.substr(impl, output.find("\n}\n", impl)
+                                                    - impl);
+    OIIO_CHECK_ASSERT(impl_body.find("let mut P = inout.P;")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(impl_body.find("let k: f32 = ") != std::string::npos);
+    OIIO_CHECK_EQUAL(impl_body.find("let k = arg_in.k;"), std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("store_Vector_soa(globals.P, i, inout.P);")
+                      != std::string::npos);
+}
+
+
+
+// Operators resolve to native scalar ops or monomorphic std calls.
+static void
+test_operators()
+{
+    const char* source
+        = "shader operator_test(float Kd = 0.5, int n = 2,\n"
+          "                     output color result = 0)\n"
+          "{\n"
+          "    float f = Kd * n;\n"
+          "    result = (N + P) * f - n * color(1);\n"
+          "    Ci = diffuse(N) * Kd + reflection(N, 1.5) * n;\n"
+          "}\n";
+    std::vector<std::string> options { "-q", "-t", "artic" };
+    OSLCompiler compiler;
+    std::string output;
+    bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                      "operator_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    if (verbose)
+        std::cout << output << "\n";
+    OIIO_CHECK_EQUAL(output.find("ops_"), std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("(Kd) * (n) as f32") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("add_Vector_Vector(") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("mul_Vector_f32(") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("mul_f32_Vector((n) as f32, ")
+                      != std::string::npos);
+    // Closures are data: weights scale, sums concatenate.
+    OIIO_CHECK_ASSERT(output.find("add_Closure_Closure(") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("mul_Closure_f32(") != std::string::npos);
+}
+
+
+
+// Comparisons promote mixed int/float operands, triples and matrices
+// compare with scalars through std helpers, and scalar division is safe.
+static void
+test_compare_and_divide()
+{
+    const char* source
+        = "shader compare_test(float Kd = 0.5, int n = 2,\n"
+          "                    output float result = 0)\n"
+          "{\n"
+          "    vector V = N;\n"
+          "    matrix M = 1;\n"
+          "    if (n < Kd)\n"
+          "        result = 1;\n"
+          "    if (V == 1)\n"
+          "        result = 2;\n"
+          "    if (M != 2)\n"
+          "        result = 3;\n"
+          "    result = result + Kd / n + n / 3;\n"
+          "}\n";
+    std::vector<std::string> options { "-q", "-t", "artic" };
+    OSLCompiler compiler;
+    std::string output;
+    bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                      "compare_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    if (verbose)
+        std::cout << output << "\n";
+    OIIO_CHECK_ASSERT(output.find("((n) as f32 < (Kd))") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("eq_Vector_f32((V), ") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("neq_Matrix_f32((M), ")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("div_f32_f32((Kd), (n) as f32)")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("div_i32_i32((n), ") != std::string::npos);
+
+    std::string std_art;
+    OIIO_CHECK_ASSERT(OIIO::Filesystem::read_text_file(
+        OSL_ARTIC_SOURCE_DIR "/anyosl_std.art", std_art));
+    for (const char* fn : { "eq_Vector_f32(", "neq_Vector_f32(",
+                            "eq_Matrix_f32(", "neq_Matrix_f32(",
+                            "div_f32_f32(", "div_i32_i32(" }) {
+        OIIO_CHECK_ASSERT(std_art.find(std::string("fn @") + fn)
+                          != std::string::npos);
+    }
+}
+
+
+
+// Noise, matrix and color builtins map onto the anyosl_std ports.
+static void
+test_std_builtins()
+{
+    const char* source
+        = "shader builtins_test(float noise_factor = 0.5, float s = 2,\n"
+          "                     output color result = 0)\n"
+          "{\n"
+          "    matrix M = matrix(s);\n"
+          "    point p = transform(M, P);\n"
+          "    normal n = transform(M, N);\n"
+          "    float f = mix(1.0, noise(p * 10.0), noise_factor);\n"
+          "    result = color(\"hsv\", f, 1, 1) * luminance(color(n));\n"
+          "}\n";
+    std::vector<std::string> options { "-q", "-t", "artic" };
+    OSLCompiler compiler;
+    std::string output;
+    bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                      "builtins_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    if (verbose)
+        std::cout << output << "\n";
+    OIIO_CHECK_ASSERT(output.find("diag_Matrix((s))") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("transform_Matrix_Point__Point(")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("transform_Matrix_Normal__Normal(")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("noise_Vector__f32(") != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("mix_f32_f32_f32__f32(")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("transformc_String_String_Vector__Vector("
+                                  "String::hsv, String::rgb, Vector{")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(output.find("luminance_Vector__f32(")
+                      != std::string::npos);
+}
+
+
+
+// Transforms by space name: every function the transpiler calls for them
+// must be defined by anyosl_std.art or the integration example.
+static void
+test_space_transforms()
+{
+    const char* source
+        = "shader spaces_test(output point Pout = 0,\n"
+          "                   output vector Vout = 0,\n"
+          "                   output normal Nout = 0)\n"
+          "{\n"
+          "    Pout = point(\"object\", u, v, 1)\n"
+          "           + transform(\"shader\", P);\n"
+          "    Vout = vector(\"shader\", 1, 0, 0);\n"
+          "    Nout = transform(\"object\", \"world\", N);\n"
+          "}\n";
+    std::vector<std::string> options { "-q", "-t", "artic" };
+    OSLCompiler compiler;
+    std::string output;
+    bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                      "spaces_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    if (verbose)
+        std::cout << output << "\n";
+
+    std::string defs;
+    for (const char* file :
+         { "anyosl_std.art", "anyosl_integration_example.art" }) {
+        std::string text;
+        OIIO_CHECK_ASSERT(OIIO::Filesystem::read_text_file(
+            std::string(OSL_ARTIC_SOURCE_DIR "/") + file, text));
+        defs += text;
+    }
+    const char* expected[] = {
+        "transform_String_String_Point__Point(",
+        "transform_String_Point__Point(",
+        "transform_String_String_Vector__Vector(",
+        "transform_String_String_Normal__Normal(",
+    };
+    for (const char* fn : expected) {
+        OIIO_CHECK_ASSERT(output.find(fn) != std::string::npos);
+        OIIO_CHECK_ASSERT(defs.find(std::string("fn @") + fn)
+                          != std::string::npos);
+    }
+}
+
+
+
+// Literal-only parameter defaults become struct fields of make_X_in;
+// the rest are still computed there.
+static void
+test_param_folding()
+{
+    const char* source
+        = "shader fold_test(float Kd = 0.5 * 2, int n = 3, float fk = n,\n"
+          "                 color Cs = color(1, 0.5, 0.25) * Kd,\n"
+          "                 string name = \"fold\", float fu = u * Kd,\n"
+          "                 int wrap = 2147483647 * 2,\n"
+          "                 int lowest = 2147483647 + 1,\n"
+          "                 output float result = 0)\n"
+          "{\n"
+          "    result = Kd * fk * fu;\n"
+          "}\n";
+    std::vector<std::string> options { "-q", "-t", "artic" };
+    OSLCompiler compiler;
+    std::string output;
+    bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                      "fold_test.osl");
+    OIIO_CHECK_ASSERT(ok);
+    if (verbose)
+        std::cout << output << "\n";
+    size_t make = output.find("fn make_fold_test_in(");
+    OIIO_CHECK_ASSERT(make != std::string::npos);
+    std::string make_in = output.substr(make, output.find("\n}\n", make)
+                                                  - make);
+    OIIO_CHECK_ASSERT(make_in.find("Kd = 1.0,") != std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("n = 3,") != std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("fk = 3.0,") != std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("Cs = Vector{x = 1.0, y = 0.5, z = 0.25},")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("name = String::fold,")
+                      != std::string::npos);
+    // int folding wraps like Artic's i32 does.
+    OIIO_CHECK_ASSERT(make_in.find("wrap = -2,") != std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("lowest = (-2147483647 - 1),")
+                      != std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("let Kd") == std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("let Cs") == std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("let fu: f32 = ") != std::string::npos);
+    OIIO_CHECK_ASSERT(make_in.find("fu = fu,") != std::string::npos);
+}
+
+
+
+// Collects compiler diagnostics instead of printing them.
+class CaptureErrors final : public ErrorHandler {
+public:
+    void operator()(int /*errcode*/, const std::string& msg) override
+    {
+        messages += msg + "\n";
+    }
+    std::string messages;
+};
+
+
+
+// Unsupported constructs are diagnosed at their source location; with
+// -artic-partial only the functions containing them are left out.
+static void
+test_unsupported()
+{
+    const char* source
+        = "float first_positive(float a[4])\n"
+          "{\n"
+          "    for (int i = 0; i < 4; i++)\n"
+          "        if (a[i] > 0)\n"
+          "            break;\n"
+          "    return 0;\n"
+          "}\n"
+          "float twice(float x) { return x * 2; }\n"
+          "shader partial_test(float Kd = 0.5, output float result = 0)\n"
+          "{\n"
+          "    result = twice(Kd);\n"
+          "}\n";
+
+    {
+        CaptureErrors errors;
+        OSLCompiler compiler(&errors);
+        std::vector<std::string> options { "-q", "-t", "artic" };
+        std::string output;
+        bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                          "partial_test.osl");
+        if (verbose)
+            std::cout << errors.messages << "\n";
+        OIIO_CHECK_ASSERT(!ok);
+        OIIO_CHECK_ASSERT(
+            errors.messages.find(
+                "partial_test.osl:5: error: Artic: unsupported 'break' statement")
+            != std::string::npos);
+    }
+
+    {
+        CaptureErrors errors;
+        OSLCompiler compiler(&errors);
+        std::vector<std::string> options { "-q", "-t", "artic",
+                                           "-artic-partial" };
+        std::string output;
+        bool ok = compiler.compile_buffer(source, output, options, stdoslpath,
+                                          "partial_test.osl");
+        if (verbose)
+            std::cout << errors.messages << "\n" << output << "\n";
+        OIIO_CHECK_ASSERT(ok);
+        OIIO_CHECK_ASSERT(
+            output.find("// first_positive: not transpiled ('break' statement)")
+            != std::string::npos);
+        OIIO_CHECK_EQUAL(output.find("fn @first_positive"), std::string::npos);
+        OIIO_CHECK_ASSERT(output.find("fn @twice_f32__f32(")
+                          != std::string::npos);
+        OIIO_CHECK_ASSERT(output.find("fn @partial_test_batched(")
+                          != std::string::npos);
+        OIIO_CHECK_ASSERT(
+            errors.messages.find("1 of 3 functions not transpiled")
+            != std::string::npos);
+    }
+
+    {
+        // A failed compile to a file reports the construct once, not again
+        // at the call site, and leaves no partial .art behind.
+        std::string srcfile = OIIO::Filesystem::unique_path(
+            OIIO::Filesystem::temp_directory_path()
+            + "/partial_test_%%%%-%%%%.osl");
+        std::string outfile = OIIO::Filesystem::replace_extension(srcfile,
+                                                                  ".art");
+        OIIO::ofstream out;
+        OIIO::Filesystem::open(out, srcfile);
+        out << "float first_positive(float a[4])\n"
+               "{\n"
+               "    for (int i = 0; i < 4; i++)\n"
+               "        if (a[i] > 0)\n"
+               "            break;\n"
+               "    return 0;\n"
+               "}\n"
+               "shader caller_test(float a[4] = { 1, 2, 3, 4 },\n"
+               "                   output float result = 0)\n"
+               "{\n"
+               "    result = first_positive(a);\n"
+               "}\n";
+        out.close();
+        CaptureErrors errors;
+        OSLCompiler compiler(&errors);
+        std::vector<std::string> options { "-q", "-t", "artic", "-o",
+                                           outfile };
+        bool ok = compiler.compile(srcfile, options, stdoslpath);
+        if (verbose)
+            std::cout << errors.messages << "\n";
+        OIIO_CHECK_ASSERT(!ok);
+        OIIO_CHECK_ASSERT(errors.messages.find("unsupported 'break' statement")
+                          != std::string::npos);
+        OIIO_CHECK_EQUAL(errors.messages.find("untranspiled function"),
+                         std::string::npos);
+        OIIO_CHECK_ASSERT(!OIIO::Filesystem::exists(outfile));
+        OIIO::Filesystem::remove(srcfile);
+        OIIO::Filesystem::remove(outfile);
+    }
+}
+
+
+
+static void
+test_transpile_big_shader()
+{
+    std::string source  = make_big_shader(nfunctions);
+    std::string srcfile = OIIO::Filesystem::unique_path(
+        OIIO::Filesystem::temp_directory_path() + "/artic_bench-%%%%%%.osl");
+    {
+        OIIO::ofstream out;
+        OIIO::Filesystem::open(out, srcfile);
+        out << source;
+    }
+    size_t peak_before = peak_memory_used();
+
+    size_t oso_size = 0, artic_size = 0;
+    double oso_time   = time_compile(srcfile, "oso", oso_size);
+    size_t peak_oso   = peak_memory_used();
+    double artic_time = time_compile(srcfile, "artic", artic_size);
+    size_t peak_artic = peak_memory_used();
+    OIIO::Filesystem::remove(srcfile);
+    OIIO_CHECK_ASSERT(artic_size > 0);
+
+    std::cout << "Generated shader: " << nfunctions << " functions, "
+              << OIIO::Strutil::memformat(source.size()) << " of OSL\n";
+    std::cout << "  oso:   " << OIIO::Strutil::timeintervalformat(oso_time, 3)
+              << ", " << OIIO::Strutil::memformat(oso_size) << "\n";
+    std::cout << "  artic: "
+              << OIIO::Strutil::timeintervalformat(artic_time, 3) << ", "
+              << OIIO::Strutil::memformat(artic_size) << "\n";
+    // Peak RSS only grows, so the artic figure can only show memory it
+    // needed beyond what the oso compile already reached.
+    std::cout << "  peak RSS: " << OIIO::Strutil::memformat(peak_before)
+              << " before compiling, "
+              << OIIO::Strutil::memformat(peak_oso) << " after oso, "
+              << OIIO::Strutil::memformat(peak_artic) << " after artic\n";
+}
+
+
+
+int
+main(int argc, char* argv[])
+{
+    getargs(argc, argv);
+
+    test_global_usage();
+    test_default_writes_global();
+    test_operators();
+    test_compare_and_divide();
+    test_std_builtins();
+    test_space_transforms();
+    test_param_folding();
+    test_unsupported();
+    test_transpile_big_shader();
+
+    return unit_test_failures;
+}
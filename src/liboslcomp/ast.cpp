@@ -312,6 +312,75 @@ ASTNode::vec_to_list(std::vector<ref>& vec)
 
 
 
+ASTNode::ref
+ASTCloner::clone(ASTNode* n)
+{
+    if (!n)
+        return ASTNode::ref();
+    ASTNode* copy = nullptr;
+    switch (n->nodetype()) {
+#define CLONE_NODE(type, cls)                                                  \
+    case ASTNode::type: copy = new cls(*static_cast<cls*>(n)); break;
+        CLONE_NODE(shader_declaration_node, ASTshader_declaration)
+        CLONE_NODE(function_declaration_node, ASTfunction_declaration)
+        CLONE_NODE(variable_declaration_node, ASTvariable_declaration)
+        CLONE_NODE(compound_initializer_node, ASTcompound_initializer)
+        CLONE_NODE(variable_ref_node, ASTvariable_ref)
+        CLONE_NODE(preincdec_node, ASTpreincdec)
+        CLONE_NODE(postincdec_node, ASTpostincdec)
+        CLONE_NODE(index_node, ASTindex)
+        CLONE_NODE(structselect_node, ASTstructselect)
+        CLONE_NODE(conditional_statement_node, ASTconditional_statement)
+        CLONE_NODE(loop_statement_node, ASTloop_statement)
+        CLONE_NODE(loopmod_statement_node, ASTloopmod_statement)
+        CLONE_NODE(return_statement_node, ASTreturn_statement)
+        CLONE_NODE(binary_expression_node, ASTbinary_expression)
+        CLONE_NODE(unary_expression_node, ASTunary_expression)
+        CLONE_NODE(assign_expression_node, ASTassign_expression)
+        CLONE_NODE(ternary_expression_node, ASTternary_expression)
+        CLONE_NODE(comma_operator_node, ASTcomma_operator)
+        CLONE_NODE(typecast_expression_node, ASTtypecast_expression)
+        CLONE_NODE(type_constructor_node, ASTtype_constructor)
+        CLONE_NODE(function_call_node, ASTfunction_call)
+        CLONE_NODE(literal_node, ASTliteral)
+#undef CLONE_NODE
+    default: OSL_ASSERT(0 && "unknown AST node type");
+    }
+#ifndef NDEBUG
+    node_counts[copy->nodetype()] += 1;
+    node_counts_peak[copy->nodetype()] += 1;
+#endif
+    ASTNode::ref result(copy);
+    m_nodes[n]       = copy;
+    copy->m_compiler = m_compiler;
+    copy->m_next.reset();
+    // The copied child lists are still the original's; copy them too.
+    for (auto& child : copy->m_children)
+        child = clone_list(child.get());
+    copy->clone_fixup(*this);
+    return result;
+}
+
+
+
+ASTNode::ref
+ASTCloner::clone_list(ASTNode* n)
+{
+    ASTNode::ref head;
+    ASTNode* tail = nullptr;
+    for (; n; n = n->nextptr()) {
+        ASTNode::ref copy = clone(n);
+        if (tail)
+            tail->m_next = copy;
+        else
+            head = copy;
+        tail = copy.get();
+    }
+    return head;
+}
+
+
+
 std::string
 ASTNode::list_to_types_string(const ASTNode* node)
 {
@@ -513,6 +582,14 @@ ASTfunction_declaration::add_meta(ref metaref)
 
 
 
+void
+ASTfunction_declaration::clone_fixup(ASTCloner& cloner)
+{
+    m_sym = cloner.sym(m_sym);
+}
+
+
+
 const char*
 ASTfunction_declaration::childname(size_t i) const
 {
@@ -606,6 +683,24 @@ ASTvariable_declaration::ASTvariable_declaration(OSLCompilerImpl* comp,
 
 
 
+void
+ASTvariable_declaration::clone_fixup(ASTCloner& cloner)
+{
+    if (m_ismetadata) {
+        // Metadata symbols aren't in the symbol table; each node has its own.
+        Symbol* sym = new Symbol;
+        *sym        = *m_sym;
+        sym->node(this);
+        m_sym = sym;
+    } else {
+        m_sym = cloner.sym(m_sym);
+    }
+    for (auto& f : m_struct_field_inits)
+        f.second = cloner.node(f.second);
+}
+
+
+
 const char*
 ASTvariable_declaration::nodetypename() const
 {
@@ -661,6 +756,14 @@ ASTvariable_ref::ASTvariable_ref(OSLCompilerImpl* comp, ustring name)
 
 
 
+void
+ASTvariable_ref::clone_fixup(ASTCloner& cloner)
+{
+    m_sym = cloner.sym(m_sym);
+}
+
+
+
 void
 ASTvariable_ref::print(std::ostream& out, int indentlevel) const
 {
@@ -807,6 +910,15 @@ ASTstructselect::ASTstructselect(OSLCompilerImpl* comp, ASTNode* expr,
 
 
 
+void
+ASTstructselect::clone_fixup(ASTCloner& cloner)
+{
+    m_fieldsym  = cloner.sym(m_fieldsym);
+    m_compindex = cloner.clone(m_compindex.get());
+}
+
+
+
 /// Return the symbol pointer to the individual field that this
 /// structselect represents; also set structid to the ID of the
 /// structure type, and fieldid to the field index within the struct.
@@ -1145,6 +1257,14 @@ ASTunary_expression::ASTunary_expression (OSLCompilerImpl *comp, int op,
 
 
 
+void
+ASTunary_expression::clone_fixup(ASTCloner& cloner)
+{
+    m_function_overload = cloner.func(m_function_overload);
+}
+
+
+
 const char *
 ASTunary_expression::childname (size_t i) const
 {
@@ -1202,6 +1322,14 @@ ASTbinary_expression::ASTbinary_expression (OSLCompilerImpl *comp, Operator op,
 
 
 
+void
+ASTbinary_expression::clone_fixup(ASTCloner& cloner)
+{
+    m_function_overload = cloner.func(m_function_overload);
+}
+
+
+
 const char *
 ASTbinary_expression::childname (size_t i) const
 {
@@ -1341,6 +1469,15 @@ ASTfunction_call::ASTfunction_call(OSLCompilerImpl* comp, ustring name,
 
 
 
+void
+ASTfunction_call::clone_fixup(ASTCloner& cloner)
+{
+    m_sym  = cloner.sym(m_sym);
+    m_poly = cloner.func(m_poly);
+}
+
+
+
 const char*
 ASTfunction_call::childname(size_t i) const
 {
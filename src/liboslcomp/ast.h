@@ -18,6 +18,8 @@ class oslFlexLexer;
 
 OSL_NAMESPACE_ENTER
 
+class ArticTranspiler;
+
 namespace pvt {
 
 
@@ -25,6 +27,7 @@ namespace pvt {
 class OSLCompilerImpl;
 class Symbol;
 class TypeSpec;
+class ASTCloner;
 
 
 
@@ -196,7 +199,12 @@ public:
     /// Reverse the order of the list.
     friend ASTNode::ref reverse(ASTNode::ref list);
 
-    friend class ASTtype_constructor;
+    friend class OSL::ArticTranspiler;  // walks children for analyses
+    friend class ASTCloner;             // relinks the copies it makes
+
+    /// After ASTCloner copies this node (and its children), translate
+    /// the copy's references to symbols and to other nodes.
+    virtual void clone_fixup(ASTCloner& /*cloner*/) {}
 
 
 
@@ -468,6 +476,7 @@ public:
                             ASTNode* form, ASTNode* stmts, ASTNode* meta,
                             int sourceline_start = -1);
     const char* nodetypename() const { return "function_declaration"; }
+    void clone_fixup(ASTCloner& cloner);
     const char* childname(size_t i) const;
     void print(std::ostream& out, int indentlevel = 0) const;
     TypeSpec typecheck(TypeSpec expected);
@@ -499,6 +508,7 @@ public:
                             bool ismeta, bool isoutput, bool initlist,
                             int sourceline_start = -1);
     const char* nodetypename() const;
+    void clone_fixup(ASTCloner& cloner);
     const char* childname(size_t i) const;
     void print(std::ostream& out, int indentlevel = 0) const;
     TypeSpec typecheck(TypeSpec expected);
@@ -558,6 +568,7 @@ class ASTvariable_ref final : public ASTNode {
 public:
     ASTvariable_ref(OSLCompilerImpl* comp, ustring name);
     const char* nodetypename() const { return "variable_ref"; }
+    void clone_fixup(ASTCloner& cloner);
     const char* childname(size_t /*i*/) const { return ""; }  // no children
     void print(std::ostream& out, int indentlevel = 0) const;
     TypeSpec typecheck(TypeSpec expected);
@@ -646,6 +657,7 @@ class ASTstructselect final : public ASTNode {
 public:
     ASTstructselect(OSLCompilerImpl* comp, ASTNode* expr, ustring field);
     const char* nodetypename() const { return "structselect"; }
+    void clone_fixup(ASTCloner& cloner);
     const char* childname(size_t i) const;
     void print(std::ostream& out, int indentlevel = 0) const;
     TypeSpec typecheck(TypeSpec expected);
@@ -760,6 +772,7 @@ public:
     ASTfunction_call(OSLCompilerImpl* comp, ustring name, ASTNode* args,
                      FunctionSymbol* funcsym = nullptr);
     const char* nodetypename() const { return "function_call"; }
+    void clone_fixup(ASTCloner& cloner);
     const char* childname(size_t i) const;
     const char* opname() const;
     void print(std::ostream& out, int indentlevel = 0) const;
@@ -928,8 +941,6 @@ public:
     {
     }
 
-    ASTtype_constructor(ASTfunction_call* fc): ASTtype_constructor(fc->m_compiler, fc->m_typespec, fc->args().get()){}
-    ASTtype_constructor(TypeSpec to_init_type, ASTNode* init_node): ASTtype_constructor(init_node->m_compiler, to_init_type, init_node){}
 
     const char* nodetypename() const { return "type_constructor"; }
     const char* childname(size_t i) const;
@@ -997,6 +1008,7 @@ public:
     ASTunary_expression(OSLCompilerImpl* comp, int op, ASTNode* expr);
 
     const char* nodetypename() const { return "unary_expression"; }
+    void clone_fixup(ASTCloner& cloner);
     const char* childname(size_t i) const;
     const char* opname() const;
     const char* opword() const;
@@ -1017,6 +1029,7 @@ public:
                          ASTNode* right);
 
     const char* nodetypename() const { return "binary_expression"; }
+    void clone_fixup(ASTCloner& cloner);
     const char* childname(size_t i) const;
     const char* opname() const;
     const char* opword() const;
@@ -1094,8 +1107,47 @@ public:
 
 
 
+/// Copies syntax trees parsed by one compiler, along with the symbols
+/// they refer to, into another compiler.  The copies can then be
+/// typechecked and generate code without touching the originals, which
+/// is how compiles share a single parse of stdosl.h.
+class ASTCloner {
+public:
+    explicit ASTCloner(OSLCompilerImpl* compiler) : m_compiler(compiler) {}
+
+    /// Make references to 'from' in the copies refer to 'to' instead.
+    void map(const Symbol* from, Symbol* to) { m_syms[from] = to; }
 
+    /// The symbol that the copies use in place of s (s itself if it was
+    /// not mapped).
+    Symbol* sym(Symbol* s) const
+    {
+        auto found = m_syms.find(s);
+        return found != m_syms.end() ? found->second : s;
+    }
+    FunctionSymbol* func(FunctionSymbol* f) const
+    {
+        return static_cast<FunctionSymbol*>(sym(f));
+    }
 
+    /// The copy of node n (n itself if it has not been copied).
+    ASTNode* node(ASTNode* n) const
+    {
+        auto found = m_nodes.find(n);
+        return found != m_nodes.end() ? found->second : n;
+    }
+
+    /// Copy node n and everything below it, but not the nodes after it.
+    ASTNode::ref clone(ASTNode* n);
+
+    /// Copy the whole list of nodes that starts with n.
+    ASTNode::ref clone_list(ASTNode* n);
+
+private:
+    OSLCompilerImpl* m_compiler;  ///< Compiler that will own the copies
+    std::unordered_map<const Symbol*, Symbol*> m_syms;
+    std::unordered_map<const ASTNode*, ASTNode*> m_nodes;
+};
 
 
 
@@ -3,16 +3,22 @@
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
 
+#include <algorithm>
+#include <cctype>
 #include <cerrno>
 #include <cstdio>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <streambuf>
 #include <string>
 #include <vector>
 #include "artic.h"
 #include "oslcomp_pvt.h"
+#include "../liboslexec/osoreader.h"
 
 #include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/hash.h>
 #include <OpenImageIO/platform.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
@@ -141,36 +147,26 @@ OSLCompilerImpl::preprocess_file(const std::string& filename,
 
 
 
-bool
-OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
-                                   const std::string& filename,
-                                   const std::string& stdoslpath,
-                                   const std::vector<std::string>& defines,
-                                   const std::vector<std::string>& includepaths,
-                                   std::string& result)
+// Run the clang preprocessor over 'instring' (named 'filename'), leaving
+// the output in 'result' and any diagnostics in 'errors'. If 'keep_macros'
+// is true, macro definitions are echoed to the output (like cpp -dD). If
+// 'remap_name' is not empty, includes of that file see 'remap_contents'
+// instead of what is on disk.
+static void
+run_preprocessor(const std::string& instring, const std::string& filename,
+                 const std::vector<std::string>& defines,
+                 const std::vector<std::string>& includepaths,
+                 bool keep_macros, const std::string& remap_name,
+                 string_view remap_contents, std::string& result,
+                 std::string& errors)
 {
-    std::string instring;
-    if (!stdoslpath.empty()) {
-        instring
-            = OIIO::Strutil::sprintf("#include \"%s\"\n",
-                                     OIIO::Strutil::escape_chars(stdoslpath));
-        // Note: because we're turning this from a regular string into a
-        // double-quoted string injected into the OSL parse stream, we need
-        // to fully escape any backslashes used in Windows file paths. We
-        // don't want "c:\path\to\new\osl" to be interpreted as
-        // "c:\path<tab>o<newline>ew\osl" !
-    } else {
-        instring = "\n";
-    }
-    instring += buffer;
     std::unique_ptr<llvm::MemoryBuffer> mbuf(
         llvm::MemoryBuffer::getMemBuffer(instring, filename));
 
     clang::CompilerInstance inst;
 
     // Set up error capture for the preprocessor
-    std::string preproc_errors;
-    llvm::raw_string_ostream errstream(preproc_errors);
+    llvm::raw_string_ostream errstream(errors);
     clang::DiagnosticOptions* diagOptions = new clang::DiagnosticOptions();
     clang::TextDiagnosticPrinter* diagPrinter
         = new clang::TextDiagnosticPrinter(errstream, diagOptions);
@@ -195,7 +191,7 @@ OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
     sm.setMainFileID(sm.createFileID(std::move(mbuf), clang::SrcMgr::C_User));
 
     inst.getPreprocessorOutputOpts().ShowCPP               = 1;
-    inst.getPreprocessorOutputOpts().ShowMacros            = 0;
+    inst.getPreprocessorOutputOpts().ShowMacros            = keep_macros;
     inst.getPreprocessorOutputOpts().ShowComments          = 0;
     inst.getPreprocessorOutputOpts().ShowLineMarkers       = 1;
     inst.getPreprocessorOutputOpts().ShowMacroComments     = 0;
@@ -232,6 +228,15 @@ OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
         else if (d[1] == 'U')
             preprocOpts.addMacroUndef(d.c_str() + 2);
     }
+    if (remap_name.size()) {
+        // The buffer doesn't own the text, the caller keeps it alive
+        preprocOpts.addRemappedFile(remap_name,
+                                    llvm::MemoryBuffer::getMemBuffer(
+                                        llvm::StringRef(remap_contents.data(),
+                                                        remap_contents.size()),
+                                        remap_name)
+                                        .release());
+    }
 
     inst.getLangOpts().LineComment = 1;
     inst.createPreprocessor(clang::TU_Prefix);
@@ -241,6 +246,296 @@ OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
     clang::DoPrintPreprocessedInput(inst.getPreprocessor(), &ostream,
                                     inst.getPreprocessorOutputOpts());
     diagPrinter->EndSourceFile();
+    ostream.flush();
+    errstream.flush();
+}
+
+
+
+// Line markers carry enter/leave-include flags ("# 1 "foo.h" 2") that are
+// only valid relative to the include stack they were produced with. Drop
+// them so that preprocessed text can be included from anywhere.
+static std::string
+strip_linemarker_flags(const std::string& text)
+{
+    std::string result;
+    result.reserve(text.size());
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        eol        = (eol == std::string::npos) ? text.size() : eol + 1;
+        if (eol - pos > 2 && text[pos] == '#' && text[pos + 1] == ' '
+            && isdigit(text[pos + 2])) {
+            size_t q = text.rfind('"', eol - 1);
+            if (q != std::string::npos && q > pos
+                && text.find('"', pos) < q) {
+                result.append(text, pos, q + 1 - pos);
+                result += '\n';
+                pos = eol;
+                continue;
+            }
+        }
+        result.append(text, pos, eol - pos);
+        pos = eol;
+    }
+    return result;
+}
+
+
+
+// The files that preprocessed text was read from, as named by its line
+// markers (pseudo files like "<built-in>" excepted).
+static std::vector<std::string>
+linemarker_files(const std::string& text)
+{
+    std::vector<std::string> files;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        eol        = (eol == std::string::npos) ? text.size() : eol;
+        if (eol - pos > 2 && text[pos] == '#' && text[pos + 1] == ' '
+            && isdigit(text[pos + 2])) {
+            size_t q0 = text.find('"', pos);
+            size_t q1 = text.rfind('"', eol - 1);
+            if (q0 < q1 && q1 < eol && q0 + 1 < text.size()
+                && text[q0 + 1] != '<') {
+                std::string f = text.substr(q0 + 1, q1 - q0 - 1);
+                if (std::find(files.begin(), files.end(), f) == files.end())
+                    files.push_back(f);
+            }
+        }
+        pos = eol + 1;
+    }
+    return files;
+}
+
+
+
+// Preprocessing stdosl.h is the same work for every shader compiled with
+// the same options, so it is expanded once per process (keeping its macro
+// definitions, which user code relies on) and the expansion is shared,
+// read-only, by all compilers -- which may be running concurrently, e.g.
+// under oslc -j. Later compiles see the expansion in place of the file.
+//
+// The same goes for parsing it: the first compile that can use it parses
+// stdosl.h on its own, and each compile after that copies the resulting
+// symbols and syntax trees (see OSLCompilerImpl::parse_preprocessed).
+struct StdoslExpansion {
+    std::string path;                       ///< stdosl.h
+    std::vector<std::string> defines;       ///< -D/-U it was expanded with
+    std::vector<std::string> includepaths;  ///< -I it was expanded with
+    std::string text;                       ///< The expansion, macros kept
+    std::vector<std::string> includes;      ///< stdosl.h and its includes
+
+    std::once_flag parse_once;
+    std::unique_ptr<ErrorHandler> parse_errhandler;
+    std::unique_ptr<OSLCompilerImpl> parse;  ///< Null if it can't be shared
+    std::string parse_prefix;    ///< Preprocessed text through stdosl.h
+    std::string parse_mainfile;  ///< Quoted main file name in parse_prefix
+    size_t parse_firstsym = 0;   ///< Symbols declared before stdosl.h
+};
+
+static OIIO::spin_mutex stdosl_expansion_mutex;
+
+// Constructed on first use, so that it is destroyed (along with the shared
+// parses) before the AST node accounting of debug builds reports leaks.
+static std::map<std::string, std::shared_ptr<StdoslExpansion>>&
+stdosl_expansions()
+{
+    static std::map<std::string, std::shared_ptr<StdoslExpansion>> expansions;
+    return expansions;
+}
+
+static std::shared_ptr<StdoslExpansion>
+expanded_stdosl(const std::string& stdoslpath,
+                const std::vector<std::string>& defines,
+                const std::vector<std::string>& includepaths)
+{
+    std::string key = OIIO::Strutil::sprintf(
+        "%s|%d|%s|%s", stdoslpath,
+        (long long)OIIO::Filesystem::last_write_time(stdoslpath),
+        OIIO::Strutil::join(defines, " "),
+        OIIO::Strutil::join(includepaths, ":"));
+    {
+        OIIO::spin_lock lock(stdosl_expansion_mutex);
+        auto found = stdosl_expansions().find(key);
+        if (found != stdosl_expansions().end())
+            return found->second;
+    }
+
+    std::string contents, expansion, errors;
+    if (!OIIO::Filesystem::read_text_file(stdoslpath, contents))
+        return nullptr;
+    run_preprocessor(contents, stdoslpath, defines, includepaths,
+                     true /*keep_macros*/, std::string(), string_view(),
+                     expansion, errors);
+    if (errors.size())
+        return nullptr;  // Let the regular include report the problem
+
+    auto shared          = std::make_shared<StdoslExpansion>();
+    shared->path         = stdoslpath;
+    shared->defines      = defines;
+    shared->includepaths = includepaths;
+    shared->text         = strip_linemarker_flags(expansion);
+    shared->includes     = linemarker_files(expansion);
+    OIIO::spin_lock lock(stdosl_expansion_mutex);
+    return stdosl_expansions().emplace(key, shared).first->second;
+}
+
+
+
+// The preprocessed text of a compile starts with a line marker naming the
+// main file, then has stdosl.h, then a marker returning to line 2 of the
+// main file. Return the length of the text before that marker (0 if it
+// isn't there), and the quoted main file name.
+static size_t
+stdosl_prefix_length(const std::string& text, std::string& mainfile)
+{
+    size_t eol = text.find('\n');
+    if (!OIIO::Strutil::starts_with(text, "# 1 \"") || eol == std::string::npos)
+        return 0;
+    mainfile    = text.substr(4, eol - 4);
+    size_t back = text.find("\n# 2 " + mainfile + " 2\n", eol);
+    return back == std::string::npos ? 0 : back + 1;
+}
+
+
+
+// Silently counts the messages of the shared stdosl.h parse. If there are
+// any, compiles parse the header themselves so that they get to see them.
+class CountingErrorHandler final : public ErrorHandler {
+public:
+    void operator()(int /*errcode*/, const std::string& /*msg*/) override
+    {
+        ++count;
+    }
+    int count = 0;
+};
+
+
+
+void
+OSLCompilerImpl::parse_stdosl(StdoslExpansion& expansion)
+{
+    std::unique_ptr<CountingErrorHandler> errhandler(new CountingErrorHandler);
+    std::unique_ptr<OSLCompilerImpl> parse(
+        new OSLCompilerImpl(errhandler.get()));
+    parse->m_cwd           = OIIO::Filesystem::current_path();
+    parse->m_main_filename = ustring("<stdosl>");
+    std::string preprocessed, mainfile;
+    bool ok = parse->preprocess_buffer("", "<stdosl>", expansion.path,
+                                       expansion.defines,
+                                       expansion.includepaths, preprocessed);
+    parse->m_stdosl.reset();  // Don't let the expansion own itself
+    if (!ok)
+        return;
+    size_t prefixlen = stdosl_prefix_length(preprocessed, mainfile);
+    if (!prefixlen)
+        return;
+    preprocessed.resize(prefixlen);
+    size_t firstsym = parse->symtab().allsyms().size();
+    if (parse->osl_parse_buffer(preprocessed) || errhandler->count
+        || parse->m_shader)
+        return;
+
+    expansion.parse_errhandler = std::move(errhandler);
+    expansion.parse            = std::move(parse);
+    expansion.parse_prefix     = std::move(preprocessed);
+    expansion.parse_mainfile   = mainfile;
+    expansion.parse_firstsym   = firstsym;
+}
+
+
+
+bool
+OSLCompilerImpl::import_stdosl(const OSLCompilerImpl& stdosl, size_t firstsym)
+{
+    ASTCloner cloner(this);
+    if (!m_func_decls.empty()
+        || !m_symtab.import(stdosl.m_symtab, firstsym, cloner))
+        return false;
+    for (auto& f : stdosl.m_func_decls)
+        m_func_decls.push_back(cloner.clone(f.get()));
+    for (auto s = m_symtab.begin() + firstsym; s != m_symtab.end(); ++s)
+        (*s)->node(cloner.node((*s)->node()));
+    m_nowarn_lines.insert(stdosl.m_nowarn_lines.begin(),
+                          stdosl.m_nowarn_lines.end());
+    return true;
+}
+
+
+
+bool
+OSLCompilerImpl::parse_preprocessed(const std::string& preprocessed_buffer)
+{
+    StdoslExpansion* stdosl = m_stdosl.get();
+    if (!stdosl)
+        return osl_parse_buffer(preprocessed_buffer);
+
+    // The expansion stands in for stdosl.h and whatever it includes, so
+    // the dependencies have to be recorded here, made relative to the
+    // working directory like the lexer does.
+    for (std::string f : stdosl->includes) {
+        if (f.find(m_cwd) == 0) {
+            f.erase(0, m_cwd.size());
+            if (f.size() && (f[0] == '/' || f[0] == '\\'))
+                f.erase(0, 1);
+        }
+        m_file_dependencies.emplace(f);
+    }
+
+    std::call_once(stdosl->parse_once, [stdosl]() { parse_stdosl(*stdosl); });
+    std::string mainfile;
+    size_t prefixlen = stdosl_prefix_length(preprocessed_buffer, mainfile);
+    // Source file names in the shared parse are relative to its working
+    // directory, and the text up to the main file must be the same
+    // (other than the main file name) for the parse to be the same.
+    if (stdosl->parse && prefixlen && stdosl->parse->m_cwd == m_cwd
+        && preprocessed_buffer.compare(
+               0, prefixlen,
+               OIIO::Strutil::replace(stdosl->parse_prefix,
+                                      stdosl->parse_mainfile, mainfile, true))
+               == 0
+        && import_stdosl(*stdosl->parse, stdosl->parse_firstsym))
+        return osl_parse_buffer(preprocessed_buffer.substr(prefixlen));
+    return osl_parse_buffer(preprocessed_buffer);
+}
+
+
+
+bool
+OSLCompilerImpl::preprocess_buffer(const std::string& buffer,
+                                   const std::string& filename,
+                                   const std::string& stdoslpath,
+                                   const std::vector<std::string>& defines,
+                                   const std::vector<std::string>& includepaths,
+                                   std::string& result)
+{
+    std::string instring;
+    std::shared_ptr<StdoslExpansion> stdosl;
+    if (!stdoslpath.empty()) {
+        instring
+            = OIIO::Strutil::sprintf("#include \"%s\"\n",
+                                     OIIO::Strutil::escape_chars(stdoslpath));
+        // Note: because we're turning this from a regular string into a
+        // double-quoted string injected into the OSL parse stream, we need
+        // to fully escape any backslashes used in Windows file paths. We
+        // don't want "c:\path\to\new\osl" to be interpreted as
+        // "c:\path<tab>o<newline>ew\osl" !
+        if (OIIO::Filesystem::exists(stdoslpath))
+            stdosl = expanded_stdosl(stdoslpath, defines, includepaths);
+    } else {
+        instring = "\n";
+    }
+    instring += buffer;
+
+    std::string preproc_errors;
+    run_preprocessor(instring, filename, defines, includepaths,
+                     false /*keep_macros*/,
+                     stdosl ? stdoslpath : std::string(),
+                     stdosl ? string_view(stdosl->text) : string_view(),
+                     result, preproc_errors);
+    m_stdosl = stdosl;
 
     if (preproc_errors.size()) {
         while (preproc_errors.size()
@@ -260,8 +555,11 @@ OSLCompilerImpl::read_compile_options(const std::vector<std::string>& options,
                                       std::vector<std::string>& includepaths)
 {
     m_output_filename.clear();
-    m_preprocess_only = false;
-    m_compile_target  = CompileTargets::OSO;
+    m_artic_cache_dir.clear();
+    m_artic_partial      = false;
+    m_artic_vector_width = 8;
+    m_preprocess_only    = false;
+    m_compile_target     = CompileTargets::OSO;
     for (size_t i = 0; i < options.size(); ++i) {
         if (options[i] == "-v") {
             // verbose mode
@@ -283,6 +581,15 @@ OSLCompilerImpl::read_compile_options(const std::vector<std::string>& options,
                 || options[i] == "ARTIC") {
                 m_compile_target = CompileTargets::ARTIC;
             }
+        } else if (options[i] == "-artic-cache" && i < options.size() - 1) {
+            ++i;
+            m_artic_cache_dir = options[i];
+        } else if (options[i] == "-artic-partial") {
+            m_artic_partial = true;
+        } else if (options[i] == "-artic-vector-width"
+                   && i < options.size() - 1) {
+            ++i;
+            m_artic_vector_width = std::max(1, OIIO::Strutil::stoi(options[i]));
         } else if (options[i] == "-O0") {
             m_optimizelevel = 0;
         } else if (options[i] == "-O" || options[i] == "-O1") {
@@ -294,6 +601,9 @@ OSLCompilerImpl::read_compile_options(const std::vector<std::string>& options,
         } else if (options[i] == "-embed-source"
                    || options[i] == "--embed-source") {
             m_embed_source = true;
+        } else if (options[i] == "-binary-oso"
+                   || options[i] == "--binary-oso") {
+            m_binary_oso = true;
         } else if (options[i] == "-MD"
                    || options[i] == "--write-dependencies") {
             // write depfile w/ user and system headers
@@ -445,10 +755,20 @@ OSLCompilerImpl::compile(string_view filename,
         return false;
     }
 
+    // When transpiling to Artic, an unchanged preprocessed source means an
+    // unchanged result, so try the cache before doing any parsing. The
+    // dependency file needs the parse, so don't short-circuit for -M*.
+    std::string artic_key;
+    if (m_compile_target == CompileTargets::ARTIC && !m_preprocess_only
+        && !m_generate_deps && !m_artic_cache_dir.empty())
+        artic_key = artic_cache_key(preprocess_result);
+
     if (m_preprocess_only && !m_generate_deps) {
         std::cout << preprocess_result;
+    } else if (artic_key.size() && artic_cache_fetch(artic_key)) {
+        // The cached code was already written to the output file
     } else {
-        bool parseerr = osl_parse_buffer(preprocess_result);
+        bool parseerr = parse_preprocessed(preprocess_result);
         if (!parseerr) {
             if (shader())
                 shader()->typecheck();
@@ -467,37 +787,23 @@ OSLCompilerImpl::compile(string_view filename,
             write_dependency_file(filename);
 
         if (!error_encountered()) {
-            if(m_compile_target == CompileTargets::ARTIC){
-                ArticSource artic_source("  ");
-                ArticTranspiler artic_transpiler(&artic_source, nullptr);
-                for(auto sym: this->symtab()){
-                    if(sym->is_structure()){
-                        artic_transpiler.generate_struct_definition(sym->typespec());
-                    } else if(sym->node() && sym->node()->nodetype() != ASTNode::NodeType::variable_declaration_node){
-                        auto node = sym->node();
-                        if(!node->is_std_node()){
-                            artic_transpiler.dispatch_node(node);
-                        }
-                    }
-
-                }
-                artic_transpiler.dispatch_node(shader());
-                artic_source.print();
+            if (m_compile_target != CompileTargets::ARTIC) {
+                shader()->codegen();
+                track_variable_dependencies();
+                track_variable_lifetimes();
+                check_for_illegal_writes();
+                //            if (m_optimizelevel >= 1)
+                //                coalesce_temporaries ();
             }
-
-
-            shader()->codegen();
-            track_variable_dependencies();
-            track_variable_lifetimes();
-            check_for_illegal_writes();
-            //            if (m_optimizelevel >= 1)
-            //                coalesce_temporaries ();
         }
 
         if (!error_encountered()) {
             if (m_output_filename.size() == 0)
                 m_output_filename = default_output_filename();
 
+            if (m_compile_target == CompileTargets::ARTIC)
+                return emit_artic_file(artic_key);
+
             OIIO::ofstream oso_output;
             OIIO::Filesystem::open(oso_output, m_output_filename);
             if (!oso_output.good()) {
@@ -518,6 +824,8 @@ OSLCompilerImpl::compile(string_view filename,
                        m_output_filename);
                 return false;
             }
+            if (m_binary_oso && !write_binary_oso_file())
+                return false;
         }
     }
 
@@ -559,7 +867,7 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
     if (m_preprocess_only) {
         std::cout << preprocess_result;
     } else {
-        bool parseerr = osl_parse_buffer(preprocess_result);
+        bool parseerr = parse_preprocessed(preprocess_result);
         if (!parseerr) {
             if (shader())
                 shader()->typecheck();
@@ -575,17 +883,26 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
         }
 
         if (!error_encountered()) {
-            shader()->codegen();
-            track_variable_dependencies();
-            track_variable_lifetimes();
-            check_for_illegal_writes();
-            //            if (m_optimizelevel >= 1)
-            //                coalesce_temporaries ();
+            if (m_compile_target == CompileTargets::ARTIC) {
+                // The "oso" buffer receives the Artic source instead
+                std::ostringstream artic_output;
+                transpile_artic(artic_output);
+                osobuffer = artic_output.str();
+            } else {
+                shader()->codegen();
+                track_variable_dependencies();
+                track_variable_lifetimes();
+                check_for_illegal_writes();
+                //            if (m_optimizelevel >= 1)
+                //                coalesce_temporaries ();
+            }
         }
 
         if (!error_encountered()) {
             if (m_output_filename.empty())
                 m_output_filename = default_output_filename();
+            if (m_compile_target == CompileTargets::ARTIC)
+                return true;
 
             std::ostringstream oso_output;
             oso_output.imbue(std::locale::classic());  // force C locale
@@ -604,6 +921,35 @@ OSLCompilerImpl::compile_buffer(string_view sourcecode, std::string& osobuffer,
 
 
 
+bool
+OSLCompilerImpl::write_binary_oso_file()
+{
+    OSOReaderToBinary binary_oso(m_errhandler);
+    std::string text;
+    if (!OIIO::Filesystem::read_text_file(m_output_filename, text)
+        || !binary_oso.parse_file(m_output_filename)) {
+        errorf(ustring(), 0, "Could not convert \"%s\" to binary OSO",
+               m_output_filename);
+        return false;
+    }
+    std::string filename
+        = OIIO::Filesystem::replace_extension(m_output_filename, ".osob");
+    std::string binary = binary_oso.binary(text);
+    OIIO::ofstream osob_output;
+    OIIO::Filesystem::open(osob_output, filename,
+                           std::ios::out | std::ios::binary);
+    if (osob_output.good())
+        osob_output.write(binary.data(), binary.size());
+    osob_output.close();
+    if (!osob_output.good()) {
+        errorf(ustring(), 0, "Failed to write to \"%s\"", filename);
+        return false;
+    }
+    return true;
+}
+
+
+
 void
 OSLCompilerImpl::write_dependency_file(string_view filename)
 {
@@ -683,12 +1029,168 @@ std::string
 OSLCompilerImpl::default_output_filename()
 {
     if (m_shader && shader_decl())
-        return shader_decl()->shadername().string() + ".oso";
+        return shader_decl()->shadername().string()
+               + (m_compile_target == CompileTargets::ARTIC ? ".art" : ".oso");
     return std::string();
 }
 
 
 
+bool
+OSLCompilerImpl::transpile_artic(std::ostream& out)
+{
+    ArticSource artic_source("  ", &out);
+    ArticTranspiler artic_transpiler(&artic_source, this, m_artic_partial,
+                                     m_artic_vector_width);
+    for (auto sym : symtab()) {
+        if (sym->is_structure()) {
+            artic_transpiler.generate_struct_definition(sym->typespec());
+        } else if (sym->node()
+                   && sym->node()->nodetype()
+                          != ASTNode::NodeType::variable_declaration_node) {
+            auto node = sym->node();
+            if (!node->is_std_node()) {
+                artic_transpiler.transpile_unit(node);
+            }
+        }
+    }
+    artic_transpiler.transpile_unit(shader());
+    artic_source.flush();
+    artic_transpiler.report_summary(main_filename());
+    return !error_encountered();
+}
+
+
+
+bool
+OSLCompilerImpl::write_artic_file(const std::string& code)
+{
+    OIIO::ofstream art_output;
+    OIIO::Filesystem::open(art_output, m_output_filename);
+    if (!art_output.good()) {
+        errorf(ustring(), 0, "Could not open \"%s\"", m_output_filename);
+        return false;
+    }
+    art_output << code;
+    art_output.close();
+    if (!art_output.good()) {
+        errorf(ustring(), 0, "Failed to write to \"%s\"", m_output_filename);
+        return false;
+    }
+    return true;
+}
+
+
+
+bool
+OSLCompilerImpl::emit_artic_file(const std::string& cache_key)
+{
+    if (cache_key.size()) {
+        // Need the whole text for the cache entry anyway
+        std::ostringstream code;
+        if (!transpile_artic(code) || !write_artic_file(code.str()))
+            return false;
+        artic_cache_store(cache_key, code.str());
+        return true;
+    }
+
+    // Stream into a temporary next to the output and rename it into place
+    // once transpilation succeeded, so a failure leaves no partial .art.
+    std::string tmpname = OIIO::Filesystem::unique_path(m_output_filename
+                                                        + ".%%%%-%%%%-%%%%");
+    OIIO::ofstream art_output;
+    OIIO::Filesystem::open(art_output, tmpname);
+    if (!art_output.good()) {
+        errorf(ustring(), 0, "Could not open \"%s\"", m_output_filename);
+        return false;
+    }
+    bool ok = transpile_artic(art_output);
+    art_output.close();
+    std::string err;
+    if (ok && !art_output.good()) {
+        errorf(ustring(), 0, "Failed to write to \"%s\"", m_output_filename);
+        ok = false;
+    }
+    if (ok && !OIIO::Filesystem::rename(tmpname, m_output_filename, err)) {
+        errorf(ustring(), 0, "Failed to write to \"%s\": %s",
+               m_output_filename, err);
+        ok = false;
+    }
+    if (!ok)
+        OIIO::Filesystem::remove(tmpname, err);
+    return ok;
+}
+
+
+
+std::string
+OSLCompilerImpl::artic_cache_key(string_view preprocessed_source) const
+{
+    OIIO::SHA1 sha;
+    std::string salt = OIIO::Strutil::sprintf(
+        "oslc %s anyosl_std %d width %d%s\n", OSL_LIBRARY_VERSION_STRING,
+        anyosl_std_version, m_artic_vector_width,
+        m_artic_partial ? " partial" : "");
+    sha.append(salt.data(), salt.size());
+    sha.append(preprocessed_source.data(), preprocessed_source.size());
+    return sha.digest();
+}
+
+
+
+// A cache entry is the name of the shader on the first line, followed by
+// the transpiled Artic source.
+bool
+OSLCompilerImpl::artic_cache_fetch(const std::string& key)
+{
+    std::string path = m_artic_cache_dir + "/" + key + ".artcache";
+    std::string entry;
+    if (!OIIO::Filesystem::exists(path)
+        || !OIIO::Filesystem::read_text_file(path, entry))
+        return false;
+    size_t eol = entry.find('\n');
+    if (eol == std::string::npos || eol == 0)
+        return false;  // truncated or foreign file, just transpile again
+    if (m_output_filename.empty())
+        m_output_filename = entry.substr(0, eol) + ".art";
+    if (m_verbose)
+        infof(m_main_filename, 0, "Using cached Artic source %s", path);
+    return write_artic_file(entry.substr(eol + 1));
+}
+
+
+
+void
+OSLCompilerImpl::artic_cache_store(const std::string& key,
+                                   const std::string& code)
+{
+    if (!shader_decl())
+        return;
+    std::string err;
+    if (!OIIO::Filesystem::is_directory(m_artic_cache_dir)
+        && !OIIO::Filesystem::create_directory(m_artic_cache_dir, err)) {
+        warningf(ustring(), 0, "Could not create Artic cache \"%s\": %s",
+                 m_artic_cache_dir, err);
+        return;
+    }
+    // Write to a unique temporary and rename it into place, so that
+    // concurrent compiles never observe a partially written entry.
+    std::string path = m_artic_cache_dir + "/" + key + ".artcache";
+    std::string tmppath
+        = OIIO::Filesystem::unique_path(path + ".%%%%-%%%%-%%%%");
+    OIIO::ofstream out;
+    OIIO::Filesystem::open(out, tmppath);
+    out << shader_decl()->shadername() << "\n" << code;
+    out.close();
+    if (!out.good() || !OIIO::Filesystem::rename(tmppath, path, err)) {
+        OIIO::Filesystem::remove(tmppath, err);
+        warningf(ustring(), 0, "Could not write Artic cache entry \"%s\"",
+                 path);
+    }
+}
+
+
+
 void
 OSLCompilerImpl::write_oso_metadata(const ASTNode* metanode) const
 {
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <set>
 #include <stack>
 #include <vector>
@@ -33,6 +34,8 @@ typedef std::map<const Symbol*, SymPtrSet> SymDependencyMap;
 
 enum CompileTargets { OSO, ARTIC };
 
+struct StdoslExpansion;  // stdosl.h preprocessed once, see oslcomp.cpp
+
 
 
 class OSLCompilerImpl {
@@ -51,6 +54,11 @@ public:
 
     bool osl_parse_buffer(const std::string& preprocessed_buffer);
 
+    /// Like osl_parse_buffer, but when the buffer starts with the same
+    /// stdosl.h as the shared parse of it, copy that parse instead of
+    /// parsing the header again.  Returns true on a parse error.
+    bool parse_preprocessed(const std::string& preprocessed_buffer);
+
     /// The name of the file we're currently parsing
     ///
     ustring filename() const { return m_filename; }
@@ -392,6 +400,43 @@ private:
     void write_oso_metadata(const ASTNode* metanode) const;
     void write_dependency_file(string_view filename);
 
+    /// Parse stdosl.h alone into expansion.parse, if it parses cleanly,
+    /// for parse_preprocessed to share.
+    static void parse_stdosl(StdoslExpansion& expansion);
+
+    /// Copy the symbols and function declarations of 'stdosl', which
+    /// has parsed nothing but stdosl.h, into this not yet used compiler.
+    /// 'firstsym' is the number of symbols stdosl had before parsing.
+    bool import_stdosl(const OSLCompilerImpl& stdosl, size_t firstsym);
+
+    /// Convert the .oso just written to binary OSO, in a .osob file next
+    /// to it, for the shading system to load without parsing.
+    bool write_binary_oso_file();
+
+    /// Transpile the parsed shader (and the user functions and structs
+    /// it depends on) to Artic source, streamed to 'out'.
+    bool transpile_artic(std::ostream& out);
+
+    /// Write already transpiled Artic source to the output file.
+    bool write_artic_file(const std::string& code);
+
+    /// Transpile straight into the output file, and into the Artic cache
+    /// if a cache key is given.
+    bool emit_artic_file(const std::string& cache_key);
+
+    /// Cache key for the Artic transpilation of a preprocessed source:
+    /// a hash of the source, the anyosl_std.art version the generated
+    /// code is written against, and the compiler version.
+    std::string artic_cache_key(string_view preprocessed_source) const;
+
+    /// Look for an up-to-date transpiled shader in the Artic cache
+    /// directory and, if found, write it to the output file (named after
+    /// the cached shader unless -o was given). Returns true on a hit.
+    bool artic_cache_fetch(const std::string& key);
+
+    /// Store freshly transpiled Artic source in the cache directory.
+    void artic_cache_store(const std::string& key, const std::string& code);
+
     template<typename... Args>
     inline void osof(const char* fmt, const Args&... args) const
     {
@@ -474,6 +519,7 @@ private:
     bool m_generate_deps = false;  ///< Generate dependencies? -MD or -MMD?
     bool m_generate_system_deps = false;  ///< Generate system header deps? -MD
     bool m_embed_source         = false;  ///< Embed preprocessed source in oso?
+    bool m_binary_oso           = false;  ///< Also write binary oso?
     bool m_err_on_warning;                ///< Treat warnings as errors?
     int m_optimizelevel;                  ///< Optimization level
     OpcodeVec m_ircode;                   ///< Generated IR code
@@ -502,6 +548,10 @@ private:
     std::set<ustring> m_file_dependencies;  ///< All include file dependencies
     std::stack<TypeSpec> m_typespec_stack;  ///< Just for function_declaration
     CompileTargets m_compile_target;
+    std::string m_artic_cache_dir;  ///< Transpiled Artic cache (-artic-cache)
+    bool m_artic_partial = false;   ///< Skip untranspilable functions
+    int m_artic_vector_width = 8;   ///< Lanes per packet of <shader>_batched
+    std::shared_ptr<StdoslExpansion> m_stdosl;  ///< Preprocessed stdosl.h
 };
 
 
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -226,6 +227,7 @@ int
 SymbolTable::new_struct(ustring name)
 {
     int structid = TypeSpec::new_struct(new StructSpec(name, scopeid()));
+    m_structids.push_back(structid);
     insert(new Symbol(name, TypeSpec("", structid), SymTypeType));
     return structid;
 }
@@ -235,7 +237,8 @@ SymbolTable::new_struct(ustring name)
 StructSpec*
 SymbolTable::current_struct()
 {
-    return TypeSpec::struct_list().back().get();
+    return m_structids.size() ? TypeSpec::structspec(m_structids.back())
+                              : nullptr;
 }
 
 
@@ -271,13 +274,67 @@ SymbolTable::pop()
 
 
 
+bool
+SymbolTable::import(const SymbolTable& src, size_t first, ASTCloner& cloner)
+{
+    if (m_allsyms.size() != first || src.m_allsyms.size() < first
+        || m_scopeid != 0 || src.m_scopeid != 0)
+        return false;
+    for (size_t i = 0; i < first; ++i) {
+        if (m_allsyms[i]->name() != src.m_allsyms[i]->name()
+            || m_allsyms[i]->symtype() != src.m_allsyms[i]->symtype())
+            return false;
+    }
+    for (size_t i = first; i < src.m_allsyms.size(); ++i) {
+        // Constants point into themselves and struct types are global
+        // registrations; neither may be copied.
+        SymType st = src.m_allsyms[i]->symtype();
+        if (st == SymTypeConst || st == SymTypeType
+            || src.m_allsyms[i]->typespec().is_structure_based())
+            return false;
+    }
+
+    for (size_t i = 0; i < first; ++i)
+        cloner.map(src.m_allsyms[i], m_allsyms[i]);
+    for (size_t i = first; i < src.m_allsyms.size(); ++i) {
+        const Symbol* s = src.m_allsyms[i];
+        Symbol* copy;
+        if (s->is_function()) {
+            FunctionSymbol* f = new FunctionSymbol(s->name(), s->typespec());
+            *f   = *static_cast<const FunctionSymbol*>(s);
+            copy = f;
+        } else {
+            copy  = new Symbol;
+            *copy = *s;
+        }
+        m_allsyms.push_back(copy);
+        m_allmangled[ustring(copy->mangled())] = copy;
+        cloner.map(s, copy);
+    }
+    for (size_t i = first; i < m_allsyms.size(); ++i) {
+        if (m_allsyms[i]->is_function()) {
+            FunctionSymbol* f = static_cast<FunctionSymbol*>(m_allsyms[i]);
+            f->nextpoly(cloner.func(f->nextpoly()));
+        }
+    }
+    for (auto& entry : src.m_scopetables[0])
+        m_scopetables[0][entry.first] = cloner.sym(entry.second);
+    m_nextscopeid = std::max(m_nextscopeid, src.m_nextscopeid);
+    return true;
+}
+
+
+
 void
 SymbolTable::delete_syms()
 {
     for (auto& sym : m_allsyms)
         delete sym;
     m_allsyms.clear();
-    TypeSpec::struct_list().clear();
+    // Only release our own structs, other compilers may be running
+    for (int id : m_structids)
+        TypeSpec::delete_struct(id);
+    m_structids.clear();
 }
 
 
@@ -285,10 +342,10 @@ SymbolTable::delete_syms()
 void
 SymbolTable::print()
 {
-    if (TypeSpec::struct_list().size()) {
+    if (m_structids.size()) {
         std::cout << "Structure table:\n";
-        int structid = 1;
-        for (auto&& s : TypeSpec::struct_list()) {
+        for (int structid : m_structids) {
+            const StructSpec* s = TypeSpec::structspec(structid);
             if (!s)
                 continue;
             std::cout << "    " << structid << ": struct " << s->mangled();
@@ -300,7 +357,6 @@ SymbolTable::print()
                 const StructSpec::FieldSpec& f(s->field(i));
                 std::cout << "\t" << f.name << " : " << f.type.string() << "\n";
             }
-            ++structid;
         }
         std::cout << "\n";
     }
@@ -22,6 +22,7 @@ namespace pvt {
 
 class OSLCompilerImpl;
 class ASTNode;  // forward declaration
+class ASTCloner;
 
 
 
@@ -240,6 +241,15 @@ public:
     ///
     void pop();
 
+    /// Copy into this table the symbols that 'src' declared after its
+    /// first 'first' symbols, keeping their scopes, and tell 'cloner'
+    /// which copy stands for which original.  Both tables must start
+    /// with the same 'first' symbols (the globals and builtins every
+    /// compiler declares) and nothing else, and 'src' must be back in
+    /// its global scope.  Return false, leaving this table untouched, if
+    /// that isn't the case or 'src' holds symbols that can't be copied.
+    bool import(const SymbolTable& src, size_t first, ASTCloner& cloner);
+
     /// delete all symbols that have ever been entered into the table.
     /// After doing this, beware following any Symbol pointers left over!
     void delete_syms();
@@ -266,6 +276,7 @@ private:
     ScopeTable m_allmangled;        ///< All syms, mangled, in a hash table
     int m_scopeid;                  ///< Current scope ID
     int m_nextscopeid;              ///< Next unique scope ID
+    std::vector<int> m_structids;   ///< Structs made by this table
 };
 
 
@@ -41,6 +41,11 @@ public:
     /// and store the llvm::Function* handle to it with the ShaderGroup.
     virtual void run ();
 
+    /// Generate code with a minimal LLVM pass pipeline (and bypass the
+    /// JIT object cache), as a fast stand-in until the group's optimized
+    /// code is ready.
+    void quick_jit (bool quick) { m_quick_jit = quick; }
+
 
     /// What LLVM debug level are we at?
     int llvm_debug() const;
@@ -410,7 +415,10 @@ public:
     llvm::Function *layer_func () const { return ll.current_function(); }
 
     /// Call this when JITing a texture-like call, to track how many.
+    /// An async_jit re-run of an already jitted group counted them before.
     void generated_texture_call (bool handle) {
+        if (group().jitted())
+            return;
         shadingsys().m_stat_tex_calls_codegened += 1;
         if (handle)
             shadingsys().m_stat_tex_calls_as_handles += 1;
@@ -462,6 +470,7 @@ private:
     std::map<std::string,std::string>           m_varname_map;
 
     bool m_use_optix;                   ///< Compile for OptiX?
+    bool m_quick_jit = false;           ///< Minimal optimization?
 
     friend class ShadingSystemImpl;
 };
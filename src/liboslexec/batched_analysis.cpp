@@ -37,6 +37,7 @@ static ustring op_compl("compl");
 static ustring op_concat("concat");
 static ustring op_continue("continue");
 static ustring op_endswith("endswith");
+static ustring op_environment("environment");
 static ustring op_eq("eq");
 static ustring op_functioncall("functioncall");
 static ustring op_functioncall_nr("functioncall_nr");
@@ -103,7 +104,8 @@ are_op_results_always_implicitly_varying(ustring opname)
 {
     return (opname == Strings::op_getmessage) | (opname == Strings::op_trace)
            | (opname == Strings::op_texture)
-           | (opname == Strings::op_texture3d);
+           | (opname == Strings::op_texture3d)
+           | (opname == Strings::op_environment);
     // Renderer might identify result of getattribute as always uniform
     // depending on the attribute itself, so it cannot
     // be "always" implicitly varying based solely on the opname.
@@ -6,6 +6,8 @@
 
 #include <llvm/IR/Constant.h>
 
+#include <OSL/batched_texture.h>
+
 #include "batched_backendllvm.h"
 
 
@@ -1160,6 +1162,167 @@ LLVMGEN (llvm_gen_compare_op)
 }
 
 
+// Return a pointer to a wide copy of the value (or a deriv) of sym, for
+// shadeops that only take that argument wide.  Varying symbols are passed
+// in place; uniform ones, and derivs sym doesn't have (which load as 0),
+// are written to a temp, so a TempScope must be active.
+static llvm::Value *
+llvm_wide_arg_ptr (BatchedBackendLLVM &rop, const Symbol &sym, int deriv = 0)
+{
+    if (sym.is_varying() && (deriv == 0 || sym.has_derivs()))
+        return rop.llvm_void_ptr (sym, deriv);
+
+    const TypeSpec &t = sym.typespec();
+    llvm::Value *tmpptr = rop.getOrAllocateTemp (t, false /*derivs*/,
+                                                 false /*is_uniform*/);
+    auto disable_masked_stores = rop.ll.create_masking_scope (false);
+    for (int c = 0;  c < t.aggregate();  ++c) {
+        llvm::Value *v = rop.llvm_load_value (sym, deriv, c, TypeDesc::UNKNOWN,
+                                              false /*op_is_uniform*/);
+        rop.llvm_store_value (v, tmpptr, t, 0, NULL, c);
+    }
+    return rop.ll.void_ptr (tmpptr);
+}
+
+
+
+// Fill the wide matrix at transform with the transformation from the
+// space named by From to the one named by To (either may be NULL for
+// "common"), returning as an int the lanes for which both were known.
+static llvm::Value *
+llvm_batched_build_transform_matrix (BatchedBackendLLVM &rop,
+                                     llvm::Value *transform,
+                                     const Symbol *From, const Symbol *To)
+{
+    bool from_is_uniform = (From == NULL || From->is_uniform());
+    bool to_is_uniform = (To == NULL || To->is_uniform());
+    llvm::Value *args[] = { rop.sg_void_ptr(),
+        rop.ll.void_ptr(transform),
+        From == NULL ? rop.ll.constant(Strings::common)
+                     : (from_is_uniform ? rop.llvm_load_value(*From) : rop.llvm_void_ptr(*From)),
+        To == NULL ? rop.ll.constant(Strings::common)
+                   : (to_is_uniform ? rop.llvm_load_value(*To) : rop.llvm_void_ptr(*To)),
+        rop.ll.mask_as_int(rop.ll.current_mask())};
+
+    // Dynamically build function name
+    FuncSpec func_spec("build_transform_matrix");
+    func_spec.arg_varying(TypeDesc::TypeMatrix);
+    func_spec.arg(TypeDesc::TypeString, from_is_uniform);
+    func_spec.arg(TypeDesc::TypeString, to_is_uniform);
+    func_spec.mask();
+
+    return rop.ll.call_function (rop.build_name(func_spec), args);
+}
+
+
+
+// Transform the triple P by the matrix at transform into the varying
+// Result, P and Result may be the same symbol.  Lanes not set in
+// succeeded_as_int get P unchanged.  The wide shadeops only carry derivs
+// when both P and Result have them, otherwise Result's are zeroed.
+static void
+llvm_batched_transform_triple (BatchedBackendLLVM &rop,
+                               const char *triple_type,
+                               const Symbol &P, const Symbol &Result,
+                               llvm::Value *transform,
+                               bool transform_is_uniform,
+                               llvm::Value *succeeded_as_int)
+{
+    OSL_ASSERT(Result.is_varying());
+    bool derivs = P.is_varying() && P.has_derivs() && Result.has_derivs();
+
+    llvm::Value *args[] = {
+        rop.llvm_void_ptr(P /* src */),
+        rop.llvm_void_ptr(Result /* dest */),
+        rop.ll.void_ptr(transform),
+        succeeded_as_int,
+        rop.ll.mask_as_int(rop.ll.current_mask())};
+
+    // Dynamically build function name
+    auto transform_name = llvm::Twine("transform_") + triple_type;
+    FuncSpec func_spec(transform_name);
+    func_spec.arg(P, derivs, P.is_uniform());
+    func_spec.arg(Result, derivs, false /*is_uniform*/);
+    func_spec.arg(TypeDesc::TypeMatrix44, transform_is_uniform);
+    func_spec.mask();
+
+    rop.ll.call_function (rop.build_name(func_spec), args);
+
+    if (Result.has_derivs() && !derivs)
+        rop.llvm_zero_derivs (Result);
+}
+
+
+
+// Transform the triple P from the space named by From to the one named by
+// To (either may be NULL for "common") into the varying Result.  When both
+// names are uniform, the renderer is first asked for a matrix that does
+// not depend on time, which transforms every lane at the cost of a single
+// uniform matrix; only if it has none (time-varying, per-lane shader or
+// object space, or unknown) do we build a wide matrix from each lane's
+// time.
+static void
+llvm_batched_transform_by_spaces (BatchedBackendLLVM &rop,
+                                  const char *triple_type,
+                                  const Symbol &P, const Symbol &Result,
+                                  const Symbol *From, const Symbol *To)
+{
+    bool spaces_are_uniform = (From == NULL || From->is_uniform())
+                              && (To == NULL || To->is_uniform());
+    // Shader and object space come from the varying shader globals
+    for (const Symbol *space : { From, To }) {
+        if (space && space->is_constant()
+            && (space->get_string() == Strings::shader
+                || space->get_string() == Strings::object))
+            spaces_are_uniform = false;
+    }
+
+    llvm::BasicBlock *wide_block = nullptr, *after_block = nullptr;
+    if (spaces_are_uniform) {
+        BatchedBackendLLVM::TempScope temp_scope(rop);
+        llvm::Value *matrix = rop.getOrAllocateTemp (
+            TypeSpec(TypeDesc::TypeMatrix), false /*derivs*/,
+            true /*is_uniform*/);
+        llvm::Value *args[] = { rop.sg_void_ptr(), rop.ll.void_ptr(matrix),
+            From == NULL ? rop.ll.constant(Strings::common)
+                         : rop.llvm_load_value(*From),
+            To == NULL ? rop.ll.constant(Strings::common)
+                       : rop.llvm_load_value(*To) };
+        FuncSpec func_spec("build_transform_matrix");
+        func_spec.arg_uniform(TypeDesc::TypeMatrix);
+        func_spec.arg_uniform(TypeDesc::TypeString);
+        func_spec.arg_uniform(TypeDesc::TypeString);
+        llvm::Value *is_static = rop.ll.call_function (
+            rop.build_name(func_spec), args);
+
+        llvm::BasicBlock *static_block = rop.ll.new_basic_block (
+            rop.llvm_debug() ? "static transform" : std::string());
+        wide_block = rop.ll.new_basic_block (
+            rop.llvm_debug() ? "time-varying transform" : std::string());
+        after_block = rop.ll.new_basic_block (
+            rop.llvm_debug() ? "after transform" : std::string());
+        rop.ll.op_branch (rop.ll.op_ne (is_static, rop.ll.constant(0)),
+                          static_block, wide_block);
+        // insert point is now static_block
+        llvm_batched_transform_triple (rop, triple_type, P, Result, matrix,
+                                       true /*transform_is_uniform*/,
+                                       rop.ll.mask_as_int(rop.ll.current_mask()));
+        rop.ll.op_branch (after_block);
+        rop.ll.set_insert_point (wide_block);
+    }
+
+    llvm::Value *transform = rop.temp_wide_matrix_ptr();
+    llvm::Value *succeeded_as_int = llvm_batched_build_transform_matrix (
+                                        rop, transform, From, To);
+    llvm_batched_transform_triple (rop, triple_type, P, Result, transform,
+                                   false /*transform_is_uniform*/,
+                                   succeeded_as_int);
+    if (after_block)
+        rop.ll.op_branch (after_block);  // also moves insert point
+}
+
+
+
 // Construct spatial triple (point, vector, normal), optionally with a
 // transformation from a named coordinate system.
 LLVMGEN (llvm_gen_construct_triple)
@@ -1252,46 +1415,1173 @@ LLVMGEN (llvm_gen_construct_triple)
 //            // nonlinear transformations potentially are supported.
 //            rop.ll.call_function ("osl_transform_triple_nonlinear", args, 8);
 //        } else
-        llvm::Value * transform = rop.temp_wide_matrix_ptr();
-        llvm::Value *succeeded_as_int = nullptr;
-        {
-            llvm::Value *args[] = { rop.sg_void_ptr(),
-                rop.ll.void_ptr(transform),
-                space_is_uniform ? rop.llvm_load_value(Space) : rop.llvm_void_ptr(Space),
-                rop.ll.constant(Strings::common),
-                rop.ll.mask_as_int(rop.ll.current_mask())};
-
-            // Dynamically build function name
-            FuncSpec func_spec("build_transform_matrix");
-            func_spec.arg_varying(TypeDesc::TypeMatrix);
-            func_spec.arg(Space,false/*derivs*/, space_is_uniform);
-            func_spec.arg_uniform(TypeDesc::TypeString);
-            func_spec.mask();
+        OSL_ASSERT(Result.is_uniform() == false && "unreachable case");
+        // definitely not a nonlinear transformation
+        llvm_batched_transform_by_spaces (rop, triple_type.c_str(), Result,
+                                          Result, &Space, NULL /*common*/);
+    }
+    return true;
+}
+
+
+
+/// matrix constructor.  Comes in several varieties:
+///    matrix (float)
+///    matrix (space, float)
+///    matrix (...16 floats...)
+///    matrix (space, ...16 floats...)
+///    matrix (fromspace, tospace)
+LLVMGEN (llvm_gen_matrix)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    Symbol& Result = *rop.opargsym (op, 0);
+    int nargs = op.nargs();
+    bool using_space = (nargs == 3 || nargs == 18);
+    bool using_two_spaces = (nargs == 3 && rop.opargsym(op,2)->typespec().is_string());
+    int nfloats = nargs - 1 - (int)using_space;
+    OSL_DASSERT (nargs == 2 || nargs == 3 || nargs == 17 || nargs == 18);
 
-            succeeded_as_int = rop.ll.call_function (rop.build_name(func_spec), args);
+    bool result_is_uniform = Result.is_uniform();
+
+    if (using_two_spaces) {
+        // Named spaces come from the varying shader globals, so the
+        // batched analysis makes Result varying
+        OSL_ASSERT(!result_is_uniform);
+        Symbol& From = *rop.opargsym (op, 1);
+        Symbol& To = *rop.opargsym (op, 2);
+        llvm::Value *args[] = {
+            rop.sg_void_ptr(),  // shader globals
+            rop.llvm_void_ptr(Result),  // result
+            From.is_uniform() ? rop.llvm_load_value(From) : rop.llvm_void_ptr(From),
+            To.is_uniform() ? rop.llvm_load_value(To) : rop.llvm_void_ptr(To),
+            rop.ll.mask_as_int(rop.ll.current_mask())};
+
+        FuncSpec func_spec("get_from_to_matrix");
+        func_spec.arg_varying(TypeDesc::TypeMatrix);
+        func_spec.arg(From, From.is_uniform());
+        func_spec.arg(To, To.is_uniform());
+        func_spec.mask();
+        rop.ll.call_function (rop.build_name(func_spec), args);
+    } else {
+        if (nfloats == 1) {
+            llvm::Value* zero = result_is_uniform ? rop.ll.constant(0.0f)
+                                                  : rop.ll.wide_constant(0.0f);
+            for (int i = 0; i < 16; i++) {
+                llvm::Value* src_val = ((i%4) == (i/4))
+                    ? rop.llvm_load_value (*rop.opargsym(op,1+using_space), 0, 0,
+                                           TypeDesc::UNKNOWN, result_is_uniform)
+                    : zero;
+                rop.llvm_store_value (src_val, Result, 0, i);
+            }
+        } else if (nfloats == 16) {
+            for (int i = 0; i < 16; i++) {
+                llvm::Value* src_val = rop.llvm_load_value (*rop.opargsym(op,i+1+using_space), 0, 0,
+                                                            TypeDesc::UNKNOWN, result_is_uniform);
+                rop.llvm_store_value (src_val, Result, 0, i);
+            }
+        } else {
+            OSL_ASSERT (0);
         }
-        {
-            llvm::Value *args[] = {
-                rop.llvm_void_ptr(Result /* src */),
-                rop.llvm_void_ptr(Result /* dest */),
-                rop.ll.void_ptr(transform),
-                succeeded_as_int,
-                rop.ll.mask_as_int(rop.ll.current_mask())};
-
-            OSL_ASSERT(Result.is_uniform() == false && "unreachable case");
-            // definitely not a nonlinear transformation
-
-            // Dynamically build function name
-            auto transform_name = llvm::Twine("transform_") + triple_type.c_str();
-            FuncSpec func_spec(transform_name);
-            func_spec.arg(Result, Result.has_derivs(), resultIsUniform);
-            func_spec.arg(Result, Result.has_derivs(), resultIsUniform);
-            func_spec.arg_varying(TypeDesc::TypeMatrix44);
-            func_spec.mask();
+        if (using_space) {
+            Symbol& Space = *rop.opargsym (op, 1);
+            bool is_common = false;
+            if (Space.is_constant()) {
+                ustring from = Space.get_string();
+                is_common = (from == Strings::common ||
+                             from == rop.shadingsys().commonspace_synonym());
+            }
+            if (! is_common) {
+                OSL_ASSERT(!result_is_uniform);
+                llvm::Value *args[] = {
+                    rop.sg_void_ptr(),  // shader globals
+                    rop.llvm_void_ptr(Result),  // result
+                    Space.is_uniform() ? rop.llvm_load_value(Space) : rop.llvm_void_ptr(Space),
+                    rop.ll.mask_as_int(rop.ll.current_mask())};
+
+                // There is only a masked version, which also takes
+                // care of lanes whose space is unknown
+                FuncSpec func_spec("prepend_matrix_from");
+                func_spec.arg_varying(TypeDesc::TypeMatrix);
+                func_spec.arg(Space, Space.is_uniform());
+                func_spec.mask();
+                rop.ll.call_function (rop.build_name(func_spec), args);
+            }
+        }
+    }
+    if (Result.has_derivs())
+        rop.llvm_zero_derivs (Result);
+    return true;
+}
+
+
 
-            rop.ll.call_function (rop.build_name(func_spec), args);
+/// int getmatrix (fromspace, tospace, M)
+LLVMGEN (llvm_gen_getmatrix)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    OSL_DASSERT (op.nargs() == 4);
+    Symbol& Result = *rop.opargsym (op, 0);
+    Symbol& From = *rop.opargsym (op, 1);
+    Symbol& To = *rop.opargsym (op, 2);
+    Symbol& M = *rop.opargsym (op, 3);
+
+    // Named spaces come from the varying shader globals, so the batched
+    // analysis makes both Result and M varying
+    OSL_ASSERT(Result.is_varying() && M.is_varying());
+
+    llvm::Value *args[] = {
+        rop.sg_void_ptr(),  // shader globals
+        rop.llvm_void_ptr(M),  // matrix result
+        From.is_uniform() ? rop.llvm_load_value(From) : rop.llvm_void_ptr(From),
+        To.is_uniform() ? rop.llvm_load_value(To) : rop.llvm_void_ptr(To),
+        rop.ll.mask_as_int(rop.ll.current_mask())};
+
+    FuncSpec func_spec("get_from_to_matrix");
+    func_spec.arg_varying(TypeDesc::TypeMatrix);
+    func_spec.arg(From, From.is_uniform());
+    func_spec.arg(To, To.is_uniform());
+    func_spec.mask();
+    llvm::Value *result = rop.ll.call_function (rop.build_name(func_spec), args);
+    rop.llvm_conversion_store_masked_status (result, Result);
+    rop.llvm_zero_derivs (M);
+    return true;
+}
+
+
+
+// transform{,v,n} (string tospace, triple p)
+// transform{,v,n} (string fromspace, string tospace, triple p)
+// transform{,v,n} (matrix, triple p)
+LLVMGEN (llvm_gen_transform)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    int nargs = op.nargs();
+    Symbol *Result = rop.opargsym (op, 0);
+    Symbol *From = (nargs == 3) ? NULL : rop.opargsym (op, 1);
+    Symbol *To = rop.opargsym (op, (nargs == 3) ? 1 : 2);
+    Symbol *P = rop.opargsym (op, (nargs == 3) ? 2 : 3);
+
+    TypeDesc::VECSEMANTICS vectype = TypeDesc::POINT;
+    const char *triple_type = "point";
+    if (op.opname() == "transformv") {
+        vectype = TypeDesc::VECTOR;
+        triple_type = "vector";
+    } else if (op.opname() == "transformn") {
+        vectype = TypeDesc::NORMAL;
+        triple_type = "normal";
+    }
+
+    if (To->typespec().is_matrix()) {
+        if (Result->is_uniform()) {
+            // llvm_ops has the uniform matrix version already implemented
+            return llvm_gen_generic (rop, opnum);
         }
+        // Every lane has a matrix
+        llvm_batched_transform_triple (rop, triple_type, *P, *Result,
+                                       rop.llvm_void_ptr(*To), To->is_uniform(),
+                                       rop.ll.mask_as_int(rop.ll.current_mask()));
+        return true;
+    }
+
+    // Named space versions from here on out.
+    ustring from, to;  // N.B.: initialize to empty strings
+    if ((From == NULL || From->is_constant()) && To->is_constant()) {
+        // We can know all the space names at this time
+        from = From ? From->get_string() : Strings::common;
+        to = To->get_string();
+        ustring syn = rop.shadingsys().commonspace_synonym();
+        if (from == syn)
+            from = Strings::common;
+        if (to == syn)
+            to = Strings::common;
+        if (from == to) {
+            // An identity transformation, just copy
+            if (Result != P) // don't bother in-place copy
+                rop.llvm_assign_impl (*Result, *P);
+            return true;
+        }
+    }
+
+    if (rop.renderer()->transform_points (NULL, from, to, 0.0f, NULL, NULL, 0, vectype)) {
+        // There is no wide version of the nonlinear transformation
+        rop.shadingcontext()->errorf("nonlinear transformations are not supported by the batched backend (%s:%d)",
+                                     op.sourcefile(), op.sourceline());
+        return false;
+    }
+
+    // Named spaces may depend on the varying shader globals, so the
+    // batched analysis makes Result varying
+    llvm_batched_transform_by_spaces (rop, triple_type, *P, *Result, From, To);
+    return true;
+}
+
+
+
+// transformc (string fromspace, string tospace, color p)
+LLVMGEN (llvm_gen_transformc)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    OSL_DASSERT (op.nargs() == 4);
+    Symbol *Result = rop.opargsym (op, 0);
+    Symbol *From = rop.opargsym (op, 1);
+    Symbol *To = rop.opargsym (op, 2);
+    Symbol *C = rop.opargsym (op, 3);
+
+    FuncSpec func_spec("transform_color");
+    if (Result->is_uniform()) {
+        llvm::Value *args[] = { rop.sg_void_ptr(),
+            rop.llvm_void_ptr(*C), rop.ll.constant(C->has_derivs()),
+            rop.llvm_void_ptr(*Result), rop.ll.constant(Result->has_derivs()),
+            rop.ll.void_ptr(rop.llvm_load_value(*From)),
+            rop.ll.void_ptr(rop.llvm_load_value(*To)) };
+        rop.ll.call_function (rop.build_name(func_spec), args);
+        return true;
+    }
+
+    // The masked version takes everything wide
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+    bool c_derivs = C->is_varying() && C->has_derivs();
+    llvm::Value *args[] = { rop.sg_void_ptr(),
+        llvm_wide_arg_ptr(rop, *C), rop.ll.constant(c_derivs),
+        rop.llvm_void_ptr(*Result), rop.ll.constant(Result->has_derivs()),
+        llvm_wide_arg_ptr(rop, *From), llvm_wide_arg_ptr(rop, *To),
+        rop.ll.mask_as_int(rop.ll.current_mask()) };
+    func_spec.mask();
+    rop.ll.call_function (rop.build_name(func_spec), args);
+    return true;
+}
+
+
+
+// color blackbody (float temperatureK)
+// color wavelength_color (float wavelength_nm)  // same function signature
+LLVMGEN (llvm_gen_blackbody)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    OSL_DASSERT (op.nargs() == 2);
+    Symbol &Result (*rop.opargsym (op, 0));
+    Symbol &Temperature (*rop.opargsym (op, 1));
+    OSL_DASSERT (Result.typespec().is_triple() && Temperature.typespec().is_float());
+
+    FuncSpec func_spec(op.opname().c_str());
+    if (Result.is_uniform()) {
+        llvm::Value* args[] = { rop.sg_void_ptr(), rop.llvm_void_ptr(Result),
+                                rop.llvm_load_value(Temperature) };
+        func_spec.arg_uniform(TypeDesc::TypeColor);
+        func_spec.arg_uniform(TypeDesc::TypeFloat);
+        rop.ll.call_function (rop.build_name(func_spec), args);
+    } else {
+        BatchedBackendLLVM::TempScope temp_scope(rop);
+        llvm::Value* args[] = { rop.sg_void_ptr(), rop.llvm_void_ptr(Result),
+                                llvm_wide_arg_ptr(rop, Temperature),
+                                rop.ll.mask_as_int(rop.ll.current_mask()) };
+        func_spec.arg_varying(TypeDesc::TypeColor);
+        func_spec.arg_varying(TypeDesc::TypeFloat);
+        func_spec.mask();
+        rop.ll.call_function (rop.build_name(func_spec), args);
+    }
+
+    // Punt, zero out derivs.
+    // FIXME -- only of some day, someone truly needs blackbody() to
+    // correctly return derivs with spatially-varying temperature.
+    if (Result.has_derivs())
+        rop.llvm_zero_derivs (Result);
+
+    return true;
+}
+
+
+
+// Return a pointer to a copy of the varying Knots with zero derivs, for
+// the wide splines that want knots with derivs.  A TempScope must be
+// active.
+static llvm::Value *
+llvm_knots_with_derivs_ptr (BatchedBackendLLVM &rop, const Symbol &Knots)
+{
+    OSL_ASSERT (Knots.is_varying() && !Knots.has_derivs());
+    const TypeSpec &t = Knots.typespec();
+    llvm::Value *tmpptr = rop.getOrAllocateTemp (t, true /*derivs*/,
+                                                 false /*is_uniform*/);
+    auto disable_masked_stores = rop.ll.create_masking_scope (false);
+    llvm::Value *zero = rop.ll.wide_constant (0.0f);
+    for (int i = 0;  i < t.arraylength();  ++i) {
+        llvm::Value *index = rop.ll.constant (i);
+        for (int c = 0;  c < t.aggregate();  ++c) {
+            llvm::Value *v = rop.llvm_load_value (Knots, 0, index, c,
+                                                  TypeDesc::UNKNOWN,
+                                                  false /*op_is_uniform*/);
+            rop.llvm_store_value (v, tmpptr, t, 0, index, c);
+            rop.llvm_store_value (zero, tmpptr, t, 1, index, c);
+            rop.llvm_store_value (zero, tmpptr, t, 2, index, c);
+        }
+    }
+    return rop.ll.void_ptr (tmpptr);
+}
+
+
+
+// spline (string basis, float x, [int nknots,] knots[])
+// splineinverse (string basis, float y, [int nknots,] float knots[])
+LLVMGEN (llvm_gen_spline)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+
+    OSL_DASSERT(op.nargs() >= 4 && op.nargs() <= 5);
+
+    bool has_knot_count = (op.nargs() == 5);
+    Symbol& Result   = *rop.opargsym (op, 0);
+    Symbol& Spline   = *rop.opargsym (op, 1);
+    Symbol& Value    = *rop.opargsym (op, 2);
+    Symbol& Knot_count = *rop.opargsym (op, 3); // might alias Knots
+    Symbol& Knots    = has_knot_count ? *rop.opargsym (op, 4) :
+                                        *rop.opargsym (op, 3);
+
+    OSL_DASSERT(!Result.typespec().is_closure_based() &&
+             Spline.typespec().is_string()  &&
+             Value.typespec().is_float() &&
+             !Knots.typespec().is_closure_based() &&
+             Knots.typespec().is_array() &&
+             (!has_knot_count || (has_knot_count && Knot_count.typespec().is_int())));
+
+    // The wide shadeops share the basis and knot count between lanes
+    if (Spline.is_varying() || (has_knot_count && Knot_count.is_varying())) {
+        rop.shadingcontext()->errorf("%s basis and knot count must be uniform for the batched backend (%s:%d)",
+                                     op.opname(), op.sourcefile(), op.sourceline());
+        return false;
+    }
+
+    bool op_is_uniform = Result.is_uniform();
+    // only use derivatives for result if:
+    //   result has derivs and (value || knots) have derivs
+    bool result_derivs = Result.has_derivs() && (Value.has_derivs() || Knots.has_derivs());
+    bool value_derivs = result_derivs && Value.has_derivs();
+    bool knot_derivs = result_derivs && Knots.has_derivs();
+    bool value_is_uniform = Value.is_uniform();
+    bool knots_are_uniform = Knots.is_uniform();
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    llvm::Value *value_ptr = rop.llvm_void_ptr (Value);
+    llvm::Value *knots_ptr = rop.llvm_void_ptr (Knots);
+    if (! op_is_uniform) {
+        // Only some mixes of uniform and varying arguments have a wide
+        // shadeop.  Varying knots with derivs go with any x, so give
+        // varying knots derivs when the result needs them; otherwise x
+        // is passed wide, with derivs if the result has them.
+        if (result_derivs && ! knots_are_uniform && ! Knots.has_derivs()) {
+            knots_ptr = llvm_knots_with_derivs_ptr (rop, Knots);
+            knot_derivs = true;
+        }
+        if (knots_are_uniform || ! knot_derivs) {
+            value_ptr = rop.llvm_load_arg (Value, result_derivs,
+                                           false /*op_is_uniform*/);
+            value_derivs = result_derivs;
+            value_is_uniform = false;
+        }
+    }
+
+    llvm::Value * args[] = {
+        rop.llvm_void_ptr (Result),
+        rop.ll.void_ptr (rop.llvm_load_value (Spline)),
+        value_ptr,
+        knots_ptr,
+        has_knot_count ?
+            rop.llvm_load_value (Knot_count) :
+            rop.ll.constant ((int)Knots.typespec().arraylength()),
+        rop.ll.constant ((int)Knots.typespec().arraylength()),
+        rop.ll.mask_as_int (rop.ll.current_mask()),
+    };
+
+    FuncSpec func_spec(op.opname().c_str());
+    func_spec.arg (Result, result_derivs, op_is_uniform);
+    func_spec.arg (Value, value_derivs, value_is_uniform);
+    func_spec.arg (Knots.typespec().simpletype().elementtype(), knot_derivs,
+                   knots_are_uniform);
+    if (op_is_uniform) {
+        // The scalar shadeops take no mask
+        func_spec.unbatch();
+        rop.ll.call_function (rop.build_name(func_spec),
+                              cspan<llvm::Value *>(args, 6));
+    } else {
+        func_spec.mask();
+        rop.ll.call_function (rop.build_name(func_spec), args);
+    }
+
+    if (Result.has_derivs() && !result_derivs)
+        rop.llvm_zero_derivs (Result);
+
+    return true;
+}
+
+
+
+// Copy the uniform array at uniform_ptr into every active lane of the
+// varying array Dest.
+static void
+llvm_broadcast_array (BatchedBackendLLVM &rop, llvm::Value *uniform_ptr,
+                      const Symbol &Dest)
+{
+    OSL_ASSERT (Dest.is_varying());
+    const TypeSpec &t = Dest.typespec();
+    for (int i = 0;  i < t.arraylength();  ++i) {
+        llvm::Value *index = rop.ll.constant (i);
+        for (int c = 0;  c < t.aggregate();  ++c) {
+            llvm::Value *v = rop.llvm_load_value (uniform_ptr, t, 0, index, c);
+            rop.llvm_store_value (rop.ll.widen_value (v), Dest, 0, index, c);
+        }
+    }
+}
+
+
+
+// int split (string str, output string result[], string sep, int maxsplit)
+LLVMGEN (llvm_gen_split)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    OSL_DASSERT(op.nargs() >= 3 && op.nargs() <= 5);
+    Symbol& R       = *rop.opargsym (op, 0);
+    Symbol& Str     = *rop.opargsym (op, 1);
+    Symbol& Results = *rop.opargsym (op, 2);
+    OSL_DASSERT(R.typespec().is_int() && Str.typespec().is_string() &&
+             Results.typespec().is_array() &&
+             Results.typespec().is_string_based());
+
+    bool op_is_uniform = R.is_uniform();
+    // A varying op can only write varying results
+    OSL_ASSERT(op_is_uniform || Results.is_varying());
+    int resultslen = Results.typespec().arraylength();
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    if (op_is_uniform) {
+        // Results may still be varying from writes elsewhere, then the
+        // uniform split goes through a temporary copied to every lane.
+        llvm::Value *results_ptr = Results.is_uniform() ?
+            rop.llvm_void_ptr (Results) :
+            rop.getOrAllocateTemp (Results.typespec(), false /*derivs*/,
+                                   true /*is_uniform*/);
+        llvm::Value *args[] = {
+            rop.llvm_load_value (Str),
+            rop.ll.void_ptr (results_ptr),
+            op.nargs() >= 4 ? rop.llvm_load_value (*rop.opargsym (op, 3)) :
+                              rop.ll.constant (""),
+            op.nargs() >= 5 ? rop.llvm_load_value (*rop.opargsym (op, 4)) :
+                              rop.ll.constant (resultslen),
+            rop.ll.constant (resultslen),
+        };
+        llvm::Value *ret = rop.ll.call_function ("osl_split", args);
+        rop.llvm_store_value (ret, R);
+        if (Results.is_varying())
+            llvm_broadcast_array (rop, results_ptr, Results);
+        return true;
     }
+
+    llvm::Value *wsep;
+    if (op.nargs() >= 4) {
+        wsep = rop.llvm_load_arg (*rop.opargsym (op, 3), false /*derivs*/,
+                                  false /*op_is_uniform*/);
+    } else {
+        llvm::Value *tmpptr = rop.getOrAllocateTemp (TypeSpec(TypeDesc::STRING),
+                                                     false /*derivs*/,
+                                                     false /*is_uniform*/);
+        rop.ll.op_unmasked_store (rop.ll.wide_constant (ustring("")), tmpptr);
+        wsep = rop.ll.void_ptr (tmpptr);
+    }
+    llvm::Value *wmaxsplit;
+    if (op.nargs() >= 5) {
+        wmaxsplit = rop.llvm_load_arg (*rop.opargsym (op, 4), false /*derivs*/,
+                                       false /*op_is_uniform*/);
+    } else {
+        llvm::Value *tmpptr = rop.getOrAllocateTemp (TypeSpec(TypeDesc::INT),
+                                                     false /*derivs*/,
+                                                     false /*is_uniform*/);
+        rop.ll.op_unmasked_store (rop.ll.wide_constant (resultslen), tmpptr);
+        wmaxsplit = rop.ll.void_ptr (tmpptr);
+    }
+    llvm::Value *args[] = {
+        rop.llvm_void_ptr (R),
+        rop.llvm_load_arg (Str, false /*derivs*/, false /*op_is_uniform*/),
+        rop.llvm_void_ptr (Results),
+        wsep,
+        wmaxsplit,
+        rop.ll.constant (resultslen),
+        rop.ll.mask_as_int (rop.ll.current_mask()),
+    };
+    rop.ll.call_function (rop.build_name(FuncSpec("split").mask()), args);
+    return true;
+}
+
+
+
+// int regex_search (string subject, string pattern)
+// int regex_search (string subject, int results[], string pattern)
+// int regex_match (string subject, string pattern)
+// int regex_match (string subject, int results[], string pattern)
+LLVMGEN (llvm_gen_regex)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    int nargs = op.nargs();
+    OSL_DASSERT (nargs == 3 || nargs == 4);
+    Symbol &Result (*rop.opargsym (op, 0));
+    Symbol &Subject (*rop.opargsym (op, 1));
+    bool do_match_results = (nargs == 4);
+    bool fullmatch = (op.opname() == "regex_match");
+    Symbol &Match (*rop.opargsym (op, 2));
+    Symbol &Pattern (*rop.opargsym (op, 2+do_match_results));
+    OSL_DASSERT (Result.typespec().is_int() && Subject.typespec().is_string() &&
+                 Pattern.typespec().is_string());
+    OSL_DASSERT (!do_match_results ||
+                 (Match.typespec().is_array() &&
+                  Match.typespec().elementtype().is_int()));
+
+    bool op_is_uniform = Result.is_uniform();
+    // A varying op can only write varying match results
+    OSL_ASSERT(op_is_uniform || !do_match_results || Match.is_varying());
+    int nresults = do_match_results ? Match.typespec().arraylength() : 0;
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    if (op_is_uniform) {
+        // Match may still be varying from writes elsewhere, then the
+        // uniform match goes through a temporary copied to every lane.
+        bool broadcast = do_match_results && Match.is_varying();
+        llvm::Value *match_ptr = nullptr;
+        if (broadcast)
+            match_ptr = rop.getOrAllocateTemp (Match.typespec(),
+                                               false /*derivs*/,
+                                               true /*is_uniform*/);
+        llvm::Value* call_args[] = {
+            rop.sg_void_ptr(),
+            rop.llvm_load_value (Subject),
+            do_match_results ? rop.ll.void_ptr (broadcast ? match_ptr :
+                                                rop.llvm_get_pointer (Match)) :
+                               rop.ll.void_ptr_null(),
+            rop.ll.constant (nresults),
+            rop.llvm_load_value (Pattern),
+            rop.ll.constant (fullmatch),
+        };
+        llvm::Value *ret = rop.ll.call_function (rop.build_name("regex_impl"),
+                                                 call_args);
+        rop.llvm_store_value (ret, Result);
+        if (broadcast)
+            llvm_broadcast_array (rop, match_ptr, Match);
+        return true;
+    }
+
+    llvm::Value* call_args[] = {
+        rop.sg_void_ptr(),
+        rop.llvm_void_ptr (Result),
+        rop.llvm_load_arg (Subject, false /*derivs*/, false /*op_is_uniform*/),
+        do_match_results ? rop.llvm_void_ptr (Match) : rop.ll.void_ptr_null(),
+        rop.ll.constant (nresults),
+        rop.llvm_load_arg (Pattern, false /*derivs*/, false /*op_is_uniform*/),
+        rop.ll.constant (fullmatch),
+        rop.ll.mask_as_int (rop.ll.current_mask()),
+    };
+    rop.ll.call_function (rop.build_name(FuncSpec("regex_impl").mask()),
+                          call_args);
+    return true;
+}
+
+
+
+LLVMGEN (llvm_gen_noise)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    bool periodic = (op.opname() == Strings::pnoise ||
+                     op.opname() == Strings::psnoise);
+
+    int arg = 0;   // Next arg to read
+    Symbol &Result = *rop.opargsym (op, arg++);
+    int outdim = Result.typespec().is_triple() ? 3 : 1;
+    Symbol *Name = rop.opargsym (op, arg++);
+    ustring name;
+    if (Name->typespec().is_string()) {
+        name = Name->is_constant() ? Name->get_string() : ustring();
+    } else {
+        // Not a string, must be the old-style noise/pnoise
+        --arg;  // forget that arg
+        Name = NULL;
+        name = op.opname();
+    }
+
+    Symbol *S = rop.opargsym (op, arg++), *T = NULL;
+    Symbol *Sper = NULL, *Tper = NULL;
+    int indim = S->typespec().is_triple() ? 3 : 1;
+    bool derivs = S->has_derivs();
+
+    if (periodic) {
+        if (op.nargs() > (arg+1) &&
+                (rop.opargsym(op,arg+1)->typespec().is_float() ||
+                 rop.opargsym(op,arg+1)->typespec().is_triple())) {
+            // 2D or 4D
+            ++indim;
+            T = rop.opargsym (op, arg++);
+            derivs |= T->has_derivs();
+        }
+        Sper = rop.opargsym (op, arg++);
+        if (indim == 2 || indim == 4)
+            Tper = rop.opargsym (op, arg++);
+    } else {
+        // non-periodic case
+        if (op.nargs() > arg && rop.opargsym(op,arg)->typespec().is_float()) {
+            // either 2D or 4D, so needs a second index
+            ++indim;
+            T = rop.opargsym (op, arg++);
+            derivs |= T->has_derivs();
+        }
+    }
+    derivs &= Result.has_derivs();  // ignore derivs if result doesn't need
+
+    if (name.empty() || name == Strings::gabor) {
+        // The generic and gabor noises need the noise options and the
+        // shader globals, which have no wide implementation yet.
+        rop.shadingcontext()->errorf("%snoise type \"%s\" is not supported by the batched backend, called from (%s:%d)",
+                                (periodic ? "periodic " : ""),
+                                name.empty() ? "<varying>" : name.c_str(),
+                                op.sourcefile(), op.sourceline());
+        return false;
+    } else if (name == Strings::perlin || name == Strings::snoise ||
+               name == Strings::psnoise) {
+        name = periodic ? Strings::psnoise : Strings::snoise;
+    } else if (name == Strings::uperlin || name == Strings::noise ||
+               name == Strings::pnoise) {
+        name = periodic ? Strings::pnoise : Strings::noise;
+    } else if (name == Strings::cell || name == Strings::cellnoise) {
+        name = periodic ? Strings::pcellnoise : Strings::cellnoise;
+        derivs = false;  // cell noise derivs are always zero
+    } else if (name == Strings::hash || name == Strings::hashnoise) {
+        name = periodic ? Strings::phashnoise : Strings::hashnoise;
+        derivs = false;  // hash noise derivs are always zero
+    } else if (name == Strings::simplex && !periodic) {
+        name = Strings::simplexnoise;
+    } else if (name == Strings::usimplex && !periodic) {
+        name = Strings::usimplexnoise;
+    } else {
+        rop.shadingcontext()->errorf("%snoise type \"%s\" is unknown, called from (%s:%d)",
+                                (periodic ? "periodic " : ""), name,
+                                op.sourcefile(), op.sourceline());
+        return false;
+    }
+
+    if (rop.shadingsys().no_noise()) {
+        // renderer option to replace noise with constant value. This can be
+        // useful as a profiling aid, to see how much it speeds up to have
+        // trivial expense for noise calls.
+        if (name == Strings::noise || name == Strings::usimplexnoise ||
+            name == Strings::cellnoise || name == Strings::hashnoise ||
+            name == Strings::pcellnoise || name == Strings::pnoise)
+            name = ustring("unullnoise");
+        else
+            name = ustring("nullnoise");
+        periodic = false;
+    }
+
+    // The batched analysis only leaves Result uniform when every argument
+    // is uniform too, in which case the scalar shadeop does the job.
+    bool op_is_uniform = Result.is_uniform();
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    FuncSpec func_spec(name.c_str());
+    llvm::Value * args[8]; int nargs = 0;
+    // A varying result is always passed by pointer, as is a uniform
+    // triple return or float return with derivs
+    bool result_is_ptr = !op_is_uniform || outdim == 3 || derivs;
+    if (result_is_ptr) {
+        args[nargs++] = rop.llvm_void_ptr (Result);
+    }
+    func_spec.arg (Result, derivs, op_is_uniform);
+    func_spec.arg (*S, derivs, op_is_uniform);
+    args[nargs++] = rop.llvm_load_arg (*S, derivs, op_is_uniform);
+    if (T) {
+        func_spec.arg (*T, derivs, op_is_uniform);
+        args[nargs++] = rop.llvm_load_arg (*T, derivs, op_is_uniform);
+    }
+    if (periodic) {
+        func_spec.arg (*Sper, false /* no derivs */, op_is_uniform);
+        args[nargs++] = rop.llvm_load_arg (*Sper, false, op_is_uniform);
+        if (Tper) {
+            func_spec.arg (*Tper, false /* no derivs */, op_is_uniform);
+            args[nargs++] = rop.llvm_load_arg (*Tper, false, op_is_uniform);
+        }
+    }
+
+    if (op_is_uniform) {
+        func_spec.unbatch();
+    } else {
+        // Every wide noise is masked
+        func_spec.mask();
+        args[nargs++] = rop.ll.mask_as_int (rop.ll.current_mask());
+    }
+
+    llvm::Value *r = rop.ll.call_function (rop.build_name(func_spec),
+                                           cspan<llvm::Value *>(args, nargs));
+    if (!result_is_ptr) {
+        rop.llvm_store_value (r, Result);
+    }
+
+    if (Result.has_derivs() && !derivs) {
+        rop.llvm_zero_derivs (Result);
+    }
+
+    return true;
+}
+
+
+
+// Fill in the BatchedTextureOptions the wide texture shadeops are passed,
+// from the optional token/value arguments of a texture op.  The struct is
+// shared by all the texture ops of a layer, so every member is written.
+// Unlike TextureOpt, only the blurs and widths may vary per lane, and the
+// wrap and interp modes must be known when generating code.  Returns
+// false, after reporting it, for arguments that can't be expressed.
+static bool
+llvm_batched_texture_options (BatchedBackendLLVM &rop, int opnum,
+                              int first_optional_arg, bool tex3d, int nchans,
+                              llvm::Value* &alpha, bool &alpha_derivs,
+                              llvm::Value* &errormessage)
+{
+    TextureOpt optdefaults;  // So we start from the scalar defaults
+    llvm::Value *sblur = rop.ll.wide_constant (optdefaults.sblur);
+    llvm::Value *tblur = rop.ll.wide_constant (optdefaults.tblur);
+    llvm::Value *rblur = rop.ll.wide_constant (optdefaults.rblur);
+    llvm::Value *swidth = rop.ll.wide_constant (optdefaults.swidth);
+    llvm::Value *twidth = rop.ll.wide_constant (optdefaults.twidth);
+    llvm::Value *rwidth = rop.ll.wide_constant (optdefaults.rwidth);
+    llvm::Value *firstchannel = rop.ll.constant (optdefaults.firstchannel);
+    llvm::Value *subimage = rop.ll.constant (optdefaults.subimage);
+    llvm::Value *subimagename = rop.ll.void_ptr_null ();
+    llvm::Value *swrap = rop.ll.constant ((int)optdefaults.swrap);
+    llvm::Value *twrap = rop.ll.constant ((int)optdefaults.twrap);
+    llvm::Value *rwrap = rop.ll.constant ((int)optdefaults.rwrap);
+    llvm::Value *interpmode = rop.ll.constant ((int)optdefaults.interpmode);
+    llvm::Value *fill = rop.ll.constant (optdefaults.fill);
+    llvm::Value *missingcolor = NULL;
+
+    Opcode &op (rop.inst()->ops()[opnum]);
+    auto unsupported = [&](ustring name, const char *why) -> bool {
+        rop.shadingcontext()->errorf("texture%s optional argument \"%s\" %s for the batched backend (%s:%d)",
+                                     tex3d ? "3d" : "", name, why,
+                                     op.sourcefile(), op.sourceline());
+        return false;
+    };
+
+    for (int a = first_optional_arg;  a < op.nargs();  ++a) {
+        Symbol &Name (*rop.opargsym(op,a));
+        OSL_DASSERT (Name.typespec().is_string() &&
+                     "optional texture token must be a string");
+        OSL_DASSERT (a+1 < op.nargs() && "malformed argument list for texture");
+        ustring name = Name.get_string();
+        ++a;  // advance to next argument
+
+        if (name.empty())    // skip empty string param name
+            continue;
+
+        Symbol &Val (*rop.opargsym(op,a));
+        TypeDesc valtype = Val.typespec().simpletype ();
+
+#define PARAM_WIDE_FLOAT(paramname)                                     \
+        if (name == Strings::paramname &&                               \
+            (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT)) { \
+            paramname = rop.llvm_load_value (Val, 0, 0, TypeDesc::TypeFloat, \
+                                             false /*op_is_uniform*/);  \
+            continue;                                                   \
+        }
+
+#define PARAM_WIDE_FLOAT_STR(paramname)                                 \
+        if (name == Strings::paramname &&                               \
+            (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT)) { \
+            llvm::Value *val = rop.llvm_load_value (Val, 0, 0, TypeDesc::TypeFloat, \
+                                                    false /*op_is_uniform*/); \
+            s##paramname = t##paramname = val;                          \
+            if (tex3d)                                                  \
+                r##paramname = val;                                     \
+            continue;                                                   \
+        }
+
+#define PARAM_UNIFORM(paramname,valtest,cast)                           \
+        if (name == Strings::paramname && (valtest)) {                  \
+            if (! Val.is_uniform())                                     \
+                return unsupported (name, "must be uniform");           \
+            paramname = rop.llvm_load_value (Val, 0, 0, cast);          \
+            continue;                                                   \
+        }
+
+#define PARAM_STRING_CODE(paramname,decoder,fieldname)                  \
+        if (name == Strings::paramname && valtype == TypeDesc::STRING) { \
+            if (! Val.is_constant())                                    \
+                return unsupported (name, "must be a constant");        \
+            int code = (int) decoder (Val.get_string());                \
+            if (code >= 0)                                              \
+                fieldname = rop.ll.constant (code);                     \
+            continue;                                                   \
+        }
+
+        PARAM_WIDE_FLOAT_STR (width)
+        PARAM_WIDE_FLOAT (swidth)
+        PARAM_WIDE_FLOAT (twidth)
+        PARAM_WIDE_FLOAT (rwidth)
+        PARAM_WIDE_FLOAT_STR (blur)
+        PARAM_WIDE_FLOAT (sblur)
+        PARAM_WIDE_FLOAT (tblur)
+        PARAM_WIDE_FLOAT (rblur)
+
+        if (name == Strings::wrap && valtype == TypeDesc::STRING) {
+            if (! Val.is_constant())
+                return unsupported (name, "must be a constant");
+            swrap = twrap = rop.ll.constant ((int) OIIO::Tex::decode_wrapmode (Val.get_string()));
+            if (tex3d)
+                rwrap = swrap;
+            continue;
+        }
+        PARAM_STRING_CODE (swrap, OIIO::Tex::decode_wrapmode, swrap)
+        PARAM_STRING_CODE (twrap, OIIO::Tex::decode_wrapmode, twrap)
+        PARAM_STRING_CODE (rwrap, OIIO::Tex::decode_wrapmode, rwrap)
+
+        PARAM_UNIFORM (fill, valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT,
+                       TypeDesc::TypeFloat)
+        PARAM_UNIFORM (firstchannel, valtype == TypeDesc::INT, TypeDesc::UNKNOWN)
+        PARAM_UNIFORM (subimage, valtype == TypeDesc::INT, TypeDesc::UNKNOWN)
+
+        // BatchedTextureOptions has no time, as OIIO doesn't use it either
+        if (name == Strings::time &&
+            (valtype == TypeDesc::FLOAT || valtype == TypeDesc::INT))
+            continue;
+
+        if (name == Strings::subimage && valtype == TypeDesc::STRING) {
+            if (! Val.is_uniform())
+                return unsupported (name, "must be uniform");
+            subimagename = rop.ll.void_ptr (rop.llvm_load_value (Val));
+            continue;
+        }
+
+        PARAM_STRING_CODE (interp, tex_interp_to_code, interpmode)
+
+        // Texture ops are implicitly varying, so everything they write is
+        if (name == Strings::alpha && valtype == TypeDesc::FLOAT) {
+            OSL_ASSERT (Val.is_varying());
+            alpha = rop.llvm_void_ptr (Val);
+            alpha_derivs = Val.has_derivs();
+            continue;
+        }
+        if (name == Strings::errormessage && valtype == TypeDesc::STRING) {
+            OSL_ASSERT (Val.is_varying());
+            errormessage = rop.llvm_void_ptr (Val);
+            continue;
+        }
+        if ((name == Strings::missingcolor &&
+             equivalent(valtype,TypeDesc::TypeColor)) ||
+            (name == Strings::missingalpha && valtype == TypeDesc::FLOAT)) {
+            if (! Val.is_uniform())
+                return unsupported (name, "must be uniform");
+            if (! missingcolor) {
+                // Enough storage for the missingcolor value (4 floats)
+                missingcolor = rop.ll.op_alloca (rop.ll.type_float(), 4);
+            }
+            if (name == Strings::missingcolor)
+                rop.ll.op_memcpy (rop.ll.void_ptr(missingcolor),
+                                  rop.llvm_void_ptr(Val), (int)sizeof(Color3));
+            else
+                rop.ll.op_store (rop.llvm_load_value (Val),
+                                 rop.ll.GEP (missingcolor, nchans));
+            continue;
+        }
+        rop.shadingcontext()->errorf("Unknown texture%s optional argument: \"%s\", <%s> (%s:%d)",
+                                     tex3d ? "3d" : "", name, valtype,
+                                     op.sourcefile(), op.sourceline());
+#undef PARAM_WIDE_FLOAT
+#undef PARAM_WIDE_FLOAT_STR
+#undef PARAM_UNIFORM
+#undef PARAM_STRING_CODE
+    }
+
+    // The order of the members is the same for every batch width
+    typedef BatchedTextureOptions<8>::LLVMMemberIndex Member;
+    llvm::Value *bto = rop.temp_batched_texture_options_ptr ();
+    auto disable_masked_stores = rop.ll.create_masking_scope (false);
+    auto store = [&](Member member, llvm::Value *val) -> void {
+        rop.ll.op_store (val, rop.ll.GEP (bto, 0, static_cast<int>(member)));
+    };
+    store (Member::sblur, sblur);
+    store (Member::tblur, tblur);
+    store (Member::rblur, rblur);
+    store (Member::swidth, swidth);
+    store (Member::twidth, twidth);
+    store (Member::rwidth, rwidth);
+    store (Member::firstchannel, firstchannel);
+    store (Member::subimage, subimage);
+    store (Member::subimagename, subimagename);
+    store (Member::swrap, swrap);
+    store (Member::twrap, twrap);
+    store (Member::rwrap, rwrap);
+    store (Member::mipmode, rop.ll.constant ((int)optdefaults.mipmode));
+    store (Member::interpmode, interpmode);
+    store (Member::anisotropic, rop.ll.constant (optdefaults.anisotropic));
+    store (Member::conservative_filter,
+           rop.ll.constant ((int)optdefaults.conservative_filter));
+    store (Member::fill, fill);
+    store (Member::missingcolor,
+           missingcolor ? missingcolor
+                        : rop.ll.ptr_cast (rop.ll.void_ptr_null(),
+                                           rop.ll.type_float_ptr()));
+    store (Member::private_envlayout, rop.ll.constant (0));
+    return true;
+}
+
+
+
+// Call the masked wide shadeop of a texture, texture3d or environment op,
+// whose coordinate arguments are in coords.  The shadeops look up a single
+// file, so a varying Filename is handled by calling once per distinct
+// name among the active lanes.
+static void
+llvm_batched_texture_lookup (BatchedBackendLLVM &rop, const char *opname,
+                             const Symbol &Filename,
+                             cspan<llvm::Value *> coords, int nchans,
+                             const Symbol &Result, llvm::Value *alpha,
+                             bool alpha_derivs, llvm::Value *errormessage)
+{
+    OSL_ASSERT (Result.is_varying());
+
+    RendererServices::TextureHandle *texture_handle = NULL;
+    if (Filename.is_constant() && rop.shadingsys().opt_texture_handle()) {
+        texture_handle = rop.renderer()->get_texture_handle (Filename.get_string(), rop.shadingcontext());
+    }
+
+    llvm::Value *mask = rop.ll.current_mask();
+    llvm::Value *name = nullptr;
+    llvm::Value *loc_of_remaining_lanes = nullptr;
+    llvm::BasicBlock *bin_block = nullptr, *after_bins_block = nullptr;
+    if (Filename.is_uniform()) {
+        name = rop.llvm_load_value (Filename);
+    } else {
+        llvm::Value *wide_name = rop.llvm_load_value (Filename, 0, 0, TypeDesc::UNKNOWN,
+                                                      false /*op_is_uniform*/);
+        loc_of_remaining_lanes = rop.ll.op_alloca (rop.ll.type_int(), 1,
+                                                   "texture lanes remaining");
+        rop.ll.op_store (rop.ll.mask_as_int (mask), loc_of_remaining_lanes);
+        bin_block = rop.ll.new_basic_block (rop.llvm_debug() ? "texture filename bin" : std::string());
+        after_bins_block = rop.ll.new_basic_block (rop.llvm_debug() ? "after texture filename bins" : std::string());
+        rop.ll.op_branch (bin_block);
+
+        // Take the name of the first remaining lane, and every remaining
+        // lane that shares it
+        llvm::Value *remaining = rop.ll.int_as_mask (rop.ll.op_load (loc_of_remaining_lanes));
+        name = rop.ll.op_extract (wide_name, rop.ll.op_1st_active_lane_of (remaining));
+        mask = rop.ll.op_lanes_that_match_masked (name, wide_name, remaining);
+        rop.ll.op_store (rop.ll.mask_as_int (rop.ll.op_xor (remaining, mask)),
+                         loc_of_remaining_lanes);
+    }
+
+    llvm::Value *args[17];
+    int nargs = 0;
+    args[nargs++] = rop.sg_void_ptr();
+    args[nargs++] = rop.ll.void_ptr (name);
+    args[nargs++] = rop.ll.constant_ptr (texture_handle);
+    args[nargs++] = rop.ll.void_ptr (rop.temp_batched_texture_options_ptr());
+    for (llvm::Value *coord : coords)
+        args[nargs++] = coord;
+    args[nargs++] = rop.ll.constant (nchans);
+    args[nargs++] = rop.llvm_void_ptr (Result);
+    args[nargs++] = rop.ll.constant ((int)Result.has_derivs());
+    args[nargs++] = alpha ? alpha : rop.ll.void_ptr_null();
+    args[nargs++] = rop.ll.constant ((int)alpha_derivs);
+    args[nargs++] = errormessage ? errormessage : rop.ll.void_ptr_null();
+    args[nargs++] = rop.ll.mask_as_int (mask);
+    OSL_DASSERT (nargs <= 17);
+
+    FuncSpec func_spec(opname);
+    func_spec.mask();
+    rop.ll.call_function (rop.build_name(func_spec),
+                          cspan<llvm::Value *>(args, nargs));
+
+    if (! Filename.is_uniform()) {
+        llvm::Value *remaining = rop.ll.op_load (loc_of_remaining_lanes);
+        rop.ll.op_branch (rop.ll.op_ne (remaining, rop.ll.constant(0)),
+                          bin_block, after_bins_block);
+        // insert point is now after_bins_block
+    }
+    rop.generated_texture_call (texture_handle != NULL);
+}
+
+
+
+LLVMGEN (llvm_gen_texture)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    Symbol &Result = *rop.opargsym (op, 0);
+    Symbol &Filename = *rop.opargsym (op, 1);
+    Symbol &S = *rop.opargsym (op, 2);
+    Symbol &T = *rop.opargsym (op, 3);
+    int nchans = Result.typespec().aggregate();
+
+    bool user_derivs = false;
+    int first_optional_arg = 4;
+    if (op.nargs() > 4 && rop.opargsym(op,4)->typespec().is_float()) {
+        user_derivs = true;
+        first_optional_arg = 8;
+        OSL_DASSERT(rop.opargsym(op,5)->typespec().is_float());
+        OSL_DASSERT(rop.opargsym(op,6)->typespec().is_float());
+        OSL_DASSERT(rop.opargsym(op,7)->typespec().is_float());
+    }
+
+    llvm::Value *alpha = NULL, *errormessage = NULL;
+    bool alpha_derivs = false;
+    if (! llvm_batched_texture_options (rop, opnum, first_optional_arg,
+                                        false /*3d*/, nchans,
+                                        alpha, alpha_derivs, errormessage))
+        return false;
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    llvm::Value *coords[] = {
+        llvm_wide_arg_ptr (rop, S),
+        llvm_wide_arg_ptr (rop, T),
+        user_derivs ? llvm_wide_arg_ptr (rop, *rop.opargsym (op, 4)) : llvm_wide_arg_ptr (rop, S, 1),
+        user_derivs ? llvm_wide_arg_ptr (rop, *rop.opargsym (op, 5)) : llvm_wide_arg_ptr (rop, T, 1),
+        user_derivs ? llvm_wide_arg_ptr (rop, *rop.opargsym (op, 6)) : llvm_wide_arg_ptr (rop, S, 2),
+        user_derivs ? llvm_wide_arg_ptr (rop, *rop.opargsym (op, 7)) : llvm_wide_arg_ptr (rop, T, 2),
+    };
+    llvm_batched_texture_lookup (rop, "texture", Filename, coords, nchans,
+                                 Result, alpha, alpha_derivs, errormessage);
+    return true;
+}
+
+
+
+// texture3d and environment take the same arguments, a triple and its
+// derivs instead of s and t
+static bool
+llvm_gen_texture_triple (BatchedBackendLLVM &rop, int opnum, bool tex3d)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+    Symbol &Result = *rop.opargsym (op, 0);
+    Symbol &Filename = *rop.opargsym (op, 1);
+    Symbol &P = *rop.opargsym (op, 2);
+    int nchans = Result.typespec().aggregate();
+
+    bool user_derivs = false;
+    int first_optional_arg = 3;
+    if (op.nargs() > 3 && rop.opargsym(op,3)->typespec().is_triple()) {
+        user_derivs = true;
+        first_optional_arg = 5;
+        OSL_DASSERT(rop.opargsym(op,4)->typespec().is_triple());
+    }
+
+    llvm::Value *alpha = NULL, *errormessage = NULL;
+    bool alpha_derivs = false;
+    if (! llvm_batched_texture_options (rop, opnum, first_optional_arg,
+                                        tex3d, nchans,
+                                        alpha, alpha_derivs, errormessage))
+        return false;
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    llvm::Value *coords[] = {
+        llvm_wide_arg_ptr (rop, P),
+        user_derivs ? llvm_wide_arg_ptr (rop, *rop.opargsym (op, 3)) : llvm_wide_arg_ptr (rop, P, 1),
+        user_derivs ? llvm_wide_arg_ptr (rop, *rop.opargsym (op, 4)) : llvm_wide_arg_ptr (rop, P, 2),
+    };
+    llvm_batched_texture_lookup (rop, tex3d ? "texture3d" : "environment",
+                                 Filename, coords, nchans,
+                                 Result, alpha, alpha_derivs, errormessage);
+    return true;
+}
+
+
+
+LLVMGEN (llvm_gen_texture3d)
+{
+    return llvm_gen_texture_triple (rop, opnum, true /*3d*/);
+}
+
+
+
+LLVMGEN (llvm_gen_environment)
+{
+    return llvm_gen_texture_triple (rop, opnum, false /*3d*/);
+}
+
+
+
+LLVMGEN (llvm_gen_gettextureinfo)
+{
+    Opcode &op (rop.inst()->ops()[opnum]);
+
+    OSL_DASSERT(op.nargs() == 4);
+
+    Symbol& Result   = *rop.opargsym (op, 0);
+    Symbol& Filename = *rop.opargsym (op, 1);
+    Symbol& Dataname = *rop.opargsym (op, 2);
+    Symbol& Data     = *rop.opargsym (op, 3);
+
+    OSL_DASSERT(!Result.typespec().is_closure_based() &&
+             Filename.typespec().is_string() &&
+             Dataname.typespec().is_string() &&
+             !Data.typespec().is_closure_based() &&
+             Result.typespec().is_int());
+
+    if (! Dataname.is_uniform()) {
+        rop.shadingcontext()->errorf("gettextureinfo data name must be uniform for the batched backend (%s:%d)",
+                                     op.sourcefile(), op.sourceline());
+        return false;
+    }
+
+    BatchedBackendLLVM::TempScope temp_scope(rop);
+
+    // The shadeops are passed a pointer to the TypeDesc of Data
+    llvm::Value *typedesc = rop.ll.op_alloca (rop.ll.type_typedesc(), 1, "typedesc");
+    rop.ll.op_store (rop.ll.constant (Data.typespec().simpletype()), typedesc);
+
+    if (Filename.is_uniform() && Data.is_uniform()) {
+        RendererServices::TextureHandle *texture_handle = NULL;
+        if (Filename.is_constant() && rop.shadingsys().opt_texture_handle()) {
+            texture_handle = rop.renderer()->get_texture_handle(Filename.get_string(), rop.shadingcontext());
+        }
+
+        llvm::Value * args[] = {
+            rop.sg_void_ptr(),
+            rop.ll.void_ptr (rop.llvm_load_value (Filename)),
+            rop.ll.constant_ptr (texture_handle),
+            rop.ll.void_ptr (rop.llvm_load_value (Dataname)),
+            rop.ll.void_ptr (typedesc),
+            // destination
+            rop.llvm_void_ptr (Data),
+        };
+        FuncSpec func_spec("get_textureinfo_uniform");
+        llvm::Value *r = rop.ll.call_function (rop.build_name(func_spec), args);
+        rop.llvm_conversion_store_uniform_status (r, Result);
+        rop.generated_texture_call (texture_handle != NULL);
+    } else {
+        // Data is written from Filename, so it is varying whenever that is
+        OSL_ASSERT (Data.is_varying());
+        llvm::Value * args[] = {
+            rop.sg_void_ptr(),
+            llvm_wide_arg_ptr (rop, Filename),
+            rop.ll.void_ptr (rop.llvm_load_value (Dataname)),
+            rop.ll.void_ptr (typedesc),
+            // destination
+            rop.llvm_void_ptr (Data),
+            rop.ll.mask_as_int (rop.ll.current_mask()),
+        };
+        FuncSpec func_spec("get_textureinfo");
+        func_spec.mask();
+        llvm::Value *r = rop.ll.call_function (rop.build_name(func_spec), args);
+        if (Result.is_varying()) {
+            rop.llvm_conversion_store_masked_status (r, Result);
+        } else {
+            // A uniform filename can only be found for all lanes or none
+            rop.llvm_conversion_store_uniform_status (
+                rop.ll.op_bool_to_int (rop.ll.op_ne (r, rop.ll.constant(0))),
+                Result);
+        }
+        rop.generated_texture_call (false);
+    }
+    /* Do not leave derivs uninitialized */
+    if (Data.has_derivs())
+        rop.llvm_zero_derivs (Data);
+
     return true;
 }
 
@@ -1320,14 +2610,11 @@ TBD_LLVMGEN(llvm_gen_filterwidth)
 TBD_LLVMGEN(llvm_gen_arraylength)
 TBD_LLVMGEN(llvm_gen_arraycopy)
 TBD_LLVMGEN(llvm_gen_neg)
-TBD_LLVMGEN(llvm_gen_texture)
 TBD_LLVMGEN(llvm_gen_printf)
 TBD_LLVMGEN(llvm_gen_area)
 TBD_LLVMGEN(llvm_gen_getmessage)
 TBD_LLVMGEN(llvm_gen_bitwise_binary_op)
 TBD_LLVMGEN(llvm_gen_if)
-TBD_LLVMGEN(llvm_gen_noise)
-TBD_LLVMGEN(llvm_gen_transformc)
 TBD_LLVMGEN(llvm_gen_pointcloud_search)
 TBD_LLVMGEN(llvm_gen_mxcompref)
 TBD_LLVMGEN(llvm_gen_dict_find)
@@ -1341,29 +2628,19 @@ TBD_LLVMGEN(llvm_gen_raytype)
 TBD_LLVMGEN(llvm_gen_trace)
 TBD_LLVMGEN(llvm_gen_pointcloud_get)
 TBD_LLVMGEN(llvm_gen_return)
-TBD_LLVMGEN(llvm_gen_regex)
 TBD_LLVMGEN(llvm_gen_pointcloud_write)
 TBD_LLVMGEN(llvm_gen_isconstant)
 TBD_LLVMGEN(llvm_gen_loop_op)
-TBD_LLVMGEN(llvm_gen_matrix)
 TBD_LLVMGEN(llvm_gen_select)
-TBD_LLVMGEN(llvm_gen_split)
 TBD_LLVMGEN(llvm_gen_unary_op)
 TBD_LLVMGEN(llvm_gen_aref)
 TBD_LLVMGEN(llvm_gen_luminance)
 TBD_LLVMGEN(llvm_gen_dict_value)
 TBD_LLVMGEN(llvm_gen_loopmod_op)
-TBD_LLVMGEN(llvm_gen_transform)
 TBD_LLVMGEN(llvm_gen_closure)
-TBD_LLVMGEN(llvm_gen_gettextureinfo)
-TBD_LLVMGEN(llvm_gen_blackbody)
-TBD_LLVMGEN(llvm_gen_spline)
 TBD_LLVMGEN(llvm_gen_dict_next)
-TBD_LLVMGEN(llvm_gen_texture3d)
 TBD_LLVMGEN(llvm_gen_nop)
 TBD_LLVMGEN(llvm_gen_minmax)
-TBD_LLVMGEN(llvm_gen_getmatrix)
-TBD_LLVMGEN(llvm_gen_environment)
 TBD_LLVMGEN(llvm_gen_mix)
 TBD_LLVMGEN(llvm_gen_setmessage)
 
@@ -801,6 +801,11 @@ BatchedBackendLLVM::llvm_type_groupdata()
     fields.push_back(ll.type_array(ll.type_int(), sz));
     offset += sz * sizeof(int);
     ++order;
+    // The flags are the leading bytes that group init clears, so that
+    // clear_heap can skip them. It only clears layer_run if more than one
+    // layer is used, and then the userdata flags follow.
+    group().llvm_groupdata_wide_flags_size(m_num_used_layers > 1 ? offset
+                                                                 : 0);
 
     // Now add the array that tells which userdata have been initialized,
     // and the space for the userdata values.
@@ -817,6 +822,8 @@ BatchedBackendLLVM::llvm_type_groupdata()
         fields.push_back(ll.type_array(ll.type_int(), sz));
         offset += nuserdata * sizeof(int);
         ++order;
+        if (m_num_used_layers > 1)
+            group().llvm_groupdata_wide_flags_size(offset);
         for (int i = 0; i < nuserdata; ++i) {
             TypeDesc type = types[i];
             // TODO: why do we always make deriv room? Do we not know
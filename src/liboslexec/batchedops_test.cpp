@@ -0,0 +1,868 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Run small shaders through the batched backend, and check that every
+// lane of a batch gets the same outputs as shading that point on its own
+// with the scalar backend.  Each shader exercises the code generation and
+// the wide shadeops of one family of ops.
+
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imagebuf.h>
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/batched_rendererservices.h>
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+
+using namespace OSL;
+
+
+static constexpr int W = 8;    // Width of the batches we run
+static std::string libdir = OSL_TARGET_LIB_DIR;
+static float tolerance = 1.0e-5f;
+static bool verbose = false;
+
+
+// shader noise_ops (output float f_perlin = 0, output color c_uperlin = 0,
+//                   output float f_cell = 0, output float f_hash = 0,
+//                   output vector v_simplex = 0, output float f_pnoise = 0)
+// {
+//     point Q = P * 3.7;
+//     f_perlin = noise ("perlin", Q);
+//     c_uperlin = noise (Q, u);
+//     f_cell = cellnoise (Q);
+//     f_hash = hashnoise (Q);
+//     v_simplex = noise ("simplex", u * 5, v * 5);
+//     f_pnoise = pnoise (Q, point (2));
+// }
+static const char *noise_ops_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader noise_ops\n"
+    "oparam\tfloat\tf_perlin\t0\t\t%read{2147483647,-1} %write{1,1}\n"
+    "oparam\tcolor\tc_uperlin\t0 0 0\t\t%read{2147483647,-1} %write{2,2}\n"
+    "oparam\tfloat\tf_cell\t0\t\t%read{2147483647,-1} %write{3,3}\n"
+    "oparam\tfloat\tf_hash\t0\t\t%read{2147483647,-1} %write{4,4}\n"
+    "oparam\tvector\tv_simplex\t0 0 0\t\t%read{2147483647,-1} %write{7,7}\n"
+    "oparam\tfloat\tf_pnoise\t0\t\t%read{2147483647,-1} %write{8,8}\n"
+    "global\tpoint\tP\t%read{0,0} %write{2147483647,-1}\n"
+    "global\tfloat\tu\t%read{2,5} %write{2147483647,-1}\n"
+    "global\tfloat\tv\t%read{6,6} %write{2147483647,-1}\n"
+    "local\tpoint\tQ\t%read{1,8} %write{0,0}\n"
+    "const\tfloat\t$const1\t3.70000005\t\t%read{0,0} %write{2147483647,-1}\n"
+    "const\tstring\t$const2\t\"perlin\"\t\t%read{1,1} %write{2147483647,-1}\n"
+    "const\tfloat\t$const3\t5\t\t%read{5,6} %write{2147483647,-1}\n"
+    "temp\tfloat\t$tmp1\t%read{7,7} %write{5,5}\n"
+    "temp\tfloat\t$tmp2\t%read{7,7} %write{6,6}\n"
+    "const\tstring\t$const4\t\"simplex\"\t\t%read{7,7} %write{2147483647,-1}\n"
+    "const\tpoint\t$const5\t2 2 2\t\t%read{8,8} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\tmul\t\tQ P $const1 \t%argrw{\"wrr\"}\n"
+    "\tnoise\t\tf_perlin $const2 Q \t%argrw{\"wrr\"}\n"
+    "\tnoise\t\tc_uperlin Q u \t%argrw{\"wrr\"}\n"
+    "\tcellnoise\t\tf_cell Q \t%argrw{\"wr\"}\n"
+    "\thashnoise\t\tf_hash Q \t%argrw{\"wr\"}\n"
+    "\tmul\t\t$tmp1 u $const3 \t%argrw{\"wrr\"}\n"
+    "\tmul\t\t$tmp2 v $const3 \t%argrw{\"wrr\"}\n"
+    "\tnoise\t\tv_simplex $const4 $tmp1 $tmp2 \t%argrw{\"wrrr\"}\n"
+    "\tpnoise\t\tf_pnoise Q $const5 \t%argrw{\"wrr\"}\n"
+    "\tend\n";
+
+
+
+// The texture file is written by the test, and the shader text gets its
+// name substituted for TEXFILE.
+//
+// shader texture_ops (output color c_tex = 0, output float f_alpha = 0,
+//                     output float f_blur = 0, output color c_env = 0,
+//                     output int i_found = 0, output int i_res[2] = { 0, 0 },
+//                     output float f_chans = 0)
+// {
+//     c_tex = texture ("TEXFILE", u, v, "alpha", f_alpha);
+//     f_blur = texture ("TEXFILE", u * 3, v, "blur", 0.05, "swidth", v * 4,
+//                       "wrap", "periodic", "firstchannel", 1);
+//     c_env = environment ("TEXFILE", N + P);
+//     i_found = gettextureinfo ("TEXFILE", "resolution", i_res);
+//     int chans = 0;
+//     gettextureinfo ("TEXFILE", "channels", chans);
+//     f_chans = chans;
+// }
+static const char *texture_ops_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader texture_ops\n"
+    "oparam\tcolor\tc_tex\t0 0 0\t\t%read{2147483647,-1} %write{0,0}\n"
+    "oparam\tfloat\tf_alpha\t0\t\t%read{2147483647,-1} %write{0,0}\n"
+    "oparam\tfloat\tf_blur\t0\t\t%read{2147483647,-1} %write{3,3}\n"
+    "oparam\tcolor\tc_env\t0 0 0\t\t%read{2147483647,-1} %write{5,5}\n"
+    "oparam\tint\ti_found\t0\t\t%read{2147483647,-1} %write{6,6}\n"
+    "oparam\tint[2]\ti_res\t0 0\t\t%read{2147483647,-1} %write{6,6}\n"
+    "oparam\tfloat\tf_chans\t0\t\t%read{2147483647,-1} %write{9,9}\n"
+    "global\tpoint\tP\t%read{4,4} %write{2147483647,-1}\n"
+    "global\tnormal\tN\t%read{4,4} %write{2147483647,-1}\n"
+    "global\tfloat\tu\t%read{0,1} %write{2147483647,-1}\n"
+    "global\tfloat\tv\t%read{0,3} %write{2147483647,-1}\n"
+    "local\tint\tchans\t%read{9,9} %write{7,8}\n"
+    "const\tstring\t$const1\t\"TEXFILE\"\t\t%read{0,8} %write{2147483647,-1}\n"
+    "const\tstring\t$const2\t\"alpha\"\t\t%read{0,0} %write{2147483647,-1}\n"
+    "temp\tfloat\t$tmp1\t%read{3,3} %write{1,1}\n"
+    "const\tfloat\t$const3\t3\t\t%read{1,1} %write{2147483647,-1}\n"
+    "temp\tfloat\t$tmp2\t%read{3,3} %write{2,2}\n"
+    "const\tfloat\t$const4\t4\t\t%read{2,2} %write{2147483647,-1}\n"
+    "const\tstring\t$const5\t\"blur\"\t\t%read{3,3} %write{2147483647,-1}\n"
+    "const\tfloat\t$const6\t0.0500000007\t\t%read{3,3} %write{2147483647,-1}\n"
+    "const\tstring\t$const7\t\"swidth\"\t\t%read{3,3} %write{2147483647,-1}\n"
+    "const\tstring\t$const8\t\"wrap\"\t\t%read{3,3} %write{2147483647,-1}\n"
+    "const\tstring\t$const9\t\"periodic\"\t\t%read{3,3} %write{2147483647,-1}\n"
+    "const\tstring\t$const10\t\"firstchannel\"\t\t%read{3,3} %write{2147483647,-1}\n"
+    "const\tint\t$const11\t1\t\t%read{3,3} %write{2147483647,-1}\n"
+    "temp\tvector\t$tmp3\t%read{5,5} %write{4,4}\n"
+    "const\tstring\t$const12\t\"resolution\"\t\t%read{6,6} %write{2147483647,-1}\n"
+    "const\tint\t$const13\t0\t\t%read{7,7} %write{2147483647,-1}\n"
+    "const\tstring\t$const14\t\"channels\"\t\t%read{8,8} %write{2147483647,-1}\n"
+    "temp\tint\t$tmp4\t%read{2147483647,-1} %write{8,8}\n"
+    "code ___main___\n"
+    "\ttexture\t\tc_tex $const1 u v $const2 f_alpha \t%argrw{\"wrrrrw\"} %argderivs{2,3}\n"
+    "\tmul\t\t$tmp1 u $const3 \t%argrw{\"wrr\"}\n"
+    "\tmul\t\t$tmp2 v $const4 \t%argrw{\"wrr\"}\n"
+    "\ttexture\t\tf_blur $const1 $tmp1 v $const5 $const6 $const7 $tmp2 $const8 $const9 $const10 $const11 \t%argrw{\"wrrrrrrrrrrr\"} %argderivs{2,3}\n"
+    "\tadd\t\t$tmp3 N P \t%argrw{\"wrr\"}\n"
+    "\tenvironment\t\tc_env $const1 $tmp3 \t%argrw{\"wrr\"} %argderivs{2}\n"
+    "\tgettextureinfo\t\ti_found $const1 $const12 i_res \t%argrw{\"wrrw\"}\n"
+    "\tassign\t\tchans $const13 \t%argrw{\"wr\"}\n"
+    "\tgettextureinfo\t\t$tmp4 $const1 $const14 chans \t%argrw{\"wrrw\"}\n"
+    "\tassign\t\tf_chans chans \t%argrw{\"wr\"}\n"
+    "\tend\n";
+
+
+
+// The file name varies per lane, so the batched lookup runs once for each
+// distinct name among the active lanes: TEXFILE and OTHERFILE are written
+// by the test (OTHERFILE at half the brightness), the last one is missing.
+//
+// shader texture_varying (output color c_tex = 0, output int i_err = 0)
+// {
+//     string file = "TEXFILE";
+//     if (u > 0.5)
+//         file = "OTHERFILE";
+//     if (u > 0.8)
+//         file = "batchedops_missing.tif";
+//     string err = "";
+//     c_tex = texture (file, u, v, "errormessage", err);
+//     i_err = (err != "");
+// }
+static const char *texture_varying_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader texture_varying\n"
+    "oparam\tcolor\tc_tex\t0 0 0\t\t%read{2147483647,-1} %write{8,8}\n"
+    "oparam\tint\ti_err\t0\t\t%read{2147483647,-1} %write{9,9}\n"
+    "global\tfloat\tu\t%read{1,8} %write{2147483647,-1}\n"
+    "global\tfloat\tv\t%read{8,8} %write{2147483647,-1}\n"
+    "local\tstring\tfile\t%read{8,8} %write{0,6}\n"
+    "local\tstring\terr\t%read{9,9} %write{7,8}\n"
+    "const\tstring\t$const1\t\"TEXFILE\"\t\t%read{0,0} %write{2147483647,-1}\n"
+    "temp\tint\t$tmp1\t%read{2,2} %write{1,1}\n"
+    "const\tfloat\t$const2\t0.5\t\t%read{1,1} %write{2147483647,-1}\n"
+    "const\tstring\t$const3\t\"OTHERFILE\"\t\t%read{3,3} %write{2147483647,-1}\n"
+    "temp\tint\t$tmp2\t%read{5,5} %write{4,4}\n"
+    "const\tfloat\t$const4\t0.800000012\t\t%read{4,4} %write{2147483647,-1}\n"
+    "const\tstring\t$const5\t\"batchedops_missing.tif\"\t\t%read{6,6} %write{2147483647,-1}\n"
+    "const\tstring\t$const6\t\"\"\t\t%read{7,9} %write{2147483647,-1}\n"
+    "const\tstring\t$const7\t\"errormessage\"\t\t%read{8,8} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\tassign\t\tfile $const1 \t%argrw{\"wr\"}\n"
+    "\tgt\t\t$tmp1 u $const2 \t%argrw{\"wrr\"}\n"
+    "\tif\t\t$tmp1 4 4 \t%argrw{\"r\"}\n"
+    "\tassign\t\tfile $const3 \t%argrw{\"wr\"}\n"
+    "\tgt\t\t$tmp2 u $const4 \t%argrw{\"wrr\"}\n"
+    "\tif\t\t$tmp2 7 7 \t%argrw{\"r\"}\n"
+    "\tassign\t\tfile $const5 \t%argrw{\"wr\"}\n"
+    "\tassign\t\terr $const6 \t%argrw{\"wr\"}\n"
+    "\ttexture\t\tc_tex file u v $const7 err \t%argrw{\"wrrrrw\"} %argderivs{2,3}\n"
+    "\tneq\t\ti_err err $const6 \t%argrw{\"wrr\"}\n"
+    "\tend\n";
+
+
+// shader matrix_ops (output point p_shader = 0, output vector v_obj = 0,
+//                    output normal n_my = 0, output point p_obj = 0,
+//                    output matrix m_from = 0, output matrix m_two = 0,
+//                    output int i_found = 0, output matrix m_get = 0,
+//                    output point p_mat = 0, output point p_uni = 0,
+//                    output color c_hsv = 0, output color c_uhsv = 0,
+//                    output color c_bb = 0, output color c_wl = 0)
+// {
+//     p_shader = transform ("shader", P);
+//     v_obj = transform ("object", "myspace", I);
+//     n_my = transform ("myspace", N);
+//     p_obj = point ("object", u, v, 1);
+//     m_from = matrix ("object", u);
+//     m_two = matrix ("shader", "myspace");
+//     i_found = getmatrix ("myspace", "object", m_get);
+//     p_mat = transform (m_from, P);
+//     matrix m_uni = matrix (2);
+//     point q = transform (m_uni, point (1, 2, 3));
+//     p_uni = q;
+//     c_hsv = transformc ("hsv", "rgb", color (u, v, 0.5));
+//     color cu = transformc ("hsv", "rgb", color (0.2, 0.5, 0.8));
+//     c_uhsv = cu;
+//     c_bb = blackbody (1000 + 5000 * u);
+//     color wl = wavelength_color (550);
+//     c_wl = wl;
+// }
+static const char *matrix_ops_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader matrix_ops\n"
+    "oparam\tpoint\tp_shader\t0 0 0\t\t%read{2147483647,-1} %write{0,0}\n"
+    "oparam\tvector\tv_obj\t0 0 0\t\t%read{2147483647,-1} %write{1,1}\n"
+    "oparam\tnormal\tn_my\t0 0 0\t\t%read{2147483647,-1} %write{2,2}\n"
+    "oparam\tpoint\tp_obj\t0 0 0\t\t%read{2147483647,-1} %write{3,3}\n"
+    "oparam\tmatrix\tm_from\t0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\t\t%read{7,7} %write{4,4}\n"
+    "oparam\tmatrix\tm_two\t0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\t\t%read{2147483647,-1} %write{5,5}\n"
+    "oparam\tint\ti_found\t0\t\t%read{2147483647,-1} %write{6,6}\n"
+    "oparam\tmatrix\tm_get\t0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\t\t%read{2147483647,-1} %write{6,6}\n"
+    "oparam\tpoint\tp_mat\t0 0 0\t\t%read{2147483647,-1} %write{7,7}\n"
+    "oparam\tpoint\tp_uni\t0 0 0\t\t%read{2147483647,-1} %write{10,10}\n"
+    "oparam\tcolor\tc_hsv\t0 0 0\t\t%read{2147483647,-1} %write{12,12}\n"
+    "oparam\tcolor\tc_uhsv\t0 0 0\t\t%read{2147483647,-1} %write{14,14}\n"
+    "oparam\tcolor\tc_bb\t0 0 0\t\t%read{2147483647,-1} %write{17,17}\n"
+    "oparam\tcolor\tc_wl\t0 0 0\t\t%read{2147483647,-1} %write{19,19}\n"
+    "global\tpoint\tP\t%read{0,7} %write{2147483647,-1}\n"
+    "global\tvector\tI\t%read{1,1} %write{2147483647,-1}\n"
+    "global\tnormal\tN\t%read{2,2} %write{2147483647,-1}\n"
+    "global\tfloat\tu\t%read{3,15} %write{2147483647,-1}\n"
+    "global\tfloat\tv\t%read{3,11} %write{2147483647,-1}\n"
+    "local\tmatrix\tm_uni\t%read{9,9} %write{8,8}\n"
+    "local\tpoint\tq\t%read{10,10} %write{9,9}\n"
+    "local\tcolor\tcu\t%read{14,14} %write{13,13}\n"
+    "local\tcolor\twl\t%read{19,19} %write{18,18}\n"
+    "const\tstring\t$const1\t\"shader\"\t\t%read{0,5} %write{2147483647,-1}\n"
+    "const\tstring\t$const2\t\"object\"\t\t%read{1,6} %write{2147483647,-1}\n"
+    "const\tstring\t$const3\t\"myspace\"\t\t%read{1,6} %write{2147483647,-1}\n"
+    "const\tfloat\t$const4\t1\t\t%read{3,3} %write{2147483647,-1}\n"
+    "const\tfloat\t$const5\t2\t\t%read{8,8} %write{2147483647,-1}\n"
+    "const\tpoint\t$const6\t1 2 3\t\t%read{9,9} %write{2147483647,-1}\n"
+    "temp\tcolor\t$tmp1\t%read{12,12} %write{11,11}\n"
+    "const\tfloat\t$const7\t0.5\t\t%read{11,11} %write{2147483647,-1}\n"
+    "const\tstring\t$const8\t\"hsv\"\t\t%read{12,13} %write{2147483647,-1}\n"
+    "const\tstring\t$const9\t\"rgb\"\t\t%read{12,13} %write{2147483647,-1}\n"
+    "const\tcolor\t$const10\t0.200000003 0.5 0.800000012\t\t%read{13,13} %write{2147483647,-1}\n"
+    "const\tfloat\t$const11\t5000\t\t%read{15,15} %write{2147483647,-1}\n"
+    "temp\tfloat\t$tmp2\t%read{16,16} %write{15,15}\n"
+    "const\tfloat\t$const12\t1000\t\t%read{16,16} %write{2147483647,-1}\n"
+    "temp\tfloat\t$tmp3\t%read{17,17} %write{16,16}\n"
+    "const\tfloat\t$const13\t550\t\t%read{18,18} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\ttransform\t\tp_shader $const1 P \t%argrw{\"wrr\"}\n"
+    "\ttransformv\t\tv_obj $const2 $const3 I \t%argrw{\"wrrr\"}\n"
+    "\ttransformn\t\tn_my $const3 N \t%argrw{\"wrr\"}\n"
+    "\tpoint\t\tp_obj $const2 u v $const4 \t%argrw{\"wrrrr\"}\n"
+    "\tmatrix\t\tm_from $const2 u \t%argrw{\"wrr\"}\n"
+    "\tmatrix\t\tm_two $const1 $const3 \t%argrw{\"wrr\"}\n"
+    "\tgetmatrix\t\ti_found $const3 $const2 m_get \t%argrw{\"wrrw\"}\n"
+    "\ttransform\t\tp_mat m_from P \t%argrw{\"wrr\"}\n"
+    "\tmatrix\t\tm_uni $const5 \t%argrw{\"wr\"}\n"
+    "\ttransform\t\tq m_uni $const6 \t%argrw{\"wrr\"}\n"
+    "\tassign\t\tp_uni q \t%argrw{\"wr\"}\n"
+    "\tcolor\t\t$tmp1 u v $const7 \t%argrw{\"wrrr\"}\n"
+    "\ttransformc\t\tc_hsv $const8 $const9 $tmp1 \t%argrw{\"wrrr\"}\n"
+    "\ttransformc\t\tcu $const8 $const9 $const10 \t%argrw{\"wrrr\"}\n"
+    "\tassign\t\tc_uhsv cu \t%argrw{\"wr\"}\n"
+    "\tmul\t\t$tmp2 $const11 u \t%argrw{\"wrr\"}\n"
+    "\tadd\t\t$tmp3 $const12 $tmp2 \t%argrw{\"wrr\"}\n"
+    "\tblackbody\t\tc_bb $tmp3 \t%argrw{\"wr\"}\n"
+    "\twavelength_color\t\twl $const13 \t%argrw{\"wr\"}\n"
+    "\tassign\t\tc_wl wl \t%argrw{\"wr\"}\n"
+    "\tend\n";
+
+
+
+// shader spline_ops (float knots[6] = { 0, 0.2, 0.3, 0.7, 1, 1 },
+//                    color cknots[4] = { 0, color(0,0,1), color(0.5,0,0.5),
+//                                        color(1,0.25,1) },
+//                    output float f_spline = 0, output float f_dx = 0,
+//                    output color c_spline = 0, output float f_inv = 0,
+//                    output float f_count = 0, output float f_uni = 0)
+// {
+//     float s = spline ("catmull-rom", u, knots);
+//     f_spline = s;
+//     f_dx = Dx (s);
+//     c_spline = spline ("linear", v, cknots);
+//     f_inv = splineinverse ("linear", u, knots);
+//     f_count = spline ("bspline", v, 5, knots);
+//     float w = spline ("catmull-rom", 0.3, knots);
+//     f_uni = w;
+// }
+static const char *spline_ops_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader spline_ops\n"
+    "param\tfloat[6]\tknots\t0 0.2 0.3 0.7 1 1\t\t%read{0,6} %write{2147483647,-1}\n"
+    "param\tcolor[4]\tcknots\t0 0 0 0 0 1 0.5 0 0.5 1 0.25 1\t\t%read{3,3} %write{2147483647,-1}\n"
+    "oparam\tfloat\tf_spline\t0\t\t%read{2147483647,-1} %write{1,1}\n"
+    "oparam\tfloat\tf_dx\t0\t\t%read{2147483647,-1} %write{2,2}\n"
+    "oparam\tcolor\tc_spline\t0 0 0\t\t%read{2147483647,-1} %write{3,3}\n"
+    "oparam\tfloat\tf_inv\t0\t\t%read{2147483647,-1} %write{4,4}\n"
+    "oparam\tfloat\tf_count\t0\t\t%read{2147483647,-1} %write{5,5}\n"
+    "oparam\tfloat\tf_uni\t0\t\t%read{2147483647,-1} %write{7,7}\n"
+    "global\tfloat\tu\t%read{0,4} %write{2147483647,-1}\n"
+    "global\tfloat\tv\t%read{3,5} %write{2147483647,-1}\n"
+    "local\tfloat\ts\t%read{1,2} %write{0,0}\n"
+    "local\tfloat\tw\t%read{7,7} %write{6,6}\n"
+    "const\tstring\t$const1\t\"catmull-rom\"\t\t%read{0,6} %write{2147483647,-1}\n"
+    "const\tstring\t$const2\t\"linear\"\t\t%read{3,4} %write{2147483647,-1}\n"
+    "const\tstring\t$const3\t\"bspline\"\t\t%read{5,5} %write{2147483647,-1}\n"
+    "const\tint\t$const4\t5\t\t%read{5,5} %write{2147483647,-1}\n"
+    "const\tfloat\t$const5\t0.300000012\t\t%read{6,6} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\tspline\t\ts $const1 u knots \t%argrw{\"wrrr\"}\n"
+    "\tassign\t\tf_spline s \t%argrw{\"wr\"}\n"
+    "\tDx\t\tf_dx s \t%argrw{\"wr\"} %argderivs{1}\n"
+    "\tspline\t\tc_spline $const2 v cknots \t%argrw{\"wrrr\"}\n"
+    "\tsplineinverse\t\tf_inv $const2 u knots \t%argrw{\"wrrr\"}\n"
+    "\tspline\t\tf_count $const3 v $const4 knots \t%argrw{\"wrrrr\"}\n"
+    "\tspline\t\tw $const1 $const5 knots \t%argrw{\"wrrr\"}\n"
+    "\tassign\t\tf_uni w \t%argrw{\"wr\"}\n"
+    "\tend\n";
+
+
+
+// shader string_ops (output string s_sub = "", output string s_cat = "",
+//                    output int i_len = 0, output int i_hash = 0,
+//                    output int i_char = 0, output int i_starts = 0,
+//                    output int i_ends = 0, output int i_stoi = 0,
+//                    output float f_stof = 0, output int i_split = 0,
+//                    output string s_parts[3] = { "", "", "" },
+//                    output int i_search = 0, output int i_match = 0,
+//                    output int i_groups[6] = { 0, 0, 0, 0, 0, 0 },
+//                    output int i_usplit = 0, output int i_uregex = 0,
+//                    output string s_ucat = "")
+// {
+//     int start = int (u * 5);
+//     string sub = substr ("a,bc,def,gh", start, 6);
+//     s_sub = sub;
+//     s_cat = concat (sub, "!");
+//     i_len = strlen (s_cat);
+//     i_hash = hash (sub);
+//     i_char = getchar (sub, 1);
+//     i_starts = startswith (sub, "a");
+//     i_ends = endswith (sub, "f");
+//     string digits = substr ("3.14159", start, 3);
+//     i_stoi = stoi (digits);
+//     f_stof = stof (digits);
+//     i_split = split (sub, s_parts, ",");
+//     i_search = regex_search (sub, "[a-c]+");
+//     i_match = regex_match (sub, i_groups, "([a-z]+),([a-z]*).*");
+//     string uparts[3];
+//     int nu = split ("x y z", uparts, " ");
+//     i_usplit = nu;
+//     int ru = regex_search ("abc", "b");
+//     i_uregex = ru;
+//     string cu = concat ("x", "y");
+//     s_ucat = cu;
+// }
+static const char *string_ops_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader string_ops\n"
+    "oparam\tstring\ts_sub\t\"\"\t\t%read{2147483647,-1} %write{3,3}\n"
+    "oparam\tstring\ts_cat\t\"\"\t\t%read{5,5} %write{4,4}\n"
+    "oparam\tint\ti_len\t0\t\t%read{2147483647,-1} %write{5,5}\n"
+    "oparam\tint\ti_hash\t0\t\t%read{2147483647,-1} %write{6,6}\n"
+    "oparam\tint\ti_char\t0\t\t%read{2147483647,-1} %write{7,7}\n"
+    "oparam\tint\ti_starts\t0\t\t%read{2147483647,-1} %write{8,8}\n"
+    "oparam\tint\ti_ends\t0\t\t%read{2147483647,-1} %write{9,9}\n"
+    "oparam\tint\ti_stoi\t0\t\t%read{2147483647,-1} %write{11,11}\n"
+    "oparam\tfloat\tf_stof\t0\t\t%read{2147483647,-1} %write{12,12}\n"
+    "oparam\tint\ti_split\t0\t\t%read{2147483647,-1} %write{13,13}\n"
+    "oparam\tstring[3]\ts_parts\t\"\" \"\" \"\"\t\t%read{2147483647,-1} %write{13,13}\n"
+    "oparam\tint\ti_search\t0\t\t%read{2147483647,-1} %write{14,14}\n"
+    "oparam\tint\ti_match\t0\t\t%read{2147483647,-1} %write{15,15}\n"
+    "oparam\tint[6]\ti_groups\t0 0 0 0 0 0\t\t%read{2147483647,-1} %write{15,15}\n"
+    "oparam\tint\ti_usplit\t0\t\t%read{2147483647,-1} %write{17,17}\n"
+    "oparam\tint\ti_uregex\t0\t\t%read{2147483647,-1} %write{19,19}\n"
+    "oparam\tstring\ts_ucat\t\"\"\t\t%read{2147483647,-1} %write{21,21}\n"
+    "global\tfloat\tu\t%read{0,0} %write{2147483647,-1}\n"
+    "local\tint\tstart\t%read{2,10} %write{1,1}\n"
+    "local\tstring\tsub\t%read{3,15} %write{2,2}\n"
+    "local\tstring\tdigits\t%read{11,12} %write{10,10}\n"
+    "local\tstring[3]\tuparts\t%read{2147483647,-1} %write{16,16}\n"
+    "local\tint\tnu\t%read{17,17} %write{16,16}\n"
+    "local\tint\tru\t%read{19,19} %write{18,18}\n"
+    "local\tstring\tcu\t%read{21,21} %write{20,20}\n"
+    "temp\tfloat\t$tmp1\t%read{1,1} %write{0,0}\n"
+    "const\tfloat\t$const1\t5\t\t%read{0,0} %write{2147483647,-1}\n"
+    "const\tstring\t$const2\t\"a,bc,def,gh\"\t\t%read{2,2} %write{2147483647,-1}\n"
+    "const\tint\t$const3\t6\t\t%read{2,2} %write{2147483647,-1}\n"
+    "const\tstring\t$const4\t\"!\"\t\t%read{4,4} %write{2147483647,-1}\n"
+    "const\tint\t$const5\t1\t\t%read{7,7} %write{2147483647,-1}\n"
+    "const\tstring\t$const6\t\"a\"\t\t%read{8,8} %write{2147483647,-1}\n"
+    "const\tstring\t$const7\t\"f\"\t\t%read{9,9} %write{2147483647,-1}\n"
+    "const\tstring\t$const8\t\"3.14159\"\t\t%read{10,10} %write{2147483647,-1}\n"
+    "const\tint\t$const9\t3\t\t%read{10,10} %write{2147483647,-1}\n"
+    "const\tstring\t$const10\t\",\"\t\t%read{13,13} %write{2147483647,-1}\n"
+    "const\tstring\t$const11\t\"[a-c]+\"\t\t%read{14,14} %write{2147483647,-1}\n"
+    "const\tstring\t$const12\t\"([a-z]+),([a-z]*).*\"\t\t%read{15,15} %write{2147483647,-1}\n"
+    "const\tstring\t$const13\t\"x y z\"\t\t%read{16,16} %write{2147483647,-1}\n"
+    "const\tstring\t$const14\t\" \"\t\t%read{16,16} %write{2147483647,-1}\n"
+    "const\tstring\t$const15\t\"abc\"\t\t%read{18,18} %write{2147483647,-1}\n"
+    "const\tstring\t$const16\t\"b\"\t\t%read{18,18} %write{2147483647,-1}\n"
+    "const\tstring\t$const17\t\"x\"\t\t%read{20,20} %write{2147483647,-1}\n"
+    "const\tstring\t$const18\t\"y\"\t\t%read{20,20} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\tmul\t\t$tmp1 u $const1 \t%argrw{\"wrr\"}\n"
+    "\tassign\t\tstart $tmp1 \t%argrw{\"wr\"}\n"
+    "\tsubstr\t\tsub $const2 start $const3 \t%argrw{\"wrrr\"}\n"
+    "\tassign\t\ts_sub sub \t%argrw{\"wr\"}\n"
+    "\tconcat\t\ts_cat sub $const4 \t%argrw{\"wrr\"}\n"
+    "\tstrlen\t\ti_len s_cat \t%argrw{\"wr\"}\n"
+    "\thash\t\ti_hash sub \t%argrw{\"wr\"}\n"
+    "\tgetchar\t\ti_char sub $const5 \t%argrw{\"wrr\"}\n"
+    "\tstartswith\t\ti_starts sub $const6 \t%argrw{\"wrr\"}\n"
+    "\tendswith\t\ti_ends sub $const7 \t%argrw{\"wrr\"}\n"
+    "\tsubstr\t\tdigits $const8 start $const9 \t%argrw{\"wrrr\"}\n"
+    "\tstoi\t\ti_stoi digits \t%argrw{\"wr\"}\n"
+    "\tstof\t\tf_stof digits \t%argrw{\"wr\"}\n"
+    "\tsplit\t\ti_split sub s_parts $const10 \t%argrw{\"wrwr\"}\n"
+    "\tregex_search\t\ti_search sub $const11 \t%argrw{\"wrr\"}\n"
+    "\tregex_match\t\ti_match sub i_groups $const12 \t%argrw{\"wrwr\"}\n"
+    "\tsplit\t\tnu $const13 uparts $const14 \t%argrw{\"wrwr\"}\n"
+    "\tassign\t\ti_usplit nu \t%argrw{\"wr\"}\n"
+    "\tregex_search\t\tru $const15 $const16 \t%argrw{\"wrr\"}\n"
+    "\tassign\t\ti_uregex ru \t%argrw{\"wr\"}\n"
+    "\tconcat\t\tcu $const17 $const18 \t%argrw{\"wrr\"}\n"
+    "\tassign\t\ts_ucat cu \t%argrw{\"wr\"}\n"
+    "\tend\n";
+
+
+
+// "shader" and "object" space come from the shader globals, "myspace" is
+// known to the renderer by name.
+static Matrix44 Mshad (1, 0, 0, 0,
+                       0, 1, 0, 0,
+                       0, 0, 1, 0,
+                       0.25f, -0.5f, 1, 1);
+static Matrix44 Mobj (0, 1, 0, 0,
+                      -1, 0, 0, 0,
+                      0, 0, 2, 0,
+                      1, 0, 0, 1);
+static Matrix44 Mmyspace (2, 0, 0, 0,
+                          0, 0.5f, 0, 0,
+                          0, 0, 1, 0,
+                          0, 1, -1, 1);
+
+static bool
+named_matrix (ustring name, Matrix44 &result)
+{
+    if (name != ustring("myspace"))
+        return false;
+    result = Mmyspace;
+    return true;
+}
+
+
+
+class BatchedTestRenderer final : public BatchedRendererServices<W> {
+public:
+    OSL_USING_DATA_WIDTH(W);
+
+    Mask get_matrix (BatchedShaderGlobals * /*bsg*/, Masked<Matrix44> result,
+                     Wide<const TransformationPtr> xform,
+                     Wide<const float> /*time*/) override
+    {
+        result.mask().foreach ([=](ActiveLane lane) -> void {
+            result[lane] = *reinterpret_cast<const Matrix44 *>(xform[lane]);
+        });
+        return result.mask();
+    }
+    bool is_overridden_get_inverse_matrix_WmWxWf () const override { return false; }
+
+    Mask get_matrix (BatchedShaderGlobals * /*bsg*/, Masked<Matrix44> result,
+                     ustring from, Wide<const float> /*time*/) override
+    {
+        Matrix44 M;
+        if (! named_matrix (from, M))
+            return Mask(false);
+        result.mask().foreach ([=](ActiveLane lane) -> void {
+            result[lane] = M;
+        });
+        return result.mask();
+    }
+    bool is_overridden_get_matrix_WmWsWf () const override { return false; }
+    bool is_overridden_get_inverse_matrix_WmsWf () const override { return false; }
+    bool is_overridden_get_inverse_matrix_WmWsWf () const override { return false; }
+
+    bool is_attribute_uniform (ustring /*object*/, ustring /*name*/) override
+    {
+        return false;
+    }
+    Mask get_attribute (BatchedShaderGlobals * /*bsg*/, ustring /*object*/,
+                        ustring /*name*/, MaskedData /*val*/) override
+    {
+        return Mask(false);
+    }
+    Mask get_array_attribute (BatchedShaderGlobals * /*bsg*/,
+                              ustring /*object*/, ustring /*name*/,
+                              int /*index*/, MaskedData /*val*/) override
+    {
+        return Mask(false);
+    }
+    bool get_attribute_uniform (BatchedShaderGlobals * /*bsg*/,
+                                ustring /*object*/, ustring /*name*/,
+                                RefData /*val*/) override
+    {
+        return false;
+    }
+    bool get_array_attribute_uniform (BatchedShaderGlobals * /*bsg*/,
+                                      ustring /*object*/, ustring /*name*/,
+                                      int /*index*/, RefData /*val*/) override
+    {
+        return false;
+    }
+    Mask get_userdata (ustring /*name*/, BatchedShaderGlobals * /*bsg*/,
+                       MaskedData /*val*/) override
+    {
+        return Mask(false);
+    }
+
+    bool is_overridden_texture () const override { return false; }
+    bool is_overridden_texture3d () const override { return false; }
+};
+
+
+
+class TestRenderer final : public RendererServices {
+public:
+    bool get_matrix (ShaderGlobals * /*sg*/, Matrix44 &result,
+                     TransformationPtr xform, float /*time*/) override
+    {
+        result = *reinterpret_cast<const Matrix44 *>(xform);
+        return true;
+    }
+    bool get_matrix (ShaderGlobals * /*sg*/, Matrix44 &result,
+                     TransformationPtr xform) override
+    {
+        result = *reinterpret_cast<const Matrix44 *>(xform);
+        return true;
+    }
+    bool get_matrix (ShaderGlobals * /*sg*/, Matrix44 &result,
+                     ustring from, float /*time*/) override
+    {
+        return named_matrix (from, result);
+    }
+    bool get_matrix (ShaderGlobals * /*sg*/, Matrix44 &result,
+                     ustring from) override
+    {
+        return named_matrix (from, result);
+    }
+
+    BatchedRendererServices<W> *batched (WidthOf<W>) override
+    {
+        return &m_batched;
+    }
+
+private:
+    BatchedTestRenderer m_batched;
+};
+
+
+
+static void
+getargs (int argc, char *argv[])
+{
+    bool help = false;
+    OIIO::ArgParse ap;
+    ap.options ("batchedops_test\n"
+                OIIO_INTRO_STRING "\n"
+                "Usage:  batchedops_test [options]",
+                "--help", &help, "Print help message",
+                "-v", &verbose, "Verbose output",
+                "--libdir %s", &libdir,
+                    "Directory holding the wide target libraries",
+                "--tolerance %f", &tolerance,
+                    OIIO::Strutil::sprintf("Allowed relative difference of floats (default: %g)", tolerance).c_str(),
+                NULL);
+    if (ap.parse (argc, (const char**)argv) < 0) {
+        std::cerr << ap.geterror() << std::endl;
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+    if (help) {
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+
+// Every lane shades its own point of a small patch at z = 1, P = (u,v,1).
+static float lane_u (int lane) { return 0.05f + 0.13f * lane; }
+static float lane_v (int lane) { return 0.9f - 0.11f * lane; }
+static const float dudx = 0.125f, dvdy = 0.0625f;
+
+
+static void
+setup_point (ShadingSystem &ss, ShaderGlobals &sg, int lane)
+{
+    memset ((char *)&sg, 0, sizeof(sg));
+    sg.renderstate = &sg;
+    sg.raytype = ss.raytype_bit (ustring("camera"));
+    sg.u = lane_u (lane);
+    sg.v = lane_v (lane);
+    sg.dudx = dudx;
+    sg.dvdy = dvdy;
+    sg.P = Vec3 (sg.u, sg.v, 1.0f);
+    sg.dPdx = Vec3 (dudx, 0.0f, 0.0f);
+    sg.dPdy = Vec3 (0.0f, dvdy, 0.0f);
+    sg.dPdu = Vec3 (1.0f, 0.0f, 0.0f);
+    sg.dPdv = Vec3 (0.0f, 1.0f, 0.0f);
+    sg.I = Vec3 (sg.u, sg.v, 1.0f);
+    sg.N = sg.Ng = Vec3 (0.0f, 0.0f, 1.0f);
+    sg.shader2common = OSL::TransformationPtr (&Mshad);
+    sg.object2common = OSL::TransformationPtr (&Mobj);
+    sg.surfacearea = 1.0f;
+}
+
+
+
+static void
+setup_batch (ShadingSystem &ss, BatchedShaderGlobals<W> &bsg)
+{
+    memset ((char *)&bsg.uniform, 0, sizeof(bsg.uniform));
+    bsg.uniform.renderstate = &bsg;
+    bsg.uniform.raytype = ss.raytype_bit (ustring("camera"));
+
+    auto &vsg = bsg.varying;
+    memset ((char *)&vsg, 0, sizeof(vsg));
+    for (int lane = 0;  lane < W;  ++lane) {
+        ShaderGlobals sg;
+        setup_point (ss, sg, lane);
+        vsg.P[lane] = sg.P;
+        vsg.dPdx[lane] = sg.dPdx;
+        vsg.dPdy[lane] = sg.dPdy;
+        vsg.I[lane] = sg.I;
+        vsg.N[lane] = sg.N;
+        vsg.Ng[lane] = sg.Ng;
+        vsg.u[lane] = sg.u;
+        vsg.dudx[lane] = sg.dudx;
+        vsg.v[lane] = sg.v;
+        vsg.dvdy[lane] = sg.dvdy;
+        vsg.dPdu[lane] = sg.dPdu;
+        vsg.dPdv[lane] = sg.dPdv;
+        vsg.object2common[lane] = sg.object2common;
+        vsg.shader2common[lane] = sg.shader2common;
+        vsg.surfacearea[lane] = sg.surfacearea;
+    }
+}
+
+
+
+static ShaderGroupRef
+make_group (ShadingSystem &ss, const char *shader,
+            const std::vector<ustring> &outputs)
+{
+    ShaderGroupRef group = ss.ShaderGroupBegin ();
+    OIIO_CHECK_ASSERT (ss.Shader (*group, "surface", shader, "layer"));
+    OIIO_CHECK_ASSERT (ss.ShaderGroupEnd (*group));
+    ss.attribute (group.get(), "renderer_outputs",
+                  TypeDesc(TypeDesc::STRING, int(outputs.size())),
+                  outputs.data());
+    return group;
+}
+
+
+
+// Check one lane of an output.  Batched data is laid out with a block of
+// W values for each component, one component of an array after another.
+static void
+compare_lane (const char *shader, ustring out, TypeDesc t, const void *scalar,
+              const void *wide, int lane)
+{
+    int n = int(t.numelements() * t.aggregate);
+    for (int i = 0;  i < n;  ++i) {
+        int w = i * W + lane;
+        bool same = false;
+        std::string sval, wval;
+        if (t.basetype == TypeDesc::FLOAT) {
+            float a = ((const float *)scalar)[i];
+            float b = ((const float *)wide)[w];
+            same = std::abs(a - b) <= tolerance * std::max (1.0f, std::abs(a));
+            sval = OIIO::Strutil::sprintf ("%.9g", a);
+            wval = OIIO::Strutil::sprintf ("%.9g", b);
+        } else if (t.basetype == TypeDesc::INT) {
+            int a = ((const int *)scalar)[i];
+            int b = ((const int *)wide)[w];
+            same = (a == b);
+            sval = OIIO::Strutil::sprintf ("%d", a);
+            wval = OIIO::Strutil::sprintf ("%d", b);
+        } else if (t.basetype == TypeDesc::STRING) {
+            ustring a = ((const ustring *)scalar)[i];
+            ustring b = ((const ustring *)wide)[w];
+            same = (a == b);
+            sval = OIIO::Strutil::sprintf ("\"%s\"", a);
+            wval = OIIO::Strutil::sprintf ("\"%s\"", b);
+        }
+        OIIO_CHECK_ASSERT (same);
+        if (! same || verbose)
+            std::cout << OIIO::Strutil::sprintf ("  %s %s[%d] lane %d: scalar %s, batched %s\n",
+                                                 shader, out, i, lane, sval, wval);
+    }
+}
+
+
+
+// Write a small RGBA gradient for the texture lookups, scaled by gain.  It
+// is tagged as a lat-long environment map so that environment() can read
+// it too.
+static bool
+write_texture (const std::string &filename, float gain = 1.0f)
+{
+    OIIO::ImageSpec spec (16, 8, 4, TypeDesc::FLOAT);
+    spec.attribute ("textureformat", "LatLong Environment");
+    OIIO::ImageBuf buf (spec);
+    const float topleft[] = { 0.0f, 0.0f, 1.0f, 1.0f };
+    const float topright[] = { 1.0f, 0.0f, 0.5f, 0.75f };
+    const float bottomleft[] = { 0.0f, 1.0f, 0.0f, 0.5f };
+    const float bottomright[] = { 1.0f, 1.0f, 0.25f, 0.25f };
+    return OIIO::ImageBufAlgo::fill (buf, topleft, topright, bottomleft,
+                                     bottomright)
+        && OIIO::ImageBufAlgo::mul (buf, buf, gain)
+        && buf.write (filename);
+}
+
+
+
+struct Harness {
+    TestRenderer renderer;
+    ShadingSystem scalar_ss { &renderer };
+    ShadingSystem batched_ss { &renderer };
+    PerThreadInfo *scalar_thread = nullptr, *batched_thread = nullptr;
+    ShadingContext *scalar_ctx = nullptr, *batched_ctx = nullptr;
+
+    Harness ()
+    {
+        // Without batched execution, the analysis only gets in the way
+        scalar_ss.attribute ("opt_batched_analysis", 0);
+        // We are only building FMA versions of the target libraries
+        batched_ss.attribute ("llvm_jit_fma", 1);
+        batched_ss.attribute ("searchpath:library", libdir);
+        scalar_thread = scalar_ss.create_thread_info ();
+        scalar_ctx = scalar_ss.get_context (scalar_thread);
+        batched_thread = batched_ss.create_thread_info ();
+        batched_ctx = batched_ss.get_context (batched_thread);
+    }
+    ~Harness ()
+    {
+        scalar_ss.release_context (scalar_ctx);
+        scalar_ss.destroy_thread_info (scalar_thread);
+        batched_ss.release_context (batched_ctx);
+        batched_ss.destroy_thread_info (batched_thread);
+    }
+
+    // Shade one batch with the named shader, and every lane of it on its
+    // own, comparing the outputs.
+    void check (const char *shader, const char *oso,
+                std::initializer_list<const char *> outputs)
+    {
+        std::cout << "Checking " << shader << "\n";
+        OIIO_CHECK_ASSERT (scalar_ss.LoadMemoryCompiledShader (shader, oso));
+        OIIO_CHECK_ASSERT (batched_ss.LoadMemoryCompiledShader (shader, oso));
+        std::vector<ustring> outnames (outputs.begin(), outputs.end());
+        ShaderGroupRef sgroup = make_group (scalar_ss, shader, outnames);
+        ShaderGroupRef bgroup = make_group (batched_ss, shader, outnames);
+
+        BatchedShaderGlobals<W> bsg;
+        setup_batch (batched_ss, bsg);
+        OIIO_CHECK_ASSERT (batched_ss.batched<W>().execute (*batched_ctx,
+                                                            *bgroup, W, bsg));
+
+        for (int lane = 0;  lane < W;  ++lane) {
+            ShaderGlobals sg;
+            setup_point (scalar_ss, sg, lane);
+            OIIO_CHECK_ASSERT (scalar_ss.execute (*scalar_ctx, *sgroup, sg));
+            for (ustring out : outnames) {
+                const ShaderSymbol *ssym = scalar_ss.find_symbol (*sgroup, out);
+                const ShaderSymbol *bsym = batched_ss.find_symbol (*bgroup, out);
+                OIIO_CHECK_ASSERT (ssym && bsym);
+                if (! ssym || ! bsym)
+                    continue;
+                compare_lane (shader, out, scalar_ss.symbol_typedesc (ssym),
+                              scalar_ss.symbol_address (*scalar_ctx, ssym),
+                              batched_ss.symbol_address (*batched_ctx, bsym),
+                              lane);
+            }
+        }
+    }
+};
+
+
+
+int
+main (int argc, char *argv[])
+{
+    getargs (argc, argv);
+
+    Harness harness;
+    if (! harness.batched_ss.supports_batch_execution_at (W)) {
+        std::cout << "Skipping, batched execution at width " << W
+                  << " is not supported on this machine\n";
+        return unit_test_failures;
+    }
+
+    harness.check ("noise_ops", noise_ops_oso,
+                   { "f_perlin", "c_uperlin", "f_cell", "f_hash",
+                     "v_simplex", "f_pnoise" });
+
+    std::string texfile = "batchedops_test.tif";
+    OIIO_CHECK_ASSERT (write_texture (texfile));
+    std::string texture_oso = OIIO::Strutil::replace (texture_ops_oso,
+                                                      "TEXFILE", texfile, true);
+    // Keep the lookups of a constant file name from being folded away
+    harness.scalar_ss.attribute ("opt_constant_fold", 0);
+    harness.batched_ss.attribute ("opt_constant_fold", 0);
+    harness.check ("texture_ops", texture_oso.c_str(),
+                   { "c_tex", "f_alpha", "f_blur", "c_env", "i_found",
+                     "i_res", "f_chans" });
+    // Lanes binned by file name, one bin failing without failing the rest
+    std::string otherfile = "batchedops_other.tif";
+    OIIO_CHECK_ASSERT (write_texture (otherfile, 0.5f));
+    std::string varying_oso = OIIO::Strutil::replace (texture_varying_oso,
+                                                      "TEXFILE", texfile, true);
+    varying_oso = OIIO::Strutil::replace (varying_oso, "OTHERFILE", otherfile,
+                                          true);
+    harness.check ("texture_varying", varying_oso.c_str(),
+                   { "c_tex", "i_err" });
+    OIIO::Filesystem::remove (otherfile);
+    OIIO::Filesystem::remove (texfile);
+    // ... and the uniform forms of the matrix, color, spline and
+    // string ops
+    harness.check ("matrix_ops", matrix_ops_oso,
+                   { "p_shader", "v_obj", "n_my", "p_obj", "m_from", "m_two",
+                     "i_found", "m_get", "p_mat", "p_uni", "c_hsv", "c_uhsv",
+                     "c_bb", "c_wl" });
+    harness.check ("spline_ops", spline_ops_oso,
+                   { "f_spline", "f_dx", "c_spline", "f_inv", "f_count",
+                     "f_uni" });
+    harness.check ("string_ops", string_ops_oso,
+                   { "s_sub", "s_cat", "i_len", "i_hash", "i_char",
+                     "i_starts", "i_ends", "i_stoi", "f_stof", "i_split",
+                     "s_parts", "i_search", "i_match", "i_groups",
+                     "i_usplit", "i_uregex", "s_ucat" });
+    harness.scalar_ss.attribute ("opt_constant_fold", 1);
+    harness.batched_ss.attribute ("opt_constant_fold", 1);
+
+    return unit_test_failures;
+}
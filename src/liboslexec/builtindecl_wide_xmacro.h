@@ -186,9 +186,10 @@ DECL(__OSL_OP(warning), "xXis*")
 DECL(__OSL_OP(fprintf), "xXiss*")
 
 
-DECL(__OSL_MASKED_OP(split), "xXXXXXii")
-
 // DECL (osl_incr_layers_executed, "xX") // original used by wide currently
+#endif // __OSL_TBD
+
+DECL(__OSL_MASKED_OP(split), "xXXXXXii")
 
 
 
@@ -196,6 +197,9 @@ WIDE_NOISE_IMPL(cellnoise)
 // commented out in non-wide, there is no derivative version of cellnoise
 //WIDE_NOISE_DERIV_IMPL(cellnoise)
 
+WIDE_NOISE_IMPL(hashnoise)
+// no derivative version of hashnoise either
+
 WIDE_NOISE_IMPL(noise)
 WIDE_NOISE_DERIV_IMPL(noise)
 
@@ -219,12 +223,7 @@ WIDE_PNOISE_IMPL(pcellnoise)
 // commented out in non-wide, there is no derivative version of pcellnoise
 //WIDE_PNOISE_DERIV_IMPL(pcellnoise)
 
-
-WIDE_GENERIC_NOISE_DERIV_IMPL(gabornoise)
-WIDE_GENERIC_PNOISE_DERIV_IMPL(gaborpnoise)
-
-WIDE_GENERIC_NOISE_DERIV_IMPL(genericnoise)
-WIDE_GENERIC_PNOISE_DERIV_IMPL(genericpnoise)
+WIDE_PNOISE_IMPL(phashnoise)
 
 WIDE_NOISE_IMPL(nullnoise)
 WIDE_NOISE_DERIV_IMPL(nullnoise)
@@ -232,6 +231,14 @@ WIDE_NOISE_DERIV_IMPL(nullnoise)
 WIDE_NOISE_IMPL(unullnoise)
 WIDE_NOISE_DERIV_IMPL(unullnoise)
 
+
+#ifdef __OSL_TBD
+WIDE_GENERIC_NOISE_DERIV_IMPL(gabornoise)
+WIDE_GENERIC_PNOISE_DERIV_IMPL(gaborpnoise)
+
+WIDE_GENERIC_NOISE_DERIV_IMPL(genericnoise)
+WIDE_GENERIC_PNOISE_DERIV_IMPL(genericpnoise)
+
 //DECL (osl_noiseparams_set_anisotropic, "xXi") // share non-wide impl
 //DECL (osl_noiseparams_set_do_filter, "xXi") // share non-wide impl
 //DECL (osl_noiseparams_set_direction, "xXv") // share non-wide impl
@@ -239,6 +246,7 @@ WIDE_NOISE_DERIV_IMPL(unullnoise)
 //DECL (osl_noiseparams_set_impulses, "xXf")  // share non-wide impl
 
 DECL(__OSL_OP(count_noise), "xX")
+#endif // __OSL_TBD
 
 // Need wide for combinations of the 3 parameters allowed to be uniform
 // caveat, some combos are unreachable/uneeded
@@ -298,6 +306,7 @@ DECL(__OSL_MASKED_OP3(splineinverse, Wdf, Wdf, f), "xXXXXiii")
 DECL(__OSL_MASKED_OP3(splineinverse, Wdf, f, Wdf), "xXXXXiii")
 DECL(__OSL_MASKED_OP3(splineinverse, Wdf, Wf, Wdf), "xXXXXiii")
 
+#ifdef __OSL_TBD
 #if 0  // incomplete
 // setmessage/getmessage involve closures, leave to next iteration
 //DECL (osl_setmessage, "xXsLXisi")
@@ -314,6 +323,7 @@ DECL(__OSL_MASKED_OP(getmessage), "xXXssLXiisii")
 //DECL (osl_setmessage_varying_name_wide_data_masked, "xXXLXisii")
 DECL(__OSL_MASKED_OP(setmessage_uniform_name_wide_data), "xXXLXisii")
 DECL(__OSL_MASKED_OP(setmessage_varying_name_wide_data), "xXXLXisii")
+#endif // __OSL_TBD
 
 DECL(__OSL_OP(blackbody_vf), "xXXf")
 DECL(__OSL_MASKED_OP2(blackbody, Wv, Wf), "xXXXi")
@@ -340,11 +350,13 @@ DECL(__OSL_MASKED_OP2(prepend_matrix_from, Wm, Ws), "xXXXi")
 // DECL (osl_transform_triple, "iXXiXiXXi") // unneeded
 // DECL (osl_transform_triple_nonlinear, "iXXiXiXXi") // unneeded
 
+DECL(__OSL_OP3(build_transform_matrix, m, s, s), "iXXXX")
 DECL(__OSL_MASKED_OP3(build_transform_matrix, Wm, s, s), "iXXXXi")
 DECL(__OSL_MASKED_OP3(build_transform_matrix, Wm, Ws, s), "iXXXXi")
 DECL(__OSL_MASKED_OP3(build_transform_matrix, Wm, s, Ws), "iXXXXi")
 DECL(__OSL_MASKED_OP3(build_transform_matrix, Wm, Ws, Ws), "iXXXXi")
 
+#ifdef __OSL_TBD
 
 DECL(__OSL_OP(dict_find_iis), "iXiX")
 DECL(__OSL_MASKED_OP3(dict_find, Wi, Wi, Ws), "xXXXXi")
@@ -498,6 +510,7 @@ DECL(__OSL_MASKED_OP4(smoothstep, Wdf, Wf, Wdf, Wf), "xXXXXi")
 // DECL (osl_transformv_dvmdv, "xXXX")
 // DECL (osl_transformn_vmv, "xXXX")
 // DECL (osl_transformn_dvmdv, "xXXX")
+#endif // __OSL_TBD
 
 DECL(__OSL_MASKED_OP3(transform_point, v, Wv, m), "xXXXii")
 DECL(__OSL_MASKED_OP3(transform_point, v, Wv, Wm), "xXXXii")
@@ -527,6 +540,7 @@ DECL(__OSL_MASKED_OP3(transform_normal, Wdv, Wdv, m), "xXXXii")
 DECL(__OSL_MASKED_OP(transform_color), "xXXiXiXXi")
 DECL(__OSL_OP(transform_color), "xXXiXiXX")
 
+#ifdef __OSL_TBD
 
 DECL(__OSL_OP3(dot, Wf, Wv, Wv), "xXXX")
 DECL(__OSL_MASKED_OP3(dot, Wf, Wv, Wv), "xXXXi")
@@ -591,12 +605,16 @@ DECL(__OSL_OP3(div, Wm, Wm, Wf), "xXXX")
 DECL(__OSL_MASKED_OP3(div, Wm, Wm, Wf), "xXXXi")
 DECL(__OSL_MASKED_OP3(div, Wm, Wf, Wm), "xXXXi")
 
+#endif // __OSL_TBD
+
 // forced masked version only
 DECL(__OSL_MASKED_OP3(get_from_to_matrix, Wm, s, s), "iXXssi")
 DECL(__OSL_MASKED_OP3(get_from_to_matrix, Wm, s, Ws), "iXXsXi")
 DECL(__OSL_MASKED_OP3(get_from_to_matrix, Wm, Ws, s), "iXXXsi")
 DECL(__OSL_MASKED_OP3(get_from_to_matrix, Wm, Ws, Ws), "iXXXXi")
 
+#ifdef __OSL_TBD
+
 //varying vs non varying
 DECL(__OSL_OP2(transpose, Wm, Wm), "xXX")
 DECL(__OSL_MASKED_OP2(transpose, Wm, Wm), "xXXi")
@@ -604,6 +622,8 @@ DECL(__OSL_MASKED_OP2(transpose, Wm, Wm), "xXXi")
 DECL(__OSL_OP2(determinant, Wf, Wm), "xXX")
 DECL(__OSL_MASKED_OP2(determinant, Wf, Wm), "xXXi")
 
+#endif // __OSL_TBD
+
 // forced masked version only
 DECL(__OSL_MASKED_OP3(concat, Ws, Ws, Ws), "xXXXi")
 DECL(__OSL_MASKED_OP2(strlen, Wi, Ws), "xXXi")
@@ -622,12 +642,12 @@ DECL(__OSL_OP(regex_impl), "iXsXisi")
 // of osl_texture_set_XXX functions
 DECL(__OSL_MASKED_OP(texture), "iXXXXXXXXXXiXiXiXi")
 DECL(__OSL_MASKED_OP(texture3d), "iXXXXXXXiXiXiXi")
-#if 0  // incomplete
-DECL (osl_environment, "iXXXXXXXiXXXXXXX")
-#endif
+DECL(__OSL_MASKED_OP(environment), "iXXXXXXXiXiXiXi")
 DECL(__OSL_MASKED_OP(get_textureinfo), "iXXXXXi")
 DECL(__OSL_OP(get_textureinfo_uniform), "iXXXXXX")
 
+#ifdef __OSL_TBD
+
 // Wide Code generator will set trace options directly in LLVM IR
 // without calling helper functions
 //DECL (osl_trace_set_mindist, "xXf") // unneeded
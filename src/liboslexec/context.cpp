@@ -69,7 +69,8 @@ ShadingContext::execute_init (ShaderGroup &sgroup, ShaderGlobals &ssg, bool run)
         sgroup.start_running ();
         if (! sgroup.jitted()) {
             auto ctx = shadingsys().get_context(thread_info());
-            shadingsys().optimize_group (sgroup, ctx, true /*do_jit*/);
+            shadingsys().optimize_group (sgroup, ctx, true /*do_jit*/,
+                                         true /*quick_jit*/);
             if (shadingsys().m_greedyjit && shadingsys().m_groups_to_compile_count) {
                 // If we are greedily JITing, optimize/JIT everything now
                 shadingsys().optimize_all_groups ();
@@ -89,9 +90,11 @@ ShadingContext::execute_init (ShaderGroup &sgroup, ShaderGlobals &ssg, bool run)
     // Allocate enough space on the heap
     size_t heap_size_needed = sgroup.llvm_groupdata_size();
     reserve_heap(heap_size_needed);
+    // Zero out stats for this execution
+    clear_runtime_stats ();
+
     // Zero out the heap memory we will be using
-    if (shadingsys().m_clearmemory)
-        memset (m_heap.get(), 0, heap_size_needed);
+    clear_heap (heap_size_needed, sgroup.llvm_groupdata_flags_size(), run);
 
     // Set up closure storage
     m_closure_pool.clear();
@@ -102,9 +105,6 @@ ShadingContext::execute_init (ShaderGroup &sgroup, ShaderGlobals &ssg, bool run)
     // Clear miscellaneous scratch space
     m_scratch_pool.clear ();
 
-    // Zero out stats for this execution
-    clear_runtime_stats ();
-
     if (run) {
         RunLLVMGroupFunc run_func = sgroup.llvm_compiled_init();
         if (!run_func)
@@ -252,9 +252,12 @@ ShadingContext::Batched<WidthT>::execute_init
     // Allocate enough space on the heap
     size_t heap_size_needed = sgroup.llvm_groupdata_wide_size();
     context().reserve_heap(heap_size_needed);
+    // Zero out stats for this execution
+    context().clear_runtime_stats ();
+
     // Zero out the heap memory we will be using
-    if (shadingsys().m_clearmemory)
-        memset (context().m_heap.get(), 0, heap_size_needed);
+    context().clear_heap (heap_size_needed, sgroup.llvm_groupdata_wide_flags_size(),
+                          run && batch_size > 0);
 
     // Set up closure storage
     context().m_closure_pool.clear();
@@ -267,9 +270,6 @@ ShadingContext::Batched<WidthT>::execute_init
     // Clear miscellaneous scratch space
     context().m_scratch_pool.clear ();
 
-    // Zero out stats for this execution
-    context().clear_runtime_stats ();
-
     if (run) {
         bsg.uniform.context = &context();
         bsg.uniform.renderer = context().renderer();
@@ -0,0 +1,272 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Toggle a parameter of a group back and forth with ReParameter, as an
+// interactive session would, and check that returning to an earlier
+// value reuses its compiled code (and still computes the right thing).
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/timer.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+
+using namespace OSL;
+
+
+static int iterations = 20;
+
+
+// shader cachenode (float Kd = 0.5, output float out = 0)
+// {
+//     out = Kd * 2;
+// }
+static const char *cachenode_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader cachenode\n"
+    "param\tfloat\tKd\t0.5\t\t%read{0,0} %write{2147483647,-1}\n"
+    "oparam\tfloat\tout\t0\t\t%read{2147483647,-1} %write{0,0}\n"
+    "const\tfloat\t$const1\t2\t\t%read{0,0} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\tmul\t\tout Kd $const1 \t%argrw{\"wrr\"}\n"
+    "\tend\n";
+
+// The same, computing out = Kd * 3, to replace the cachenode master
+static const char *cachenode3_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader cachenode\n"
+    "param\tfloat\tKd\t0.5\t\t%read{0,0} %write{2147483647,-1}\n"
+    "oparam\tfloat\tout\t0\t\t%read{2147483647,-1} %write{0,0}\n"
+    "const\tfloat\t$const1\t3\t\t%read{0,0} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\tmul\t\tout Kd $const1 \t%argrw{\"wrr\"}\n"
+    "\tend\n";
+
+// shader varnode (float Kv = 0.5 [[ int lockgeom = 0 ]],
+//                 output float out = 0)
+// {
+//     out = Kv * 2;
+// }
+static const char *varnode_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader varnode\n"
+    "param\tfloat\tKv\t0.5\t\t%meta{int,lockgeom,0}  %read{0,0} %write{2147483647,-1}\n"
+    "oparam\tfloat\tout\t0\t\t%read{2147483647,-1} %write{0,0}\n"
+    "const\tfloat\t$const1\t2\t\t%read{0,0} %write{2147483647,-1}\n"
+    "code ___main___\n"
+    "\tmul\t\tout Kv $const1 \t%argrw{\"wrr\"}\n"
+    "\tend\n";
+
+
+
+static void
+getargs (int argc, char *argv[])
+{
+    bool help = false;
+    OIIO::ArgParse ap;
+    ap.options ("groupcache_test\n"
+                OIIO_INTRO_STRING "\n"
+                "Usage:  groupcache_test [options]",
+                "--help", &help, "Print help message",
+                "--iters %d", &iterations,
+                    OIIO::Strutil::sprintf("Number of timed toggles (default: %d)", iterations).c_str(),
+                NULL);
+    if (ap.parse (argc, (const char**)argv) < 0) {
+        std::cerr << ap.geterror() << std::endl;
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+    if (help) {
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+
+static ShaderGroupRef
+make_group (ShadingSystem &ss, const char *shader, const char *param,
+            float value)
+{
+    ShaderGroupRef group = ss.ShaderGroupBegin ();
+    ss.Parameter (*group, param, value);
+    OIIO_CHECK_ASSERT (ss.Shader (*group, "surface", shader, "layer"));
+    OIIO_CHECK_ASSERT (ss.ShaderGroupEnd (*group));
+    return group;
+}
+
+
+
+static int
+get_stat (ShadingSystem &ss, const char *name)
+{
+    int val = -1;
+    ss.getattribute (name, TypeDesc::INT, &val);
+    return val;
+}
+
+
+
+// Run the group on one point and return its output.
+static float
+run (ShadingSystem &ss, ShadingContext *ctx, ShaderGroup &group)
+{
+    ShaderGlobals sg;
+    memset ((char *)&sg, 0, sizeof(sg));
+    ss.execute (*ctx, group, sg);
+    const ShaderSymbol *out = ss.find_symbol (group, ustring("out"));
+    OIIO_CHECK_ASSERT (out);
+    return out ? *(const float *)ss.symbol_address (*ctx, out) : 0.0f;
+}
+
+
+
+// ReParameter of a group whose optimized JIT is still queued (async_jit)
+// drops the queued JIT, and the group runs with the new value.
+static void
+test_async_reparameter (RendererServices &renderer)
+{
+    ShadingSystem ss (&renderer);
+    ustring outputs[] = { ustring("out") };
+    ss.attribute ("renderer_outputs", TypeDesc(TypeDesc::STRING, 1), &outputs);
+    ss.attribute ("group_cache_size", 2);
+    ss.attribute ("async_jit", 1);
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("cachenode", cachenode_oso));
+    PerThreadInfo *thread_info = ss.create_thread_info ();
+    ShadingContext *ctx = ss.get_context (thread_info);
+    for (int i = 0;  i < 20;  ++i) {
+        ShaderGroupRef group = make_group (ss, "cachenode", "Kd", 0.5f);
+        OIIO_CHECK_EQUAL (run (ss, ctx, *group), 1.0f);
+        OIIO_CHECK_ASSERT (ss.ReParameter (*group, "layer", "Kd", 0.25f));
+        OIIO_CHECK_EQUAL (run (ss, ctx, *group), 0.5f);
+        OIIO_CHECK_ASSERT (ss.ReParameter (*group, "layer", "Kd", 0.5f));
+        OIIO_CHECK_EQUAL (run (ss, ctx, *group), 1.0f);
+    }
+    ss.release_context (ctx);
+    ss.destroy_thread_info (thread_info);
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+    getargs (argc, argv);
+
+    RendererServices renderer;
+    ShadingSystem ss (&renderer);
+    ustring outputs[] = { ustring("out") };
+    ss.attribute ("renderer_outputs", TypeDesc(TypeDesc::STRING, 1), &outputs);
+    ss.attribute ("group_cache_size", 2);
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("cachenode", cachenode_oso));
+
+    PerThreadInfo *thread_info = ss.create_thread_info ();
+    ShadingContext *ctx = ss.get_context (thread_info);
+
+    ShaderGroupRef group = make_group (ss, "cachenode", "Kd", 0.5f);
+
+    // First value: compiled
+    OIIO_CHECK_EQUAL (run (ss, ctx, *group), 1.0f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_misses"), 1);
+
+    // Second value: compiled, even though Kd is not lockgeom=0. The
+    // group is rebuilt, but that doesn't count as another group.
+    int groups = get_stat (ss, "stat:groups");
+    int instances = get_stat (ss, "stat:instances");
+    OIIO_CHECK_ASSERT (ss.ReParameter (*group, "layer", "Kd", 0.25f));
+    OIIO_CHECK_EQUAL (run (ss, ctx, *group), 0.5f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_misses"), 2);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:groups"), groups);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:instances"), instances);
+
+    // Back to the first value: cached
+    OIIO_CHECK_ASSERT (ss.ReParameter (*group, "layer", "Kd", 0.5f));
+    OIIO_CHECK_EQUAL (run (ss, ctx, *group), 1.0f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_hits"), 1);
+
+    // A separate group built the same way shares the cached code too
+    ShaderGroupRef twin = make_group (ss, "cachenode", "Kd", 0.25f);
+    OIIO_CHECK_EQUAL (run (ss, ctx, *twin), 0.5f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_hits"), 2);
+
+    // A third value evicts the least recently used, which was 0.5
+    OIIO_CHECK_ASSERT (ss.ReParameter (*group, "layer", "Kd", 1.0f));
+    OIIO_CHECK_EQUAL (run (ss, ctx, *group), 2.0f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_evictions"), 1);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_entries"), 2);
+    OIIO_CHECK_ASSERT (ss.ReParameter (*group, "layer", "Kd", 0.5f));
+    OIIO_CHECK_EQUAL (run (ss, ctx, *group), 1.0f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_misses"), 4);
+
+    // Time toggling between the two cached values
+    int hits = get_stat (ss, "stat:group_cache_hits");
+    OIIO::Timer timer;
+    for (int i = 0;  i < iterations;  ++i) {
+        ss.ReParameter (*group, "layer", "Kd", (i & 1) ? 0.5f : 1.0f);
+        run (ss, ctx, *group);
+    }
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_hits"), hits + iterations);
+    std::cout << OIIO::Strutil::sprintf ("  %8.2f us per cached toggle\n",
+                                         1.0e6 * timer() / std::max (iterations, 1));
+
+    // A lockgeom=0 parameter is still changed in place, without
+    // compiling again
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("varnode", varnode_oso));
+    ShaderGroupRef var = make_group (ss, "varnode", "Kv", 0.5f);
+    OIIO_CHECK_EQUAL (run (ss, ctx, *var), 1.0f);
+    int misses = get_stat (ss, "stat:group_cache_misses");
+    hits = get_stat (ss, "stat:group_cache_hits");
+    OIIO_CHECK_ASSERT (ss.ReParameter (*var, "layer", "Kv", 0.25f));
+    OIIO_CHECK_EQUAL (run (ss, ctx, *var), 0.5f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_misses"), misses);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_hits"), hits);
+
+    // ... unless another group shares the layer, even once the cache is
+    // turned off
+    ShaderGroupRef var1 = make_group (ss, "varnode", "Kv", 0.75f);
+    ShaderGroupRef var2 = make_group (ss, "varnode", "Kv", 0.75f);
+    OIIO_CHECK_EQUAL (run (ss, ctx, *var1), 1.5f);
+    OIIO_CHECK_EQUAL (run (ss, ctx, *var2), 1.5f);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_hits"), hits + 1);
+    ss.attribute ("group_cache_size", 0);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_entries"), 0);
+    OIIO_CHECK_ASSERT (ss.ReParameter (*var2, "layer", "Kv", 1.0f));
+    OIIO_CHECK_EQUAL (run (ss, ctx, *var2), 2.0f);
+    OIIO_CHECK_EQUAL (run (ss, ctx, *var1), 1.5f);
+    ss.attribute ("group_cache_size", 2);
+
+    // A replaced master doesn't get the code of the one it replaced
+    OIIO_CHECK_EQUAL (run (ss, ctx, *make_group (ss, "cachenode", "Kd", 0.5f)),
+                      1.0f);
+    ss.attribute ("allow_shader_replacement", 1);
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("cachenode", cachenode3_oso));
+    OIIO_CHECK_EQUAL (run (ss, ctx, *make_group (ss, "cachenode", "Kd", 0.5f)),
+                      1.5f);
+
+    // Only options that shape the code, and only when they change, empty
+    // the cache
+    OIIO_CHECK_ASSERT (get_stat (ss, "stat:group_cache_entries") > 0);
+    ss.attribute ("statistics:level", 1);
+    int llvm_optimize = get_stat (ss, "llvm_optimize");
+    ss.attribute ("llvm_optimize", llvm_optimize);
+    OIIO_CHECK_ASSERT (get_stat (ss, "stat:group_cache_entries") > 0);
+    ss.attribute ("llvm_optimize", llvm_optimize ? 0 : 1);
+    OIIO_CHECK_EQUAL (get_stat (ss, "stat:group_cache_entries"), 0);
+
+    ss.release_context (ctx);
+    ss.destroy_thread_info (thread_info);
+
+    test_async_reparameter (renderer);
+    return unit_test_failures;
+}
@@ -7,6 +7,7 @@
 #include <cstdio>
 #include <algorithm>
 
+#include <OpenImageIO/hash.h>
 #include <OpenImageIO/strutil.h>
 
 #include "oslexec_pvt.h"
@@ -707,6 +708,54 @@ ShaderInstance::mergeable (const ShaderInstance &b, const ShaderGroup& /*g*/) co
 }
 
 
+size_t
+ShaderInstance::merge_hash () const
+{
+    size_t h = 0;
+    auto mix = [&](size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+
+    mix ((size_t) master());
+    mix (run_lazily());
+    for (auto&& c : m_connections) {
+        mix (c.srclayer);
+        mix (c.src.param);
+        mix (c.src.arrayindex);
+        mix (c.src.channel);
+        mix (c.dst.param);
+        mix (c.dst.arrayindex);
+        mix (c.dst.channel);
+    }
+
+    bool optimized = (m_instsymbols.size() != 0 || m_instops.size() != 0);
+    if (!optimized) {
+        // Same parameter values, exactly as mergeable() compares them.
+        // Before optimization its choice of parameters depends only on
+        // the master's symbols, so both sides agree on which to hash.
+        for (int i = firstparam();  i < lastparam();  ++i) {
+            const Symbol *sym = mastersymbol(i);
+            if (! sym->everused_in_group() || sym->typespec().is_closure())
+                continue;
+            if (sym->valuesource() == Symbol::InstanceVal ||
+                sym->valuesource() == Symbol::DefaultVal)
+                mix (OIIO::farmhash::Hash ((const char *)param_storage(i),
+                                           sym->typespec().simpletype().size()));
+        }
+    } else {
+        // After optimization, the parameter values are baked into the
+        // instance's own code, which must be the same.
+        mix (m_instops.size());
+        for (auto&& op : m_instops)
+            mix (op.opname().hash());
+        for (int arg : m_instargs)
+            mix (arg);
+        mix (m_maincodebegin);
+        mix (m_maincodeend);
+    }
+    return h;
+}
+
+
+
 }; // namespace pvt
 
 
@@ -801,11 +850,19 @@ ShaderGroup::mark_entry_layer (int layer)
 
 std::string
 ShaderGroup::serialize () const
+{
+    lock_guard lock (m_mutex);
+    return serialize_nolock ();
+}
+
+
+
+std::string
+ShaderGroup::serialize_nolock () const
 {
     std::ostringstream out;
     out.imbue (std::locale::classic());  // force C locale
     out.precision (9);
-    lock_guard lock (m_mutex);
     for (int i = 0, nl = nlayers(); i < nl; ++i) {
         const ShaderInstance *inst = m_layers[i].get();
 
@@ -878,4 +935,102 @@ ShaderGroup::serialize () const
 }
 
 
+
+void
+ShaderGroup::copy_optimized (const ShaderGroup &src)
+{
+    m_layers = src.m_layers;
+    m_num_entry_layers = src.m_num_entry_layers;
+    m_does_nothing = src.m_does_nothing;
+    m_llvm_groupdata_size = src.m_llvm_groupdata_size;
+    m_llvm_groupdata_wide_size = src.m_llvm_groupdata_wide_size;
+    m_llvm_groupdata_flags_size = src.m_llvm_groupdata_flags_size;
+    m_llvm_groupdata_wide_flags_size = src.m_llvm_groupdata_wide_flags_size;
+    copy_compiled_layers (src.m_llvm_compiled_layers,
+                          src.m_llvm_compiled_layers.size());
+    llvm_compiled_version (src.llvm_compiled_version());
+    llvm_compiled_init (src.llvm_compiled_init());
+    m_llvm_compiled_wide_version = src.m_llvm_compiled_wide_version;
+    m_llvm_compiled_wide_init = src.m_llvm_compiled_wide_init;
+    m_llvm_compiled_wide_layers = src.m_llvm_compiled_wide_layers;
+    m_llvm_ptx_compiled_version = src.m_llvm_ptx_compiled_version;
+    m_raytype_queries = src.m_raytype_queries;
+    m_globals_read = src.m_globals_read;
+    m_globals_write = src.m_globals_write;
+    m_textures_needed = src.m_textures_needed;
+    m_closures_needed = src.m_closures_needed;
+    m_globals_needed = src.m_globals_needed;
+    m_userdata_names = src.m_userdata_names;
+    m_userdata_types = src.m_userdata_types;
+    m_userdata_offsets = src.m_userdata_offsets;
+    m_userdata_derivs = src.m_userdata_derivs;
+    m_userdata_layers = src.m_userdata_layers;
+    m_userdata_init_vals = src.m_userdata_init_vals;
+    m_attributes_needed = src.m_attributes_needed;
+    m_attribute_scopes = src.m_attribute_scopes;
+    m_unknown_textures_needed = src.m_unknown_textures_needed;
+    m_unknown_closures_needed = src.m_unknown_closures_needed;
+    m_unknown_attributes_needed = src.m_unknown_attributes_needed;
+    // Set the flags last: another thread may test them without the lock.
+    m_batch_jitted = src.m_batch_jitted;
+    m_jitted = src.m_jitted;
+    m_optimized = src.m_optimized;
+}
+
+
+
+void
+ShaderGroup::copy_compiled_layers (const AtomicFuncs &src, size_t n)
+{
+    // std::atomic can't be copied or moved, so build a fresh vector and
+    // move the whole vector into place.
+    AtomicFuncs layers (n);
+    for (size_t i = 0, e = std::min (n, src.size());  i < e;  ++i)
+        layers[i].store (src[i].load (std::memory_order_acquire),
+                         std::memory_order_relaxed);
+    m_llvm_compiled_layers = std::move (layers);
+}
+
+
+
+void
+ShaderGroup::reset_unoptimized (const ShaderGroup &fresh)
+{
+    m_optimized = 0;
+    m_jitted = 0;
+    m_batch_jitted = 0;
+    m_layers = fresh.m_layers;
+    m_num_entry_layers = fresh.m_num_entry_layers;
+    m_raytype_queries = fresh.m_raytype_queries;
+    m_does_nothing = false;
+    m_llvm_groupdata_size = 0;
+    m_llvm_groupdata_wide_size = 0;
+    m_llvm_groupdata_flags_size = 0;
+    m_llvm_groupdata_wide_flags_size = 0;
+    llvm_compiled_version (nullptr);
+    llvm_compiled_init (nullptr);
+    m_llvm_compiled_layers.clear ();
+    m_llvm_compiled_wide_version = nullptr;
+    m_llvm_compiled_wide_init = nullptr;
+    m_llvm_compiled_wide_layers.clear ();
+    m_llvm_ptx_compiled_version.clear ();
+    m_globals_read = 0;
+    m_globals_write = 0;
+    m_textures_needed.clear ();
+    m_closures_needed.clear ();
+    m_globals_needed.clear ();
+    m_userdata_names.clear ();
+    m_userdata_types.clear ();
+    m_userdata_offsets.clear ();
+    m_userdata_derivs.clear ();
+    m_userdata_layers.clear ();
+    m_userdata_init_vals.clear ();
+    m_attributes_needed.clear ();
+    m_attribute_scopes.clear ();
+    m_unknown_textures_needed = false;
+    m_unknown_closures_needed = false;
+    m_unknown_attributes_needed = false;
+}
+
+
 OSL_NAMESPACE_EXIT
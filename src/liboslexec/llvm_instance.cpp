@@ -243,6 +243,10 @@ BackendLLVM::llvm_type_groupdata ()
     fields.push_back (ll.type_array (ll.type_bool(), sz));
     offset += sz * sizeof(bool);
     ++order;
+    // The flags are the leading bytes that group init clears, so that
+    // clear_heap can skip them. It only clears layer_run if more than one
+    // layer is used, and then the userdata flags follow.
+    group().llvm_groupdata_flags_size (m_num_used_layers > 1 ? offset : 0);
 
     // Now add the array that tells which userdata have been initialized,
     // and the space for the userdata values.
@@ -258,6 +262,8 @@ BackendLLVM::llvm_type_groupdata ()
         fields.push_back (ll.type_array (ll.type_bool(), sz));
         offset += nuserdata * sizeof(bool);
         ++order;
+        if (m_num_used_layers > 1)
+            group().llvm_groupdata_flags_size (offset);
         for (int i = 0; i < nuserdata; ++i) {
             TypeDesc type = types[i];
             // NB: Userdata derivs are not currently supported in OptiX, since
@@ -1121,7 +1127,8 @@ BackendLLVM::initialize_llvm_group ()
 
     // Set up optimization passes. Don't target the host if we're building
     // for OptiX.
-    ll.setup_optimization_passes (shadingsys().llvm_optimize(),
+    // Quick JIT uses optlevel 10, which adds next to no passes.
+    ll.setup_optimization_passes (m_quick_jit ? 10 : shadingsys().llvm_optimize(),
                                   shadingsys().llvm_target_host() && !use_optix());
 
     // Clear the shaderglobals and groupdata types -- they will be
@@ -1243,6 +1250,14 @@ BackendLLVM::run ()
     // End of mutex lock, for the OSL_LLVM_NO_BITCODE case
     }
 
+    // Code with debugging hooks can't be reused by another process; the
+    // rest is cached unless it turns out to refer to raw addresses.
+    std::shared_ptr<LLVM_Util::ObjectCache> jit_cache;
+    if (! use_optix() && ! m_quick_jit && ! shadingsys().llvm_debugging_symbols()
+        && ! shadingsys().llvm_profiling_events())
+        jit_cache = shadingsys().llvm_jit_cache();
+    ll.relocatable_strings (jit_cache != nullptr);
+
     m_stat_llvm_setup_time += timer.lap();
 
     // Set up m_num_used_layers to be the number of layers that are
@@ -1266,7 +1281,9 @@ BackendLLVM::run ()
             m_layer_remap[layer] = m_num_used_layers++;
         }
     }
-    shadingsys().m_stat_empty_instances += nlayers - m_num_used_layers;
+    // An async_jit re-run of an already jitted group has counted these.
+    if (! group().jitted())
+        shadingsys().m_stat_empty_instances += nlayers - m_num_used_layers;
 
     initialize_llvm_group ();
 
@@ -1292,6 +1309,17 @@ BackendLLVM::run ()
                                  group().name(), m_llvm_local_mem/1024);
     }
 
+    if (jit_cache) {
+        // Function names carry group and instance ids, which differ from
+        // run to run. Name them by layer so the IR of identical groups is
+        // identical; each group has a module of its own.
+        ll.func_name (init_func, "osl_cached_group_init");
+        for (int layer = 0; layer < nlayers; ++layer)
+            if (funcs[layer])
+                ll.func_name (funcs[layer],
+                              Strutil::sprintf ("osl_cached_layer_%d", layer));
+    }
+
     // The module contains tons of "library" functions that our generated IR
     // might call. But probably not. We don't want to incur the overhead of
     // fully compiling those, so we want to get rid of all functions not
@@ -1340,6 +1368,18 @@ BackendLLVM::run ()
         ll.prune_and_internalize_module(external_functions);
     }
 
+    bool jit_cache_hit = false;
+    if (jit_cache) {
+        if (ll.module_has_absolute_addresses ()) {
+            if (! group().jitted())
+                shadingsys().m_stat_jit_cache_uncacheable += 1;
+        } else {
+            std::string key = Strutil::sprintf ("OSL %s",
+                                                OSL_LIBRARY_VERSION_STRING);
+            jit_cache_hit = ll.use_object_cache (jit_cache.get(), key);
+        }
+    }
+
     // Debug code to dump the pre-optimized bitcode to a file
     if (llvm_debug() >= 2 || shadingsys().llvm_output_bitcode()) {
         // Make a safe group name that doesn't have "/" in it! Also beware
@@ -1360,8 +1400,9 @@ BackendLLVM::run ()
         }
     }
 
-    // Optimize the LLVM IR unless it's a do-nothing group.
-    if (! group().does_nothing())
+    // Optimize the LLVM IR unless it's a do-nothing group, or its object
+    // code comes from the JIT cache.
+    if (! group().does_nothing() && ! jit_cache_hit)
         ll.do_optimize();
 
     m_stat_llvm_opt_time += timer.lap();
@@ -1427,12 +1468,20 @@ BackendLLVM::run ()
     else {
         // Force the JIT to happen now and retrieve the JITed function pointers
         // for the initialization and all public entry points.
-        group().llvm_compiled_init ((RunLLVMGroupFunc) ll.getPointerToFunction(init_func));
+        RunLLVMGroupFunc init = (RunLLVMGroupFunc) ll.getPointerToFunction(init_func);
+        std::vector<RunLLVMGroupFunc> entries (nlayers, nullptr);
         for (int layer = 0; layer < nlayers; ++layer) {
             llvm::Function* f = funcs[layer];
             if (f && group().is_entry_layer (layer))
-                group().llvm_compiled_layer (layer, (RunLLVMGroupFunc) ll.getPointerToFunction(f));
+                entries[layer] = (RunLLVMGroupFunc) ll.getPointerToFunction(f);
         }
+        // The group may already be running quick-JITed code on other
+        // threads (async_jit). Each pointer is swapped with a single
+        // release store, so the new code is visible before it is.
+        for (int layer = 0; layer < nlayers; ++layer)
+            if (entries[layer])
+                group().llvm_compiled_layer (layer, entries[layer]);
+        group().llvm_compiled_init (init);
         if (group().num_entry_layers())
             group().llvm_compiled_version (NULL);
         else
@@ -3,9 +3,15 @@
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
 
+#include <atomic>
 #include <memory>
 #include <cinttypes>
+#include <sstream>
+#include <unordered_map>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/hash.h>
+#include <OpenImageIO/strutil.h>
 #include <OpenImageIO/thread.h>
 #include <boost/thread/tss.hpp>   /* for thread_specific_ptr */
 
@@ -54,6 +60,7 @@
 #include <llvm/ExecutionEngine/GenericValue.h>
 #include <llvm/ExecutionEngine/JITEventListener.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/PrettyStackTrace.h>
@@ -212,6 +219,58 @@ LLVM_Util::total_jit_memory_held ()
 
 
 
+// Relocatable ustring constants (see LLVM_Util::relocatable_strings) are
+// loads from an external global named osl_ustr_<hex of the characters>.
+// When code referring to one is loaded, the name is bound to a slot
+// holding the ustring's address in this process. Slots are never freed,
+// since JITed code outlives any LLVM_Util.
+static const char relocatable_ustring_prefix[] = "osl_ustr_";
+static OIIO::spin_mutex ustring_slots_mutex;
+static std::unordered_map<ustring, std::unique_ptr<const char*>,
+                          OIIO::ustringHash> ustring_slots;
+
+static std::string
+relocatable_ustring_name (ustring s)
+{
+    std::string name = relocatable_ustring_prefix;
+    for (unsigned char c : s.string())
+        name += OIIO::Strutil::sprintf ("%02x", c);
+    return name;
+}
+
+static int
+hex_digit (char c)
+{
+    return c >= '0' && c <= '9' ? c - '0'
+         : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Address of the slot for the symbol name, or 0 if it does not name a
+// relocatable ustring.
+static uint64_t
+relocatable_ustring_address (string_view name)
+{
+    OIIO::Strutil::parse_char (name, '_', false);  // Mach-O global prefix
+    if (! OIIO::Strutil::parse_prefix (name, relocatable_ustring_prefix)
+        || name.size() % 2)
+        return 0;
+    std::string chars;
+    for (size_t i = 0; i < name.size(); i += 2) {
+        int hi = hex_digit (name[i]), lo = hex_digit (name[i+1]);
+        if (hi < 0 || lo < 0)
+            return 0;
+        chars += char (hi * 16 + lo);
+    }
+    ustring s (chars);
+    OIIO::spin_lock lock (ustring_slots_mutex);
+    std::unique_ptr<const char*>& slot = ustring_slots[s];
+    if (! slot)
+        slot.reset (new const char* (s.c_str()));
+    return uint64_t (slot.get());
+}
+
+
+
 /// MemoryManager - Create a shell that passes on requests
 /// to a real LLVMMemoryManager underneath, but can be retained after the
 /// dummy is destroyed.  Also, we don't pass along any deallocations.
@@ -245,6 +304,9 @@ public:
     }
     
     llvm::JITSymbol findSymbol(const std::string &Name) override {
+        uint64_t ustr = relocatable_ustring_address (Name);
+        if (ustr)
+            return llvm::JITSymbol (ustr, llvm::JITSymbolFlags::Exported);
         return mm->findSymbol(Name);
     }
 
@@ -281,7 +343,8 @@ public:
     }
 
     uint64_t getSymbolAddress(const std::string &Name) override {
-        return mm->getSymbolAddress (Name);
+        uint64_t ustr = relocatable_ustring_address (Name);
+        return ustr ? ustr : mm->getSymbolAddress (Name);
     }
 
     bool finalizeMemory(std::string *ErrMsg) override {
@@ -1641,6 +1704,220 @@ LLVM_Util::InstallLazyFunctionCreator (void* (*P)(const std::string &))
 
 
 
+// An entry is the magic line, the key length and the key, followed by
+// the object file exactly as MCJIT produced it.
+static const char object_cache_magic[] = "OSL JIT object cache 1\n";
+
+class LLVM_Util::ObjectCache::Impl final : public llvm::ObjectCache {
+public:
+    Impl (string_view dir) : m_dir(dir) {}
+
+    /// Read the entry for key, if there is one, and hold on to it until
+    /// the engine compiling the module with that identifier asks for it.
+    bool fetch (const std::string& key);
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject (const llvm::Module* M) override;
+
+    void notifyObjectCompiled (const llvm::Module* M,
+                               llvm::MemoryBufferRef obj) override;
+
+    std::string m_dir;
+    std::atomic<long long> m_hits { 0 };
+    std::atomic<long long> m_misses { 0 };
+    std::atomic<long long> m_bytes_read { 0 };
+    std::atomic<long long> m_bytes_written { 0 };
+    std::atomic<long long> m_write_failures { 0 };
+
+private:
+    std::string path (const std::string& key) const {
+        OIIO::SHA1 sha (key.data(), key.size());
+        return m_dir + "/" + sha.digest() + ".oslobj";
+    }
+    static std::string header (const std::string& key) {
+        return OIIO::Strutil::sprintf ("%s%d\n", object_cache_magic,
+                                       key.size()) + key;
+    }
+
+    OIIO::spin_mutex m_mutex;
+    // Identical groups may be compiled by several threads at once.
+    std::unordered_multimap<std::string,
+                            std::unique_ptr<llvm::MemoryBuffer>> m_fetched;
+};
+
+
+
+bool
+LLVM_Util::ObjectCache::Impl::fetch (const std::string& key)
+{
+    std::string entry;
+    OIIO::ifstream in;
+    OIIO::Filesystem::open (in, path(key), std::ios::in | std::ios::binary);
+    if (in) {
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        entry = contents.str();
+    }
+    std::string head = header (key);
+    if (entry.size() <= head.size() || entry.compare (0, head.size(), head)) {
+        // Missing, truncated, or a different key with the same hash
+        ++m_misses;
+        return false;
+    }
+    llvm::StringRef object (entry.data() + head.size(),
+                            entry.size() - head.size());
+    std::unique_ptr<llvm::MemoryBuffer> buffer
+        = llvm::MemoryBuffer::getMemBufferCopy (object, "osl_jit_cache");
+    ++m_hits;
+    m_bytes_read += object.size();
+    OIIO::spin_lock lock (m_mutex);
+    m_fetched.emplace (key, std::move(buffer));
+    return true;
+}
+
+
+
+std::unique_ptr<llvm::MemoryBuffer>
+LLVM_Util::ObjectCache::Impl::getObject (const llvm::Module* M)
+{
+    OIIO::spin_lock lock (m_mutex);
+    auto found = m_fetched.find (M->getModuleIdentifier());
+    if (found == m_fetched.end())
+        return nullptr;  // Not fetched: compile, then notifyObjectCompiled
+    std::unique_ptr<llvm::MemoryBuffer> buffer = std::move(found->second);
+    m_fetched.erase (found);
+    return buffer;
+}
+
+
+
+void
+LLVM_Util::ObjectCache::Impl::notifyObjectCompiled (const llvm::Module* M,
+                                                    llvm::MemoryBufferRef obj)
+{
+    const std::string& key = M->getModuleIdentifier();
+    std::string err;
+    if (! OIIO::Filesystem::is_directory (m_dir) &&
+        ! OIIO::Filesystem::create_directory (m_dir, err)) {
+        ++m_write_failures;
+        return;
+    }
+    // Write to a unique temporary and rename it into place, so that no
+    // other process ever reads a partially written entry.
+    std::string filename = path (key);
+    std::string tmpname = OIIO::Filesystem::unique_path (filename + ".%%%%-%%%%-%%%%");
+    OIIO::ofstream out;
+    OIIO::Filesystem::open (out, tmpname, std::ios::out | std::ios::binary);
+    std::string head = header (key);
+    out.write (head.data(), head.size());
+    out.write (obj.getBufferStart(), obj.getBufferSize());
+    out.close ();
+    if (! out.good() || ! OIIO::Filesystem::rename (tmpname, filename, err)) {
+        OIIO::Filesystem::remove (tmpname, err);
+        ++m_write_failures;
+        return;
+    }
+    m_bytes_written += obj.getBufferSize();
+}
+
+
+
+LLVM_Util::ObjectCache::ObjectCache (string_view directory)
+    : m_impl(new Impl(directory))
+{
+}
+
+
+
+LLVM_Util::ObjectCache::~ObjectCache ()
+{
+}
+
+
+
+const std::string&
+LLVM_Util::ObjectCache::directory () const
+{
+    return m_impl->m_dir;
+}
+
+
+
+long long LLVM_Util::ObjectCache::hits () const { return m_impl->m_hits; }
+long long LLVM_Util::ObjectCache::misses () const { return m_impl->m_misses; }
+long long LLVM_Util::ObjectCache::bytes_read () const { return m_impl->m_bytes_read; }
+long long LLVM_Util::ObjectCache::bytes_written () const { return m_impl->m_bytes_written; }
+long long LLVM_Util::ObjectCache::write_failures () const { return m_impl->m_write_failures; }
+
+
+
+bool
+LLVM_Util::use_object_cache (ObjectCache* cache, const std::string& key)
+{
+    OSL_ASSERT (cache && m_llvm_exec);
+    // The unoptimized IR is part of the key. It captures every decision
+    // made while specializing the group (options, renderer queries folded
+    // to constants) that the caller's key could miss.
+    std::string bitcode;
+    llvm::raw_string_ostream bitcode_stream (bitcode);
+    llvm::WriteBitcodeToFile (*module(), bitcode_stream);
+    bitcode_stream.flush ();
+    OIIO::SHA1 ir (bitcode.data(), bitcode.size());
+    std::string fullkey = OIIO::Strutil::sprintf (
+        "%s\nLLVM %s, %s, fma %d, aggressive %d, width %d\nIR %s\n",
+        key, OSL_LLVM_FULL_VERSION, target_isa_name(m_target_isa),
+        jit_fma(), jit_aggressive(), m_vector_width, ir.digest());
+    module()->setModuleIdentifier (fullkey);
+    m_llvm_exec->setObjectCache (cache->m_impl.get());
+    return cache->m_impl->fetch (fullkey);
+}
+
+
+
+// Does the constant bake in a nonzero address, like the inttoptr
+// constants made by constant_ptr() and constant(ustring)?
+static bool
+constant_has_address (const llvm::Constant* c,
+                      std::unordered_set<const llvm::Constant*>& visited)
+{
+    if (llvm::isa<llvm::GlobalValue>(c) || ! visited.insert(c).second)
+        return false;
+    auto expr = llvm::dyn_cast<llvm::ConstantExpr>(c);
+    if (expr && expr->getOpcode() == llvm::Instruction::IntToPtr) {
+        auto from = llvm::cast<llvm::Constant>(expr->getOperand(0));
+        if (! from->isNullValue() && ! llvm::isa<llvm::ConstantExpr>(from))
+            return true;
+    }
+    for (const llvm::Use& op : c->operands()) {
+        auto opc = llvm::dyn_cast<llvm::Constant>(op.get());
+        if (opc && constant_has_address (opc, visited))
+            return true;
+    }
+    return false;
+}
+
+
+
+bool
+LLVM_Util::module_has_absolute_addresses ()
+{
+    std::unordered_set<const llvm::Constant*> visited;
+    for (const llvm::GlobalVariable& g : module()->globals())
+        if (g.hasInitializer() &&
+            constant_has_address (g.getInitializer(), visited))
+            return true;
+    for (const llvm::Function& f : *module())
+        for (const llvm::BasicBlock& bb : f)
+            for (const llvm::Instruction& inst : bb)
+                for (const llvm::Use& op : inst.operands()) {
+                    auto c = llvm::dyn_cast<llvm::Constant>(op.get());
+                    if (c && constant_has_address (c, visited))
+                        return true;
+                }
+    return false;
+}
+
+
+
 void
 LLVM_Util::setup_optimization_passes (int optlevel, bool target_host)
 {
@@ -2710,6 +2987,19 @@ LLVM_Util::constant_ptr (void *p, llvm::PointerType *type)
 llvm::Value *
 LLVM_Util::constant (ustring s)
 {
+    if (m_relocatable_strings && s.c_str() && builder().GetInsertBlock()) {
+        // Load the address from a global that is bound when the code is
+        // loaded. The load goes at the top of the function, so that it
+        // dominates every use, wherever the value ends up being used.
+        llvm::Constant* global
+            = module()->getOrInsertGlobal (relocatable_ustring_name(s),
+                                           type_string());
+        llvm::cast<llvm::GlobalVariable>(global)->setConstant (true);
+        llvm::BasicBlock& entry
+            = builder().GetInsertBlock()->getParent()->getEntryBlock();
+        llvm::IRBuilder<> top (&entry, entry.getFirstInsertionPt());
+        return top.CreateLoad (type_string(), global, "ustring constant");
+    }
     // Create a const size_t with the ustring contents
     size_t bits = sizeof(size_t)*8;
     llvm::Value *str = llvm::ConstantInt::get (context(),
@@ -5517,6 +5807,14 @@ LLVM_Util::func_name (llvm::Function *func)
 
 
 
+void
+LLVM_Util::func_name (llvm::Function *func, const std::string &name)
+{
+    func->setName (name);
+}
+
+
+
 llvm::DIFile *
 LLVM_Util::getOrCreateDebugFileFor(const std::string &file_name)
 {
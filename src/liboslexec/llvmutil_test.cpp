@@ -6,6 +6,7 @@
 #include <OpenImageIO/ustring.h>
 
 #include <OpenImageIO/argparse.h>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/unittest.h>
@@ -214,6 +215,72 @@ test_big_func (bool do_print=false)
 
 
 
+// JIT the following function through the object cache, and call it:
+//      const char* mystring () { return ustring("cached string").c_str(); }
+// Set hit to whether the object code was loaded from the cache.
+static const char*
+jit_cached_string_func (OSL::pvt::LLVM_Util::ObjectCache &cache, bool &hit)
+{
+    OSL::pvt::LLVM_Util::PerThreadInfo pti;
+    OSL::pvt::LLVM_Util ll(pti);
+    ll.relocatable_strings (true);
+
+    llvm::Function *func = ll.make_function ("mystring", false,
+                                             (llvm::Type *)ll.type_string());
+    ll.current_function (func);
+    ll.op_return (ll.constant (OIIO::ustring("cached string")));
+    OIIO_CHECK_ASSERT (! ll.module_has_absolute_addresses ());
+
+    ll.execengine ();  // the cache is attached to the engine
+    hit = ll.use_object_cache (&cache, "llvmutil_test");
+    if (! hit) {
+        ll.setup_optimization_passes (0);
+        ll.do_optimize ();
+    }
+    typedef const char* (*StringFunc)();
+    StringFunc mystring = (StringFunc) ll.getPointerToFunction (func);
+    return mystring ();
+}
+
+
+
+void
+test_object_cache ()
+{
+    std::string dir = OIIO::Filesystem::unique_path (
+        OIIO::Filesystem::temp_directory_path() + "/llvmutil_test_%%%%-%%%%");
+    OSL::pvt::LLVM_Util::ObjectCache cache (dir);
+    const char *expected = OIIO::ustring("cached string").c_str();
+
+    // The first JIT compiles and stores, the second only loads, and the
+    // string is bound to this process's copy either way.
+    bool hit = true;
+    OIIO_CHECK_EQUAL (jit_cached_string_func (cache, hit), expected);
+    OIIO_CHECK_ASSERT (! hit);
+    OIIO_CHECK_EQUAL (jit_cached_string_func (cache, hit), expected);
+    OIIO_CHECK_ASSERT (hit);
+    OIIO_CHECK_EQUAL (cache.hits(), 1);
+    OIIO_CHECK_EQUAL (cache.misses(), 1);
+    OIIO_CHECK_ASSERT (cache.bytes_written() > 0);
+    OIIO_CHECK_EQUAL (cache.bytes_read(), cache.bytes_written());
+
+    // Raw pointers make the code valid in this process only.
+    {
+        OSL::pvt::LLVM_Util::PerThreadInfo pti;
+        OSL::pvt::LLVM_Util ll(pti);
+        llvm::Function *func = ll.make_function ("myptr", false,
+                                                 (llvm::Type *)ll.type_void_ptr());
+        ll.current_function (func);
+        ll.op_return (ll.constant_ptr (&cache));
+        OIIO_CHECK_ASSERT (ll.module_has_absolute_addresses ());
+    }
+
+    std::string err;
+    OIIO::Filesystem::remove_all (dir, err);
+}
+
+
+
 void
 test_isa_features()
 {
@@ -249,6 +316,7 @@ main (int argc, char *argv[])
     // Test simple functions
     test_int_func();
     test_triple_func();
+    test_object_cache();
 
     if (memtest) {
         for (int i = 0; i < memtest; ++i) {
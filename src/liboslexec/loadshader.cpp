@@ -36,6 +36,8 @@ public:
     virtual ~OSOReaderToMaster () { }
     virtual bool parse_file (const std::string &filename);
     virtual bool parse_memory (const std::string &oso);
+    virtual bool parse_binary (string_view oso);
+    virtual bool parse_binary_file (const std::string &filename);
     virtual void version (const char *specid, int major, int minor);
     virtual void shader (const char *shadertype, const char *name);
     virtual void symbol (SymType symtype, TypeSpec typespec, const char *name);
@@ -102,6 +104,32 @@ OSOReaderToMaster::parse_memory (const std::string &oso)
 
 
 
+bool
+OSOReaderToMaster::parse_binary (string_view oso)
+{
+    m_master->m_osofilename = "<none>";
+    m_master->m_maincodebegin = 0;
+    m_master->m_maincodeend = 0;
+    m_codesection.clear ();
+    m_codesym = -1;
+    return OSOReader::parse_binary (oso) && ! m_errors;
+}
+
+
+
+bool
+OSOReaderToMaster::parse_binary_file (const std::string &filename)
+{
+    m_master->m_osofilename = filename;
+    m_master->m_maincodebegin = 0;
+    m_master->m_maincodeend = 0;
+    m_codesection.clear ();
+    m_codesym = -1;
+    return OSOReader::parse_binary_file (filename) && ! m_errors;
+}
+
+
+
 
 void
 OSOReaderToMaster::version (const char* /*specid*/, int major, int minor)
@@ -535,44 +563,96 @@ ShadingSystemImpl::loadshader (string_view cname)
 {
     if (Strutil::ends_with (cname, ".oso"))
         cname.remove_suffix (4);   // strip superfluous .oso
+    else if (Strutil::ends_with (cname, ".osob"))
+        cname.remove_suffix (5);   // ... or .osob
     if (! cname.size()) {
         error ("Attempt to load shader with empty name \"\".");
         return NULL;
     }
     ++m_stat_shaders_requested;
     ustring name (cname);
-    lock_guard guard (m_mutex);  // Thread safety
-    ShaderNameMap::const_iterator found = m_shader_masters.find (name);
-    if (found != m_shader_masters.end()) {
-        // if (debug())
-        //     infof("Found %s in shader_masters", name);
-        // Already loaded this shader, return its reference
-        return (*found).second;
+
+    // The first thread to ask for a shader claims it by entering a future
+    // for it in the map, and loads it with no lock held. Any other thread
+    // asking for the same shader waits on that future; threads loading
+    // other shaders don't wait at all.
+    std::promise<ShaderMaster::ref> promise;
+    std::shared_future<ShaderMaster::ref> loading;
+    {
+        lock_guard guard (m_shader_masters_mutex);
+        ShaderNameMap::const_iterator found = m_shader_masters.find (name);
+        if (found != m_shader_masters.end())
+            loading = found->second;
+        else
+            m_shader_masters[name] = promise.get_future().share();
+    }
+    if (loading.valid()) {
+        // Already loaded this shader (or another thread is loading it),
+        // return its reference
+        if (loading.wait_for (std::chrono::seconds(0)) != std::future_status::ready) {
+            OIIO::Timer timer;
+            loading.wait ();
+            spin_lock lock (m_stat_mutex);
+            m_stat_master_wait_time += timer();
+        }
+        return loading.get ();
     }
 
-    // Not found in the map
+    // Not found in the map. Whatever happens, fulfil the promise, or the
+    // threads waiting on it would get std::broken_promise instead.
+    ShaderMaster::ref r;
+    try {
+        r = load_master_file (name);
+    } catch (...) {
+        promise.set_exception (std::current_exception());
+        throw;
+    }
+    promise.set_value (r);
+    return r;
+}
+
+
+
+ShaderMaster::ref
+ShadingSystemImpl::load_master_file (ustring name)
+{
+    std::vector<std::string> searchpath_dirs;
+    {
+        lock_guard guard (m_mutex);  // the searchpath may change under us
+        searchpath_dirs = m_searchpath_dirs;
+    }
     OSOReaderToMaster oso (*this);
-    bool testcwd = m_searchpath_dirs.empty();  // test "." if there's no searchpath
+    bool testcwd = searchpath_dirs.empty();  // test "." if there's no searchpath
     std::string filename = OIIO::Filesystem::searchpath_find (name.string() + ".oso",
-                                                        m_searchpath_dirs,
+                                                        searchpath_dirs,
                                                         testcwd);
+    // Prefer the binary form (oslc -binary-oso) written next to the .oso,
+    // if it was made from the .oso as it is now (it records the size and
+    // hash of its text), and take a lone binary if there is no .oso at
+    // all. Reading and hashing the text is still far cheaper than lexing
+    // it.
+    std::string binfilename = filename.size() ? filename + "b"
+        : OIIO::Filesystem::searchpath_find (name.string() + ".osob",
+                                             searchpath_dirs, testcwd);
+    bool binary = false;
+    if (OIIO::Filesystem::exists (binfilename)) {
+        std::string text;
+        binary = filename.empty()
+            || (OIIO::Filesystem::read_text_file (filename, text)
+                && OSOReader::binary_file_made_from (binfilename, text));
+    }
+    if (binary)
+        filename = binfilename;
     if (filename.empty ()) {
         errorf("No .oso file could be found for shader \"%s\"", name);
         return NULL;
     }
     OIIO::Timer timer;
-    bool ok = oso.parse_file (filename);
+    bool ok = binary ? oso.parse_binary_file (filename)
+                     : oso.parse_file (filename);
     ShaderMaster::ref r = ok ? oso.master() : nullptr;
-    m_shader_masters[name] = r;
-    double loadtime = timer();
-    {
-        spin_lock lock (m_stat_mutex);
-        m_stat_master_load_time += loadtime;
-    }
     if (ok) {
         ++m_stat_shaders_loaded;
-        infof("Loaded \"%s\" (took %s)", filename,
-              Strutil::timeintervalformat(loadtime, 2));
         OSL_DASSERT (r);
         r->resolve_syms ();
         // if (debug()) {
@@ -580,15 +660,29 @@ ShadingSystemImpl::loadshader (string_view cname)
         //     if (s.length())
         //         infof("%s", s);
         // }
-    } else {
-        errorf("Unable to read \"%s\"", filename);
     }
-
+    double loadtime = timer();
+    record_master_load_time (loadtime);
+    if (ok)
+        infof("Loaded \"%s\" (took %s)", filename,
+              Strutil::timeintervalformat(loadtime, 2));
+    else
+        errorf("Unable to read \"%s\"", filename);
     return r;
 }
 
 
 
+void
+ShadingSystemImpl::record_master_load_time (double loadtime)
+{
+    spin_lock lock (m_stat_mutex);
+    m_stat_master_load_time += loadtime;
+    m_stat_master_load_time_thread[std::this_thread::get_id()] += loadtime;
+}
+
+
+
 bool
 ShadingSystemImpl::LoadMemoryCompiledShader (string_view shadername,
                                              string_view buffer)
@@ -602,40 +696,53 @@ ShadingSystemImpl::LoadMemoryCompiledShader (string_view shadername,
         return false;
     }
 
+    // Claim the name as loadshader does, so that requests for it wait for
+    // this master rather than look for it on disk.
     ustring name (shadername);
-    lock_guard guard (m_mutex);  // Thread safety
-    ShaderNameMap::const_iterator found = m_shader_masters.find (name);
-    if (found != m_shader_masters.end() && ! allow_shader_replacement()) {
-        if (debug())
-            infof("Preload shader %s already exists in shader_masters", name);
-        return false;
+    std::promise<ShaderMaster::ref> promise;
+    {
+        lock_guard guard (m_shader_masters_mutex);
+        ShaderNameMap::const_iterator found = m_shader_masters.find (name);
+        if (found != m_shader_masters.end() && ! allow_shader_replacement()) {
+            if (debug())
+                infof("Preload shader %s already exists in shader_masters", name);
+            return false;
+        }
+        m_shader_masters[name] = promise.get_future().share();
     }
 
     // Not found in the map
     OSOReaderToMaster reader (*this);
     OIIO::Timer timer;
-    bool ok = reader.parse_memory (buffer);
-    ShaderMaster::ref r = ok ? reader.master() : nullptr;
-    m_shader_masters[name] = r;
-    double loadtime = timer();
-    {
-        spin_lock lock (m_stat_mutex);
-        m_stat_master_load_time += loadtime;
+    bool ok = false;
+    ShaderMaster::ref r;
+    try {
+        ok = OSOReader::is_binary (buffer) ? reader.parse_binary (buffer)
+                                           : reader.parse_memory (buffer);
+        r = ok ? reader.master() : nullptr;
+        if (ok) {
+            ++m_stat_shaders_loaded;
+            OSL_DASSERT (r);
+            r->resolve_syms ();
+            // if (debug()) {
+            //     std::string s = r->print ();
+            //     if (s.length())
+            //         infof ("%s", s);
+            // }
+        }
+    } catch (...) {
+        // Don't leave threads waiting on this name with a broken promise
+        promise.set_exception (std::current_exception());
+        throw;
     }
-    if (ok) {
-        ++m_stat_shaders_loaded;
+    promise.set_value (r);
+    double loadtime = timer();
+    record_master_load_time (loadtime);
+    if (ok)
         infof("Loaded \"%s\" (took %s)", shadername,
               Strutil::timeintervalformat(loadtime, 2));
-        OSL_DASSERT (r);
-        r->resolve_syms ();
-        // if (debug()) {
-        //     std::string s = r->print ();
-        //     if (s.length())
-        //         infof ("%s", s);
-        // }
-    } else {
+    else
         errorf("Unable to parse preloaded shader \"%s\"", shadername);
-    }
 
     return ok;
 }
@@ -0,0 +1,112 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Build wide synthetic shader groups made of many identical copies of a
+// small network, and check how merge_instances collapses them (and time it
+// with --bench).
+
+#include <algorithm>
+#include <vector>
+
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+
+#include "testbench.h"
+
+using namespace OSL;
+
+
+static std::vector<int> layer_counts { 250, 500, 1000, 2000 };
+static int chain_length = 10;   // at least 2
+static int ntrials = testbench_workload (3, 3);
+
+
+
+static void
+getargs (int argc, char *argv[])
+{
+    std::string counts;
+    testbench_getargs (argc, argv, "mergeinstances_test",
+                       "--layers %s", &counts,
+                           "Comma-separated layer counts of the groups to build",
+                       "--chain %d", &chain_length,
+                           OIIO::Strutil::sprintf("Layers per copy of the network (default: %d)", chain_length).c_str(),
+                       "--trials %d", &ntrials, "Number of trials");
+    if (counts.size()) {
+        layer_counts.clear ();
+        OIIO::Strutil::extract_from_list_string (layer_counts, counts);
+    }
+}
+
+
+
+// Build a group of ncopies copies of a chain of chain_length layers, in
+// which each layer feeds the next, plus a final entry layer fed by the
+// last chain. Each layer of a later copy duplicates the one in the first
+// copy, but only once the layers upstream of it have been merged. The
+// ends of the chains that feed nothing are unused and never merged.
+// Return the time spent merging, and set merges to the number of
+// instances merged away.
+static double
+build_group (ShadingSystem &ss, int ncopies, int &merges)
+{
+    float merge_time_before = 0.0f, merge_time_after = 0.0f;
+    int merged_before = 0, merged_after = 0;
+    ss.getattribute ("stat:inst_merge_time", TypeDesc::FLOAT, &merge_time_before);
+    ss.getattribute ("stat:merged_inst", TypeDesc::INT, &merged_before);
+
+    ShaderGroupRef group = ss.ShaderGroupBegin ();
+    std::string prev;
+    for (int copy = 0;  copy < ncopies;  ++copy) {
+        for (int k = 0;  k < chain_length;  ++k) {
+            std::string layer = OIIO::Strutil::sprintf ("c%d_%d", copy, k);
+            ss.Parameter (*group, "scale", float(k + 1));
+            ss.Shader (*group, "surface", "chainnode", layer);
+            if (k > 0)
+                ss.ConnectShaders (*group, prev, "out", layer, "in");
+            prev = layer;
+        }
+    }
+    ss.Shader (*group, "surface", "chainnode", "entry");
+    ss.ConnectShaders (*group, prev, "out", "entry", "in");
+    ss.ShaderGroupEnd (*group);
+
+    ss.getattribute ("stat:inst_merge_time", TypeDesc::FLOAT, &merge_time_after);
+    ss.getattribute ("stat:merged_inst", TypeDesc::INT, &merged_after);
+    merges = merged_after - merged_before;
+    return merge_time_after - merge_time_before;
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+    getargs (argc, argv);
+
+    RendererServices renderer;
+    ShadingSystem ss (&renderer);
+    ss.attribute ("opt_merge_instances", 2);  // merge at ShaderGroupEnd
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("chainnode", chainnode_oso));
+
+    testbench_report ("  layers    merged    merge time\n");
+    for (int nlayers : layer_counts) {
+        int ncopies = std::max (1, nlayers / chain_length);
+        double best = 0.0;
+        for (int t = 0;  t < std::max (ntrials, 1);  ++t) {
+            int merges = 0;
+            double time = build_group (ss, ncopies, merges);
+            OIIO_CHECK_EQUAL (merges, (ncopies - 1) * (chain_length - 1));
+            best = t ? std::min (best, time) : time;
+        }
+        testbench_report ("  %6d  %8d  %9.2f ms\n",
+                          ncopies * chain_length + 1,
+                          (ncopies - 1) * (chain_length - 1), best * 1000.0);
+    }
+
+    return unit_test_failures;
+}
@@ -0,0 +1,132 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Check the hashed MessageList lookup against walking the list, and time
+// the two (with --bench) on shades that set and then get a number of
+// messages.
+
+#include <vector>
+
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/unittest.h>
+
+#include "oslexec_pvt.h"
+#include "testbench.h"
+
+using namespace OSL;
+using namespace OSL::pvt;
+
+
+static std::vector<int> message_counts { 4, 32, 128 };
+static int iterations = testbench_workload (20000, 10);
+
+
+static void
+getargs (int argc, char *argv[])
+{
+    std::string counts;
+    testbench_getargs (argc, argv, "messagelist_test",
+                       "--messages %s", &counts,
+                           "Comma-separated message counts per shade",
+                       "--iters %d", &iterations,
+                           OIIO::Strutil::sprintf("Number of timed shades (default: %d)", iterations).c_str());
+    if (counts.size()) {
+        message_counts.clear ();
+        OIIO::Strutil::extract_from_list_string (message_counts, counts);
+    }
+}
+
+
+
+static std::vector<ustring>
+make_names (int n, const char *prefix)
+{
+    std::vector<ustring> names;
+    for (int i = 0;  i < n;  ++i)
+        names.emplace_back (OIIO::Strutil::sprintf ("%s%d", prefix, i));
+    return names;
+}
+
+
+
+// Both lookups find the same messages, before and after clearing, and
+// including more messages than the table can hold.
+static void
+test_lookup ()
+{
+    MessageList messages;
+    for (int n : { 1, 4, 32, 128, 3000 }) {
+        std::vector<ustring> names = make_names (n, "msg");
+        std::vector<ustring> missing = make_names (n, "nomsg");
+        for (int pass = 0;  pass < 2;  ++pass) {
+            messages.clear ();
+            for (int i = 0;  i < n;  ++i) {
+                float val = float(i);
+                messages.add (names[i], i % 3 ? &val : nullptr, TypeDesc::FLOAT,
+                              0, ustring("test.osl"), i);
+            }
+            for (int i = 0;  i < n;  ++i) {
+                const Message *m = messages.find (names[i]);
+                OIIO_CHECK_ASSERT (m && m == messages.find_in_list (names[i]));
+                OIIO_CHECK_ASSERT (m && m->sourceline == i);
+                OIIO_CHECK_ASSERT (messages.find (missing[i]) == nullptr);
+            }
+        }
+    }
+    messages.clear ();
+    OIIO_CHECK_ASSERT (messages.find (ustring("msg0")) == nullptr);
+}
+
+
+
+// A shade sets n messages and then gets each of them, as a network of
+// layers passing messages along would.
+template<bool Hashed>
+static double
+time_shades (const std::vector<ustring> &names)
+{
+    MessageList messages;
+    float val = 1.0f;
+    double sum = 0.0;
+    OIIO::Timer timer;
+    for (int s = 0;  s < iterations;  ++s) {
+        messages.clear ();
+        for (auto&& name : names) {
+            const Message *m = Hashed ? messages.find (name)
+                                      : messages.find_in_list (name);
+            if (! m)
+                messages.add (name, &val, TypeDesc::FLOAT, 0, ustring(), 0);
+        }
+        for (auto&& name : names) {
+            const Message *m = Hashed ? messages.find (name)
+                                      : messages.find_in_list (name);
+            sum += *(const float *)m->data;
+        }
+    }
+    double time = timer();
+    OIIO_CHECK_EQUAL (sum, double(iterations) * names.size());
+    return time;
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+    getargs (argc, argv);
+
+    test_lookup ();
+
+    testbench_report ("  messages      list      hashed   (ns per lookup)\n");
+    for (int n : message_counts) {
+        std::vector<ustring> names = make_names (n, "message");
+        double lookups = 2.0 * n * std::max (iterations, 1);
+        double list = time_shades<false> (names);
+        double hashed = time_shades<true> (names);
+        testbench_report ("  %8d  %8.2f  %10.2f\n", n,
+                          1.0e9 * list / lookups, 1.0e9 * hashed / lookups);
+    }
+
+    return unit_test_failures;
+}
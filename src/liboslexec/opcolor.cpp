@@ -776,6 +776,19 @@ ColorSystem::blackbody_rgb (float T)
 
 
 
+OSL_HOSTDEVICE Color3
+ColorSystem::wavelength_rgb (float lambda_nm)
+{
+    Color3 rgb = XYZ_to_RGB (wavelength_color_XYZ (lambda_nm));
+//    constrain_rgb (rgb);
+    rgb *= 1.0/2.52;    // Empirical scale from lg to make all comps <= 1
+//    norm_rgb (rgb);
+    clamp_zero (rgb);
+    return rgb;
+}
+
+
+
 } // namespace pvt
 
 
@@ -791,12 +804,7 @@ OSL_SHADEOP OSL_HOSTDEVICE void osl_blackbody_vf (void *sg, void *out, float tem
 OSL_SHADEOP OSL_HOSTDEVICE void osl_wavelength_color_vf (void *sg, void *out, float lambda)
 {
     ColorSystem &cs = op_color_colorsystem(sg);
-    Color3 rgb = cs.XYZ_to_RGB (wavelength_color_XYZ (lambda));
-//    constrain_rgb (rgb);
-    rgb *= 1.0/2.52;    // Empirical scale from lg to make all comps <= 1
-//    norm_rgb (rgb);
-    clamp_zero (rgb);
-    *(Color3 *)out = rgb;
+    *(Color3 *)out = cs.wavelength_rgb (lambda);
 }
 
 
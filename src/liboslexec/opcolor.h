@@ -65,6 +65,11 @@ public:
     OSL_HOSTDEVICE Color3
     blackbody_rgb (float T /*Kelvin*/);
 
+    /// Return the RGB in the current color space for a single wavelength
+    /// of light (in nm).
+    OSL_HOSTDEVICE Color3
+    wavelength_rgb (float lambda_nm);
+
     /// Set the current color space.
     OSL_HOSTDEVICE bool
     set_colorspace (StringParam colorspace);
@@ -17,6 +17,7 @@
 #include <OpenImageIO/fmath.h>
 
 #include "oslexec_pvt.h"
+#include "opstring.h"
 
 
 #define USTR(cstr) (*((ustring *)&cstr))
@@ -29,19 +30,7 @@ namespace pvt {
 OSL_SHADEOP const char *
 osl_concat_sss (const char *s, const char *t)
 {
-    size_t sl = USTR(s).length();
-    size_t tl = USTR(t).length();
-    size_t len = sl + tl;
-    std::unique_ptr<char[]> heap_buf;
-    char local_buf[256];
-    char* buf = local_buf;
-    if (len > sizeof(local_buf)) {
-        heap_buf.reset(new char[len]);
-        buf = heap_buf.get();
-    }
-    memcpy(buf     , s, sl);
-    memcpy(buf + sl, t, tl);
-    return ustring(buf, len).c_str();
+    return StringOps::concat (USTR(s), USTR(t)).c_str();
 }
 
 OSL_SHADEOP int
@@ -59,36 +48,20 @@ osl_hash_is (const char *s)
 OSL_SHADEOP int
 osl_getchar_isi (const char *str, int index)
 {
-    return str && unsigned(index) < USTR(str).length() ? str[index] : 0;
+    return StringOps::char_at (USTR(str), index);
 }
 
 
     OSL_SHADEOP int
 osl_startswith_iss (const char *s_, const char *substr_)
 {
-    ustring substr (USTR(substr_));
-    size_t substr_len = substr.length();
-    if (substr_len == 0)         // empty substr always matches
-        return 1;
-    ustring s (USTR(s_));
-    size_t s_len = s.length();
-    if (substr_len > s_len)      // longer needle than haystack can't
-        return 0;                // match (including empty s)
-    return strncmp (s.c_str(), substr.c_str(), substr_len) == 0;
+    return StringOps::startswith (USTR(s_), USTR(substr_));
 }
 
 OSL_SHADEOP int
 osl_endswith_iss (const char *s_, const char *substr_)
 {
-    ustring substr (USTR(substr_));
-    size_t substr_len = substr.length();
-    if (substr_len == 0)         // empty substr always matches
-        return 1;
-    ustring s (USTR(s_));
-    size_t s_len = s.length();
-    if (substr_len > s_len)      // longer needle than haystack can't
-        return 0;                // match (including empty s)
-    return strncmp (s.c_str()+s_len-substr_len, substr.c_str(), substr_len) == 0;
+    return StringOps::endswith (USTR(s_), USTR(substr_));
 }
 
 OSL_SHADEOP int
@@ -106,15 +79,7 @@ osl_stof_fs (const char *str)
 OSL_SHADEOP const char *
 osl_substr_ssii (const char *s_, int start, int length)
 {
-    ustring s (USTR(s_));
-    int slen = int (s.length());
-    if (slen == 0)
-        return NULL;  // No substring of empty string
-    int b = start;
-    if (b < 0)
-        b += slen;
-    b = Imath::clamp (b, 0, slen);
-    return ustring(s, b, Imath::clamp (length, 0, slen)).c_str();
+    return StringOps::substr (USTR(s_), start, length).c_str();
 }
 
 
@@ -124,29 +89,10 @@ osl_regex_impl (void *sg_, const char *subject_, void *results, int nresults,
 {
     ShaderGlobals *sg = (ShaderGlobals *)sg_;
     ShadingContext *ctx = sg->context;
-    const std::string &subject (ustring::from_unique(subject_).string());
-    match_results<std::string::const_iterator> mresults;
-    const regex &regex (ctx->find_regex (USTR(pattern)));
-    if (nresults > 0) {
-        std::string::const_iterator start = subject.begin();
-        int res = fullmatch ? regex_match (subject, mresults, regex)
-                            : regex_search (subject, mresults, regex);
-        int *m = (int *)results;
-        for (int r = 0;  r < nresults;  ++r) {
-            if (r/2 < (int)mresults.size()) {
-                if ((r & 1) == 0)
-                    m[r] = mresults[r/2].first - start;
-                else
-                    m[r] = mresults[r/2].second - start;
-            } else {
-                m[r] = USTR(pattern).length();
-            }
-        }
-        return res;
-    } else {
-        return fullmatch ? regex_match (subject, regex)
-                         : regex_search (subject, regex);
-    }
+    return StringOps::regex_impl (USTR(subject_),
+                                  ctx->find_regex (USTR(pattern)),
+                                  USTR(pattern), (int *)results, nresults,
+                                  fullmatch);
 }
 
 
@@ -224,13 +170,8 @@ OSL_SHADEOP int
 osl_split (const char *str, ustring *results, const char *sep,
            int maxsplit, int resultslen)
 {
-    maxsplit = OIIO::clamp (maxsplit, 0, resultslen);
-    std::vector<std::string> splits;
-    Strutil::split (USTR(str).string(), splits, USTR(sep).string(), maxsplit);
-    int n = std::min (maxsplit, (int)splits.size());
-    for (int i = 0;  i < n;  ++i)
-        results[i] = ustring(splits[i]);
-    return n;
+    return StringOps::split (USTR(str), results, USTR(sep), maxsplit,
+                             resultslen);
 }
 
 
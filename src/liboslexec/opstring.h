@@ -0,0 +1,148 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <OpenImageIO/fmath.h>
+#include <OpenImageIO/strutil.h>
+
+#include "oslexec_pvt.h"
+
+OSL_NAMESPACE_ENTER
+
+namespace pvt {
+
+// The string functions shared by the scalar shadeops (opstring.cpp) and
+// the batched ones (wide/wide_opstring.cpp), which call them once per
+// distinct set of arguments.  Kept in their own namespace to stay clear
+// of the many other concat/split/substr in scope.
+namespace StringOps {
+
+inline ustring
+concat (ustring s, ustring t)
+{
+    size_t sl = s.length();
+    size_t tl = t.length();
+    size_t len = sl + tl;
+    std::unique_ptr<char[]> heap_buf;
+    char local_buf[256];
+    char* buf = local_buf;
+    if (len > sizeof(local_buf)) {
+        heap_buf.reset(new char[len]);
+        buf = heap_buf.get();
+    }
+    memcpy(buf     , s.c_str(), sl);
+    memcpy(buf + sl, t.c_str(), tl);
+    return ustring(buf, len);
+}
+
+
+
+inline int
+char_at (ustring s, int index)
+{
+    return s.c_str() && unsigned(index) < s.length() ? s.c_str()[index] : 0;
+}
+
+
+
+inline int
+startswith (ustring s, ustring substr)
+{
+    size_t substr_len = substr.length();
+    if (substr_len == 0)         // empty substr always matches
+        return 1;
+    size_t s_len = s.length();
+    if (substr_len > s_len)      // longer needle than haystack can't
+        return 0;                // match (including empty s)
+    return strncmp (s.c_str(), substr.c_str(), substr_len) == 0;
+}
+
+
+
+inline int
+endswith (ustring s, ustring substr)
+{
+    size_t substr_len = substr.length();
+    if (substr_len == 0)         // empty substr always matches
+        return 1;
+    size_t s_len = s.length();
+    if (substr_len > s_len)      // longer needle than haystack can't
+        return 0;                // match (including empty s)
+    return strncmp (s.c_str()+s_len-substr_len, substr.c_str(), substr_len) == 0;
+}
+
+
+
+inline ustring
+substr (ustring s, int start, int length)
+{
+    int slen = int (s.length());
+    if (slen == 0)
+        return ustring();  // No substring of empty string
+    int b = start;
+    if (b < 0)
+        b += slen;
+    b = Imath::clamp (b, 0, slen);
+    return ustring(s, b, Imath::clamp (length, 0, slen));
+}
+
+
+
+// Match subject against an already compiled regex, filling in the
+// nresults match offsets (begin and end of each group; the length of the
+// pattern for groups that did not match).
+inline int
+regex_impl (ustring subject, const regex &regex, ustring pattern,
+            int *results, int nresults, int fullmatch)
+{
+    const std::string &subject_str (subject.string());
+    if (nresults > 0) {
+        match_results<std::string::const_iterator> mresults;
+        std::string::const_iterator start = subject_str.begin();
+        int res = fullmatch ? regex_match (subject_str, mresults, regex)
+                            : regex_search (subject_str, mresults, regex);
+        for (int r = 0;  r < nresults;  ++r) {
+            if (r/2 < (int)mresults.size()) {
+                if ((r & 1) == 0)
+                    results[r] = mresults[r/2].first - start;
+                else
+                    results[r] = mresults[r/2].second - start;
+            } else {
+                results[r] = pattern.length();
+            }
+        }
+        return res;
+    } else {
+        return fullmatch ? regex_match (subject_str, regex)
+                         : regex_search (subject_str, regex);
+    }
+}
+
+
+
+// Split str at sep into at most maxsplit (and resultslen) results,
+// returning how many there were.
+inline int
+split (ustring str, ustring *results, ustring sep, int maxsplit,
+       int resultslen)
+{
+    maxsplit = OIIO::clamp (maxsplit, 0, resultslen);
+    std::vector<std::string> splits;
+    Strutil::split (str.string(), splits, sep.string(), maxsplit);
+    int n = std::min (maxsplit, (int)splits.size());
+    for (int i = 0;  i < n;  ++i)
+        results[i] = ustring(splits[i]);
+    return n;
+}
+
+}  // namespace StringOps
+}  // namespace pvt
+
+OSL_NAMESPACE_EXIT
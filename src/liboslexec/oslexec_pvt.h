@@ -4,12 +4,20 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <stack>
 #include <map>
 #include <memory>
+#include <functional>
+#include <future>
 #include <list>
+#include <deque>
+#include <thread>
+#include <condition_variable>
 #include <set>
 #include <unordered_map>
 
@@ -367,6 +375,8 @@ public:
 
     int num_params () const { return m_lastparam - m_firstparam; }
 
+    int num_ops () const { return (int)m_ops.size(); }
+
     int raytype_queries () const { return m_raytype_queries; }
 
     bool range_checking() const { return m_range_checking; }
@@ -589,6 +599,10 @@ public:
 
     bool llvm_jit_fma() const { return m_llvm_jit_fma; }
     ustring llvm_jit_target () const { return m_llvm_jit_target; }
+    /// On-disk cache of JITed groups, or null if "llvm_jit_cache" is unset.
+    std::shared_ptr<LLVM_Util::ObjectCache> llvm_jit_cache () const {
+        return std::atomic_load (&m_llvm_jit_cache);
+    }
 
     ustring debug_groupname() const { return m_debug_groupname; }
     ustring debug_layername() const { return m_debug_layername; }
@@ -604,7 +618,12 @@ public:
     /// The group is set and won't be changed again; take advantage of
     /// this by optimizing the code knowing all our instance parameters
     /// (at least the ones that can't be overridden by the geometry).
-    void optimize_group (ShaderGroup &group, ShadingContext *ctx, bool do_jit);
+    /// If quick_jit is true (and async_jit is on), JIT with a minimal
+    /// pass pipeline and queue the group for full optimization in the
+    /// background; its code is swapped for the optimized code when that
+    /// is ready.
+    void optimize_group (ShaderGroup &group, ShadingContext *ctx, bool do_jit,
+                         bool quick_jit = false);
 
     /// After doing all optimization and code JIT, we can clean up by
     /// deleting the instances' code and arguments, and paring their
@@ -631,7 +650,7 @@ public:
 
     int raytype_bit (ustring name);
 
-    void optimize_all_groups (int nthreads=0, int mythread=0, int totalthreads=1, bool do_jit=true);
+    void optimize_all_groups (int nthreads=0, bool do_jit=true);
 
     typedef std::unordered_map<ustring,OpDescriptor,ustringHash> OpDescriptorMap;
 
@@ -677,7 +696,7 @@ public:
         /// Ensure that the group has been JITed.
         void jit_group (ShaderGroup &group, ShadingContext *ctx);
 
-        void jit_all_groups (int nthreads=0, int mythread=0, int totalthreads=1);
+        void jit_all_groups (int nthreads=0);
     };
 
     template<int WidthT>
@@ -688,6 +707,66 @@ public:
 private:
     void printstats () const;
 
+    /// Queue a quick-JITed group for optimized JIT by the async_jit
+    /// threads, starting them if needed.
+    void queue_async_jit (ShaderGroupRef group);
+
+    /// Take group off the async_jit queue, if it's there, and clear its
+    /// pending flag. The caller holds the group's lock.
+    void unqueue_async_jit (ShaderGroup &group);
+
+    /// Body of each async_jit thread: JIT queued groups at the full
+    /// optimization level and swap in their code, until shutdown.
+    void async_jit_worker ();
+
+    /// Append a layer to group, as Shader() does, without counting it in
+    /// the group stats.
+    bool add_layer (ShaderGroup& group, string_view shaderusage,
+                    string_view shadername, string_view layername);
+
+    /// Add the layers, parameters and connections described by groupspec
+    /// (see ShaderGroupBegin) to g. Only count the layers in the group
+    /// stats if count_stats is true.
+    bool parse_group_spec (ShaderGroup &g, string_view usage,
+                           string_view groupspec, bool count_stats);
+
+    /// The part of ShaderGroupEnd that prepares the layers: mark the
+    /// last one, merge instances early (opt_merge_instances >= 2) if
+    /// merge is true, and gather the raytype queries.
+    void finish_group_layers (ShaderGroup &group, bool merge);
+
+    /// Key of the group cache: the group's unoptimized serialization
+    /// (m_pristine_spec) plus the group settings that shape its code.
+    std::string group_cache_key (const ShaderGroup &group) const;
+
+    /// If the group cache holds code compiled for key, give it to group
+    /// and return true.
+    bool group_cache_find (const std::string &key, ShaderGroup &group);
+
+    /// Remember the compiled group under key, evicting the least recently
+    /// used entries beyond group_cache_size.
+    void group_cache_insert (const std::string &key, const ShaderGroup &group);
+
+    /// Make group the only user of its optimized layer, so that it can be
+    /// changed in place, if dropping the group's own entry under key is
+    /// enough. Return whether group now has the layer to itself.
+    bool group_cache_unshare (const std::string &key, ShaderGroup &group,
+                              int layer);
+
+    /// Drop the least recently used entries beyond group_cache_size.
+    void group_cache_trim ();
+
+    void group_cache_clear ();
+
+    /// Call compile(group, ctx) on every live shader group, using up to
+    /// nthreads workers (<= 0 means all hardware threads). Groups are
+    /// handed out most-ops-first from a shared cursor, so the expensive
+    /// ones start early and no worker idles while work remains. The
+    /// calling thread is worker 0; the others come from OIIO's default
+    /// thread pool.
+    void compile_all_groups (int nthreads,
+                             const std::function<void(ShaderGroup&,ShadingContext*)> &compile);
+
     /// Find the index of the named layer in the shader group.
     /// If found, return the index >= 0 and put a pointer to the instance
     /// in inst; if not found, return -1 and set inst to NULL.
@@ -721,6 +800,13 @@ private:
 
     void setup_op_descriptors ();
 
+    /// Find the named shader on the searchpath, and read and resolve its
+    /// master, with no lock held.
+    ShaderMaster::ref load_master_file (ustring name);
+
+    /// Add to the master load time, overall and for the calling thread.
+    void record_master_load_time (double loadtime);
+
     RendererServices *m_renderer;         ///< Renderer services
     TextureSystem *m_texturesys;          ///< Texture system
 
@@ -729,8 +815,12 @@ private:
     static const int m_errseenmax = 32;
     mutable mutex m_errmutex;
 
-    typedef std::map<ustring,ShaderMaster::ref> ShaderNameMap;
+    // A master is entered as a future when the first request for it
+    // starts loading it, and requests that come before it's ready wait
+    // on the future.  The mutex guards the map only, not the loading.
+    typedef std::map<ustring,std::shared_future<ShaderMaster::ref>> ShaderNameMap;
     ShaderNameMap m_shader_masters;       ///< name -> shader masters map
+    mutex m_shader_masters_mutex;         ///< Guards m_shader_masters
 
     ConstantPool<int> m_int_pool;
     ConstantPool<Float> m_float_pool;
@@ -759,6 +849,7 @@ private:
     bool m_unknown_coordsys_error;        ///< Error to use unknown xform name?
     bool m_connection_error;              ///< Error for ConnectShaders to fail?
     bool m_greedyjit;                     ///< JIT as much as we can?
+    int m_async_jit;                      ///< Background JIT threads (0 = off)
     bool m_countlayerexecs;               ///< Count number of layer execs?
     bool m_relaxed_param_typecheck;       ///< Allow parameters to be set from isomorphic types (same data layout)
     int m_max_warnings_per_thread;        ///< How many warnings to display per thread before giving up?
@@ -786,6 +877,7 @@ private:
     ustring m_llvm_jit_target;            ///< ISA target for JIT
     int m_vector_width;                   ///< SIMD width maximum (8)
     int m_opt_passes;                     ///< Opt passes per layer
+    int m_opt_parallel_layers;            ///< Threads optimizing one group's layers
     int m_llvm_optimize;                  ///< OSL optimization strategy
     int m_debug;                          ///< Debugging output
     int m_llvm_debug;                     ///< More LLVM debugging output
@@ -797,6 +889,7 @@ private:
     int m_llvm_output_bitcode;            ///< Output bitcode for each group
     int m_llvm_dumpasm;                   ///< Output CPU asm of the JIT
     ustring m_llvm_prune_ir_strategy;     ///< LLVM IR pruning strategy
+    std::shared_ptr<LLVM_Util::ObjectCache> m_llvm_jit_cache; ///< JIT object cache
     ustring m_debug_groupname;            ///< Name of sole group to debug
     ustring m_debug_layername;            ///< Name of sole layer to debug
     ustring m_opt_layername;              ///< Name of sole layer to optimize
@@ -818,6 +911,7 @@ private:
     bool m_force_derivs;                  ///< Force derivs on everything
     bool m_allow_shader_replacement;      ///< Allow shader masters to replace
     int m_exec_repeat;                    ///< How many times to execute group
+    int m_group_cache_size;               ///< Compiled groups to keep (0 = off)
     int m_opt_warnings;                   ///< Warn on inability to optimize
     int m_gpu_opt_error;                  ///< Error on inability to optimize
                                           ///<   away things that can't GPU.
@@ -854,7 +948,16 @@ private:
     atomic_int m_stat_global_connections; ///< Stat: global connections elim'd
     atomic_int m_stat_tex_calls_codegened;///< Stat: total texture calls
     atomic_int m_stat_tex_calls_as_handles;///< Stat: texture calls with handles
+    atomic_int m_stat_jit_cache_uncacheable;///< Stat: groups with raw addresses
+    atomic_int m_stat_groups_quick_jitted;///< Stat: groups given quick code
+    atomic_int m_stat_groups_hot_swapped; ///< Stat: quick code replaced
+    atomic_int m_stat_group_cache_hits;   ///< Stat: groups given cached code
+    atomic_int m_stat_group_cache_misses; ///< Stat: cacheable groups compiled
+    atomic_int m_stat_group_cache_evictions; ///< Stat: entries evicted
+    double m_stat_async_jit_time;         ///< Stat: time in background JIT
     double m_stat_master_load_time;       ///< Stat: time loading masters
+    std::map<std::thread::id,double> m_stat_master_load_time_thread; ///< per thread
+    double m_stat_master_wait_time;       ///< Stat: time waiting on others' loads
     double m_stat_optimization_time;      ///< Stat: time spent optimizing
     double m_stat_opt_locking_time;       ///<   locking time
     double m_stat_specialization_time;    ///<   runtime specialization time
@@ -876,6 +979,8 @@ private:
     long long m_stat_pointcloud_gets;
     long long m_stat_pointcloud_writes;
     atomic_ll m_stat_layers_executed;     ///< Total layers executed
+    atomic_ll m_stat_heap_clears;         ///< Executes that cleared the heap
+    atomic_ll m_stat_heap_bytes_cleared;  ///< Heap bytes cleared (clearmemory)
     atomic_ll m_stat_total_shading_time_ticks; ///< Total shading time (ticks)
 
     int m_stat_max_llvm_local_mem;        ///< Stat: max LLVM local mem
@@ -904,6 +1009,24 @@ private:
 
     atomic_int m_groups_to_compile_count;
     atomic_int m_threads_currently_compiling;
+    std::vector<double> m_stat_compile_thread_busy; ///< Busy time per worker
+    double m_stat_compile_wall_time;      ///< Wall time in compile_all_groups
+    // N.B. compile_thread_busy/wall_time are protected by m_stat_mutex.
+
+    // Quick-JITed groups waiting for the async_jit threads.
+    std::deque<ShaderGroupRef> m_async_jit_queue;
+    std::vector<std::thread> m_async_jit_threads;
+    mutex m_async_jit_mutex;
+    std::condition_variable m_async_jit_cv;
+    bool m_async_jit_stop = false;
+
+    // Compiled groups by group_cache_key, most recently used first. Each
+    // entry is a group holding the optimized layers and code it shares
+    // with the groups that were given it.
+    typedef std::list<std::pair<std::string,std::shared_ptr<ShaderGroup>>> GroupCacheList;
+    GroupCacheList m_group_cache;
+    std::unordered_map<std::string,GroupCacheList::iterator> m_group_cache_index;
+    mutable spin_mutex m_group_cache_mutex;
     mutable std::map<ustring,long long> m_group_profile_times;
     // N.B. group_profile_times is protected by m_stat_mutex.
 
@@ -1299,6 +1422,11 @@ public:
     /// equivalent, in that they may be merged into a single instance?
     bool mergeable (const ShaderInstance &b, const ShaderGroup &g) const;
 
+    /// Hash of the properties that mergeable() requires to be identical:
+    /// instances with different hashes are never mergeable, so only
+    /// instances with the same hash need to be compared.
+    size_t merge_hash () const;
+
 private:
     ShaderMaster::ref m_master;         ///< Reference to the master
     SymOverrideInfoVec m_instoverrides; ///< Instance parameter info
@@ -1413,15 +1541,35 @@ struct Message {
 
 /// Represents the list of messages set by a given shader using setmessage and getmessage
 ///
+/// The messages are also indexed by an open addressing hash table on
+/// ustring::hash(), so that lookups don't walk the whole list. The table
+/// lives in the same pool as the messages, so clearing both is O(1), and
+/// it is split into pages so that no allocation is bigger than a block.
 struct MessageList {
      MessageList() : list_head(nullptr), message_data() {}
 
      void clear() {
          list_head = NULL;
+         nmessages = 0;
+         capacity = 0;
+         overflowed = false;
          message_data.clear();
      }
 
     const Message* find(ustring name) const {
+        if (! capacity)
+            return find_in_list(name);
+        size_t mask = capacity - 1;
+        for (size_t i = name.hash() & mask; ; i = (i + 1) & mask) {
+            const Message* m = slot(i);
+            if (m == NULL || m->name == name)
+                return m;
+        }
+    }
+
+    /// Find by walking the list, as find() does if there are too many
+    /// messages for the table.
+    const Message* find_in_list(ustring name) const {
         for (const Message* m = list_head; m != NULL; m = m->next)
             if (m->name == name)
                 return m; // name matches
@@ -1434,10 +1582,57 @@ struct MessageList {
             list_head->data = message_data.alloc(type.size());
             memcpy(list_head->data, data, type.size());
         }
+        // Keep the table at most half full
+        ++nmessages;
+        if (overflowed)
+            return;
+        if (2 * nmessages > capacity)
+            grow();
+        else
+            insert(list_head);
     }
 
 private:
+    static constexpr size_t PageSlots = 64;  ///< 512 bytes of pointers
+    static constexpr size_t MaxPages = 64;
+    static constexpr size_t MinSlots = 16;
+
+    const Message*& slot(size_t i) { return pages[i / PageSlots][i % PageSlots]; }
+    const Message* slot(size_t i) const { return pages[i / PageSlots][i % PageSlots]; }
+
+    void insert(const Message* m) {
+        size_t mask = capacity - 1;
+        size_t i = m->name.hash() & mask;
+        while (slot(i))
+            i = (i + 1) & mask;
+        slot(i) = m;
+    }
+
+    // Double the table (the old one is left in the pool until clear) and
+    // index every message again. Past the largest table, fall back to the
+    // list.
+    void grow() {
+        size_t newcapacity = std::max(2 * capacity, size_t(MinSlots));
+        if (newcapacity > MaxPages * PageSlots) {
+            overflowed = true;
+            capacity = 0;
+            return;
+        }
+        for (size_t p = 0; p * PageSlots < newcapacity; ++p) {
+            size_t bytes = std::min(newcapacity, size_t(PageSlots)) * sizeof(Message*);
+            pages[p] = reinterpret_cast<const Message**>(message_data.alloc(bytes, alignof(Message*)));
+            memset(pages[p], 0, bytes);
+        }
+        capacity = newcapacity;
+        for (const Message* m = list_head; m != NULL; m = m->next)
+            insert(m);
+    }
+
     Message*         list_head;
+    size_t           nmessages = 0;      ///< Messages in the list
+    size_t           capacity = 0;       ///< Table slots (0 = no table)
+    bool             overflowed = false; ///< Too many messages for the table
+    const Message**  pages[MaxPages];    ///< Table pages, in message_data
     SimplePool<1024> message_data;
 };
 
@@ -1448,7 +1643,7 @@ private:
 
 /// A ShaderGroup consists of one or more layers (each of which is a
 /// ShaderInstance), and the connections among them.
-class ShaderGroup {
+class ShaderGroup : public std::enable_shared_from_this<ShaderGroup> {
 public:
     ShaderGroup (string_view name);
     ShaderGroup (const ShaderGroup &g, string_view name);
@@ -1483,32 +1678,52 @@ public:
     int batch_jitted () const { return m_batch_jitted; }
     void batch_jitted (int batch_jitted) { m_batch_jitted = batch_jitted; }
 
+    /// Is the group running quick-JITed code while its optimized code is
+    /// built in the background? Its ops must be kept until then.
+    bool async_jit_pending () const { return m_async_jit_pending; }
+
     size_t llvm_groupdata_size () const { return m_llvm_groupdata_size; }
     void llvm_groupdata_size (size_t size) { m_llvm_groupdata_size = size; }
 
     size_t llvm_groupdata_wide_size () const { return m_llvm_groupdata_wide_size; }
     void llvm_groupdata_wide_size (size_t size) { m_llvm_groupdata_wide_size = size; }
 
+    /// Size of the layer run and userdata initialized flags at the start
+    /// of the groupdata. The group init function clears these itself, so
+    /// they don't need clearing before it runs.
+    size_t llvm_groupdata_flags_size () const { return m_llvm_groupdata_flags_size; }
+    void llvm_groupdata_flags_size (size_t size) { m_llvm_groupdata_flags_size = size; }
+    size_t llvm_groupdata_wide_flags_size () const { return m_llvm_groupdata_wide_flags_size; }
+    void llvm_groupdata_wide_flags_size (size_t size) { m_llvm_groupdata_wide_flags_size = size; }
+
+    // The scalar entry points may be swapped by an async_jit thread while
+    // other threads run the group, so they are published with release
+    // stores and read with acquire loads: whoever sees a new pointer also
+    // sees the code behind it.
     RunLLVMGroupFunc llvm_compiled_version() const {
-        return m_llvm_compiled_version;
+        return m_llvm_compiled_version.load (std::memory_order_acquire);
     }
     void llvm_compiled_version (RunLLVMGroupFunc func) {
-        m_llvm_compiled_version = func;
+        m_llvm_compiled_version.store (func, std::memory_order_release);
     }
     RunLLVMGroupFunc llvm_compiled_init() const {
-        return m_llvm_compiled_init;
+        return m_llvm_compiled_init.load (std::memory_order_acquire);
     }
     void llvm_compiled_init (RunLLVMGroupFunc func) {
-        m_llvm_compiled_init = func;
+        m_llvm_compiled_init.store (func, std::memory_order_release);
     }
     RunLLVMGroupFunc llvm_compiled_layer (int layer) const {
         return layer < (int)m_llvm_compiled_layers.size()
-                            ? m_llvm_compiled_layers[layer] : NULL;
+                   ? m_llvm_compiled_layers[layer].load (std::memory_order_acquire)
+                   : NULL;
     }
     void llvm_compiled_layer (int layer, RunLLVMGroupFunc func) {
-        m_llvm_compiled_layers.resize ((size_t)nlayers(), NULL);
+        // Only sized while the group is being compiled for the first time,
+        // never when swapping, so readers never see the vector move.
+        if (m_llvm_compiled_layers.size() != (size_t)nlayers())
+            copy_compiled_layers (m_llvm_compiled_layers, nlayers());
         if (layer < nlayers())
-            m_llvm_compiled_layers[layer] = func;
+            m_llvm_compiled_layers[layer].store (func, std::memory_order_release);
     }
 
     // Hold onto wide versions of llvm functions side by side with scalar
@@ -1555,6 +1770,15 @@ public:
 
     std::string serialize () const;
 
+    /// Take the optimized state and compiled code of src, which must have
+    /// been built from the same serialized group, sharing its optimized
+    /// layers rather than running the optimizer and JIT again.
+    void copy_optimized (const ShaderGroup &src);
+
+    /// Go back to an unoptimized group, taking the (unoptimized) layers
+    /// of fresh and dropping everything the optimizer and JIT had set.
+    void reset_unoptimized (const ShaderGroup &fresh);
+
     void lock () const { m_mutex.lock(); }
     void unlock () const { m_mutex.unlock(); }
 
@@ -1614,13 +1838,19 @@ private:
     volatile int m_jitted = 0;       ///< Is it already jitted?
     bool m_does_nothing = false;     ///< Is the shading group just func() { return; }
     volatile int m_batch_jitted = 0; ///< Is it already jitted for batch execution?
+    volatile bool m_async_jit_pending = false; ///< Optimized JIT still queued?
     size_t m_llvm_groupdata_size = 0;///< Heap size needed for its groupdata
     size_t m_llvm_groupdata_wide_size = 0;    ///< Heap size needed for its wide groupdata
+    size_t m_llvm_groupdata_flags_size = 0;   ///< Groupdata flags cleared by init
+    size_t m_llvm_groupdata_wide_flags_size = 0; ///< Wide groupdata flags cleared by init
     int m_id;                        ///< Unique ID for the group
     int m_num_entry_layers = 0;      ///< Number of marked entry layers
-    RunLLVMGroupFunc m_llvm_compiled_version = nullptr;
-    RunLLVMGroupFunc m_llvm_compiled_init = nullptr;
-    std::vector<RunLLVMGroupFunc> m_llvm_compiled_layers;
+    typedef std::vector<std::atomic<RunLLVMGroupFunc>> AtomicFuncs;
+    /// Make the layer entry points a copy of src, resized to n layers.
+    void copy_compiled_layers (const AtomicFuncs &src, size_t n);
+    std::atomic<RunLLVMGroupFunc> m_llvm_compiled_version { nullptr };
+    std::atomic<RunLLVMGroupFunc> m_llvm_compiled_init { nullptr };
+    AtomicFuncs m_llvm_compiled_layers;
     RunLLVMGroupFuncWide m_llvm_compiled_wide_version = nullptr;
     RunLLVMGroupFuncWide m_llvm_compiled_wide_init = nullptr;
     std::vector<RunLLVMGroupFuncWide> m_llvm_compiled_wide_layers;
@@ -1654,10 +1884,16 @@ private:
     // PTX assembly for compiled ShaderGroup
     std::string m_llvm_ptx_compiled_version;
 
+    // serialize() before optimization, kept when the group cache is on so
+    // that ReParameter can rebuild the group.
+    std::string m_pristine_spec;
+
     ParamValueList m_pending_params;      ///< Pending Parameter() values
     ustring m_group_use;                  ///< "Usage" of group
     bool m_complete = false;              ///< Successfully ShaderGroupEnd?
 
+    std::string serialize_nolock () const;
+
     friend class OSL::pvt::ShadingSystemImpl;
     friend class OSL::pvt::BackendLLVM;
     friend class OSL::pvt::BatchedBackendLLVM;
@@ -1878,6 +2114,8 @@ public:
     void clear_runtime_stats () {
         m_stat_get_userdata_calls = 0;
         m_stat_layers_executed = 0;
+        m_stat_heap_clears = 0;
+        m_stat_heap_bytes_cleared = 0;
     }
 
     // Transfer the per-execution stats from this context to the shading
@@ -1885,6 +2123,22 @@ public:
     void record_runtime_stats () {
         shadingsys().m_stat_get_userdata_calls += m_stat_get_userdata_calls;
         shadingsys().m_stat_layers_executed += m_stat_layers_executed;
+        if (m_stat_heap_clears) {
+            shadingsys().m_stat_heap_clears += m_stat_heap_clears;
+            shadingsys().m_stat_heap_bytes_cleared += m_stat_heap_bytes_cleared;
+        }
+    }
+
+    // Zero the part of the heap that the group's init function does not
+    // initialize itself, if "clearmemory" is set. The leading flags_size
+    // bytes, which init clears, are skipped when it is about to run.
+    void clear_heap (size_t size, size_t flags_size, bool init_will_run) {
+        size_t skip = init_will_run ? std::min (flags_size, size) : 0;
+        if (shadingsys().m_clearmemory) {
+            memset (m_heap.get() + skip, 0, size - skip);
+            m_stat_heap_clears += 1;
+            m_stat_heap_bytes_cleared += (long long)(size - skip);
+        }
     }
 
     bool allow_warnings() {
@@ -1948,6 +2202,8 @@ private:
     int m_max_warnings;                 ///< To avoid processing too many warnings
     int m_stat_get_userdata_calls;      ///< Number of calls to get_userdata
     int m_stat_layers_executed;         ///< Number of layers executed
+    int m_stat_heap_clears;             ///< Executes that cleared the heap
+    long long m_stat_heap_bytes_cleared; ///< Heap bytes cleared
     long long m_ticks;                  ///< Time executing the shader
 
     TextureOpt m_textureopt;            ///< texture call options
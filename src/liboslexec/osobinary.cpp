@@ -0,0 +1,473 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Binary OSO: a pre-tokenized form of a .oso file that is mapped straight
+// into memory and replayed through the OSOReader callbacks, without any
+// lexing or parsing.  The text .oso remains the source of truth -- the
+// binary form is made by parsing the text and recording the callbacks
+// the parser makes, in order, so a replay is indistinguishable from
+// parsing the text it came from.
+//
+// Layout, in native-endian 32 bit words:
+//
+//   header    magic "OSOB", format version, size in bytes of the string
+//             table, number of event words, and the size in bytes and
+//             64 bit farmhash (low word first) of the text it was made
+//             from
+//   strings   every distinct string once, NUL-terminated, the table
+//             padded with NULs to a multiple of 4 bytes
+//   events    for each callback, the event kind followed by its
+//             arguments: ints and floats as they are, strings as byte
+//             offsets into the string table, and a typespec as three
+//             words (closure/struct flags, the packed TypeDesc of the
+//             element or the struct name, the array length)
+//
+// A byte-swapped file doesn't match the format version, and is rejected
+// like any other stale binary. A binary whose text has changed since is
+// rejected by binary_made_from.
+
+#include <cstring>
+#include <unordered_map>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/hash.h>
+
+#include "osoreader.h"
+
+
+
+OSL_NAMESPACE_ENTER
+
+namespace pvt {   // OSL::pvt
+
+
+namespace {
+
+static const char osob_magic[4] = { 'O', 'S', 'O', 'B' };
+static const uint32_t osob_version = 2;
+static const size_t osob_header_words = 7;
+
+enum OSOBEvent {
+    OSOB_VERSION,         // specid, major, minor
+    OSOB_SHADER,          // shadertype, name
+    OSOB_SYMBOL,          // symtype, typespec (3 words), name
+    OSOB_DEFAULT_INT,     // value
+    OSOB_DEFAULT_FLOAT,   // value
+    OSOB_DEFAULT_STRING,  // value
+    OSOB_PARAMETER_DONE,
+    OSOB_HINT,            // hint
+    OSOB_CODEMARKER,      // name
+    OSOB_CODEEND,
+    OSOB_INSTRUCTION,     // label, opcode
+    OSOB_ARG,             // name
+    OSOB_JUMP,            // target
+    OSOB_INSTRUCTION_END
+};
+
+enum OSOBTypeFlags { OSOB_TYPE_CLOSURE = 1, OSOB_TYPE_STRUCT = 2 };
+
+};  // anonymous namespace
+
+
+
+uint32_t
+OSOReaderToBinary::string_offset (string_view s)
+{
+    auto inserted = m_stringmap.emplace (s.str(), (uint32_t) m_strings.size());
+    if (inserted.second) {
+        m_strings.append (s.data(), s.size());
+        m_strings += '\0';
+    }
+    return inserted.first->second;
+}
+
+
+
+void
+OSOReaderToBinary::add_float (float f)
+{
+    uint32_t w;
+    memcpy (&w, &f, sizeof(w));
+    m_events.push_back (w);
+}
+
+
+
+void
+OSOReaderToBinary::version (const char *specid, int major, int minor)
+{
+    m_events.push_back (OSOB_VERSION);
+    m_events.push_back (string_offset (specid));
+    m_events.push_back ((uint32_t) major);
+    m_events.push_back ((uint32_t) minor);
+}
+
+
+
+void
+OSOReaderToBinary::shader (const char *shadertype, const char *name)
+{
+    m_events.push_back (OSOB_SHADER);
+    m_events.push_back (string_offset (shadertype));
+    m_events.push_back (string_offset (name));
+}
+
+
+
+void
+OSOReaderToBinary::symbol (SymType symtype, TypeSpec typespec,
+                           const char *name)
+{
+    m_events.push_back (OSOB_SYMBOL);
+    m_events.push_back ((uint32_t) symtype);
+    if (typespec.is_structure_based()) {
+        m_events.push_back (OSOB_TYPE_STRUCT);
+        m_events.push_back (string_offset (typespec.structspec()->name()));
+    } else {
+        TypeDesc t = typespec.elementtype().simpletype();
+        m_events.push_back (typespec.is_closure_based() ? OSOB_TYPE_CLOSURE : 0);
+        m_events.push_back (uint32_t(t.basetype) | uint32_t(t.aggregate) << 8
+                            | uint32_t(t.vecsemantics) << 16);
+    }
+    m_events.push_back ((uint32_t) typespec.simpletype().arraylen);
+    m_events.push_back (string_offset (name));
+}
+
+
+
+void
+OSOReaderToBinary::symdefault (int def)
+{
+    m_events.push_back (OSOB_DEFAULT_INT);
+    m_events.push_back ((uint32_t) def);
+}
+
+
+
+void
+OSOReaderToBinary::symdefault (float def)
+{
+    m_events.push_back (OSOB_DEFAULT_FLOAT);
+    add_float (def);
+}
+
+
+
+void
+OSOReaderToBinary::symdefault (const char *def)
+{
+    m_events.push_back (OSOB_DEFAULT_STRING);
+    m_events.push_back (string_offset (def));
+}
+
+
+
+void
+OSOReaderToBinary::parameter_done ()
+{
+    m_events.push_back (OSOB_PARAMETER_DONE);
+}
+
+
+
+void
+OSOReaderToBinary::hint (string_view hintstring)
+{
+    m_events.push_back (OSOB_HINT);
+    m_events.push_back (string_offset (hintstring));
+}
+
+
+
+void
+OSOReaderToBinary::codemarker (const char *name)
+{
+    m_events.push_back (OSOB_CODEMARKER);
+    m_events.push_back (string_offset (name));
+}
+
+
+
+void
+OSOReaderToBinary::codeend ()
+{
+    m_events.push_back (OSOB_CODEEND);
+}
+
+
+
+void
+OSOReaderToBinary::instruction (int label, const char *opcode)
+{
+    m_events.push_back (OSOB_INSTRUCTION);
+    m_events.push_back ((uint32_t) label);
+    m_events.push_back (string_offset (opcode));
+}
+
+
+
+void
+OSOReaderToBinary::instruction_arg (const char *name)
+{
+    m_events.push_back (OSOB_ARG);
+    m_events.push_back (string_offset (name));
+}
+
+
+
+void
+OSOReaderToBinary::instruction_jump (int target)
+{
+    m_events.push_back (OSOB_JUMP);
+    m_events.push_back ((uint32_t) target);
+}
+
+
+
+void
+OSOReaderToBinary::instruction_end ()
+{
+    m_events.push_back (OSOB_INSTRUCTION_END);
+}
+
+
+
+std::string
+OSOReaderToBinary::binary (string_view source) const
+{
+    size_t strsize = (m_strings.size() + 3) & ~size_t(3);
+    size_t nevents = m_events.size();
+    std::string out (osob_header_words * 4 + strsize + nevents * 4, '\0');
+    uint32_t header[osob_header_words];
+    memcpy (&header[0], osob_magic, 4);
+    header[1] = osob_version;
+    header[2] = (uint32_t) strsize;
+    header[3] = (uint32_t) nevents;
+    uint64_t hash = OIIO::farmhash::Hash64 (source.data(), source.size());
+    header[4] = (uint32_t) source.size();
+    header[5] = (uint32_t) hash;
+    header[6] = (uint32_t) (hash >> 32);
+    char *p = &out[0];
+    memcpy (p, header, sizeof(header));
+    p += sizeof(header);
+    memcpy (p, m_strings.data(), m_strings.size());
+    p += strsize;
+    if (nevents)
+        memcpy (p, m_events.data(), nevents * 4);
+    return out;
+}
+
+
+
+bool
+OSOReader::is_binary (string_view buffer)
+{
+    return buffer.size() >= osob_header_words * 4
+        && ! memcmp (buffer.data(), osob_magic, 4);
+}
+
+
+
+bool
+OSOReader::binary_made_from (string_view buffer, string_view source)
+{
+    if (! is_binary (buffer))
+        return false;
+    uint32_t header[osob_header_words];
+    memcpy (header, buffer.data(), sizeof(header));
+    uint64_t hash = OIIO::farmhash::Hash64 (source.data(), source.size());
+    return header[1] == osob_version
+        && header[4] == (uint32_t) source.size()
+        && header[5] == (uint32_t) hash && header[6] == (uint32_t) (hash >> 32);
+}
+
+
+
+bool
+OSOReader::binary_file_made_from (const std::string &filename,
+                                  string_view source)
+{
+    std::string header (osob_header_words * 4, '\0');
+    return OIIO::Filesystem::read_bytes (filename, &header[0], header.size())
+               == header.size()
+        && binary_made_from (header, source);
+}
+
+
+
+bool
+OSOReader::parse_binary (string_view buffer)
+{
+    // Unlike the text parser, the replay touches no global state (the
+    // lexer, the locale), so it needs no lock.
+    if (! is_binary (buffer)) {
+        m_err.errorf ("Not a binary OSO file");
+        return false;
+    }
+    const char *data = buffer.data();
+    uint32_t header[osob_header_words];
+    memcpy (header, data, sizeof(header));
+    size_t strsize = header[2], nevents = header[3];
+    if (header[1] != osob_version) {
+        m_err.errorf ("Binary OSO format version %d, expected %d (it needs to be regenerated from the .oso)",
+                      header[1], osob_version);
+        return false;
+    }
+    if ((strsize & 3) || buffer.size() != sizeof(header) + strsize + nevents * 4
+        || (strsize && data[sizeof(header) + strsize - 1] != '\0')) {
+        m_err.errorf ("Corrupt binary OSO file");
+        return false;
+    }
+    const char *strings = data + sizeof(header);
+    const char *events = strings + strsize;
+
+    // Reading past the end of the events, or a string offset past the
+    // end of the table, can only come from a corrupt file.
+    size_t pos = 0;
+    bool corrupt = false;
+    auto word = [&]() -> uint32_t {
+        uint32_t w = 0;
+        if (pos < nevents)
+            memcpy (&w, events + 4 * pos, 4);
+        else
+            corrupt = true;
+        ++pos;
+        return w;
+    };
+    auto str = [&]() -> const char * {
+        uint32_t offset = word();
+        if (offset < strsize)
+            return strings + offset;
+        corrupt = true;
+        return "";
+    };
+    auto flt = [&]() -> float {
+        uint32_t w = word();
+        float f;
+        memcpy (&f, &w, sizeof(f));
+        return f;
+    };
+
+    while (pos < nevents && ! corrupt) {
+        switch (word()) {
+        case OSOB_VERSION : {
+            const char *specid = str();
+            int major = (int) word();
+            int minor = (int) word();
+            version (specid, major, minor);
+            break;
+        }
+        case OSOB_SHADER : {
+            const char *shadertype = str();
+            shader (shadertype, str());
+            break;
+        }
+        case OSOB_SYMBOL : {
+            SymType symtype = (SymType) word();
+            uint32_t flags = word();
+            TypeSpec typespec;
+            if (flags & OSOB_TYPE_STRUCT) {
+                typespec = TypeSpec (str(), 0);
+            } else {
+                uint32_t t = word();
+                TypeDesc simple ((TypeDesc::BASETYPE) (t & 0xff),
+                                 (TypeDesc::AGGREGATE) ((t >> 8) & 0xff),
+                                 (TypeDesc::VECSEMANTICS) ((t >> 16) & 0xff));
+                typespec = TypeSpec (simple, (flags & OSOB_TYPE_CLOSURE) != 0);
+            }
+            int arraylen = (int) word();
+            const char *name = str();
+            if (corrupt)
+                break;
+            if (symtype == SymTypeTemp && stop_parsing_at_temp_symbols())
+                return true;
+            current_typespec (typespec);
+            if (arraylen)
+                typespec.make_array (arraylen);
+            symbol (symtype, typespec, name);
+            break;
+        }
+        case OSOB_DEFAULT_INT :    symdefault ((int) word());  break;
+        case OSOB_DEFAULT_FLOAT :  symdefault (flt());  break;
+        case OSOB_DEFAULT_STRING : symdefault (str());  break;
+        case OSOB_PARAMETER_DONE : parameter_done ();  break;
+        case OSOB_HINT :           hint (str());  break;
+        case OSOB_CODEMARKER : {
+            const char *name = str();
+            if (corrupt)
+                break;
+            if (! parse_code_section())
+                return true;
+            codemarker (name);
+            break;
+        }
+        case OSOB_CODEEND :        codeend ();  break;
+        case OSOB_INSTRUCTION : {
+            int label = (int) word();
+            instruction (label, str());
+            break;
+        }
+        case OSOB_ARG :            instruction_arg (str());  break;
+        case OSOB_JUMP :           instruction_jump ((int) word());  break;
+        case OSOB_INSTRUCTION_END : instruction_end ();  break;
+        default :                  corrupt = true;  break;
+        }
+    }
+    if (corrupt) {
+        m_err.errorf ("Corrupt binary OSO file");
+        return false;
+    }
+    return true;
+}
+
+
+
+bool
+OSOReader::parse_binary_file (const std::string &filename)
+{
+    // Call our own parse_binary explicitly, so that subclasses that
+    // override both don't set up twice.
+#ifdef _WIN32
+    std::string contents;
+    uint64_t size = OIIO::Filesystem::file_size (filename);
+    contents.resize (size);
+    if (! OIIO::Filesystem::exists (filename) ||
+          OIIO::Filesystem::read_bytes (filename, &contents[0], size) != size) {
+        m_err.errorf ("File %s not found", filename);
+        return false;
+    }
+    return OSOReader::parse_binary (contents);
+#else
+    int fd = ::open (filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat (fd, &st) != 0) {
+        if (fd >= 0)
+            ::close (fd);
+        m_err.errorf ("File %s not found", filename);
+        return false;
+    }
+    size_t size = (size_t) st.st_size;
+    void *mapped = size ? mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                        : MAP_FAILED;
+    ::close (fd);
+    if (mapped == MAP_FAILED) {
+        m_err.errorf ("Could not map %s", filename);
+        return false;
+    }
+    bool ok = OSOReader::parse_binary (string_view ((const char *)mapped, size));
+    munmap (mapped, size);
+    return ok;
+#endif
+}
+
+
+}; // namespace pvt
+OSL_NAMESPACE_EXIT
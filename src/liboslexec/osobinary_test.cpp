@@ -0,0 +1,286 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Round trip text .oso through binary OSO, checking that replaying the
+// binary makes exactly the callbacks that parsing the text does, and
+// time the two.
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/timer.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+
+#include "osoreader.h"
+
+using namespace OSL;
+using namespace OSL::pvt;
+
+
+static int iterations = 1000;
+static bool verbose = false;
+
+
+// Covers every kind of callback: shader and symbol hints, all the symbol
+// types, int/float/string defaults, sized and unsized arrays, closures,
+// structs, several code sections, and jump targets.
+static const char *roundtrip_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "surface roundtrip\t%meta{string,help,\"Round trip\"} \n"
+    "param\tfloat\tKd\t0.5\t\t%meta{float,min,0} %read{4,4} %write{2147483647,-1}\n"
+    "param\tcolor\tCs\t1 0.25 0.333333343\t\t%read{4,4} %write{2147483647,-1}\n"
+    "param\tint[3]\tsteps\t1 -2 3\t\t%read{2147483647,-1} %write{2147483647,-1}\n"
+    "param\tfloat[]\tweights\t0.25 7.5e-05\t\t%read{2147483647,-1} %write{2147483647,-1}\n"
+    "param\tstring\tlabel\t\"a \\\"quoted\\\" label\"\t\t%read{2147483647,-1} %write{2147483647,-1}\n"
+    "param\tstruct pair\tpr\t\t%struct{\"pair\"} %structfields{a,b} %structfieldtypes{\"fi\"} %structnfields{2} %read{2147483647,-1} %write{2147483647,-1}\n"
+    "param\tfloat\tpr.a\t1\t\t%mystruct{pr} %mystructfield{0} %read{2147483647,-1} %write{2147483647,-1}\n"
+    "param\tint\tpr.b\t2\t\t%mystruct{pr} %mystructfield{1} %read{2147483647,-1} %write{2147483647,-1}\n"
+    "oparam\tclosure color\tbsdf\t\t\t%read{2147483647,-1} %write{0,0} %initexpr\n"
+    "oparam\tcolor\tCout\t0 0 0\t\t%read{2147483647,-1} %write{4,4}\n"
+    "global\tnormal\tN\t%read{0,0} %write{2147483647,-1}\n"
+    "local\tint\ti\t%read{1,1} %write{3,3}\n"
+    "temp\tint\t$tmp1\t%read{2,2} %write{1,1}\n"
+    "const\tstring\t$const1\t\"diffuse\"\t\t%read{0,0} %write{2147483647,-1}\n"
+    "const\tint\t$const2\t0\t\t%read{1,3} %write{2147483647,-1}\n"
+    "code bsdf\n"
+    "\tclosure\t\tbsdf $const1 N \t%filename{\"roundtrip.osl\"} %line{9} %argrw{\"wrr\"}\n"
+    "code ___main___\n"
+    "# roundtrip.osl:12\n"
+    "\tlt\t\t$tmp1 i $const2 \t%filename{\"roundtrip.osl\"} %line{12} %argrw{\"wrr\"}\n"
+    "\tif\t\t$tmp1 4 4 \t%argrw{\"r\"}\n"
+    "\tassign\t\ti $const2 \t%argrw{\"wr\"}\n"
+    "\tmul\t\tCout Cs Kd \t%line{14} %argrw{\"wrr\"}\n"
+    "\tend\n";
+
+
+
+// Log every callback as a line of text, so two parses can be compared.
+class OSOReaderToLog final : public OSOReader {
+public:
+    OSOReaderToLog (bool stop_at_temps = false, bool code = true)
+        : m_stop_at_temps(stop_at_temps), m_code(code) { }
+    virtual void version (const char *specid, int major, int minor) {
+        log ("version %s %d %d", specid, major, minor);
+    }
+    virtual void shader (const char *shadertype, const char *name) {
+        log ("shader %s %s", shadertype, name);
+    }
+    virtual void symbol (SymType symtype, TypeSpec typespec, const char *name) {
+        log ("symbol %d %s (%s) %s", int(symtype), typespec.string(),
+             typespec.simpletype(), name);
+    }
+    virtual void symdefault (int def) { log ("default int %d", def); }
+    virtual void symdefault (float def) { log ("default float %.9g", def); }
+    virtual void symdefault (const char *def) { log ("default string \"%s\"", def); }
+    virtual void parameter_done () { log ("parameter_done"); }
+    virtual bool stop_parsing_at_temp_symbols () { return m_stop_at_temps; }
+    virtual void hint (string_view hintstring) { log ("hint %s", hintstring); }
+    virtual bool parse_code_section () { return m_code; }
+    virtual void codemarker (const char *name) { log ("codemarker %s", name); }
+    virtual void codeend () { log ("codeend"); }
+    virtual void instruction (int label, const char *opcode) {
+        log ("instruction %d %s", label, opcode);
+    }
+    virtual void instruction_arg (const char *name) { log ("arg %s", name); }
+    virtual void instruction_jump (int target) { log ("jump %d", target); }
+    virtual void instruction_end () { log ("instruction_end"); }
+
+    std::vector<std::string> events;
+
+private:
+    template<typename... Args>
+    void log (const char *fmt, const Args&... args) {
+        events.push_back (OIIO::Strutil::sprintf (fmt, args...));
+    }
+    bool m_stop_at_temps, m_code;
+};
+
+
+
+// The corrupt binaries are expected to fail, without printing errors.
+class SilentErrorHandler final : public ErrorHandler {
+public:
+    virtual void operator() (int /*errcode*/, const std::string& /*msg*/) { }
+};
+
+
+
+static void
+getargs (int argc, char *argv[])
+{
+    bool help = false;
+    OIIO::ArgParse ap;
+    ap.options ("osobinary_test\n"
+                OIIO_INTRO_STRING "\n"
+                "Usage:  osobinary_test [options]",
+                "--help", &help, "Print help message",
+                "-v", &verbose, "Verbose mode",
+                "--iters %d", &iterations,
+                    OIIO::Strutil::sprintf("Number of timed parses (default: %d)", iterations).c_str(),
+                NULL);
+    if (ap.parse (argc, (const char**)argv) < 0) {
+        std::cerr << ap.geterror() << std::endl;
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+    if (help) {
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+
+// Parse the text and replay its binary form with the same reader
+// settings, and check that they make the same callbacks.
+static void
+test_roundtrip (const std::string &binary, bool stop_at_temps, bool code)
+{
+    OSOReaderToLog text (stop_at_temps, code), replay (stop_at_temps, code);
+    OIIO_CHECK_ASSERT (text.parse_memory (roundtrip_oso));
+    OIIO_CHECK_ASSERT (replay.parse_binary (binary));
+    OIIO_CHECK_EQUAL (text.events.size(), replay.events.size());
+    for (size_t i = 0;  i < text.events.size() && i < replay.events.size();  ++i)
+        OIIO_CHECK_EQUAL (text.events[i], replay.events[i]);
+    if (verbose && ! stop_at_temps && code)
+        for (auto&& e : replay.events)
+            std::cout << "  " << e << "\n";
+}
+
+
+
+static void
+test_corrupt (const std::string &binary)
+{
+    SilentErrorHandler silent;
+    OSOReader reader (&silent);
+    OIIO_CHECK_ASSERT (! OSOReader::is_binary (roundtrip_oso));
+    OIIO_CHECK_ASSERT (! reader.parse_binary (roundtrip_oso));
+    // Truncated
+    OIIO_CHECK_ASSERT (! reader.parse_binary (string_view (binary).substr (0, binary.size() - 4)));
+    // Another format version
+    std::string stale = binary;
+    stale[4] ^= 0x7f;
+    OIIO_CHECK_ASSERT (! reader.parse_binary (stale));
+    // An unknown event
+    std::string bad = binary;
+    for (size_t i = bad.size() - 4;  i < bad.size();  ++i)
+        bad[i] = '\x7f';
+    OIIO_CHECK_ASSERT (! reader.parse_binary (bad));
+}
+
+
+
+static void
+test_file (const std::string &binary)
+{
+    std::string filename = OIIO::Filesystem::unique_path ("osobinary_test_%%%%%%%%.osob");
+    {
+        OIIO::ofstream out;
+        OIIO::Filesystem::open (out, filename, std::ios::out | std::ios::binary);
+        out.write (binary.data(), binary.size());
+    }
+    OSOReaderToLog text, mapped;
+    OIIO_CHECK_ASSERT (text.parse_memory (roundtrip_oso));
+    OIIO_CHECK_ASSERT (mapped.parse_binary_file (filename));
+    OIIO_CHECK_ASSERT (text.events == mapped.events);
+    OIIO_CHECK_ASSERT (OSOReader::binary_file_made_from (filename, roundtrip_oso));
+    OIIO::Filesystem::remove (filename);
+}
+
+
+
+// The binary knows the text it was made from: an edit to the .oso, even
+// one that keeps its size, makes it stale.
+static void
+test_source_check (const std::string &binary)
+{
+    std::string edited = roundtrip_oso;
+    OIIO_CHECK_ASSERT (OSOReader::binary_made_from (binary, edited));
+    edited[edited.size() - 2] ^= 1;
+    OIIO_CHECK_ASSERT (! OSOReader::binary_made_from (binary, edited));
+    OIIO_CHECK_ASSERT (! OSOReader::binary_made_from (binary, edited + "\n"));
+    OIIO_CHECK_ASSERT (! OSOReader::binary_made_from (roundtrip_oso, roundtrip_oso));
+    OIIO_CHECK_ASSERT (! OSOReader::binary_file_made_from ("no_such_file.osob",
+                                                           roundtrip_oso));
+}
+
+
+
+// Load the shader both ways through the shading system and use it.
+static void
+test_load ()
+{
+    RendererServices renderer;
+    ShadingSystem ss (&renderer);
+    OSOReaderToBinary converter;
+    OIIO_CHECK_ASSERT (converter.parse_memory (roundtrip_oso));
+    std::string binary = converter.binary (roundtrip_oso);
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("roundtrip_text", roundtrip_oso));
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("roundtrip_binary", binary));
+    for (const char *name : { "roundtrip_text", "roundtrip_binary" }) {
+        ShaderGroupRef group = ss.ShaderGroupBegin ();
+        ss.Parameter (*group, "Kd", 0.75f);
+        OIIO_CHECK_ASSERT (ss.Shader (*group, "surface", name, "layer"));
+        OIIO_CHECK_ASSERT (ss.ShaderGroupEnd (*group));
+    }
+}
+
+
+
+static void
+time_parses (const std::string &binary)
+{
+    OIIO::Timer timer;
+    for (int i = 0;  i < iterations;  ++i) {
+        OSOReader reader;
+        reader.parse_memory (roundtrip_oso);
+    }
+    double text_time = timer.lap();
+    for (int i = 0;  i < iterations;  ++i) {
+        OSOReader reader;
+        reader.parse_binary (binary);
+    }
+    double binary_time = timer.lap();
+    std::cout << OIIO::Strutil::sprintf ("  text   %8.2f us/parse  (%d bytes)\n",
+                                         1.0e6 * text_time / iterations,
+                                         strlen (roundtrip_oso));
+    std::cout << OIIO::Strutil::sprintf ("  binary %8.2f us/parse  (%d bytes)\n",
+                                         1.0e6 * binary_time / iterations,
+                                         binary.size());
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+    getargs (argc, argv);
+
+    OSOReaderToBinary converter;
+    OIIO_CHECK_ASSERT (converter.parse_memory (roundtrip_oso));
+    std::string binary = converter.binary (roundtrip_oso);
+    OIIO_CHECK_ASSERT (OSOReader::is_binary (binary));
+
+    test_roundtrip (binary, false, true);
+    test_roundtrip (binary, true, true);    // like OSLQuery
+    test_roundtrip (binary, false, false);  // header and symbols only
+    test_corrupt (binary);
+    test_file (binary);
+    test_source_check (binary);
+    test_load ();
+    time_parses (binary);
+
+    return unit_test_failures;
+}
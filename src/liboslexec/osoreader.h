@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include <OSL/platform.h>
 #include "osl_pvt.h"
 
@@ -42,6 +45,30 @@ public:
     /// an unrecoverable error reading.
     virtual bool parse_memory (const std::string &buffer);
 
+    /// Replay binary OSO (see OSOReaderToBinary) from memory, calling
+    /// the same callbacks, in the same order, as parsing the text it was
+    /// made from, but with no tokenizing: the strings are passed straight
+    /// out of the buffer.  Return false if the buffer isn't binary OSO of
+    /// the current format version.
+    virtual bool parse_binary (string_view buffer);
+
+    /// Map a binary OSO file into memory and replay it as parse_binary
+    /// does.
+    virtual bool parse_binary_file (const std::string &filename);
+
+    /// Does the buffer hold binary OSO, rather than text?
+    static bool is_binary (string_view buffer);
+
+    /// Is the buffer binary OSO of the current format version made from
+    /// exactly the text OSO in source? Only the header is looked at, so
+    /// the buffer may hold just that.
+    static bool binary_made_from (string_view buffer, string_view source);
+
+    /// Is the file binary OSO made from source, as binary_made_from? Only
+    /// its header is read.
+    static bool binary_file_made_from (const std::string &filename,
+                                       string_view source);
+
     /// Declare the shader version.
     ///
     virtual void version (const char *specid, int major, int minor) { }
@@ -131,6 +158,44 @@ private:
     TypeSpec m_current_typespec;
 };
 
+
+
+/// OSOReader that records the callbacks made by parsing text OSO as
+/// binary OSO, for OSOReader::parse_binary to replay.  The text remains
+/// the source of truth; the binary form just skips the lexer.
+class OSOReaderToBinary final : public OSOReader {
+public:
+    OSOReaderToBinary (ErrorHandler *errhandler = NULL)
+        : OSOReader (errhandler) { }
+    virtual void version (const char *specid, int major, int minor);
+    virtual void shader (const char *shadertype, const char *name);
+    virtual void symbol (SymType symtype, TypeSpec typespec, const char *name);
+    virtual void symdefault (int def);
+    virtual void symdefault (float def);
+    virtual void symdefault (const char *def);
+    virtual void parameter_done ();
+    virtual void hint (string_view hintstring);
+    virtual void codemarker (const char *name);
+    virtual void codeend ();
+    virtual void instruction (int label, const char *opcode);
+    virtual void instruction_arg (const char *name);
+    virtual void instruction_jump (int target);
+    virtual void instruction_end ();
+
+    /// The binary OSO for everything parsed so far, which was parsed from
+    /// the text OSO in source. Its size and hash are recorded, so that a
+    /// binary left behind by an edited .oso can be told apart.
+    std::string binary (string_view source) const;
+
+private:
+    uint32_t string_offset (string_view s);
+    void add_float (float f);
+
+    std::string m_strings;             ///< String table
+    std::unordered_map<std::string,uint32_t> m_stringmap; ///< Offsets in it
+    std::vector<uint32_t> m_events;    ///< Recorded callbacks
+};
+
 OSL_PRAGMA_WARNING_POP
 
 
@@ -0,0 +1,183 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Build a wide group made of many separate chains of layers, optimize it
+// with and without "opt_parallel_layers", and check that both give the
+// same code and results (and time the two with --bench).
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/oslexec.h>
+#include <OSL/rendererservices.h>
+
+#include "oslexec_pvt.h"
+#include "testbench.h"
+
+using namespace OSL;
+using namespace OSL::pvt;
+
+
+static int nchains = testbench_workload (200, 4);
+static int chain_length = 10;
+static int nthreads = -1;
+
+
+
+static void
+getargs (int argc, char *argv[])
+{
+    testbench_getargs (argc, argv, "parallelopt_test",
+                       "--chains %d", &nchains,
+                           OIIO::Strutil::sprintf("Number of separate chains (default: %d)", nchains).c_str(),
+                       "--chain %d", &chain_length,
+                           OIIO::Strutil::sprintf("Layers per chain (default: %d)", chain_length).c_str(),
+                       "--threads %d", &nthreads,
+                           "Threads for the parallel optimization (default: all)");
+}
+
+
+
+static std::string
+layername (int chain, int k)
+{
+    return OIIO::Strutil::sprintf ("c%d_%d", chain, k);
+}
+
+
+
+// Every layer has its own scale, so that no two are merged, and every
+// "out" is a renderer output, so that no layer goes unused.
+static ShaderGroupRef
+build_group (ShadingSystem &ss)
+{
+    ShaderGroupRef group = ss.ShaderGroupBegin ();
+    for (int c = 0;  c < nchains;  ++c) {
+        for (int k = 0;  k < chain_length;  ++k) {
+            ss.Parameter (*group, "scale", 1.0f + 0.001f * float(c * chain_length + k));
+            ss.Shader (*group, "surface", "chainnode", layername (c, k));
+            if (k > 0)
+                ss.ConnectShaders (*group, layername (c, k-1), "out",
+                                   layername (c, k), "in");
+        }
+    }
+    ss.ShaderGroupEnd (*group);
+    return group;
+}
+
+
+
+// The optimized code of every layer, one op per line with the names of
+// its arguments, so that new symbols named differently show up too.
+static std::string
+group_code (const ShaderGroup &group)
+{
+    std::string code;
+    for (int i = 0;  i < group.nlayers();  ++i) {
+        const ShaderInstance *inst = group[i];
+        code += OIIO::Strutil::sprintf ("layer %s\n", inst->layername());
+        for (const Opcode &op : inst->ops()) {
+            code += OIIO::Strutil::sprintf ("\t%s", op.opname());
+            for (int a = 0;  a < op.nargs();  ++a)
+                code += OIIO::Strutil::sprintf (" %s",
+                            inst->argsymbol (op.firstarg() + a)->name());
+            code += "\n";
+        }
+    }
+    return code;
+}
+
+
+
+// Optimize a new group with the given setting, returning the time it
+// took and setting the post-optimization op count, the optimized code,
+// and every layer's out.
+static double
+optimize (ShadingSystem &ss, ShadingContext *ctx, int parallel,
+          int &ops, std::string &code, std::vector<float> &outs)
+{
+    ss.attribute ("opt_parallel_layers", parallel);
+    ShaderGroupRef group = build_group (ss);
+    int ops_before = 0, ops_after = 0;
+    ss.getattribute ("stat:postopt_ops", TypeDesc::INT, &ops_before);
+    OIIO::Timer timer;
+    ss.optimize_group (group.get(), ctx, false);
+    double time = timer();
+    ss.getattribute ("stat:postopt_ops", TypeDesc::INT, &ops_after);
+    ops = ops_after - ops_before;
+    code = group_code (*group);
+
+    ShaderGlobals sg;
+    memset ((char *)&sg, 0, sizeof(sg));
+    ss.execute (*ctx, *group, sg);
+    outs.clear ();
+    for (int c = 0;  c < nchains;  ++c) {
+        for (int k = 0;  k < chain_length;  ++k) {
+            const ShaderSymbol *out = ss.find_symbol (*group, ustring(layername (c, k)),
+                                                      ustring("out"));
+            OIIO_CHECK_ASSERT (out);
+            outs.push_back (out ? *(const float *)ss.symbol_address (*ctx, out) : 0.0f);
+        }
+    }
+    return time;
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+    getargs (argc, argv);
+
+    RendererServices renderer;
+    ShadingSystem ss (&renderer);
+    ustring outputs[] = { ustring("out") };
+    ss.attribute ("renderer_outputs", TypeDesc(TypeDesc::STRING, 1), &outputs);
+    OIIO_CHECK_ASSERT (ss.LoadMemoryCompiledShader ("chainnode", chainnode_oso));
+
+    PerThreadInfo *thread_info = ss.create_thread_info ();
+    ShadingContext *ctx = ss.get_context (thread_info);
+
+    // Sequential, one thread in the parallel mode, and then all the
+    // threads asked for, twice, all must give the same code and results.
+    int seq_ops = 0, one_ops = 0, par_ops = 0, again_ops = 0;
+    std::string seq_code, one_code, par_code, again_code;
+    std::vector<float> seq_outs, one_outs, par_outs, again_outs;
+    double seq_time = optimize (ss, ctx, 0, seq_ops, seq_code, seq_outs);
+    optimize (ss, ctx, 1, one_ops, one_code, one_outs);
+    double par_time = optimize (ss, ctx, nthreads, par_ops, par_code, par_outs);
+    optimize (ss, ctx, nthreads, again_ops, again_code, again_outs);
+    OIIO_CHECK_EQUAL (seq_ops, one_ops);
+    OIIO_CHECK_EQUAL (seq_ops, par_ops);
+    OIIO_CHECK_EQUAL (par_ops, again_ops);
+    OIIO_CHECK_ASSERT (seq_code.size() && seq_code == one_code);
+    OIIO_CHECK_ASSERT (seq_code == par_code);
+    OIIO_CHECK_ASSERT (par_code == again_code);
+    OIIO_CHECK_ASSERT (seq_outs == one_outs);
+    OIIO_CHECK_ASSERT (seq_outs == par_outs);
+    OIIO_CHECK_ASSERT (par_outs == again_outs);
+
+    // Check the values themselves, at the end of every chain
+    std::vector<float> scales (nchains * chain_length);
+    for (size_t i = 0;  i < scales.size();  ++i)
+        scales[i] = 1.0f + 0.001f * float(i);
+    for (int c = 0;  c < nchains;  ++c) {
+        int last = c * chain_length + chain_length - 1;
+        OIIO_CHECK_EQUAL_THRESH (seq_outs[last],
+                                 chainnode_out (&scales[c * chain_length], chain_length),
+                                 1.0e-4f * std::abs (seq_outs[last]));
+    }
+
+    testbench_report ("  %d layers: sequential %.2f ms, parallel %.2f ms\n",
+                      nchains * chain_length,
+                      seq_time * 1000.0, par_time * 1000.0);
+
+    ss.release_context (ctx);
+    ss.destroy_thread_info (thread_info);
+    return unit_test_failures;
+}
@@ -2,6 +2,9 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include <cstdio>
 #include <cmath>
@@ -104,7 +107,8 @@ RuntimeOptimizer::RuntimeOptimizer (ShadingSystemImpl &shadingsys,
       m_next_newconst(0), m_next_newtemp(0),
       m_stat_opt_locking_time(0), m_stat_specialization_time(0),
       m_stop_optimizing(false),
-      m_raytypes_on(group.raytypes_on()), m_raytypes_off(group.raytypes_off())
+      m_raytypes_on(group.raytypes_on()), m_raytypes_off(group.raytypes_off()),
+      m_unknown_message_sent(false)
 {
     memset ((char *)&m_shaderglobals, 0, sizeof(ShaderGlobals));
     m_shaderglobals.context = shadingcontext();
@@ -145,6 +149,10 @@ RuntimeOptimizer::set_inst (int newlayer)
     m_block_aliases.clear ();
     m_param_aliases.clear ();
     m_bblockids.clear ();
+    // A worker may see the layer at any point of the optimization, so
+    // the names given to new symbols only depend on the layer, whether
+    // or not the group is optimized in parallel.
+    m_next_newconst = m_next_newtemp = (int) inst()->symbols().size();
 }
 
 
@@ -928,7 +936,7 @@ RuntimeOptimizer::simplify_params ()
                     // earlier analysis by find_params_holding_globals?
                     // If so, make sure the global is in this instance's
                     // symbol table, and alias the parameter to it.
-                    ustringmap_t &g (m_params_holding_globals[c.srclayer]);
+                    ustringmap_t &g (params_holding_globals (c.srclayer));
                     auto f = g.find (srcsym->name());
                     if (f != g.end()) {
                         if (debug() > 1)
@@ -1013,7 +1021,7 @@ RuntimeOptimizer::find_params_holding_globals ()
         if (debug() > 1)
             debug_optf("I think that %s.%s will always be %s\n",
                        inst()->layername(), s.name(), src->name());
-        m_params_holding_globals[layer()][s.name()] = src->name();
+        params_holding_globals (layer())[s.name()] = src->name();
     }
 }
 
@@ -1775,6 +1783,8 @@ RuntimeOptimizer::mark_outgoing_connections ()
     FOREACH_PARAM (auto&& s, inst())
         s.connected_down (false);
     for (int lay = layer()+1;  lay < group().nlayers();  ++lay) {
+        if (! layer_in_scope (lay))
+            continue;
         for (auto&& c : group()[lay]->m_connections)
             if (c.srclayer == layer()) {
                 inst()->symbol(c.src.param)->connected_down (true);
@@ -1911,6 +1921,8 @@ RuntimeOptimizer::eliminate_middleman ()
         // connections to src.
         int s_index = inst()->symbolindex(&s);
         for (int laynum = layer()+1;  laynum < group().nlayers();  ++laynum) {
+            if (! layer_in_scope (laynum))
+                continue;
             ShaderInstance *downinst = group()[laynum];
             for (int i = 0, e = downinst->nconnections();  i < e;  ++i) {
                 Connection &c = downinst->connections()[i];
@@ -2823,6 +2835,8 @@ RuntimeOptimizer::collapse_syms ()
 
     // Fix downstream connections that reference us
     for (int lay = layer()+1;  lay < group().nlayers();  ++lay) {
+        if (! layer_in_scope (lay))
+            continue;
         for (auto&& c : group()[lay]->m_connections)
             if (c.srclayer == layer())
                 c.src.param = symbol_remap[c.src.param];
@@ -3019,6 +3033,131 @@ RuntimeOptimizer::printinst (std::ostream &out) const
 
 
 
+int
+RuntimeOptimizer::parallel_layer_threads () const
+{
+    int nthreads = shadingsys().m_opt_parallel_layers;
+    if (nthreads < 0)  // -1 means use all hardware available
+        nthreads = (int)std::thread::hardware_concurrency();
+    if (nthreads <= 1)
+        return 1;
+    // Debugging output must come out in layer order, and groups being
+    // compiled by compile_all_groups already have all the threads.
+    if (shadingsys().debug() || !shadingsys().debug_groupname().empty()
+          || !shadingsys().debug_layername().empty()
+          || !shadingsys().m_opt_layername.empty()
+          || shadingsys().m_threads_currently_compiling)
+        return 1;
+    // Messages set by one layer are seen by all later ones, connected or
+    // not, so a group that sets any must be done in order.
+    for (int layer = 0, n = group().nlayers();  layer < n;  ++layer)
+        for (auto&& op : group()[layer]->ops())
+            if (op.opname() == u_setmessage)
+                return 1;
+    return nthreads;
+}
+
+
+
+std::vector<std::vector<int>>
+RuntimeOptimizer::layer_components () const
+{
+    // Union-find over the connections, always keeping the lowest layer
+    // of a set as its root.
+    int nlayers = group().nlayers();
+    std::vector<int> root (nlayers);
+    for (int layer = 0;  layer < nlayers;  ++layer)
+        root[layer] = layer;
+    auto find = [&](int layer) -> int {
+        while (root[layer] != layer)
+            layer = root[layer] = root[root[layer]];
+        return layer;
+    };
+    for (int layer = 0;  layer < nlayers;  ++layer) {
+        for (auto&& c : group()[layer]->connections()) {
+            int a = find (layer), b = find (c.srclayer);
+            if (a != b)
+                root[std::max(a,b)] = std::min(a,b);
+        }
+    }
+    std::vector<std::vector<int>> components;
+    std::vector<int> component_of (nlayers, -1);
+    for (int layer = 0;  layer < nlayers;  ++layer) {
+        int r = find (layer);
+        if (component_of[r] < 0) {
+            component_of[r] = (int)components.size();
+            components.emplace_back ();
+        }
+        components[component_of[r]].push_back (layer);
+    }
+    return components;
+}
+
+
+
+void
+RuntimeOptimizer::for_each_component (int nthreads, const LayersFunc &func)
+{
+    std::vector<std::vector<int>> components;
+    if (nthreads > 1)
+        components = layer_components ();
+    if (components.size() < 2) {
+        std::vector<int> layers (group().nlayers());
+        for (int layer = 0;  layer < group().nlayers();  ++layer)
+            layers[layer] = layer;
+        func (*this, layers);
+        return;
+    }
+
+    // Hand out the biggest parts first, so that one big part isn't left
+    // for last. Which thread does which part can't change the result.
+    std::vector<std::pair<size_t,size_t>> order;  // (nops, component)
+    for (size_t i = 0;  i < components.size();  ++i) {
+        size_t nops = 0;
+        for (int layer : components[i])
+            nops += group()[layer]->ops().size();
+        order.emplace_back (nops, i);
+    }
+    std::stable_sort (order.begin(), order.end(),
+                      [](const std::pair<size_t,size_t> &a,
+                         const std::pair<size_t,size_t> &b) {
+                          return a.first > b.first;
+                      });
+    nthreads = std::min (nthreads, (int)components.size());
+
+    // Each worker gets its own optimizer, limited to the layers of the
+    // part it is working on.
+    std::atomic<size_t> cursor (0);
+    auto worker = [&](ShadingContext *ctx) {
+        RuntimeOptimizer rop (shadingsys(), group(), ctx);
+        rop.m_parent = this;
+        rop.m_layer_in_scope.resize (group().nlayers(), 0);
+        size_t i;
+        while ((i = cursor++) < order.size()) {
+            const std::vector<int> &layers (components[order[i].second]);
+            for (int layer : layers)
+                rop.m_layer_in_scope[layer] = 1;
+            func (rop, layers);
+            for (int layer : layers)
+                rop.m_layer_in_scope[layer] = 0;
+        }
+    };
+    OIIO::thread_pool *pool = OIIO::default_thread_pool();
+    OIIO::task_set tasks (pool);
+    for (int t = 1;  t < nthreads;  ++t)
+        tasks.push (pool->push ([&](int /*id*/){
+            PerThreadInfo *threadinfo = shadingsys().create_thread_info();
+            ShadingContext *ctx = shadingsys().get_context(threadinfo);
+            worker (ctx);
+            shadingsys().release_context(ctx);
+            shadingsys().destroy_thread_info(threadinfo);
+        }));
+    worker (shadingcontext());
+    tasks.wait ();
+}
+
+
+
 void
 RuntimeOptimizer::run ()
 {
@@ -3062,54 +3201,70 @@ RuntimeOptimizer::run ()
     // assume the layer is unused.
     check_for_error_calls(false);
 
+    // Layers only ever see the layers connected to them, so the parts of
+    // the network that aren't connected to each other may be optimized
+    // on separate threads. Each pass below is done a whole part at a
+    // time, in the same order within it as for the whole group.
+    int nthreads = parallel_layer_threads ();
+
     // Optimize each layer, from first to last
-    for (int layer = 0;  layer < nlayers;  ++layer) {
-        set_inst (layer);
-        if (inst()->unused())
-            continue;
-        // N.B. we need to resolve isconnected() calls before the instance
-        // is otherwise optimized, or else isconnected() may not reflect
-        // the original connectivity after substitutions are made.
-        resolve_isconnected ();
-        optimize_instance ();
-    }
+    for_each_component (nthreads, [](RuntimeOptimizer &rop,
+                                     const std::vector<int> &layers) {
+        for (int layer : layers) {
+            rop.set_inst (layer);
+            if (rop.inst()->unused())
+                continue;
+            // N.B. we need to resolve isconnected() calls before the
+            // instance is otherwise optimized, or else isconnected() may
+            // not reflect the original connectivity after substitutions
+            // are made.
+            rop.resolve_isconnected ();
+            rop.optimize_instance ();
+        }
+    });
     check_for_error_calls(false);  // re-check
 
     // Optimize each layer again, from last to first (because some
     // optimizations are only apparent when the subsequent shaders have
     // been simplified).
-    for (int layer = nlayers-1;  layer >= 0;  --layer) {
-        set_inst (layer);
-        if (! inst()->unused())
-            optimize_instance ();
-    }
+    for_each_component (nthreads, [](RuntimeOptimizer &rop,
+                                     const std::vector<int> &layers) {
+        for (auto l = layers.rbegin();  l != layers.rend();  ++l) {
+            rop.set_inst (*l);
+            if (! rop.inst()->unused())
+                rop.optimize_instance ();
+        }
+    });
 
     // Try merging instances again, now that we've optimized
     shadingsys().merge_instances (group(), true);
 
-    for (int layer = nlayers-1;  layer >= 0;  --layer) {
-        set_inst (layer);
-        if (inst()->unused())
-            continue;
-        find_basic_blocks ();
-        track_variable_dependencies ();
-
-        // For our parameters that require derivatives, mark their
-        // upstream connections as also needing derivatives.
-        for (auto&& c : inst()->m_connections) {
-            if (inst()->symbol(c.dst.param)->has_derivs()) {
-                Symbol *source = group()[c.srclayer]->symbol(c.src.param);
-                if (source->typespec().elementtype().is_float_based())
-                    source->has_derivs (true);
+    for_each_component (nthreads, [](RuntimeOptimizer &rop,
+                                     const std::vector<int> &layers) {
+        for (auto l = layers.rbegin();  l != layers.rend();  ++l) {
+            rop.set_inst (*l);
+            if (rop.inst()->unused())
+                continue;
+            rop.find_basic_blocks ();
+            rop.track_variable_dependencies ();
+
+            // For our parameters that require derivatives, mark their
+            // upstream connections as also needing derivatives.
+            for (auto&& c : rop.inst()->m_connections) {
+                if (rop.inst()->symbol(c.dst.param)->has_derivs()) {
+                    Symbol *source = rop.group()[c.srclayer]->symbol(c.src.param);
+                    if (source->typespec().elementtype().is_float_based())
+                        source->has_derivs (true);
+                }
             }
         }
-    }
 
-    // Post-opt cleanup: add useparam, coalesce temporaries, etc.
-    for (int layer = 0;  layer < nlayers;  ++layer) {
-        set_inst (layer);
-        post_optimize_instance ();
-    }
+        // Post-opt cleanup: add useparam, coalesce temporaries, etc.
+        for (int layer : layers) {
+            rop.set_inst (layer);
+            rop.post_optimize_instance ();
+        }
+    });
 
     // Last chance to eliminate duplicate instances
     shadingsys().merge_instances (group(), true);
@@ -3118,15 +3273,23 @@ RuntimeOptimizer::run ()
     check_for_error_calls(true);
 
     // Get rid of nop instructions and unused symbols.
+    if (optimize() >= 1) {
+        for_each_component (nthreads, [](RuntimeOptimizer &rop,
+                                         const std::vector<int> &layers) {
+            for (int layer : layers) {
+                rop.set_inst (layer);
+                if (rop.inst()->unused())
+                    continue;
+                rop.collapse_syms ();
+                rop.collapse_ops ();
+            }
+        });
+    }
     size_t new_nsyms = 0, new_nops = 0, new_deriv_syms = 0;
     for (int layer = 0;  layer < nlayers;  ++layer) {
         set_inst (layer);
         if (inst()->unused())
             continue;  // no need to print or gather stats for unused layers
-        if (optimize() >= 1) {
-            collapse_syms ();
-            collapse_ops ();
-        }
         if (debug() && !inst()->unused()) {
             track_variable_lifetimes ();
             std::cout << "After optimizing layer " << layer << " \"" 
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <map>
 #include <set>
@@ -408,7 +409,30 @@ public:
     enum { police_opt_warn = 1, police_gpu_err = 3, police_gpu_err_only = 2 };  // bit field
     bool police(const Opcode& op, string_view msg, int type = police_opt_warn);
 
+    /// Is the layer one this optimizer may look at or modify? A worker
+    /// optimizing one part of the group in parallel stays out of the
+    /// others, which no connection can reach anyway.
+    bool layer_in_scope (int layer) const {
+        return m_layer_in_scope.empty() || m_layer_in_scope[layer];
+    }
+
 private:
+    typedef std::function<void(RuntimeOptimizer &rop,
+                               const std::vector<int> &layers)> LayersFunc;
+
+    /// How many threads may optimize this group's layers at once (1 if
+    /// it must be done sequentially).
+    int parallel_layer_threads () const;
+
+    /// Return the connected components of the group's layer network,
+    /// each a sorted list of layers, ordered by their first layer.
+    std::vector<std::vector<int>> layer_components () const;
+
+    /// Call func(rop,layers) on each connected component of the layer
+    /// network, using up to nthreads worker optimizers at once. With one
+    /// thread (or one component) it is just func(*this, all layers).
+    void for_each_component (int nthreads, const LayersFunc &func);
+
     int m_optimize;                   ///< Current optimization level
     bool m_opt_simplify_param;            ///< Turn instance params into const?
     bool m_opt_constant_fold;             ///< Allow constant folding?
@@ -428,6 +452,15 @@ private:
     typedef std::unordered_map<ustring,ustring,ustringHash> ustringmap_t;
     std::vector<ustringmap_t> m_params_holding_globals;
                    ///< Which params of each layer really just hold globals
+    RuntimeOptimizer *m_parent = nullptr; ///< Group's optimizer, for a worker
+    std::vector<char> m_layer_in_scope;   ///< Layers a worker may touch
+
+    /// The params of the layer known to hold globals, kept by the group's
+    /// optimizer even when a worker is the one asking.
+    ustringmap_t &params_holding_globals (int layer) {
+        return m_parent ? m_parent->params_holding_globals (layer)
+                        : m_params_holding_globals[layer];
+    }
 
     // All below is just for the one inst we're optimizing at the moment:
     int m_pass;                       ///< Optimization pass we're on now
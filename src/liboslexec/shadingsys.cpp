@@ -622,7 +622,7 @@ ShadingSystem::raytype_bit (ustring name)
 void
 ShadingSystem::optimize_all_groups (int nthreads, bool do_jit)
 {
-    return m_impl->optimize_all_groups (nthreads, 0 /*mythread*/, 1 /*totalthreads*/, do_jit);
+    return m_impl->optimize_all_groups (nthreads, do_jit);
 }
 
 
@@ -701,7 +701,7 @@ template<int WidthT>
 void
 ShadingSystem::BatchedExecutor<WidthT>::jit_all_groups (int nthreads)
 {
-    OSL_ASSERT(0 && "To Be Implemented");
+    m_shading_system.m_impl->batched<WidthT>().jit_all_groups(nthreads);
 }
 
 // Explicitly instantiate
@@ -865,7 +865,7 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_error_repeats(false),
       m_range_checking(true),
       m_unknown_coordsys_error(true), m_connection_error(true),
-      m_greedyjit(false), m_countlayerexecs(false),
+      m_greedyjit(false), m_async_jit(0), m_countlayerexecs(false),
       m_relaxed_param_typecheck(false),
       m_max_warnings_per_thread(100),
       m_profile(0),
@@ -885,7 +885,7 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_llvm_jit_aggressive(false),
       m_optimize_nondebug(false),
       m_vector_width(4),
-      m_opt_passes(10),
+      m_opt_passes(10), m_opt_parallel_layers(0),
       m_llvm_optimize(1),
       m_debug(0), m_llvm_debug(0),
       m_llvm_debug_layers(0), m_llvm_debug_ops(0),
@@ -903,6 +903,7 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_force_derivs(false),
       m_allow_shader_replacement(false),
       m_exec_repeat(1),
+      m_group_cache_size(0),
       m_opt_warnings(0),
       m_gpu_opt_error(0),
       m_colorspace("Rec709"),
@@ -910,7 +911,7 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
       m_stat_total_llvm_time(0),
       m_stat_llvm_setup_time(0), m_stat_llvm_irgen_time(0),
       m_stat_llvm_opt_time(0), m_stat_llvm_jit_time(0),
-      m_stat_inst_merge_time(0),
+      m_stat_inst_merge_time(0), m_stat_async_jit_time(0),
       m_stat_max_llvm_local_mem(0)
 {
     m_stat_shaders_loaded = 0;
@@ -924,6 +925,12 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
     m_stat_merged_inst_opt = 0;
     m_stat_empty_groups = 0;
     m_stat_regexes = 0;
+    m_stat_jit_cache_uncacheable = 0;
+    m_stat_groups_quick_jitted = 0;
+    m_stat_groups_hot_swapped = 0;
+    m_stat_group_cache_hits = 0;
+    m_stat_group_cache_misses = 0;
+    m_stat_group_cache_evictions = 0;
     m_stat_preopt_syms = 0;
     m_stat_postopt_syms = 0;
     m_stat_syms_with_derivs = 0;
@@ -935,6 +942,7 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
     m_stat_tex_calls_codegened = 0;
     m_stat_tex_calls_as_handles = 0;
     m_stat_master_load_time = 0;
+    m_stat_master_wait_time = 0;
     m_stat_optimization_time = 0;
     m_stat_getattribute_time = 0;
     m_stat_getattribute_fail_time = 0;
@@ -948,10 +956,13 @@ ShadingSystemImpl::ShadingSystemImpl (RendererServices *renderer,
     m_stat_pointcloud_gets = 0;
     m_stat_pointcloud_writes = 0;
     m_stat_layers_executed = 0;
+    m_stat_heap_clears = 0;
+    m_stat_heap_bytes_cleared = 0;
     m_stat_total_shading_time_ticks = 0;
 
     m_groups_to_compile_count = 0;
     m_threads_currently_compiling = 0;
+    m_stat_compile_wall_time = 0;
 
     // If client didn't supply an error handler, just use the default
     // one that echoes to the terminal.
@@ -1244,6 +1255,17 @@ ShadingSystemImpl::query_closure(const char **name, int *id,
 
 ShadingSystemImpl::~ShadingSystemImpl ()
 {
+    // Stop the async_jit threads. Groups still queued keep their quick
+    // code, which is cleaned up with everything else below.
+    {
+        lock_guard lock (m_async_jit_mutex);
+        m_async_jit_stop = true;
+        m_async_jit_queue.clear ();
+    }
+    m_async_jit_cv.notify_all ();
+    for (auto &thread : m_async_jit_threads)
+        thread.join ();
+
     size_t ngroups = m_all_shader_groups.size();
     for (size_t i = 0;  i < ngroups;  ++i) {
         if (ShaderGroupRef g = m_all_shader_groups[i].lock()) {
@@ -1303,6 +1325,27 @@ osl_simd_caps()
 
 
 
+// Can setting the named option change the code that groups compile to?
+// Statistics, diagnostics, searchpaths, caches and threading can't.
+static bool
+option_shapes_code (string_view name)
+{
+    static const char *runtime_only[] = {
+        "statistics:level", "searchpath:shader", "searchpath:library",
+        "error_repeats", "max_warnings_per_thread", "compile_report",
+        "opt_warnings", "gpu_opt_error", "greedyjit", "async_jit",
+        "relaxed_param_typecheck", "allow_shader_replacement",
+        "group_cache_size", "llvm_jit_cache", "archive_groupname",
+        "archive_filename"
+    };
+    for (const char *n : runtime_only)
+        if (name == n)
+            return false;
+    return true;
+}
+
+
+
 bool
 ShadingSystemImpl::attribute (string_view name, TypeDesc type,
                               const void *val)
@@ -1322,7 +1365,25 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
         return OIIO::optparser (*this, *(const char **)val);
     }
 
+    // Forget the code compiled under the old value of an option that
+    // shapes it. Setting an option to the value it has changes nothing.
+    bool shapes_code = option_shapes_code (name);
+    if (shapes_code && (type == TypeDesc::INT || type == TypeDesc::STRING)) {
+        union { int i; const char *s; } old;
+        if (getattribute (name, type, &old))
+            shapes_code = type == TypeDesc::INT
+                              ? old.i != *(const int *)val
+                              : string_view (old.s) != string_view (*(const char **)val);
+    }
+
     lock_guard guard (m_mutex);  // Thread safety
+    if (shapes_code)
+        group_cache_clear ();
+    if (name == "group_cache_size" && type == TypeDesc::INT) {
+        m_group_cache_size = *(const int *)val;
+        group_cache_trim ();
+        return true;
+    }
     ATTR_SET ("statistics:level", int, m_statslevel);
     ATTR_SET ("debug", int, m_debug);
     ATTR_SET ("lazylayers", int, m_lazylayers);
@@ -1359,6 +1420,7 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
     ATTR_SET_STRING ("llvm_jit_target", m_llvm_jit_target);
     ATTR_SET ("vector_width", int, m_vector_width);
     ATTR_SET ("opt_passes", int, m_opt_passes);
+    ATTR_SET ("opt_parallel_layers", int, m_opt_parallel_layers);
     ATTR_SET ("optimize_nondebug", int, m_optimize_nondebug);
     ATTR_SET ("llvm_optimize", int, m_llvm_optimize);
     ATTR_SET ("llvm_debug", int, m_llvm_debug);
@@ -1385,6 +1447,7 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
     ATTR_SET ("unknown_coordsys_error", int, m_unknown_coordsys_error);
     ATTR_SET ("connection_error", int, m_connection_error);
     ATTR_SET ("greedyjit", int, m_greedyjit);
+    ATTR_SET ("async_jit", int, m_async_jit);
     ATTR_SET ("relaxed_param_typecheck", int, m_relaxed_param_typecheck);
     ATTR_SET ("countlayerexecs", int, m_countlayerexecs);
     ATTR_SET ("max_warnings_per_thread", int, m_max_warnings_per_thread);
@@ -1452,6 +1515,15 @@ ShadingSystemImpl::attribute (string_view name, TypeDesc type,
         }
         return true;
     }
+    if (name == "llvm_jit_cache" && type == TypeDesc::STRING) {
+        // Groups being JITed keep their own reference to the old cache.
+        string_view dir (*(const char **)val);
+        std::shared_ptr<LLVM_Util::ObjectCache> cache;
+        if (dir.size())
+            cache = std::make_shared<LLVM_Util::ObjectCache> (dir);
+        std::atomic_store (&m_llvm_jit_cache, cache);
+        return true;
+    }
     if (name == "error_repeats") {
         // Special case: setting error_repeats also clears the "previously
         // seen" error and warning lists.
@@ -1519,6 +1591,7 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE_STRING ("llvm_jit_target", m_llvm_jit_target);
     ATTR_DECODE ("vector_width", int, m_vector_width);
     ATTR_DECODE ("opt_passes", int, m_opt_passes);
+    ATTR_DECODE ("opt_parallel_layers", int, m_opt_parallel_layers);
     ATTR_DECODE ("optimize_nondebug", int, m_optimize_nondebug);
     ATTR_DECODE ("llvm_optimize", int, m_llvm_optimize);
     ATTR_DECODE ("debug", int, m_debug);
@@ -1536,6 +1609,7 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("unknown_coordsys_error", int, m_unknown_coordsys_error);
     ATTR_DECODE ("connection_error", int, m_connection_error);
     ATTR_DECODE ("greedyjit", int, m_greedyjit);
+    ATTR_DECODE ("async_jit", int, m_async_jit);
     ATTR_DECODE ("countlayerexecs", int, m_countlayerexecs);
     ATTR_DECODE ("relaxed_param_typecheck", int, m_relaxed_param_typecheck);
     ATTR_DECODE ("max_warnings_per_thread", int, m_max_warnings_per_thread);
@@ -1555,6 +1629,7 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("force_derivs", int, m_force_derivs);
     ATTR_DECODE ("allow_shader_replacement", int, m_allow_shader_replacement);
     ATTR_DECODE ("exec_repeat", int, m_exec_repeat);
+    ATTR_DECODE ("group_cache_size", int, m_group_cache_size);
     ATTR_DECODE ("opt_warnings", int, m_opt_warnings);
     ATTR_DECODE ("gpu_opt_error", int, m_gpu_opt_error);
 
@@ -1578,7 +1653,44 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("stat:global_connections", int, m_stat_global_connections);
     ATTR_DECODE ("stat:tex_calls_codegened", int, m_stat_tex_calls_codegened);
     ATTR_DECODE ("stat:tex_calls_as_handles", int, m_stat_tex_calls_as_handles);
+    ATTR_DECODE ("stat:jit_cache_uncacheable", int, m_stat_jit_cache_uncacheable);
+    ATTR_DECODE ("stat:groups_quick_jitted", int, m_stat_groups_quick_jitted);
+    ATTR_DECODE ("stat:groups_hot_swapped", int, m_stat_groups_hot_swapped);
+    ATTR_DECODE ("stat:group_cache_hits", int, m_stat_group_cache_hits);
+    ATTR_DECODE ("stat:group_cache_misses", int, m_stat_group_cache_misses);
+    ATTR_DECODE ("stat:group_cache_evictions", int, m_stat_group_cache_evictions);
+    if (name == "stat:group_cache_entries" && type == TypeDesc::INT) {
+        spin_lock lock (m_group_cache_mutex);
+        *(int *)val = (int) m_group_cache.size();
+        return true;
+    }
+    ATTR_DECODE ("stat:async_jit_time", float, m_stat_async_jit_time);
+    // attribute() may swap the cache concurrently: hold our own reference,
+    // and hand out a ustring that outlives it.
+    std::shared_ptr<LLVM_Util::ObjectCache> jit_cache = llvm_jit_cache();
+    if (name == "llvm_jit_cache" && type == TypeDesc::STRING) {
+        *(const char **)(val) = jit_cache
+                                    ? ustring(jit_cache->directory()).c_str()
+                                    : "";
+        return true;
+    }
+    ATTR_DECODE ("stat:jit_cache_hits", long long, jit_cache ? jit_cache->hits() : 0);
+    ATTR_DECODE ("stat:jit_cache_misses", long long, jit_cache ? jit_cache->misses() : 0);
+    ATTR_DECODE ("stat:jit_cache_bytes_read", long long, jit_cache ? jit_cache->bytes_read() : 0);
+    ATTR_DECODE ("stat:jit_cache_bytes_written", long long, jit_cache ? jit_cache->bytes_written() : 0);
+    ATTR_DECODE ("stat:jit_cache_write_failures", long long, jit_cache ? jit_cache->write_failures() : 0);
     ATTR_DECODE ("stat:master_load_time", float, m_stat_master_load_time);
+    ATTR_DECODE ("stat:master_wait_time", float, m_stat_master_wait_time);
+    if (name == "stat:master_load_time_max" && type == TypeDesc::FLOAT) {
+        // The busiest loading thread, which bounds the time spent loading
+        // when the loads run concurrently.
+        spin_lock lock (m_stat_mutex);
+        float busiest = 0.0f;
+        for (auto&& t : m_stat_master_load_time_thread)
+            busiest = std::max (busiest, float(t.second));
+        *(float *)val = busiest;
+        return true;
+    }
     ATTR_DECODE ("stat:optimization_time", float, m_stat_optimization_time);
     ATTR_DECODE ("stat:opt_locking_time", float, m_stat_opt_locking_time);
     ATTR_DECODE ("stat:specialization_time", float, m_stat_specialization_time);
@@ -1590,6 +1702,8 @@ ShadingSystemImpl::getattribute (string_view name, TypeDesc type,
     ATTR_DECODE ("stat:inst_merge_time", float, m_stat_inst_merge_time);
     ATTR_DECODE ("stat:getattribute_calls", long long, m_stat_getattribute_calls);
     ATTR_DECODE ("stat:get_userdata_calls", long long, m_stat_get_userdata_calls);
+    ATTR_DECODE ("stat:heap_clears", long long, m_stat_heap_clears);
+    ATTR_DECODE ("stat:heap_bytes_cleared", long long, m_stat_heap_bytes_cleared);
     ATTR_DECODE ("stat:noise_calls", long long, m_stat_noise_calls);
     ATTR_DECODE ("stat:pointcloud_searches", long long, m_stat_pointcloud_searches);
     ATTR_DECODE ("stat:pointcloud_gets", long long, m_stat_pointcloud_gets);
@@ -2021,6 +2135,7 @@ ShadingSystemImpl::getstats (int level) const
     INTOPT (llvm_optimize);
     INTOPT (debug);
     INTOPT (profile);
+    INTOPT (async_jit);
     INTOPT (llvm_debug);
     BOOLOPT (llvm_debug_layers);
     BOOLOPT (llvm_debug_ops);
@@ -2064,11 +2179,13 @@ ShadingSystemImpl::getstats (int level) const
     INTOPT (vector_width);
     STROPT (llvm_jit_target);
     INTOPT  (opt_passes);
+    INTOPT  (opt_parallel_layers);
     INTOPT (no_noise);
     INTOPT (no_pointcloud);
     INTOPT (force_derivs);
     INTOPT (allow_shader_replacement);
     INTOPT (exec_repeat);
+    INTOPT (group_cache_size);
     INTOPT (opt_warnings);
     INTOPT (gpu_opt_error);
     STROPT (debug_groupname);
@@ -2111,6 +2228,21 @@ ShadingSystemImpl::getstats (int level) const
     out << "    Instances: " << m_stat_instances << "\n";
     out << "  Time loading masters: "
         << Strutil::timeintervalformat (m_stat_master_load_time, 2) << "\n";
+    {
+        // Masters load concurrently, so break the time down by thread
+        spin_lock lock (m_stat_mutex);
+        if (m_stat_master_load_time_thread.size() > 1) {
+            out << Strutil::sprintf ("    Loaded by %d threads:\n",
+                                     (int)m_stat_master_load_time_thread.size());
+            int t = 0;
+            for (auto&& thread : m_stat_master_load_time_thread)
+                out << Strutil::sprintf ("      thread %2d:        ", t++)
+                    << Strutil::timeintervalformat (thread.second, 2) << "\n";
+        }
+        if (m_stat_master_wait_time > 0.0)
+            out << "    Waiting on other threads' loads: "
+                << Strutil::timeintervalformat (m_stat_master_wait_time, 2) << "\n";
+    }
     out << "  Shading groups:   " << m_stat_groups << "\n";
     out << "    Total instances in all groups: " << m_stat_groupinstances << "\n";
     float iperg = (float)m_stat_groupinstances/std::max((int)m_stat_groups,1);
@@ -2119,6 +2251,10 @@ ShadingSystemImpl::getstats (int level) const
     out << "  Shading contexts: " << m_stat_contexts << "\n";
     if (m_countlayerexecs)
         out << "  Total layers executed: " << m_stat_layers_executed << "\n";
+    if (m_stat_heap_clears)
+        out << "  Heap cleared per execute: "
+            << Strutil::memformat (m_stat_heap_bytes_cleared / m_stat_heap_clears)
+            << " (" << m_stat_heap_clears << " executes)\n";
 
 #if 0
     long long totalexec = m_layers_executed_uncond + m_layers_executed_lazy +
@@ -2186,6 +2322,52 @@ ShadingSystemImpl::getstats (int level) const
             << Strutil::timeintervalformat (m_stat_llvm_jit_time, 2) << "\n";
     }
 
+    if (m_stat_compile_wall_time > 0.0) {
+        // Busy time of each compile_all_groups worker, so the balance of
+        // the parallel optimize/JIT passes can be judged.
+        spin_lock lock (m_stat_mutex);
+        double busy = 0.0;
+        for (double t : m_stat_compile_thread_busy)
+            busy += t;
+        out << "  Parallel group compile: "
+            << Strutil::timeintervalformat (m_stat_compile_wall_time, 2)
+            << Strutil::sprintf (" wall, %d workers, %.1f%% busy\n",
+                                 (int)m_stat_compile_thread_busy.size(),
+                                 100.0 * busy / (m_stat_compile_wall_time
+                                                 * m_stat_compile_thread_busy.size()));
+        for (size_t t = 0;  t < m_stat_compile_thread_busy.size();  ++t)
+            out << Strutil::sprintf ("    worker %2d busy:             ", (int)t)
+                << Strutil::timeintervalformat (m_stat_compile_thread_busy[t], 2) << "\n";
+    }
+
+    if (m_stat_groups_quick_jitted) {
+        out << Strutil::sprintf ("  Async JIT: %d groups quick-JITed, %d swapped to optimized code\n",
+                                 (int)m_stat_groups_quick_jitted,
+                                 (int)m_stat_groups_hot_swapped);
+        out << "    background JIT time:       "
+            << Strutil::timeintervalformat (m_stat_async_jit_time, 2) << "\n";
+    }
+
+    if (m_group_cache_size > 0) {
+        spin_lock lock (m_group_cache_mutex);
+        out << Strutil::sprintf ("  Group cache: %d of %d entries, hits %d, misses %d, evictions %d\n",
+                                 (int)m_group_cache.size(), m_group_cache_size,
+                                 (int)m_stat_group_cache_hits,
+                                 (int)m_stat_group_cache_misses,
+                                 (int)m_stat_group_cache_evictions);
+    }
+
+    if (std::shared_ptr<LLVM_Util::ObjectCache> cache = llvm_jit_cache()) {
+        out << "  JIT object cache: " << cache->directory() << "\n";
+        out << Strutil::sprintf ("    hits %lld, misses %lld, uncacheable %d\n",
+                                 cache->hits(), cache->misses(),
+                                 (int)m_stat_jit_cache_uncacheable);
+        out << "    read " << Strutil::memformat (cache->bytes_read())
+            << ", wrote " << Strutil::memformat (cache->bytes_written());
+        if (cache->write_failures())
+            out << " (" << cache->write_failures() << " failed writes)";
+        out << "\n";
+    }
     out << "  Texture calls compiled: "
         << (int)m_stat_tex_calls_codegened
         << " (" << (int)m_stat_tex_calls_as_handles << " used handles)\n";
@@ -2345,6 +2527,25 @@ ShadingSystemImpl::ShaderGroupEnd (ShaderGroup& group)
     // up as a major bottleneck, I'm inclined to play it safe.
     lock_guard lock (m_mutex);
 
+    finish_group_layers (group, true);
+
+    ustring groupname = group.name();
+    if (groupname.size() && groupname == m_archive_groupname) {
+        std::string filename = m_archive_filename.string();
+        if (! filename.size())
+            filename = OIIO::Filesystem::filename (groupname.string()) + ".tar.gz";
+        archive_shadergroup (group, filename);
+    }
+
+    group.m_complete = true;
+    return true;
+}
+
+
+
+void
+ShadingSystemImpl::finish_group_layers (ShaderGroup &group, bool merge)
+{
     // Mark the layers that can be run lazily
     if (! group.m_group_use.empty()) {
         int nlayers = group.nlayers ();
@@ -2357,7 +2558,7 @@ ShadingSystemImpl::ShaderGroupEnd (ShaderGroup& group)
 
         // Merge instances now if they really want it bad, otherwise wait
         // until we optimize the group.
-        if (m_opt_merge_instances >= 2)
+        if (merge && m_opt_merge_instances >= 2)
             merge_instances (group);
     }
 
@@ -2369,17 +2570,6 @@ ShadingSystemImpl::ShaderGroupEnd (ShaderGroup& group)
     }
     // std::cout << "Group " << group.name() << " ray query bits "
     //         << group.m_raytype_queries << "\n";
-
-    ustring groupname = group.name();
-    if (groupname.size() && groupname == m_archive_groupname) {
-        std::string filename = m_archive_filename.string();
-        if (! filename.size())
-            filename = OIIO::Filesystem::filename (groupname.string()) + ".tar.gz";
-        archive_shadergroup (group, filename);
-    }
-
-    group.m_complete = true;
-    return true;
 }
 
 
@@ -2402,6 +2592,21 @@ ShadingSystemImpl::Shader (string_view shaderusage,
 bool
 ShadingSystemImpl::Shader (ShaderGroup& group, string_view shaderusage,
                            string_view shadername, string_view layername)
+{
+    bool first = group.m_group_use.empty();
+    if (! add_layer (group, shaderusage, shadername, layername))
+        return false;
+    if (first)
+        m_stat_groups += 1;
+    m_stat_groupinstances += 1;
+    return true;
+}
+
+
+
+bool
+ShadingSystemImpl::add_layer (ShaderGroup& group, string_view shaderusage,
+                              string_view shadername, string_view layername)
 {
     ShaderMaster::ref master = loadshader (shadername);
     if (! master) {
@@ -2434,7 +2639,6 @@ ShadingSystemImpl::Shader (ShaderGroup& group, string_view shaderusage,
     if (group.m_group_use.empty()) {
         // First in a group
         group.clear ();
-        m_stat_groups += 1;
         group.m_group_use = shaderusage;
     } else if (shaderusage != group.m_group_use) {
         errorf("Shader usage \"%s\" does not match current group (%s)\n"
@@ -2444,7 +2648,6 @@ ShadingSystemImpl::Shader (ShaderGroup& group, string_view shaderusage,
     }
 
     group.append (instance);
-    m_stat_groupinstances += 1;
 
     // FIXME -- check for duplicate layer name within the group?
 
@@ -2580,6 +2783,17 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
                                      string_view groupspec)
 {
     ShaderGroupRef g = ShaderGroupBegin (groupname);
+    if (! parse_group_spec (*g, usage, groupspec, true))
+        return ShaderGroupRef();
+    return g;
+}
+
+
+
+bool
+ShadingSystemImpl::parse_group_spec (ShaderGroup &g, string_view usage,
+                                     string_view groupspec, bool count_stats)
+{
     bool err = false;
     std::string errdesc;
     string_view errstatement;
@@ -2601,7 +2815,8 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
             string_view shadername = Strutil::parse_identifier (p);
             Strutil::skip_whitespace (p);
             string_view layername = Strutil::parse_until (p, " \t\r\n,;");
-            bool ok = Shader (*g, usage, shadername, layername);
+            bool ok = count_stats ? Shader (g, usage, shadername, layername)
+                                  : add_layer (g, usage, shadername, layername);
             if (!ok) {
                 errstatement = pstart;
                 err = true;
@@ -2621,7 +2836,7 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
             string_view lay2 = Strutil::parse_until (p, " \t\r\n.");
             Strutil::parse_char (p, '.');
             string_view param2 = Strutil::parse_until (p, " \t\r\n,;");
-            bool ok = ConnectShaders (*g, lay1, param1, lay2, param2);
+            bool ok = ConnectShaders (g, lay1, param1, lay2, param2);
             if (!ok) {
                 errstatement = pstart;
                 err = true;
@@ -2804,11 +3019,11 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
 
         bool ok = true;
         if (type.basetype == TypeDesc::INT) {
-            ok = Parameter (*g, paramname, type, &intvals[0], lockgeom);
+            ok = Parameter (g, paramname, type, &intvals[0], lockgeom);
         } else if (type.basetype == TypeDesc::FLOAT) {
-            ok = Parameter (*g, paramname, type, &floatvals[0], lockgeom);
+            ok = Parameter (g, paramname, type, &floatvals[0], lockgeom);
         } else if (type.basetype == TypeDesc::STRING) {
-            ok = Parameter (*g, paramname, type, &stringvals[0], lockgeom);
+            ok = Parameter (g, paramname, type, &stringvals[0], lockgeom);
         }
         if (!ok) {
             errstatement = pstart;
@@ -2834,7 +3049,7 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
         std::string msg = Strutil::sprintf(
                 "ShaderGroupBegin: error parsing group description: %s\n"
                 "        group: %s",
-                errdesc, g->name());
+                errdesc, g.name());
         if (errstatement.empty()) {
             size_t offset = p.data() - groupspec.data();
             size_t begin_stmt = std::min (groupspec.find_last_of (';', offset),
@@ -2848,10 +3063,10 @@ ShadingSystemImpl::ShaderGroupBegin (string_view groupname,
         errorf("%s", msg);
         if (debug())
             infof("Broken group was:\n---%s\n---\n", groupspec);
-        return ShaderGroupRef();
+        return false;
     }
 
-    return g;
+    return true;
 }
 
 
@@ -2861,6 +3076,74 @@ ShadingSystemImpl::ReParameter (ShaderGroup &group, string_view layername_,
                                 string_view paramname,
                                 TypeDesc type, const void *val)
 {
+    // A group that went through the group cache (it has a pristine spec)
+    // may share its optimized layers, and the parameter storage its code
+    // reads, with the cache and with other groups given the same code.
+    if (group.m_pristine_spec.size()) {
+        lock_guard lock (group.m_mutex);
+        if (group.optimized()) {
+            // A lockgeom=0 parameter is read from the layer at run time,
+            // so it can still be set in place, as without the cache, once
+            // the group is the only user of the layer.
+            int layerindex = group.find_layer (ustring(layername_));
+            if (layerindex < 0)
+                return false;   // could not find the named layer
+            ShaderInstance *layer = group[layerindex];
+            int paramindex = layer->findparam (ustring(paramname));
+            if (paramindex < 0)
+                return false;   // could not find the named parameter
+            Symbol *sym = layer->symbol (paramindex);
+            if (sym && ! sym->lockgeom() && equivalent(sym->typespec(), type)
+                && group_cache_unshare (group_cache_key (group), group,
+                                        layerindex)) {
+                memcpy (sym->data(), val, type.size());
+                // The spec no longer describes the group, which is now
+                // compiled by itself as it would be without the cache.
+                group.m_pristine_spec.clear ();
+                return true;
+            }
+            // Otherwise rebuild the unoptimized group, with layers of its
+            // own, to be compiled again or given cached code at its next
+            // execution. The layers are built straight from the spec, not
+            // through ShaderGroupBegin/End, so that they don't count as a
+            // new group; the spec was taken after ShaderGroupEnd merged
+            // the group's instances, so there is nothing more to merge.
+            auto fresh = std::make_shared<ShaderGroup> (group.name());
+            if (! parse_group_spec (*fresh, group.m_group_use,
+                                    group.m_pristine_spec, false))
+                return false;
+            finish_group_layers (*fresh, false);
+            for (int i = 0, e = group.nlayers();  i < e;  ++i)
+                if (group.num_entry_layers() && group[i]->entry_layer())
+                    fresh->mark_entry_layer (group[i]->layername());
+            // An optimized JIT still queued for the old state is moot.
+            unqueue_async_jit (group);
+            group.reset_unoptimized (*fresh);
+            ++m_groups_to_compile_count;   // it needs compiling again
+        }
+        // Set the instance value of the unoptimized layer, as Parameter()
+        // would have.
+        int layerindex = group.find_layer (ustring(layername_));
+        if (layerindex < 0)
+            return false;   // could not find the named layer
+        ShaderInstance *layer = group[layerindex];
+        int paramindex = layer->findparam (ustring(paramname));
+        if (paramindex < 0)
+            return false;   // could not find the named parameter
+        const Symbol *sym = layer->mastersymbol (paramindex);
+        if (sym->typespec().is_closure_based()
+            || sym->typespec().is_structure_based())
+            return false;
+        TypeDesc paramtype = sym->typespec().simpletype();
+        if (paramtype.is_unsized_array())
+            paramtype.arraylen = layer->instoverride(paramindex)->arraylen();
+        if (!equivalent(paramtype, type))
+            return false;
+        memcpy (layer->param_storage (paramindex), val, type.size());
+        layer->instoverride(paramindex)->valuesource (Symbol::InstanceVal);
+        return true;
+    }
+
     // Find the named layer
     ustring layername (layername_);
     ShaderInstance *layer = NULL;
@@ -3186,7 +3469,8 @@ ShadingSystemImpl::group_post_jit_cleanup (ShaderGroup &group)
 
 
 void
-ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool do_jit)
+ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx,
+                                   bool do_jit, bool quick_jit)
 {
     if (ctx) {
         // Always have ShadingContext remember the group we just optimized
@@ -3228,6 +3512,29 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
 
     double locking_time = timer();
 
+    // With the group cache on, a group in a state that was compiled
+    // before -- by this group before a ReParameter, or by another group
+    // built the same way -- takes that code instead of being compiled
+    // again.
+    std::string cache_key;
+    if (m_group_cache_size > 0 && !group.optimized() && do_jit) {
+        group.m_pristine_spec = group.serialize_nolock ();
+        cache_key = group_cache_key (group);
+        if (group_cache_find (cache_key, group)) {
+            m_stat_group_cache_hits += 1;
+            m_groups_to_compile_count -= 1;
+            spin_lock stat_lock (m_stat_mutex);
+            m_stat_opt_locking_time += locking_time;
+            m_stat_optimization_time += timer();
+            return;
+        }
+        m_stat_group_cache_misses += 1;
+    } else if (!group.optimized()) {
+        // Compiled by itself: its layers are its own, and a spec left from
+        // an earlier trip through the cache would be stale.
+        group.m_pristine_spec.clear ();
+    }
+
     bool ctx_allocated = false;
     PerThreadInfo *thread_info = nullptr;
     if (! ctx) {
@@ -3283,7 +3590,15 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
     }
 
     if (need_jit) {
+        // In async mode, give the caller quick-JITed code now and leave
+        // the expensive LLVM optimization to the async_jit threads, which
+        // need a reference to keep the group alive.
+        ShaderGroupRef async_group;
+        if (quick_jit && m_async_jit > 0 && ! renderer()->supports ("OptiX"))
+            async_group = group.shared_from_this ();
+
         BackendLLVM lljitter (*this, group, ctx);
+        lljitter.quick_jit (async_group != nullptr);
         lljitter.run ();
 
         // NOTE: it is now possible to optimize and not JIT
@@ -3293,13 +3608,28 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
         // Only cleanup when are not batching or if
         // the batch jit has already happened,
         // as it requires the ops so we can't delete them yet!
-        if (((renderer()->batched(WidthOf<16>()) == nullptr) &&
-             (renderer()->batched(WidthOf<8>()) == nullptr))
-            || group.batch_jitted()) {
+        // The optimized JIT of an async group needs them too.
+        if (async_group) {
+            group.m_async_jit_pending = true;
+            m_stat_groups_quick_jitted += 1;
+            queue_async_jit (async_group);
+        } else if (((renderer()->batched(WidthOf<16>()) == nullptr) &&
+                    (renderer()->batched(WidthOf<8>()) == nullptr))
+                   || group.batch_jitted()) {
             group_post_jit_cleanup (group);
         }
 
         group.m_jitted = true;
+
+        // Cache only finished groups. Those still waiting for their
+        // optimized JIT, or for a batched JIT that needs their ops, would
+        // have their shared layers changed under the cache.
+        if (cache_key.size() && !group.m_async_jit_pending
+            && (((renderer()->batched(WidthOf<16>()) == nullptr) &&
+                 (renderer()->batched(WidthOf<8>()) == nullptr))
+                || group.batch_jitted()))
+            group_cache_insert (cache_key, group);
+
         spin_lock stat_lock (m_stat_mutex);
         m_stat_opt_locking_time += locking_time;
         m_stat_optimization_time += timer();
@@ -3322,6 +3652,189 @@ ShadingSystemImpl::optimize_group (ShaderGroup &group, ShadingContext *ctx, bool
     m_groups_to_compile_count -= 1;
 }
 
+std::string
+ShadingSystemImpl::group_cache_key (const ShaderGroup &group) const
+{
+    std::string key = group.m_pristine_spec;
+    key += Strutil::sprintf ("# usage %s raytypes %d %d\n", group.m_group_use,
+                             group.raytypes_on(), group.raytypes_off());
+    // The spec names masters only by shader name, which a replaced master
+    // (allow_shader_replacement) keeps. Entries hold on to their masters,
+    // so an address can't be reused while a key naming it is cached.
+    for (int i = 0, nl = group.nlayers();  i < nl;  ++i)
+        key += Strutil::sprintf ("# master %p\n", (const void *)group[i]->master());
+    for (int i = 0, nl = group.nlayers();  i < nl;  ++i)
+        if (group.num_entry_layers() && group[i]->entry_layer())
+            key += Strutil::sprintf ("# entry %s\n", group[i]->layername());
+    for (auto&& name : group.m_renderer_outputs)
+        key += Strutil::sprintf ("# output %s\n", name);
+    return key;
+}
+
+
+
+bool
+ShadingSystemImpl::group_cache_find (const std::string &key, ShaderGroup &group)
+{
+    spin_lock lock (m_group_cache_mutex);
+    auto found = m_group_cache_index.find (key);
+    if (found == m_group_cache_index.end())
+        return false;
+    // Move it to the front, as the most recently used
+    m_group_cache.splice (m_group_cache.begin(), m_group_cache, found->second);
+    // Share its layers under the lock, so that group_cache_unshare sees
+    // every group using them.
+    group.copy_optimized (*found->second->second);
+    return true;
+}
+
+
+
+bool
+ShadingSystemImpl::group_cache_unshare (const std::string &key,
+                                        ShaderGroup &group, int layer)
+{
+    std::shared_ptr<ShaderGroup> entry;   // freed after we let go of the lock
+    spin_lock lock (m_group_cache_mutex);
+    auto found = m_group_cache_index.find (key);
+    bool cached = found != m_group_cache_index.end()
+        && found->second->second->m_layers[layer] == group.m_layers[layer];
+    if (group.m_layers[layer].use_count() != (cached ? 2 : 1))
+        return false;   // other groups use the layer too
+    if (cached) {
+        entry = found->second->second;
+        m_group_cache.erase (found->second);
+        m_group_cache_index.erase (found);
+    }
+    return true;
+}
+
+
+
+void
+ShadingSystemImpl::group_cache_insert (const std::string &key,
+                                       const ShaderGroup &group)
+{
+    // The entry only holds the optimized state; its name is for debugging.
+    auto entry = std::make_shared<ShaderGroup> (group.name());
+    entry->copy_optimized (group);
+    {
+        spin_lock lock (m_group_cache_mutex);
+        if (m_group_cache_index.count (key))
+            return;   // another group with the same key got there first
+        m_group_cache.emplace_front (key, entry);
+        m_group_cache_index[key] = m_group_cache.begin();
+    }
+    group_cache_trim ();
+}
+
+
+
+void
+ShadingSystemImpl::group_cache_trim ()
+{
+    GroupCacheList evicted;   // freed after we let go of the lock
+    spin_lock lock (m_group_cache_mutex);
+    while ((int)m_group_cache.size() > std::max (m_group_cache_size, 0)) {
+        m_group_cache_index.erase (m_group_cache.back().first);
+        evicted.splice (evicted.end(), m_group_cache, std::prev (m_group_cache.end()));
+        m_stat_group_cache_evictions += 1;
+    }
+}
+
+
+
+void
+ShadingSystemImpl::group_cache_clear ()
+{
+    GroupCacheList entries;   // freed after we let go of the lock
+    spin_lock lock (m_group_cache_mutex);
+    m_group_cache_index.clear ();
+    m_group_cache.swap (entries);
+}
+
+
+
+void
+ShadingSystemImpl::queue_async_jit (ShaderGroupRef group)
+{
+    lock_guard lock (m_async_jit_mutex);
+    m_async_jit_queue.push_back (group);
+    while ((int)m_async_jit_threads.size() < m_async_jit)
+        m_async_jit_threads.emplace_back (&ShadingSystemImpl::async_jit_worker, this);
+    m_async_jit_cv.notify_one ();
+}
+
+
+
+void
+ShadingSystemImpl::unqueue_async_jit (ShaderGroup &group)
+{
+    lock_guard lock (m_async_jit_mutex);
+    auto end = std::remove_if (m_async_jit_queue.begin(), m_async_jit_queue.end(),
+                               [&](const ShaderGroupRef &g){ return g.get() == &group; });
+    m_async_jit_queue.erase (end, m_async_jit_queue.end());
+    group.m_async_jit_pending = false;
+}
+
+
+
+void
+ShadingSystemImpl::async_jit_worker ()
+{
+    PerThreadInfo *threadinfo = create_thread_info();
+    ShadingContext *ctx = get_context(threadinfo);
+    for (;;) {
+        ShaderGroupRef group;
+        {
+            std::unique_lock<mutex> lock (m_async_jit_mutex);
+            m_async_jit_cv.wait (lock, [this](){
+                return m_async_jit_stop || ! m_async_jit_queue.empty();
+            });
+            if (m_async_jit_stop)
+                break;
+            group = m_async_jit_queue.front();
+            m_async_jit_queue.pop_front();
+        }
+
+        // JIT the group again at the full optimization level. Both
+        // versions lay out the groupdata identically, so BackendLLVM can
+        // swap the entry points while other threads are running the
+        // quick code, and an execution may even mix the two. A group
+        // reset by ReParameter since it was queued has no optimized
+        // state left to JIT; it will be compiled afresh.
+        OIIO::Timer timer;
+        lock_guard lock (group->m_mutex);
+        if (! group->optimized() || ! group->m_async_jit_pending)
+            continue;
+        BackendLLVM lljitter (*this, *group, ctx);
+        lljitter.run ();
+        group->m_async_jit_pending = false;
+        bool finished = ((renderer()->batched(WidthOf<16>()) == nullptr) &&
+                         (renderer()->batched(WidthOf<8>()) == nullptr))
+                        || group->batch_jitted();
+        if (finished)
+            group_post_jit_cleanup (*group);
+
+        // optimize_group skipped the cache while the group was pending.
+        // Its pristine spec is only set when the group went through the
+        // cache lookup.
+        if (finished && m_group_cache_size > 0
+            && group->m_pristine_spec.size())
+            group_cache_insert (group_cache_key (*group), *group);
+
+        // The quick JIT already counted the group's codegen stats; the
+        // time of the re-run only goes to async_jit_time.
+        m_stat_groups_hot_swapped += 1;
+        spin_lock stat_lock (m_stat_mutex);
+        m_stat_async_jit_time += timer();
+    }
+    release_context(ctx);
+    destroy_thread_info(threadinfo);
+}
+
+
+
 template <int WidthT>
 void
 ShadingSystemImpl::Batched<WidthT>::jit_group (ShaderGroup &group, ShadingContext *ctx)
@@ -3369,7 +3882,7 @@ ShadingSystemImpl::Batched<WidthT>::jit_group (ShaderGroup &group, ShadingContex
 
     // Keep OSL instructions around in case someone
     // wants the scalar version jitted
-    if (group.jitted()) {
+    if (group.jitted() && !group.async_jit_pending()) {
         m_ssi.group_post_jit_cleanup (group);
     }
 
@@ -3397,104 +3910,95 @@ ShadingSystemImpl::Batched<WidthT>::jit_group (ShaderGroup &group, ShadingContex
 }
 
 
-static void optimize_all_groups_wrapper (ShadingSystemImpl *ss, int mythread, int totalthreads, bool do_jit)
-{
-    ss->optimize_all_groups (1, mythread, totalthreads, do_jit);
-}
-
-template<int WidthT>
-static void batched_jit_all_groups_wrapper (ShadingSystemImpl *ss, int mythread, int totalthreads)
-{
-    ss->batched<WidthT>().jit_all_groups(1, mythread, totalthreads);
-}
-
 void
-ShadingSystemImpl::optimize_all_groups (int nthreads, int mythread, int totalthreads, bool do_jit)
+ShadingSystemImpl::compile_all_groups (int nthreads,
+        const std::function<void(ShaderGroup&,ShadingContext*)> &compile)
 {
-    // Spawn a bunch of threads to do this in parallel -- just call this
-    // routine again (with threads=1) for each thread.
+    // Snapshot the live groups and order them by decreasing op count, a
+    // cheap stand-in for their optimize + JIT cost. Starting the big ones
+    // first keeps a late uber-shader from becoming the critical path.
+    std::vector<std::pair<int,ShaderGroupRef> > groups;
+    {
+        spin_lock lock (m_all_shader_groups_mutex);
+        groups.reserve (m_all_shader_groups.size());
+        for (auto &g : m_all_shader_groups)
+            if (ShaderGroupRef group = g.lock())
+                groups.emplace_back (0, group);
+    }
+    for (auto &g : groups) {
+        if (g.second->m_complete)
+            for (int layer = 0;  layer < g.second->nlayers();  ++layer)
+                g.first += (*g.second)[layer]->master()->num_ops();
+    }
+    std::stable_sort (groups.begin(), groups.end(),
+                      [](const std::pair<int,ShaderGroupRef> &a,
+                         const std::pair<int,ShaderGroupRef> &b) {
+                          return a.first > b.first;
+                      });
+
     if (nthreads < 1)  // threads <= 0 means use all hardware available
-        nthreads = std::min ((int)std::thread::hardware_concurrency(),
-                             (int)m_groups_to_compile_count);
+        nthreads = (int)std::thread::hardware_concurrency();
+    nthreads = std::max (1, std::min (nthreads, (int)groups.size()));
     if (nthreads > 1) {
         if (m_threads_currently_compiling)
             return;   // never mind, somebody else spawned the JIT threads
-        OIIO::thread_group threads;
         m_threads_currently_compiling += nthreads;
-        for (int t = 0;  t < nthreads;  ++t)
-            threads.add_thread (new std::thread (optimize_all_groups_wrapper, this, t, nthreads, do_jit));
-        threads.join_all ();
-        m_threads_currently_compiling -= nthreads;
-        return;
     }
 
-    // And here's the single thread case
-    size_t ngroups = 0;
-    {
-        spin_lock lock (m_all_shader_groups_mutex);
-        ngroups = m_all_shader_groups.size();
-    }
-    PerThreadInfo* threadinfo = create_thread_info();
-    ShadingContext* ctx = get_context(threadinfo);
-    for (size_t i = 0;  i < ngroups;  ++i) {
-        // Assign to threads based on mod of totalthreads
-        if ((i % totalthreads) == (unsigned)mythread) {
-            ShaderGroupRef group;
-            {
-                spin_lock lock (m_all_shader_groups_mutex);
-                group = m_all_shader_groups[i].lock();
-            }
-            if (group && group->m_complete)
-                optimize_group (*group, ctx, do_jit);
+    // Each worker pulls the next group off the shared cursor until the
+    // list is exhausted, so a slow group only holds up its own worker.
+    std::atomic<size_t> cursor (0);
+    std::vector<double> busy (nthreads, 0.0);
+    auto worker = [&](int t) {
+        PerThreadInfo* threadinfo = create_thread_info();
+        ShadingContext* ctx = get_context(threadinfo);
+        size_t i;
+        while ((i = cursor++) < groups.size()) {
+            OIIO::Timer timer;
+            compile (*groups[i].second, ctx);
+            busy[t] += timer();
         }
+        release_context(ctx);
+        destroy_thread_info(threadinfo);
+    };
+
+    OIIO::Timer walltimer;
+    if (nthreads > 1) {
+        OIIO::thread_pool *pool = OIIO::default_thread_pool();
+        OIIO::task_set tasks (pool);
+        for (int t = 1;  t < nthreads;  ++t)
+            tasks.push (pool->push ([&,t](int /*id*/){ worker (t); }));
+        worker (0);
+        tasks.wait ();
+        m_threads_currently_compiling -= nthreads;
+    } else {
+        worker (0);
     }
-    release_context(ctx);
-    destroy_thread_info(threadinfo);
+
+    spin_lock stat_lock (m_stat_mutex);
+    m_stat_compile_wall_time += walltimer();
+    if (m_stat_compile_thread_busy.size() < busy.size())
+        m_stat_compile_thread_busy.resize (busy.size(), 0.0);
+    for (size_t t = 0;  t < busy.size();  ++t)
+        m_stat_compile_thread_busy[t] += busy[t];
 }
 
-template<int WidthT>
 void
-ShadingSystemImpl::Batched<WidthT>::jit_all_groups (int nthreads, int mythread, int totalthreads)
+ShadingSystemImpl::optimize_all_groups (int nthreads, bool do_jit)
 {
-    // Spawn a bunch of threads to do this in parallel -- just call this
-    // routine again (with threads=1) for each thread.
-    if (nthreads < 1)  // threads <= 0 means use all hardware available
-        nthreads = std::min ((int)std::thread::hardware_concurrency(),
-                             (int)m_ssi.m_groups_to_compile_count);
-    if (nthreads > 1) {
-        if (m_ssi.m_threads_currently_compiling)
-            return;   // never mind, somebody else spawned the JIT threads
-        OIIO::thread_group threads;
-        m_ssi.m_threads_currently_compiling += nthreads;
-        for (int t = 0;  t < nthreads;  ++t)
-            threads.add_thread (new std::thread (batched_jit_all_groups_wrapper<WidthT>, &m_ssi, t, nthreads));
-        threads.join_all ();
-        m_ssi.m_threads_currently_compiling -= nthreads;
-        return;
-    }
+    compile_all_groups (nthreads, [&](ShaderGroup &group, ShadingContext *ctx) {
+        if (group.m_complete)
+            optimize_group (group, ctx, do_jit);
+    });
+}
 
-    // And here's the single thread case
-    size_t ngroups = 0;
-    {
-        spin_lock lock (m_ssi.m_all_shader_groups_mutex);
-        ngroups = m_ssi.m_all_shader_groups.size();
-    }
-    PerThreadInfo* threadinfo = m_ssi.create_thread_info();
-    ShadingContext* ctx = m_ssi.get_context(threadinfo);
-    for (size_t i = 0;  i < ngroups;  ++i) {
-        // Assign to threads based on mod of totalthreads
-        if ((i % totalthreads) == (unsigned)mythread) {
-            ShaderGroupRef group;
-            {
-                spin_lock lock (m_ssi.m_all_shader_groups_mutex);
-                group = m_ssi.m_all_shader_groups[i].lock();
-            }
-            if (group)
-                jit_group (*group, ctx);
-        }
-    }
-    m_ssi.release_context(ctx);
-    m_ssi.destroy_thread_info(threadinfo);
+template<int WidthT>
+void
+ShadingSystemImpl::Batched<WidthT>::jit_all_groups (int nthreads)
+{
+    m_ssi.compile_all_groups (nthreads, [this](ShaderGroup &group, ShadingContext *ctx) {
+        jit_group (group, ctx);
+    });
 }
 
 // Explicitly instantiate, although might need to specialize on target
@@ -3524,13 +4028,14 @@ ShadingSystemImpl::merge_instances (ShaderGroup &group, bool post_opt)
     // general shading and lookdev approach of the studio.  But it was
     // very helpful for us in many cases.
     //
-    // The basic loop below looks very inefficient, O(n^2) in number of
-    // instances in the group. But it's really not -- a few seconds (sum
-    // of all threads) for even our very complex scenes. This is because
-    // most potential pairs have a very fast rejection case if they are
-    // not using the same master.  Since there's no appreciable cost to
-    // the brute force approach, it seems silly to have a complex scheme
-    // to try to reduce the number of pairings.
+    // Comparing every pair of layers is O(n^2), which is cheap for
+    // hand-built networks but dominates group setup for procedurally
+    // generated ones with thousands of layers. So each layer is only
+    // compared in full against the earlier layers with the same
+    // merge_hash(), which covers everything mergeable() requires to be
+    // identical. Layers are visited in order, and each one's incoming
+    // connections are rewired to the survivors of earlier merges before
+    // it is hashed, so merges cascade just as with the pairwise loop.
 
     if (! m_opt_merge_instances || optimize() < 1)
         return 0;
@@ -3546,64 +4051,75 @@ ShadingSystemImpl::merge_instances (ShaderGroup &group, bool post_opt)
         if (! group[layer]->unused())
             group[layer]->evaluate_writes_globals_and_userdata_params ();
 
-    // Loop over all layers...
-    for (int a = 0;  a < nlayers-1;  ++a) {
-        if (group[a]->unused() || group[a]->entry_layer()) // Don't merge a layer that's not used
-            continue;                                      // or if it's an entry layer
-        // Check all later layers...
-        for (int b = a+1;  b < nlayers;  ++b) {
-            if (group[b]->unused())    // Don't merge a layer that's not used
-                continue;
-            if (b == nlayers-1)   // Don't merge the last layer -- causes
-                continue;         // many tears because it's the group entry
+    // Earlier used layers that later ones may be merged into, by hash,
+    // and the layer that each merged-away layer was replaced by.
+    std::unordered_map<size_t, std::vector<int> > candidates;
+    std::vector<int> merged_into (nlayers, -1);
 
-            // Now we have two used layers, a and b, to examine.
-            // See if they are mergeable (identical).  All the heavy
-            // lifting is done by ShaderInstance::mergeable().
-            if (! group[a]->mergeable (*group[b], group))
-                continue;
+    for (int b = 0;  b < nlayers;  ++b) {
+        ShaderInstance *B = group[b];
+        if (B->unused())    // Don't merge a layer that's not used
+            continue;
 
-            // The two nodes a and b are mergeable, so merge them.
-            ShaderInstance *A = group[a];
-            ShaderInstance *B = group[b];
-            ++merges;
-
-            // We'll keep A, get rid of B.  For all layers later than B,
-            // check its incoming connections and replace all references
-            // to B with references to A.
-            for (int j = b+1;  j < nlayers;  ++j) {
-                ShaderInstance *inst = group[j];
-                if (inst->unused())  // don't bother if it's unused
-                    continue;
-                for (int c = 0, ce = inst->nconnections();  c < ce;  ++c) {
-                    Connection &con = inst->connection(c);
-                    if (con.srclayer == b) {
-                        con.srclayer = a;
-                        A->outgoing_connections (true);
-                        if (A->symbols().size() && B->symbols().size()) {
-                            OSL_DASSERT (A->symbol(con.src.param)->name() ==
-                                         B->symbol(con.src.param)->name());
-                        }
-                    }
+        // Replace all references to layers merged away with references
+        // to the layers we kept in their place.
+        for (int c = 0, ce = B->nconnections();  c < ce;  ++c) {
+            Connection &con = B->connection(c);
+            int a = merged_into[con.srclayer];
+            if (a >= 0) {
+                ShaderInstance *A = group[a];
+                if (A->symbols().size() && group[con.srclayer]->symbols().size()) {
+                    OSL_DASSERT (A->symbol(con.src.param)->name() ==
+                                 group[con.srclayer]->symbol(con.src.param)->name());
                 }
+                con.srclayer = a;
+                A->outgoing_connections (true);
             }
+        }
 
-            // Mark parameters of B as no longer connected
-            for (int p = B->firstparam();  p < B->lastparam();  ++p) {
-                if (B->symbols().size())
-                    B->symbol(p)->connected_down(false);
-                if (B->m_instoverrides.size())
-                    B->instoverride(p)->connected_down(false);
+        if (b == nlayers-1)   // Don't merge the last layer -- causes
+            break;            // many tears because it's the group entry
+
+        // Find the first earlier layer that b is mergeable with
+        // (identical to).  All the heavy lifting is done by
+        // ShaderInstance::mergeable().
+        std::vector<int> &bucket (candidates[B->merge_hash()]);
+        int a = -1;
+        for (int c : bucket) {
+            if (group[c]->mergeable (*B, group)) {
+                a = c;
+                break;
             }
-            // B won't be used, so mark it as having no outgoing
-            // connections and clear its incoming connections (which are
-            // no longer used).
-            OSL_DASSERT (B->merged_unused() == false);
-            B->outgoing_connections (false);
-            connectionmem += B->clear_connections ();
-            B->m_merged_unused = true;
-            OSL_DASSERT (B->unused());
         }
+        if (a < 0) {
+            // Nothing to merge with, so b is a candidate itself -- unless
+            // it's an entry layer, which must not be merged away.
+            if (! B->entry_layer())
+                bucket.push_back (b);
+            continue;
+        }
+
+        // The two nodes a and b are mergeable, so merge them. We'll keep
+        // A, get rid of B; later layers connected to B get rewired to A
+        // when the loop reaches them.
+        ++merges;
+        merged_into[b] = a;
+
+        // Mark parameters of B as no longer connected
+        for (int p = B->firstparam();  p < B->lastparam();  ++p) {
+            if (B->symbols().size())
+                B->symbol(p)->connected_down(false);
+            if (B->m_instoverrides.size())
+                B->instoverride(p)->connected_down(false);
+        }
+        // B won't be used, so mark it as having no outgoing
+        // connections and clear its incoming connections (which are
+        // no longer used).
+        OSL_DASSERT (B->merged_unused() == false);
+        B->outgoing_connections (false);
+        connectionmem += B->clear_connections ();
+        B->m_merged_unused = true;
+        OSL_DASSERT (B->unused());
     }
 
     {
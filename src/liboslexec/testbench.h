@@ -0,0 +1,135 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Shared by the unit tests that check an optimization on a synthetic
+// workload: command line parsing, a smaller workload for slow builds,
+// timings that are only printed when asked for, and a small shader to
+// build groups out of. The tests assert their results; the timings are
+// for benchmarking by hand, with --bench.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/timer.h>
+
+
+/// Default size of a test workload: full in optimized builds, divided by
+/// divisor in DEBUG, CI, and code coverage builds for the sake of test
+/// time. Options given on the command line override it.
+inline int
+testbench_workload (int full, int divisor)
+{
+#if !defined(NDEBUG) || defined(OIIO_CI) || defined(OIIO_CODE_COVERAGE)
+    return std::max (1, full / divisor);
+#else
+    (void)divisor;
+    return full;
+#endif
+}
+
+
+
+/// Whether --bench was given, asking for the timings to be printed.
+inline bool &
+testbench_timing ()
+{
+    static bool timing = false;
+    return timing;
+}
+
+
+
+/// Parse the command line of the test called name: --help, --bench, and
+/// the test's own options, given as they would be to ArgParse::options().
+template<typename... Options>
+void
+testbench_getargs (int argc, char *argv[], const char *name,
+                   Options... options)
+{
+    bool help = false;
+    std::string intro = OIIO::Strutil::sprintf (
+        "%s\n" OIIO_INTRO_STRING "\nUsage:  %s [options]", name, name);
+    OIIO::ArgParse ap;
+    ap.options (intro.c_str(),
+                "--help", &help, "Print help message",
+                "--bench", &testbench_timing(), "Print timings",
+                options...,
+                NULL);
+    if (ap.parse (argc, (const char**)argv) < 0) {
+        std::cerr << ap.geterror() << std::endl;
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+    if (help) {
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+
+/// The fastest of trials calls of func(), in seconds.
+template<typename Func>
+double
+testbench_best_time (int trials, Func &&func)
+{
+    double best = 0.0;
+    for (int t = 0;  t < std::max (trials, 1);  ++t) {
+        OIIO::Timer timer;
+        func ();
+        double time = timer();
+        best = t ? std::min (best, time) : time;
+    }
+    return best;
+}
+
+
+
+/// Print a line of timings, if they were asked for.
+template<typename... Args>
+void
+testbench_report (const char *fmt, const Args&... args)
+{
+    if (testbench_timing())
+        std::cout << OIIO::Strutil::sprintf (fmt, args...);
+}
+
+
+
+// A layer to chain into groups, in = the previous layer's out:
+//
+// shader chainnode (float in = 0, float scale = 1, output float out = 0)
+// {
+//     float t = in * scale;
+//     out = t + scale;
+// }
+static const char *chainnode_oso =
+    "OpenShadingLanguage 1.00\n"
+    "# Compiled by oslc 1.12.0\n"
+    "shader chainnode\n"
+    "param\tfloat\tin\t0\t\t%read{0,0} %write{2147483647,-1}\n"
+    "param\tfloat\tscale\t1\t\t%read{0,1} %write{2147483647,-1}\n"
+    "oparam\tfloat\tout\t0\t\t%read{2147483647,-1} %write{1,1}\n"
+    "local\tfloat\tt\t%read{1,1} %write{0,0}\n"
+    "code ___main___\n"
+    "\tmul\t\tt in scale \t%argrw{\"wrr\"}\n"
+    "\tadd\t\tout t scale \t%argrw{\"wrr\"}\n"
+    "\tend\n";
+
+/// The out of the last of a chain of chainnode layers given these scales.
+inline float
+chainnode_out (const float *scales, int n)
+{
+    float out = 0.0f;
+    for (int k = 0;  k < n;  ++k)
+        out = out * scales[k] + scales[k];
+    return out;
+}
@@ -24,15 +24,51 @@ namespace pvt {  // OSL::pvt
 #define NOT_IMPLEMENTED do {std::cerr << "NOT IMPLEMENTED "; OSL_ASSERT(false); exit(3);} while(0)
 
 
+// The structure list is shared by every compiler and shading system in the
+// process, which may be running on several threads (e.g. oslc -j). Adding
+// and removing entries is guarded by this mutex; lookups by id are not, so
+// the storage is reserved up front and never moves.
+static OIIO::spin_mutex struct_list_mutex;
+static std::vector<int> free_struct_ids;
+
+
+
 std::vector<std::shared_ptr<StructSpec>>&
 TypeSpec::struct_list()
 {
-    static std::vector<std::shared_ptr<StructSpec>> m_structs;
+    static std::vector<std::shared_ptr<StructSpec>> m_structs = [] {
+        std::vector<std::shared_ptr<StructSpec>> s;
+        s.reserve(0x8000);  // ids must fit in a short
+        return s;
+    }();
     return m_structs;
 }
 
 
 
+static int
+new_struct_locked(StructSpec* n)
+{
+    std::vector<std::shared_ptr<StructSpec>>& m_structs(TypeSpec::struct_list());
+    if (free_struct_ids.size()) {
+        int id = free_struct_ids.back();
+        free_struct_ids.pop_back();
+        m_structs[id].reset(n);
+        return id;
+    }
+    if (m_structs.size() == 0)
+        m_structs.resize(1);  // Allocate an empty one
+    if (m_structs.size() >= 0x8000) {
+        OSL_ASSERT(0 && "more struct id's than fit in a short!");
+        delete n;
+        return 0;
+    }
+    m_structs.push_back(std::shared_ptr<StructSpec>(n));
+    return (int)m_structs.size() - 1;
+}
+
+
+
 TypeSpec::TypeSpec(const char* name, int structid, int arraylen)
     : m_simple(TypeDesc::UNKNOWN, arraylen)
     , m_structure((short)structid)
@@ -86,18 +122,13 @@ TypeSpec::structure_id(const char* name, bool add)
 {
     std::vector<std::shared_ptr<StructSpec>>& m_structs(struct_list());
     ustring n(name);
+    OIIO::spin_lock lock(struct_list_mutex);
     for (int i = (int)m_structs.size() - 1; i > 0; --i) {
         if (m_structs[i] && m_structs[i]->name() == n)
             return i;
     }
-    if (add) {
-        if (m_structs.size() >= 0x8000) {
-            OSL_ASSERT(0 && "more struct id's than fit in a short!");
-            return 0;
-        }
-        int id = new_struct(new StructSpec(n, 0));
-        return id;
-    }
+    if (add)
+        return new_struct_locked(new StructSpec(n, 0));
     return 0;  // Not found, not added
 }
 
@@ -106,11 +137,20 @@ TypeSpec::structure_id(const char* name, bool add)
 int
 TypeSpec::new_struct(StructSpec* n)
 {
-    std::vector<std::shared_ptr<StructSpec>>& m_structs(struct_list());
-    if (m_structs.size() == 0)
-        m_structs.resize(1);  // Allocate an empty one
-    m_structs.push_back(std::shared_ptr<StructSpec>(n));
-    return (int)m_structs.size() - 1;
+    OIIO::spin_lock lock(struct_list_mutex);
+    return new_struct_locked(n);
+}
+
+
+
+void
+TypeSpec::delete_struct(int id)
+{
+    if (id <= 0)
+        return;
+    OIIO::spin_lock lock(struct_list_mutex);
+    struct_list()[id].reset();
+    free_struct_ids.push_back(id);
 }
 
 
@@ -0,0 +1,259 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Shader implementation of color operations (blackbody, wavelength_color
+/// and color space conversions).  As with the matrix ops, color space
+/// names are almost always uniform, so each distinct name is resolved
+/// once for all the lanes that share it.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#include <OSL/oslconfig.h>
+
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/dual_vec.h>
+#include <OSL/wide.h>
+
+#include "oslexec_pvt.h"
+#include "wide_unique_names.h"
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+namespace {
+
+OSL_FORCEINLINE ColorSystem&
+colorsystem(BatchedShaderGlobals* bsg)
+{
+    return bsg->uniform.context->shadingsys().colorsystem();
+}
+
+
+
+// True if colors in the named space need no conversion to get to RGB
+OSL_FORCEINLINE bool
+is_rgb_space(ColorSystem& cs, ustring name)
+{
+    return name == Strings::RGB || name == Strings::rgb
+           || name == cs.colorspace();
+}
+
+
+
+OSL_NOINLINE void
+prepend_color_from(BatchedShaderGlobals* bsg, Masked<Color3> wC,
+                   ustring from)
+{
+    ColorSystem& cs = colorsystem(bsg);
+    if (is_rgb_space(cs, from))
+        return;
+    ShadingContext* ctx = bsg->uniform.context;
+    wC.mask().foreach ([=, &cs](ActiveLane lane) -> void {
+        Color3 C = wC[lane];
+        wC[lane] = cs.to_rgb(from, C, ctx);
+    });
+}
+
+
+
+template<typename ColorT>
+OSL_NOINLINE void
+transform_color(BatchedShaderGlobals* bsg, Wide<const ColorT> wCin,
+                Masked<ColorT> wCout, ustring from, ustring to)
+{
+    ColorSystem& cs     = colorsystem(bsg);
+    ShadingContext* ctx = bsg->uniform.context;
+    if (from == to) {
+        wCout.mask().foreach ([=](ActiveLane lane) -> void {
+            wCout[lane] = ColorT(wCin[lane]);
+        });
+        return;
+    }
+    wCout.mask().foreach ([=, &cs](ActiveLane lane) -> void {
+        ColorT C    = wCin[lane];
+        wCout[lane] = cs.transformc(from, to, C, ctx);
+    });
+}
+
+
+
+template<typename ColorT>
+OSL_NOINLINE void
+transform_color(BatchedShaderGlobals* bsg, Wide<const ColorT> wCin,
+                Masked<ColorT> wCout, Wide<const ustring> wfrom,
+                Wide<const ustring> wto)
+{
+    foreach_unique_name(wfrom, wCout.mask(), [&](Mask from_lanes,
+                                                 ustring from) -> void {
+        foreach_unique_name(wto, from_lanes, [&](Mask lanes,
+                                                 ustring to) -> void {
+            transform_color(bsg, wCin, wCout & lanes, from, to);
+        });
+    });
+}
+
+}  // namespace
+
+
+
+OSL_BATCHOP void
+__OSL_OP(blackbody_vf)(void* bsg_, void* out, float temp)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    *reinterpret_cast<Color3*>(out) = colorsystem(bsg).blackbody_rgb(temp);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(blackbody, Wv, Wf)(void* bsg_, void* wout_, void* wtemp_,
+                                    unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ColorSystem& cs = colorsystem(bsg);
+    Wide<const float> wtemp(wtemp_);
+    Masked<Color3> wout(wout_, Mask(mask_value));
+    wout.mask().foreach ([=, &cs](ActiveLane lane) -> void {
+        wout[lane] = cs.blackbody_rgb(wtemp[lane]);
+    });
+}
+
+
+
+OSL_BATCHOP void
+__OSL_OP(wavelength_color_vf)(void* bsg_, void* out, float lambda)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    *reinterpret_cast<Color3*>(out) = colorsystem(bsg).wavelength_rgb(lambda);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(wavelength_color, Wv, Wf)(void* bsg_, void* wout_,
+                                           void* wlambda_,
+                                           unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ColorSystem& cs = colorsystem(bsg);
+    Wide<const float> wlambda(wlambda_);
+    Masked<Color3> wout(wout_, Mask(mask_value));
+    wout.mask().foreach ([=, &cs](ActiveLane lane) -> void {
+        wout[lane] = cs.wavelength_rgb(wlambda[lane]);
+    });
+}
+
+
+
+OSL_BATCHOP void
+__OSL_OP(prepend_color_from_vs)(void* bsg_, void* c_, const char* from)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ColorSystem& cs = colorsystem(bsg);
+    Color3& C       = *reinterpret_cast<Color3*>(c_);
+    C               = cs.to_rgb(USTR(from), C, bsg->uniform.context);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(prepend_color_from, Wv, s)(void* bsg_, void* c_,
+                                            const char* from,
+                                            unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    prepend_color_from(bsg, Masked<Color3>(c_, Mask(mask_value)), USTR(from));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(prepend_color_from, Wv, Ws)(void* bsg_, void* c_,
+                                             void* from_,
+                                             unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Color3> wC(c_, Mask(mask_value));
+    foreach_unique_name(Wide<const ustring>(from_), wC.mask(),
+                        [&](Mask lanes, ustring from) -> void {
+                            prepend_color_from(bsg, wC & lanes, from);
+                        });
+}
+
+
+
+// The masked transform_color takes varying colors and varying space
+// names; the unmasked one is used when everything is uniform.
+OSL_BATCHOP void
+__OSL_MASKED_OP(transform_color)(void* bsg_, void* Cin, int Cin_derivs,
+                                 void* Cout, int Cout_derivs, void* from_,
+                                 void* to_, unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Mask mask(mask_value);
+    Wide<const ustring> wfrom(from_);
+    Wide<const ustring> wto(to_);
+
+    if (Cout_derivs) {
+        if (Cin_derivs) {
+            transform_color(bsg, Wide<const Dual2<Color3>>(Cin),
+                            Masked<Dual2<Color3>>(Cout, mask), wfrom, wto);
+            return;
+        } else {
+            // We had output derivs, but not input. Zero the output
+            // derivs and fall through to the non-deriv case.
+            assign_all(MaskedDx<Color3>(Cout, mask), Color3(0.0f));
+            assign_all(MaskedDy<Color3>(Cout, mask), Color3(0.0f));
+        }
+    }
+
+    // No-derivs case
+    transform_color(bsg, Wide<const Color3>(Cin), Masked<Color3>(Cout, mask),
+                    wfrom, wto);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_OP(transform_color)(void* bsg_, void* Cin, int Cin_derivs, void* Cout,
+                          int Cout_derivs, void* from_, void* to_)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ColorSystem& cs = colorsystem(bsg);
+    ustring from    = USTR(from_);
+    ustring to      = USTR(to_);
+
+    if (Cout_derivs) {
+        if (Cin_derivs) {
+            *reinterpret_cast<Dual2<Color3>*>(Cout) = cs.transformc(
+                from, to, *reinterpret_cast<const Dual2<Color3>*>(Cin),
+                bsg->uniform.context);
+            return;
+        } else {
+            // We had output derivs, but not input. Zero the output
+            // derivs and fall through to the non-deriv case.
+            reinterpret_cast<Color3*>(Cout)[1].setValue(0.0f, 0.0f, 0.0f);
+            reinterpret_cast<Color3*>(Cout)[2].setValue(0.0f, 0.0f, 0.0f);
+        }
+    }
+
+    // No-derivs case
+    *reinterpret_cast<Color3*>(Cout)
+        = cs.transformc(from, to, *reinterpret_cast<const Color3*>(Cin),
+                        bsg->uniform.context);
+}
+
+
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#include "undef_opname_macros.h"
@@ -0,0 +1,659 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Shader implementation of matrix lookup and transform operations.
+/// Space names are almost always the same across a batch, so a uniform
+/// name costs a single renderer call for all lanes, and varying names
+/// are handled one distinct name at a time.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#include <OSL/oslconfig.h>
+
+#include <OSL/batched_rendererservices.h>
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/dual_vec.h>
+#include <OSL/wide.h>
+
+#include <OSL/Imathx/Imathx.h>
+
+#include "oslexec_pvt.h"
+#include "wide_unique_names.h"
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+namespace {
+
+OSL_FORCEINLINE Wide<const float>
+wide_time(BatchedShaderGlobals* bsg)
+{
+    return Wide<const float>(bsg->varying.time);
+}
+
+
+
+OSL_FORCEINLINE BatchedRendererServices<__OSL_WIDTH>*
+batched_renderer(BatchedShaderGlobals* bsg)
+{
+    return bsg->uniform.context->batched<__OSL_WIDTH>().renderer();
+}
+
+
+
+OSL_FORCEINLINE bool
+is_common_space(ShadingContext* ctx, ustring name)
+{
+    return name == Strings::common
+           || name == ctx->shadingsys().commonspace_synonym();
+}
+
+
+
+OSL_NOINLINE void
+invert_matrices(Masked<Matrix44> wrm)
+{
+    wrm.mask().foreach ([=](ActiveLane lane) -> void {
+        Matrix44 m = wrm[lane];
+        wrm[lane]  = m.inverse();
+    });
+}
+
+
+
+// Lanes that could not find their space get identity, and like the
+// scalar shadeops we complain about it if asked to.
+OSL_NOINLINE void
+unknown_transformation(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm,
+                       Mask failed, ustring name)
+{
+    assign_all(wrm & failed, Matrix44());
+    ShadingContext* ctx = bsg->uniform.context;
+    if (ctx->shadingsys().unknown_coordsys_error())
+        ctx->errorf("Unknown transformation \"%s\"", name);
+}
+
+
+
+// Matrix from the named space to "common" space
+OSL_NOINLINE Mask
+get_matrix(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm, ustring from)
+{
+    ShadingContext* ctx = bsg->uniform.context;
+    if (is_common_space(ctx, from)) {
+        assign_all(wrm, Matrix44());
+        return wrm.mask();
+    }
+    auto* bsr = batched_renderer(bsg);
+    if (from == Strings::shader) {
+        bsr->get_matrix(bsg, wrm,
+                        Wide<const TransformationPtr>(
+                            bsg->varying.shader2common),
+                        wide_time(bsg));
+        return wrm.mask();
+    }
+    if (from == Strings::object) {
+        bsr->get_matrix(bsg, wrm,
+                        Wide<const TransformationPtr>(
+                            bsg->varying.object2common),
+                        wide_time(bsg));
+        return wrm.mask();
+    }
+    Mask ok = bsr->get_matrix(bsg, wrm, from, wide_time(bsg));
+    if (ok != wrm.mask())
+        unknown_transformation(bsg, wrm, wrm.mask() & ~ok, from);
+    return ok;
+}
+
+
+
+OSL_NOINLINE Mask
+get_inverse_matrix(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm,
+                   Wide<const TransformationPtr> wxform)
+{
+    auto* bsr = batched_renderer(bsg);
+    if (bsr->is_overridden_get_inverse_matrix_WmWxWf())
+        return bsr->get_inverse_matrix(bsg, wrm, wxform, wide_time(bsg));
+    Mask ok = bsr->get_matrix(bsg, wrm, wxform, wide_time(bsg));
+    invert_matrices(wrm & ok);
+    return ok;
+}
+
+
+
+// Matrix from "common" space to the named space
+OSL_NOINLINE Mask
+get_inverse_matrix(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm,
+                   ustring to)
+{
+    ShadingContext* ctx = bsg->uniform.context;
+    if (is_common_space(ctx, to)) {
+        assign_all(wrm, Matrix44());
+        return wrm.mask();
+    }
+    if (to == Strings::shader) {
+        get_inverse_matrix(bsg, wrm,
+                           Wide<const TransformationPtr>(
+                               bsg->varying.shader2common));
+        return wrm.mask();
+    }
+    if (to == Strings::object) {
+        get_inverse_matrix(bsg, wrm,
+                           Wide<const TransformationPtr>(
+                               bsg->varying.object2common));
+        return wrm.mask();
+    }
+    auto* bsr = batched_renderer(bsg);
+    Mask ok(false);
+    if (bsr->is_overridden_get_inverse_matrix_WmsWf()) {
+        ok = bsr->get_inverse_matrix(bsg, wrm, to, wide_time(bsg));
+    } else {
+        ok = bsr->get_matrix(bsg, wrm, to, wide_time(bsg));
+        invert_matrices(wrm & ok);
+    }
+    if (ok != wrm.mask())
+        unknown_transformation(bsg, wrm, wrm.mask() & ~ok, to);
+    return ok;
+}
+
+
+
+// Varying names: the renderer gets one call per distinct name, unless it
+// handles varying names itself, in which case every lane naming a
+// renderer space goes to it in a single call.
+OSL_NOINLINE Mask
+get_matrix(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm,
+           Wide<const ustring> wfrom)
+{
+    ShadingContext* ctx   = bsg->uniform.context;
+    auto* bsr             = batched_renderer(bsg);
+    bool renderer_varying = bsr->is_overridden_get_matrix_WmWsWf();
+    Mask ok(false);
+    Mask named(false);
+    foreach_unique_name(wfrom, wrm.mask(),
+                        [&](Mask same, ustring from) -> void {
+                            if (renderer_varying && !is_common_space(ctx, from)
+                                && from != Strings::shader
+                                && from != Strings::object)
+                                named |= same;
+                            else
+                                ok |= get_matrix(bsg, wrm & same, from);
+                        });
+    if (named.any_on()) {
+        Mask named_ok = bsr->get_matrix(bsg, wrm & named, wfrom,
+                                        wide_time(bsg));
+        ok |= named_ok;
+        foreach_unique_name(wfrom, named & ~named_ok,
+                            [&](Mask failed, ustring from) -> void {
+                                unknown_transformation(bsg, wrm, failed, from);
+                            });
+    }
+    return ok;
+}
+
+
+
+OSL_NOINLINE Mask
+get_inverse_matrix(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm,
+                   Wide<const ustring> wto)
+{
+    ShadingContext* ctx   = bsg->uniform.context;
+    auto* bsr             = batched_renderer(bsg);
+    bool renderer_varying = bsr->is_overridden_get_inverse_matrix_WmWsWf();
+    Mask ok(false);
+    Mask named(false);
+    foreach_unique_name(wto, wrm.mask(), [&](Mask same, ustring to) -> void {
+        if (renderer_varying && !is_common_space(ctx, to)
+            && to != Strings::shader && to != Strings::object)
+            named |= same;
+        else
+            ok |= get_inverse_matrix(bsg, wrm & same, to);
+    });
+    if (named.any_on()) {
+        Mask named_ok = bsr->get_inverse_matrix(bsg, wrm & named, wto,
+                                                wide_time(bsg));
+        ok |= named_ok;
+        foreach_unique_name(wto, named & ~named_ok,
+                            [&](Mask failed, ustring to) -> void {
+                                unknown_transformation(bsg, wrm, failed, to);
+                            });
+    }
+    return ok;
+}
+
+
+
+// FromT and ToT are each either ustring or Wide<const ustring>
+template<typename FromT, typename ToT>
+OSL_FORCEINLINE Mask
+get_from_to_matrix(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm,
+                   FromT from, ToT to)
+{
+    Block<Matrix44> mfrom, mto;
+    Mask ok = get_matrix(bsg, Masked<Matrix44>(mfrom, wrm.mask()), from);
+    ok &= get_inverse_matrix(bsg, Masked<Matrix44>(mto, wrm.mask()), to);
+    Wide<const Matrix44> wmfrom(mfrom);
+    Wide<const Matrix44> wmto(mto);
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Matrix44 mf = wmfrom[lane];
+            Matrix44 mt = wmto[lane];
+            if (wrm.mask()[lane])
+                wrm[ActiveLane(lane)] = mf * mt;
+        }
+    }
+    return ok;
+}
+
+
+
+// The matrix used to transform a triple between two uniform spaces.  The
+// code generator almost always asks for a transform from or to "common",
+// which costs just one lookup.
+OSL_NOINLINE Mask
+build_transform_matrix(BatchedShaderGlobals* bsg, Masked<Matrix44> wrm,
+                       ustring from, ustring to)
+{
+    ShadingContext* ctx = bsg->uniform.context;
+    if (is_common_space(ctx, from))
+        return get_inverse_matrix(bsg, wrm, to);
+    if (is_common_space(ctx, to))
+        return get_matrix(bsg, wrm, from);
+    return get_from_to_matrix(bsg, wrm, from, to);
+}
+
+
+
+// Matrix from the named space to "common" space that holds at all times,
+// if the renderer has one.  Shader and object space differ per lane.
+OSL_FORCEINLINE bool
+get_static_matrix(ShadingContext* ctx, Matrix44& m, ustring from)
+{
+    if (is_common_space(ctx, from)) {
+        m.makeIdentity();
+        return true;
+    }
+    if (from == Strings::shader || from == Strings::object)
+        return false;
+    return ctx->renderer()->get_matrix(nullptr, m, from);
+}
+
+
+
+// Matrix from "common" space to the named space that holds at all times,
+// if the renderer has one.
+OSL_FORCEINLINE bool
+get_static_inverse_matrix(ShadingContext* ctx, Matrix44& m, ustring to)
+{
+    if (is_common_space(ctx, to)) {
+        m.makeIdentity();
+        return true;
+    }
+    if (to == Strings::shader || to == Strings::object)
+        return false;
+    return ctx->renderer()->get_inverse_matrix(nullptr, m, to);
+}
+
+
+
+// Transformations of a triple by a matrix.  prepare() is whatever only
+// depends on the matrix, so a uniform matrix pays for it once.
+struct PointTransform {
+    static OSL_FORCEINLINE Matrix44 prepare(const Matrix44& M) { return M; }
+
+    static OSL_FORCEINLINE Vec3 apply(const Matrix44& M, const Vec3& P)
+    {
+        Vec3 r;
+        robust_multVecMatrix(M, P, r);
+        return r;
+    }
+
+    static OSL_FORCEINLINE Dual2<Vec3> apply(const Matrix44& M,
+                                             const Dual2<Vec3>& P)
+    {
+        Dual2<Vec3> r;
+        robust_multVecMatrix(M, P, r);
+        return r;
+    }
+};
+
+struct VectorTransform {
+    static OSL_FORCEINLINE Matrix44 prepare(const Matrix44& M) { return M; }
+
+    static OSL_FORCEINLINE Vec3 apply(const Matrix44& M, const Vec3& V)
+    {
+        Vec3 r;
+        M.multDirMatrix(V, r);
+        return r;
+    }
+
+    static OSL_FORCEINLINE Dual2<Vec3> apply(const Matrix44& M,
+                                             const Dual2<Vec3>& V)
+    {
+        Dual2<Vec3> r;
+        multDirMatrix(M, V, r);
+        return r;
+    }
+};
+
+struct NormalTransform : public VectorTransform {
+    static OSL_FORCEINLINE Matrix44 prepare(const Matrix44& M)
+    {
+        return inlinedTransposed(M.inverse());
+    }
+};
+
+
+
+OSL_FORCEINLINE const Vec3&
+lane_value(const Vec3& v, int)
+{
+    return v;
+}
+
+template<typename DataT>
+OSL_FORCEINLINE DataT
+lane_value(Wide<const DataT> wv, int lane)
+{
+    return wv[lane];
+}
+
+
+
+// Lanes whose matrix lookup failed pass their input through unchanged,
+// as the scalar osl_transform_triple does.
+template<typename TransformT, typename DataT, typename InT>
+OSL_FORCEINLINE void
+transform_by_matrix(InT in, Masked<DataT> wr, const Matrix44& M,
+                    Mask succeeded)
+{
+    const Matrix44 xform = TransformT::prepare(M);
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            DataT v = lane_value(in, lane);
+            DataT r = TransformT::apply(xform, v);
+            if (wr.mask()[lane])
+                wr[ActiveLane(lane)] = succeeded[lane] ? r : v;
+        }
+    }
+}
+
+template<typename TransformT, typename DataT, typename InT>
+OSL_FORCEINLINE void
+transform_by_matrix(InT in, Masked<DataT> wr, Wide<const Matrix44> wM,
+                    Mask succeeded)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            DataT v        = lane_value(in, lane);
+            Matrix44 xform = TransformT::prepare(wM[lane]);
+            DataT r        = TransformT::apply(xform, v);
+            if (wr.mask()[lane])
+                wr[ActiveLane(lane)] = succeeded[lane] ? r : v;
+        }
+    }
+}
+
+}  // namespace
+
+
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(get_from_to_matrix, Wm, s, s)(void* bsg_, void* wr,
+                                               const char* from,
+                                               const char* to,
+                                               unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    return get_from_to_matrix(bsg, wrm, USTR(from), USTR(to)).value();
+}
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(get_from_to_matrix, Wm, s, Ws)(void* bsg_, void* wr,
+                                                const char* from, void* wto,
+                                                unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    return get_from_to_matrix(bsg, wrm, USTR(from), Wide<const ustring>(wto))
+        .value();
+}
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(get_from_to_matrix, Wm, Ws, s)(void* bsg_, void* wr,
+                                                void* wfrom, const char* to,
+                                                unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    return get_from_to_matrix(bsg, wrm, Wide<const ustring>(wfrom), USTR(to))
+        .value();
+}
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(get_from_to_matrix, Wm, Ws, Ws)(void* bsg_, void* wr,
+                                                 void* wfrom, void* wto,
+                                                 unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    return get_from_to_matrix(bsg, wrm, Wide<const ustring>(wfrom),
+                              Wide<const ustring>(wto))
+        .value();
+}
+
+
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(build_transform_matrix, Wm, s, s)(void* bsg_, void* wr,
+                                                   const char* from,
+                                                   const char* to,
+                                                   unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    return build_transform_matrix(bsg, wrm, USTR(from), USTR(to)).value();
+}
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(build_transform_matrix, Wm, Ws, s)(void* bsg_, void* wr,
+                                                    void* wfrom,
+                                                    const char* to,
+                                                    unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    Wide<const ustring> wfrom_names(wfrom);
+    Mask ok(false);
+    foreach_unique_name(wfrom_names, wrm.mask(),
+                        [&](Mask same, ustring from) -> void {
+                            ok |= build_transform_matrix(bsg, wrm & same, from,
+                                                         USTR(to));
+                        });
+    return ok.value();
+}
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(build_transform_matrix, Wm, s, Ws)(void* bsg_, void* wr,
+                                                    const char* from,
+                                                    void* wto,
+                                                    unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    Wide<const ustring> wto_names(wto);
+    Mask ok(false);
+    foreach_unique_name(wto_names, wrm.mask(),
+                        [&](Mask same, ustring to) -> void {
+                            ok |= build_transform_matrix(bsg, wrm & same,
+                                                         USTR(from), to);
+                        });
+    return ok.value();
+}
+
+OSL_BATCHOP int
+__OSL_MASKED_OP3(build_transform_matrix, Wm, Ws, Ws)(void* bsg_, void* wr,
+                                                     void* wfrom, void* wto,
+                                                     unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    Wide<const ustring> wfrom_names(wfrom);
+    Wide<const ustring> wto_names(wto);
+    Mask ok(false);
+    foreach_unique_name(wfrom_names, wrm.mask(),
+                        [&](Mask same_from, ustring from) -> void {
+                            foreach_unique_name(
+                                wto_names, same_from,
+                                [&](Mask same, ustring to) -> void {
+                                    ok |= build_transform_matrix(
+                                        bsg, wrm & same, from, to);
+                                });
+                        });
+    return ok.value();
+}
+
+
+
+// The uniform matrix between two uniform spaces, when neither depends on
+// time or on the lane.  Returns 0 otherwise, without reporting anything:
+// the caller falls back to the wide build_transform_matrix.
+OSL_BATCHOP int
+__OSL_OP3(build_transform_matrix, m, s, s)(void* bsg_, void* r,
+                                           const char* from, const char* to)
+{
+    auto* bsg           = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx = bsg->uniform.context;
+    Matrix44 mfrom, mto;
+    if (!get_static_matrix(ctx, mfrom, USTR(from))
+        || !get_static_inverse_matrix(ctx, mto, USTR(to)))
+        return 0;
+    *reinterpret_cast<Matrix44*>(r) = mfrom * mto;
+    return 1;
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(prepend_matrix_from, Wm, s)(void* bsg_, void* wr,
+                                             const char* from,
+                                             unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    Block<Matrix44> mfrom;
+    Mask ok = get_matrix(bsg, Masked<Matrix44>(mfrom, wrm.mask()),
+                         USTR(from));
+    Wide<const Matrix44> wmfrom(mfrom);
+    ok.foreach ([=](ActiveLane lane) -> void {
+        Matrix44 m = wrm[lane];
+        wrm[lane]  = Matrix44(wmfrom[lane]) * m;
+    });
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(prepend_matrix_from, Wm, Ws)(void* bsg_, void* wr,
+                                              void* wfrom,
+                                              unsigned int mask_value)
+{
+    auto* bsg = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    Masked<Matrix44> wrm(wr, Mask(mask_value));
+    Block<Matrix44> mfrom;
+    Mask ok = get_matrix(bsg, Masked<Matrix44>(mfrom, wrm.mask()),
+                         Wide<const ustring>(wfrom));
+    Wide<const Matrix44> wmfrom(mfrom);
+    ok.foreach ([=](ActiveLane lane) -> void {
+        Matrix44 m = wrm[lane];
+        wrm[lane]  = Matrix44(wmfrom[lane]) * m;
+    });
+}
+
+
+
+// transform_point, transform_vector and transform_normal take the
+// input triple, the result, the matrix and the lanes for which the
+// matrix was found (as returned by build_transform_matrix).
+#define __OSL_TRANSFORM_OPS(OPNAME, TRANSFORM)                               \
+    OSL_BATCHOP void __OSL_MASKED_OP3(OPNAME, v, Wv, m)(                     \
+        void* in, void* r, void* M, unsigned int succeeded_value,            \
+        unsigned int mask_value)                                             \
+    {                                                                        \
+        transform_by_matrix<TRANSFORM, Vec3>(                                \
+            *reinterpret_cast<const Vec3*>(in),                              \
+            Masked<Vec3>(r, Mask(mask_value)),                               \
+            *reinterpret_cast<const Matrix44*>(M), Mask(succeeded_value));   \
+    }                                                                        \
+                                                                             \
+    OSL_BATCHOP void __OSL_MASKED_OP3(OPNAME, v, Wv, Wm)(                    \
+        void* in, void* r, void* M, unsigned int succeeded_value,            \
+        unsigned int mask_value)                                             \
+    {                                                                        \
+        transform_by_matrix<TRANSFORM, Vec3>(                                \
+            *reinterpret_cast<const Vec3*>(in),                              \
+            Masked<Vec3>(r, Mask(mask_value)), Wide<const Matrix44>(M),      \
+            Mask(succeeded_value));                                          \
+    }                                                                        \
+                                                                             \
+    OSL_BATCHOP void __OSL_MASKED_OP3(OPNAME, Wv, Wv, m)(                    \
+        void* in, void* r, void* M, unsigned int succeeded_value,            \
+        unsigned int mask_value)                                             \
+    {                                                                        \
+        transform_by_matrix<TRANSFORM, Vec3>(                                \
+            Wide<const Vec3>(in), Masked<Vec3>(r, Mask(mask_value)),         \
+            *reinterpret_cast<const Matrix44*>(M), Mask(succeeded_value));   \
+    }                                                                        \
+                                                                             \
+    OSL_BATCHOP void __OSL_MASKED_OP3(OPNAME, Wv, Wv, Wm)(                   \
+        void* in, void* r, void* M, unsigned int succeeded_value,            \
+        unsigned int mask_value)                                             \
+    {                                                                        \
+        transform_by_matrix<TRANSFORM, Vec3>(                                \
+            Wide<const Vec3>(in), Masked<Vec3>(r, Mask(mask_value)),         \
+            Wide<const Matrix44>(M), Mask(succeeded_value));                 \
+    }                                                                        \
+                                                                             \
+    OSL_BATCHOP void __OSL_MASKED_OP3(OPNAME, Wdv, Wdv, m)(                  \
+        void* in, void* r, void* M, unsigned int succeeded_value,            \
+        unsigned int mask_value)                                             \
+    {                                                                        \
+        transform_by_matrix<TRANSFORM, Dual2<Vec3>>(                         \
+            Wide<const Dual2<Vec3>>(in),                                     \
+            Masked<Dual2<Vec3>>(r, Mask(mask_value)),                        \
+            *reinterpret_cast<const Matrix44*>(M), Mask(succeeded_value));   \
+    }                                                                        \
+                                                                             \
+    OSL_BATCHOP void __OSL_MASKED_OP3(OPNAME, Wdv, Wdv, Wm)(                 \
+        void* in, void* r, void* M, unsigned int succeeded_value,            \
+        unsigned int mask_value)                                             \
+    {                                                                        \
+        transform_by_matrix<TRANSFORM, Dual2<Vec3>>(                         \
+            Wide<const Dual2<Vec3>>(in),                                     \
+            Masked<Dual2<Vec3>>(r, Mask(mask_value)),                        \
+            Wide<const Matrix44>(M), Mask(succeeded_value));                 \
+    }
+
+__OSL_TRANSFORM_OPS(transform_point, PointTransform)
+__OSL_TRANSFORM_OPS(transform_vector, VectorTransform)
+__OSL_TRANSFORM_OPS(transform_normal, NormalTransform)
+
+#undef __OSL_TRANSFORM_OPS
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#include "undef_opname_macros.h"
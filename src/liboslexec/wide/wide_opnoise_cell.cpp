@@ -0,0 +1,39 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Shader implementation of cell noise and periodic cell noise
+/// NOTE: Execute from the library (vs. LLVM-IR) to take advantage
+/// of compiler's small vector math library.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/dual.h>
+#include <OSL/dual_vec.h>
+#include <OSL/oslconfig.h>
+#include <OSL/oslnoise.h>
+#include <OSL/sfmath.h>
+#include <OSL/wide.h>
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+// Cell noise is piecewise constant, so it has no derivative versions.
+#define __OSL_XMACRO_ARGS (cellnoise, pvt::CellNoise)
+#include "wide_opnoise_impl_xmacro.h"
+
+#define __OSL_XMACRO_ARGS (pcellnoise, pvt::PeriodicCellNoise)
+#include "wide_opnoise_periodic_impl_xmacro.h"
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#include "undef_opname_macros.h"
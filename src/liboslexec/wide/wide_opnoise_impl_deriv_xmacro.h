@@ -0,0 +1,212 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Masked wide versions of the derivative noise signatures
+// declared by WIDE_NOISE_DERIV_IMPL in builtindecl_wide_xmacro.h.
+// Each lane calls a scalar noise functor, so pass the *Scalar flavors from
+// oslnoise.h, which are written to be inlined inside of a SIMD loop.
+#ifdef __OSL_XMACRO_ARGS
+#    define __OSL_XMACRO_OPNAME \
+        __OSL_EXPAND(__OSL_XMACRO_ARG1 __OSL_XMACRO_ARGS)
+#    define __OSL_XMACRO_IMPLNAME \
+        __OSL_EXPAND(__OSL_XMACRO_ARG2 __OSL_XMACRO_ARGS)
+#endif
+
+#ifndef __OSL_XMACRO_OPNAME
+#    error must define __OSL_XMACRO_OPNAME to name of noise operation before including this header
+#endif
+
+#ifndef __OSL_XMACRO_IMPLNAME
+#    error must define __OSL_XMACRO_IMPLNAME to name of noise implementation before including this header
+#endif
+
+#ifndef __OSL_WIDTH
+#    error must define __OSL_WIDTH to number of SIMD lanes before including this header
+#endif
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(__OSL_XMACRO_OPNAME, Wdf, Wdf)(void* r_ptr, void* x_ptr,
+                                                unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, x);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdf, Wdf, Wdf)(void* r_ptr, void* x_ptr,
+                                                     void* y_ptr,
+                                                     unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        Wide<const Dual2<float>> wy(y_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            Dual2<float> y = wy[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, x, y);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(__OSL_XMACRO_OPNAME, Wdf, Wdv)(void* r_ptr, void* p_ptr,
+                                                unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, p);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdf, Wdv, Wdf)(void* r_ptr, void* p_ptr,
+                                                     void* t_ptr,
+                                                     unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        Wide<const Dual2<float>> wt(t_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            Dual2<float> t = wt[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, p, t);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(__OSL_XMACRO_OPNAME, Wdv, Wdf)(void* r_ptr, void* x_ptr,
+                                                unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, x);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdv, Wdf, Wdf)(void* r_ptr, void* x_ptr,
+                                                     void* y_ptr,
+                                                     unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        Wide<const Dual2<float>> wy(y_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            Dual2<float> y = wy[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, x, y);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(__OSL_XMACRO_OPNAME, Wdv, Wdv)(void* r_ptr, void* p_ptr,
+                                                unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, p);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdv, Wdv, Wdf)(void* r_ptr, void* p_ptr,
+                                                     void* t_ptr,
+                                                     unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        Wide<const Dual2<float>> wt(t_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            Dual2<float> t = wt[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, p, t);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+
+#undef __OSL_XMACRO_ARGS
+#undef __OSL_XMACRO_OPNAME
+#undef __OSL_XMACRO_IMPLNAME
@@ -0,0 +1,46 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Shader implementation of the null noises used when noise is disabled
+/// NOTE: Execute from the library (vs. LLVM-IR) to take advantage
+/// of compiler's small vector math library.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/dual.h>
+#include <OSL/dual_vec.h>
+#include <OSL/oslconfig.h>
+#include <OSL/oslnoise.h>
+#include <OSL/sfmath.h>
+#include <OSL/wide.h>
+
+#include "opnoise.h"
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+#define __OSL_XMACRO_ARGS (nullnoise, pvt::NullNoise)
+#include "wide_opnoise_impl_xmacro.h"
+
+#define __OSL_XMACRO_ARGS (nullnoise, pvt::NullNoise)
+#include "wide_opnoise_impl_deriv_xmacro.h"
+
+#define __OSL_XMACRO_ARGS (unullnoise, pvt::UNullNoise)
+#include "wide_opnoise_impl_xmacro.h"
+
+#define __OSL_XMACRO_ARGS (unullnoise, pvt::UNullNoise)
+#include "wide_opnoise_impl_deriv_xmacro.h"
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#include "undef_opname_macros.h"
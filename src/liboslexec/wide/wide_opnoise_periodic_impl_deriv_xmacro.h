@@ -0,0 +1,252 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Masked wide versions of the derivative periodic noise signatures
+// declared by WIDE_PNOISE_DERIV_IMPL in builtindecl_wide_xmacro.h.
+// Each lane calls a scalar noise functor, so pass the *Scalar flavors from
+// oslnoise.h, which are written to be inlined inside of a SIMD loop.
+#ifdef __OSL_XMACRO_ARGS
+#    define __OSL_XMACRO_OPNAME \
+        __OSL_EXPAND(__OSL_XMACRO_ARG1 __OSL_XMACRO_ARGS)
+#    define __OSL_XMACRO_IMPLNAME \
+        __OSL_EXPAND(__OSL_XMACRO_ARG2 __OSL_XMACRO_ARGS)
+#endif
+
+#ifndef __OSL_XMACRO_OPNAME
+#    error must define __OSL_XMACRO_OPNAME to name of noise operation before including this header
+#endif
+
+#ifndef __OSL_XMACRO_IMPLNAME
+#    error must define __OSL_XMACRO_IMPLNAME to name of noise implementation before including this header
+#endif
+
+#ifndef __OSL_WIDTH
+#    error must define __OSL_WIDTH to number of SIMD lanes before including this header
+#endif
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdf, Wdf, Wf)(void* r_ptr, void* x_ptr,
+                                                    void* px_ptr,
+                                                    unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        Wide<const float> wpx(px_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            float px = wpx[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, x, px);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP5(__OSL_XMACRO_OPNAME, Wdf, Wdf, Wdf, Wf, Wf)(void* r_ptr,
+                                                             void* x_ptr,
+                                                             void* y_ptr,
+                                                             void* px_ptr,
+                                                             void* py_ptr,
+                                                             unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        Wide<const Dual2<float>> wy(y_ptr);
+        Wide<const float> wpx(px_ptr);
+        Wide<const float> wpy(py_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            Dual2<float> y = wy[lane];
+            float px = wpx[lane];
+            float py = wpy[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, x, y, px, py);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdf, Wdv, Wv)(void* r_ptr, void* p_ptr,
+                                                    void* pp_ptr,
+                                                    unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        Wide<const Vec3> wpp(pp_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            Vec3 pp = wpp[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, p, pp);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP5(__OSL_XMACRO_OPNAME, Wdf, Wdv, Wdf, Wv, Wf)(void* r_ptr,
+                                                             void* p_ptr,
+                                                             void* t_ptr,
+                                                             void* pp_ptr,
+                                                             void* pt_ptr,
+                                                             unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<float>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        Wide<const Dual2<float>> wt(t_ptr);
+        Wide<const Vec3> wpp(pp_ptr);
+        Wide<const float> wpt(pt_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            Dual2<float> t = wt[lane];
+            Vec3 pp = wpp[lane];
+            float pt = wpt[lane];
+            if (wr.mask()[lane]) {
+                Dual2<float> result;
+                impl(result, p, t, pp, pt);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdv, Wdf, Wf)(void* r_ptr, void* x_ptr,
+                                                    void* px_ptr,
+                                                    unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        Wide<const float> wpx(px_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            float px = wpx[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, x, px);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP5(__OSL_XMACRO_OPNAME, Wdv, Wdf, Wdf, Wf, Wf)(void* r_ptr,
+                                                             void* x_ptr,
+                                                             void* y_ptr,
+                                                             void* px_ptr,
+                                                             void* py_ptr,
+                                                             unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<float>> wx(x_ptr);
+        Wide<const Dual2<float>> wy(y_ptr);
+        Wide<const float> wpx(px_ptr);
+        Wide<const float> wpy(py_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<float> x = wx[lane];
+            Dual2<float> y = wy[lane];
+            float px = wpx[lane];
+            float py = wpy[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, x, y, px, py);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(__OSL_XMACRO_OPNAME, Wdv, Wdv, Wv)(void* r_ptr, void* p_ptr,
+                                                    void* pp_ptr,
+                                                    unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        Wide<const Vec3> wpp(pp_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            Vec3 pp = wpp[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, p, pp);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+OSL_BATCHOP void
+__OSL_MASKED_OP5(__OSL_XMACRO_OPNAME, Wdv, Wdv, Wdf, Wv, Wf)(void* r_ptr,
+                                                             void* p_ptr,
+                                                             void* t_ptr,
+                                                             void* pp_ptr,
+                                                             void* pt_ptr,
+                                                             unsigned int mask_value)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        Masked<Dual2<Vec3>> wr(r_ptr, Mask(mask_value));
+        Wide<const Dual2<Vec3>> wp(p_ptr);
+        Wide<const Dual2<float>> wt(t_ptr);
+        Wide<const Vec3> wpp(pp_ptr);
+        Wide<const float> wpt(pt_ptr);
+        __OSL_XMACRO_IMPLNAME impl;
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Dual2<Vec3> p = wp[lane];
+            Dual2<float> t = wt[lane];
+            Vec3 pp = wpp[lane];
+            float pt = wpt[lane];
+            if (wr.mask()[lane]) {
+                Dual2<Vec3> result;
+                impl(result, p, t, pp, pt);
+                wr[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+
+#undef __OSL_XMACRO_ARGS
+#undef __OSL_XMACRO_OPNAME
+#undef __OSL_XMACRO_IMPLNAME
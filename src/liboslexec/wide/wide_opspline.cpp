@@ -0,0 +1,600 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Shader implementation of spline and splineinverse operations.
+/// Each lane runs the same Spline::SplineInterp code as the scalar
+/// osl_spline_* shadeops, so results match exactly.  With uniform knots
+/// (the common case) lanes are evaluated together in a SIMD loop;
+/// varying knots are copied out one lane at a time.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#include <OSL/oslconfig.h>
+
+#include <OSL/dual_vec.h>
+#include <OSL/wide.h>
+
+#include <OSL/Imathx/Imathx.h>
+
+#include <OpenImageIO/fmath.h>
+
+#include "oslexec_pvt.h"
+#include "splineimpl.h"
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+namespace {
+
+template<typename T>
+OSL_FORCEINLINE Wide<const T>
+varying(void* ptr)
+{
+    return Wide<const T>(ptr);
+}
+
+
+
+template<typename T>
+OSL_FORCEINLINE const T&
+uniform(void* ptr)
+{
+    return *reinterpret_cast<const T*>(ptr);
+}
+
+
+
+template<typename T>
+OSL_FORCEINLINE T
+lane_value(const T& value, int /*lane*/)
+{
+    return value;
+}
+
+
+
+template<typename T>
+OSL_FORCEINLINE T
+lane_value(Wide<const T> wvalue, int lane)
+{
+    return wvalue[lane];
+}
+
+
+
+// Copy one lane's knots into knots, laid out as the scalar ops expect
+// them (values, then dx, then dy when the knots have derivatives).
+template<typename KnotT>
+OSL_FORCEINLINE void
+gather_knots(Wide<const KnotT[]> wknots, int lane, KnotT* knots)
+{
+    auto lane_knots = wknots[lane];
+    int n           = lane_knots.length();
+    for (int i = 0; i < n; ++i)
+        knots[i] = lane_knots[i];
+}
+
+
+
+OSL_FORCEINLINE int
+knot_block_count(int knot_arraylen, bool knot_derivs)
+{
+    return knot_derivs ? 3 * knot_arraylen : knot_arraylen;
+}
+
+
+
+template<typename RT, typename XT, typename CT, typename KT, bool knot_derivs,
+         typename XArgT>
+OSL_FORCEINLINE void
+spline_uniform_knots(const char* spline_, Masked<RT> wR, XArgT x,
+                     void* knots_, int knot_count, int knot_arraylen)
+{
+    const Spline::SplineInterp spline = Spline::SplineInterp::create(
+        USTR(spline_));
+    const KT* knots = reinterpret_cast<const KT*>(knots_);
+
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            XT xval = lane_value(x, lane);
+            if (wR.mask()[lane]) {
+                RT result;
+                spline.template evaluate<RT, XT, CT, KT, knot_derivs>(
+                    result, xval, knots, knot_count, knot_arraylen);
+                wR[ActiveLane(lane)] = result;
+            }
+        }
+    }
+}
+
+
+
+template<typename RT, typename XT, typename CT, typename KT, bool knot_derivs,
+         typename XArgT>
+OSL_NOINLINE void
+spline_varying_knots(const char* spline_, Masked<RT> wR, XArgT x,
+                     void* knots_, int knot_count, int knot_arraylen)
+{
+    const Spline::SplineInterp spline = Spline::SplineInterp::create(
+        USTR(spline_));
+    int nknots = knot_block_count(knot_arraylen, knot_derivs);
+    Wide<const KT[]> wknots(knots_, nknots);
+    KT* knots = OIIO_ALLOCA(KT, nknots);
+
+    wR.mask().foreach ([&](ActiveLane lane) -> void {
+        gather_knots(wknots, lane, knots);
+        XT xval = lane_value(x, lane);
+        RT result;
+        spline.template evaluate<RT, XT, CT, KT, knot_derivs>(
+            result, xval, knots, knot_count, knot_arraylen);
+        wR[lane] = result;
+    });
+}
+
+
+
+// splineinverse ignores any derivatives the knots have, so only their
+// values are used.  When RT has derivatives but YT does not, the result
+// derivatives are zero.
+template<typename RT, typename YT, typename YArgT>
+OSL_NOINLINE void
+splineinverse_uniform_knots(const char* spline_, Masked<RT> wR, YArgT y,
+                            void* knots_, int knot_count, int knot_arraylen)
+{
+    const Spline::SplineInterp spline = Spline::SplineInterp::create(
+        USTR(spline_));
+    const float* knots = reinterpret_cast<const float*>(knots_);
+
+    wR.mask().foreach ([&](ActiveLane lane) -> void {
+        YT result;
+        spline.inverse<YT>(result, lane_value(y, lane), knots, knot_count,
+                           knot_arraylen);
+        wR[lane] = RT(result);
+    });
+}
+
+
+
+template<typename RT, typename YT, typename YArgT>
+OSL_NOINLINE void
+splineinverse_varying_knots(const char* spline_, Masked<RT> wR, YArgT y,
+                            void* knots_, int knot_count, int knot_arraylen)
+{
+    const Spline::SplineInterp spline = Spline::SplineInterp::create(
+        USTR(spline_));
+    Wide<const float[]> wknots(knots_, knot_arraylen);
+    float* knots = OIIO_ALLOCA(float, knot_arraylen);
+
+    wR.mask().foreach ([&](ActiveLane lane) -> void {
+        gather_knots(wknots, lane, knots);
+        YT result;
+        spline.inverse<YT>(result, lane_value(y, lane), knots, knot_count,
+                           knot_arraylen);
+        wR[lane] = RT(result);
+    });
+}
+
+}  // namespace
+
+
+
+// The op name suffixes give the types of the result, x and the knots.
+// The template arguments to the kernels mirror the scalar osl_spline_*
+// shadeops: result, x, computation and knot types, and whether the
+// knots carry derivatives.
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wf, Wf, Wf)(void* wout_, const char* spline_,
+                                     void* x_, void* knots_, int knot_count,
+                                     int knot_arraylen,
+                                     unsigned int mask_value)
+{
+    spline_varying_knots<float, float, float, float, false>(
+        spline_, Masked<float>(wout_, Mask(mask_value)), varying<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wf, Wf, f)(void* wout_, const char* spline_,
+                                    void* x_, void* knots_, int knot_count,
+                                    int knot_arraylen, unsigned int mask_value)
+{
+    spline_uniform_knots<float, float, float, float, false>(
+        spline_, Masked<float>(wout_, Mask(mask_value)), varying<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wf, f, Wf)(void* wout_, const char* spline_,
+                                    void* x_, void* knots_, int knot_count,
+                                    int knot_arraylen, unsigned int mask_value)
+{
+    spline_varying_knots<float, float, float, float, false>(
+        spline_, Masked<float>(wout_, Mask(mask_value)), uniform<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdf, Wdf, Wdf)(void* wout_, const char* spline_,
+                                        void* x_, void* knots_,
+                                        int knot_count, int knot_arraylen,
+                                        unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<float>, Dual2<float>, Dual2<float>, float,
+                         true>(spline_,
+                               Masked<Dual2<float>>(wout_, Mask(mask_value)),
+                               varying<Dual2<float>>(x_), knots_, knot_count,
+                               knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdf, Wdf, df)(void* wout_, const char* spline_,
+                                       void* x_, void* knots_,
+                                       int knot_count, int knot_arraylen,
+                                       unsigned int mask_value)
+{
+    spline_uniform_knots<Dual2<float>, Dual2<float>, Dual2<float>, float,
+                         true>(spline_,
+                               Masked<Dual2<float>>(wout_, Mask(mask_value)),
+                               varying<Dual2<float>>(x_), knots_, knot_count,
+                               knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdf, df, Wdf)(void* wout_, const char* spline_,
+                                       void* x_, void* knots_,
+                                       int knot_count, int knot_arraylen,
+                                       unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<float>, Dual2<float>, Dual2<float>, float,
+                         true>(spline_,
+                               Masked<Dual2<float>>(wout_, Mask(mask_value)),
+                               uniform<Dual2<float>>(x_), knots_, knot_count,
+                               knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdf, Wdf, f)(void* wout_, const char* spline_,
+                                      void* x_, void* knots_, int knot_count,
+                                      int knot_arraylen,
+                                      unsigned int mask_value)
+{
+    spline_uniform_knots<Dual2<float>, Dual2<float>, float, float, false>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdf, f, Wdf)(void* wout_, const char* spline_,
+                                      void* x_, void* knots_, int knot_count,
+                                      int knot_arraylen,
+                                      unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<float>, float, Dual2<float>, float, true>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        uniform<float>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdf, Wf, Wdf)(void* wout_, const char* spline_,
+                                       void* x_, void* knots_,
+                                       int knot_count, int knot_arraylen,
+                                       unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<float>, float, Dual2<float>, float, true>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        varying<float>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wv, Wf, Wv)(void* wout_, const char* spline_,
+                                     void* x_, void* knots_, int knot_count,
+                                     int knot_arraylen,
+                                     unsigned int mask_value)
+{
+    spline_varying_knots<Vec3, float, Vec3, Vec3, false>(
+        spline_, Masked<Vec3>(wout_, Mask(mask_value)), varying<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wv, Wf, v)(void* wout_, const char* spline_,
+                                    void* x_, void* knots_, int knot_count,
+                                    int knot_arraylen, unsigned int mask_value)
+{
+    spline_uniform_knots<Vec3, float, Vec3, Vec3, false>(
+        spline_, Masked<Vec3>(wout_, Mask(mask_value)), varying<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wv, f, Wv)(void* wout_, const char* spline_,
+                                    void* x_, void* knots_, int knot_count,
+                                    int knot_arraylen, unsigned int mask_value)
+{
+    spline_varying_knots<Vec3, float, Vec3, Vec3, false>(
+        spline_, Masked<Vec3>(wout_, Mask(mask_value)), uniform<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, Wdf, Wdv)(void* wout_, const char* spline_,
+                                        void* x_, void* knots_,
+                                        int knot_count, int knot_arraylen,
+                                        unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<Vec3>, Dual2<float>, Dual2<Vec3>, Vec3, true>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, Wdf, dv)(void* wout_, const char* spline_,
+                                       void* x_, void* knots_,
+                                       int knot_count, int knot_arraylen,
+                                       unsigned int mask_value)
+{
+    spline_uniform_knots<Dual2<Vec3>, Dual2<float>, Dual2<Vec3>, Vec3, true>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, df, Wdv)(void* wout_, const char* spline_,
+                                       void* x_, void* knots_,
+                                       int knot_count, int knot_arraylen,
+                                       unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<Vec3>, Dual2<float>, Dual2<Vec3>, Vec3, true>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        uniform<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, Wdf, v)(void* wout_, const char* spline_,
+                                      void* x_, void* knots_, int knot_count,
+                                      int knot_arraylen,
+                                      unsigned int mask_value)
+{
+    spline_uniform_knots<Dual2<Vec3>, Dual2<float>, Vec3, Vec3, false>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, Wdf, Wv)(void* wout_, const char* spline_,
+                                       void* x_, void* knots_,
+                                       int knot_count, int knot_arraylen,
+                                       unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<Vec3>, Dual2<float>, Vec3, Vec3, false>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, df, Wv)(void* wout_, const char* spline_,
+                                      void* x_, void* knots_, int knot_count,
+                                      int knot_arraylen,
+                                      unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<Vec3>, Dual2<float>, Vec3, Vec3, false>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        uniform<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, f, Wdv)(void* wout_, const char* spline_,
+                                      void* x_, void* knots_, int knot_count,
+                                      int knot_arraylen,
+                                      unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<Vec3>, float, Dual2<Vec3>, Vec3, true>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        uniform<float>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, Wf, Wdv)(void* wout_, const char* spline_,
+                                       void* x_, void* knots_,
+                                       int knot_count, int knot_arraylen,
+                                       unsigned int mask_value)
+{
+    spline_varying_knots<Dual2<Vec3>, float, Dual2<Vec3>, Vec3, true>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        varying<float>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(spline, Wdv, Wf, dv)(void* wout_, const char* spline_,
+                                      void* x_, void* knots_, int knot_count,
+                                      int knot_arraylen,
+                                      unsigned int mask_value)
+{
+    spline_uniform_knots<Dual2<Vec3>, float, Dual2<Vec3>, Vec3, true>(
+        spline_, Masked<Dual2<Vec3>>(wout_, Mask(mask_value)),
+        varying<float>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wf, Wf, Wf)(void* wout_, const char* spline_,
+                                            void* x_, void* knots_,
+                                            int knot_count, int knot_arraylen,
+                                            unsigned int mask_value)
+{
+    splineinverse_varying_knots<float, float>(
+        spline_, Masked<float>(wout_, Mask(mask_value)), varying<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wf, Wf, f)(void* wout_, const char* spline_,
+                                           void* x_, void* knots_,
+                                           int knot_count, int knot_arraylen,
+                                           unsigned int mask_value)
+{
+    splineinverse_uniform_knots<float, float>(
+        spline_, Masked<float>(wout_, Mask(mask_value)), varying<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wf, f, Wf)(void* wout_, const char* spline_,
+                                           void* x_, void* knots_,
+                                           int knot_count, int knot_arraylen,
+                                           unsigned int mask_value)
+{
+    splineinverse_varying_knots<float, float>(
+        spline_, Masked<float>(wout_, Mask(mask_value)), uniform<float>(x_),
+        knots_, knot_count, knot_arraylen);
+}
+
+
+
+// Knot derivatives are ignored, as in osl_splineinverse_dfdfdf
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wdf, Wdf, Wdf)(void* wout_,
+                                               const char* spline_, void* x_,
+                                               void* knots_, int knot_count,
+                                               int knot_arraylen,
+                                               unsigned int mask_value)
+{
+    splineinverse_varying_knots<Dual2<float>, Dual2<float>>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wdf, Wdf, df)(void* wout_,
+                                              const char* spline_, void* x_,
+                                              void* knots_, int knot_count,
+                                              int knot_arraylen,
+                                              unsigned int mask_value)
+{
+    splineinverse_uniform_knots<Dual2<float>, Dual2<float>>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wdf, df, Wdf)(void* wout_,
+                                              const char* spline_, void* x_,
+                                              void* knots_, int knot_count,
+                                              int knot_arraylen,
+                                              unsigned int mask_value)
+{
+    splineinverse_varying_knots<Dual2<float>, Dual2<float>>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        uniform<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wdf, Wdf, f)(void* wout_, const char* spline_,
+                                             void* x_, void* knots_,
+                                             int knot_count,
+                                             int knot_arraylen,
+                                             unsigned int mask_value)
+{
+    splineinverse_uniform_knots<Dual2<float>, Dual2<float>>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        varying<Dual2<float>>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+// x has no derivatives, so neither does the result, as in
+// osl_splineinverse_dffdf
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wdf, f, Wdf)(void* wout_, const char* spline_,
+                                             void* x_, void* knots_,
+                                             int knot_count,
+                                             int knot_arraylen,
+                                             unsigned int mask_value)
+{
+    splineinverse_varying_knots<Dual2<float>, float>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        uniform<float>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(splineinverse, Wdf, Wf, Wdf)(void* wout_,
+                                              const char* spline_, void* x_,
+                                              void* knots_, int knot_count,
+                                              int knot_arraylen,
+                                              unsigned int mask_value)
+{
+    splineinverse_varying_knots<Dual2<float>, float>(
+        spline_, Masked<Dual2<float>>(wout_, Mask(mask_value)),
+        varying<float>(x_), knots_, knot_count, knot_arraylen);
+}
+
+
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#include "undef_opname_macros.h"
@@ -0,0 +1,282 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Shader implementation of string operations.  Strings are nearly
+/// always the same across a batch (texture and attribute names), and
+/// ustring operations are expensive, so when every active lane has the
+/// same arguments the operation is done once and the result broadcast.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#include <OSL/oslconfig.h>
+
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/wide.h>
+
+#include <OpenImageIO/fmath.h>
+#include <OpenImageIO/strutil.h>
+
+#include "oslexec_pvt.h"
+#include "opstring.h"
+#include "wide_unique_names.h"
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+// concat, startswith, substr, split, ... shared with the scalar shadeops
+using namespace pvt::StringOps;
+
+namespace {
+
+// True if every active lane holds the same value
+template<typename T>
+OSL_FORCEINLINE bool
+is_uniform(Wide<const T> wvalue, Mask mask)
+{
+    T first   = wvalue[mask.first_on()];
+    bool same = true;
+    mask.foreach ([&](ActiveLane lane) -> void {
+        if (!(T(wvalue[lane]) == first))
+            same = false;
+    });
+    return same;
+}
+
+
+
+template<typename... ArgTs>
+OSL_FORCEINLINE bool
+are_uniform(Mask mask, Wide<const ArgTs>... wargs)
+{
+    bool uniform[] = { is_uniform(wargs, mask)... };
+    for (bool u : uniform)
+        if (!u)
+            return false;
+    return true;
+}
+
+
+
+// Store f(args...) into each active lane of wr, calling f only once when
+// the arguments are the same for every active lane.
+template<typename RT, typename FunctorT, typename... ArgTs>
+OSL_FORCEINLINE void
+eval_lanes(Masked<RT> wr, FunctorT f, Wide<const ArgTs>... wargs)
+{
+    Mask mask = wr.mask();
+    if (!mask.any_on())
+        return;
+    if (are_uniform(mask, wargs...)) {
+        int lane = mask.first_on();
+        RT value = f(ArgTs(wargs[lane])...);
+        assign_all(wr, value);
+        return;
+    }
+    mask.foreach ([&](ActiveLane lane) -> void {
+        wr[lane] = f(ArgTs(wargs[lane])...);
+    });
+}
+
+}  // namespace
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(concat, Ws, Ws, Ws)(void* wr_, void* ws_, void* wt_,
+                                     unsigned int mask_value)
+{
+    eval_lanes(Masked<ustring>(wr_, Mask(mask_value)), concat,
+               Wide<const ustring>(ws_), Wide<const ustring>(wt_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(strlen, Wi, Ws)(void* wr_, void* ws_,
+                                 unsigned int mask_value)
+{
+    eval_lanes(
+        Masked<int>(wr_, Mask(mask_value)),
+        [](ustring s) -> int { return int(s.length()); },
+        Wide<const ustring>(ws_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(hash, Wi, Ws)(void* wr_, void* ws_, unsigned int mask_value)
+{
+    eval_lanes(
+        Masked<int>(wr_, Mask(mask_value)),
+        [](ustring s) -> int { return int(s.hash()); },
+        Wide<const ustring>(ws_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(getchar, Wi, Ws, Wi)(void* wr_, void* ws_, void* windex_,
+                                      unsigned int mask_value)
+{
+    eval_lanes(Masked<int>(wr_, Mask(mask_value)), char_at,
+               Wide<const ustring>(ws_), Wide<const int>(windex_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(startswith, Wi, Ws, Ws)(void* wr_, void* ws_,
+                                         void* wsubstr_,
+                                         unsigned int mask_value)
+{
+    eval_lanes(Masked<int>(wr_, Mask(mask_value)), startswith,
+               Wide<const ustring>(ws_), Wide<const ustring>(wsubstr_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP3(endswith, Wi, Ws, Ws)(void* wr_, void* ws_, void* wsubstr_,
+                                       unsigned int mask_value)
+{
+    eval_lanes(Masked<int>(wr_, Mask(mask_value)), endswith,
+               Wide<const ustring>(ws_), Wide<const ustring>(wsubstr_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(stoi, Wi, Ws)(void* wr_, void* ws_, unsigned int mask_value)
+{
+    eval_lanes(
+        Masked<int>(wr_, Mask(mask_value)),
+        [](ustring s) -> int {
+            return s.c_str() ? Strutil::from_string<int>(s.c_str()) : 0;
+        },
+        Wide<const ustring>(ws_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP2(stof, Wf, Ws)(void* wr_, void* ws_, unsigned int mask_value)
+{
+    eval_lanes(
+        Masked<float>(wr_, Mask(mask_value)),
+        [](ustring s) -> float {
+            return s.c_str() ? Strutil::from_string<float>(s.c_str()) : 0.0f;
+        },
+        Wide<const ustring>(ws_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP4(substr, Ws, Ws, Wi, Wi)(void* wr_, void* ws_, void* wstart_,
+                                         void* wlength_,
+                                         unsigned int mask_value)
+{
+    eval_lanes(Masked<ustring>(wr_, Mask(mask_value)), substr,
+               Wide<const ustring>(ws_), Wide<const int>(wstart_),
+               Wide<const int>(wlength_));
+}
+
+
+
+OSL_BATCHOP void
+__OSL_MASKED_OP(split)(void* wresult_, void* wstr_, void* wresults_,
+                       void* wsep_, void* wmaxsplit_, int resultslen,
+                       unsigned int mask_value)
+{
+    Masked<int> wresult(wresult_, Mask(mask_value));
+    Masked<ustring[]> wresults(wresults_, resultslen, wresult.mask(), 0);
+    Wide<const ustring> wstr(wstr_);
+    Wide<const ustring> wsep(wsep_);
+    Wide<const int> wmaxsplit(wmaxsplit_);
+
+    Mask mask = wresult.mask();
+    if (!mask.any_on())
+        return;
+    ustring* results = OIIO_ALLOCA(ustring, resultslen);
+    if (are_uniform(mask, wstr, wsep, wmaxsplit)) {
+        int lane = mask.first_on();
+        int n    = split(wstr[lane], results, wsep[lane], wmaxsplit[lane],
+                         resultslen);
+        assign_all(wresult, n);
+        for (int i = 0; i < n; ++i)
+            assign_all(wresults.get_element(i), results[i]);
+        return;
+    }
+    mask.foreach ([&](ActiveLane lane) -> void {
+        int n = split(wstr[lane], results, wsep[lane], wmaxsplit[lane],
+                      resultslen);
+        wresult[lane] = n;
+        for (int i = 0; i < n; ++i)
+            wresults[lane][i] = results[i];
+    });
+}
+
+
+
+// The compiled regex for each distinct pattern comes from the context's
+// regex cache once, and is then shared by all the lanes using it.
+OSL_BATCHOP void
+__OSL_MASKED_OP(regex_impl)(void* bsg_, void* wsuccess_, void* wsubject_,
+                            void* wresults_, int nresults, void* wpattern_,
+                            int fullmatch, unsigned int mask_value)
+{
+    auto* bsg           = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx = bsg->uniform.context;
+    Masked<int> wsuccess(wsuccess_, Mask(mask_value));
+    Masked<int[]> wresults(wresults_, nresults, wsuccess.mask(), 0);
+    Wide<const ustring> wsubject(wsubject_);
+    Wide<const ustring> wpattern(wpattern_);
+
+    int* results = OIIO_ALLOCA(int, std::max(nresults, 1));
+    foreach_unique_name(wpattern, wsuccess.mask(),
+                        [&](Mask same, ustring pattern) -> void {
+        const regex& regex(ctx->find_regex(pattern));
+        if (is_uniform(wsubject, same)) {
+            int success = regex_impl(wsubject[same.first_on()], regex,
+                                     pattern, results, nresults, fullmatch);
+            assign_all(wsuccess & same, success);
+            for (int r = 0; r < nresults; ++r)
+                assign_all(wresults.get_element(r) & same, results[r]);
+            return;
+        }
+        same.foreach ([&](ActiveLane lane) -> void {
+            wsuccess[lane] = regex_impl(wsubject[lane], regex, pattern,
+                                        results, nresults, fullmatch);
+            for (int r = 0; r < nresults; ++r)
+                wresults[lane][r] = results[r];
+        });
+    });
+}
+
+
+
+OSL_BATCHOP int
+__OSL_OP(regex_impl)(void* bsg_, const char* subject_, void* results,
+                     int nresults, const char* pattern_, int fullmatch)
+{
+    auto* bsg           = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx = bsg->uniform.context;
+    ustring pattern     = USTR(pattern_);
+    return regex_impl(USTR(subject_), ctx->find_regex(pattern), pattern,
+                      reinterpret_cast<int*>(results), nresults, fullmatch);
+}
+
+
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#include "undef_opname_macros.h"
@@ -0,0 +1,576 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Shader implementation of texture, texture3d, environment and
+/// gettextureinfo operations.
+/// Unless the renderer overrides them, lookups are made over all the
+/// active lanes at once through OIIO's batched TextureSystem calls.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#include <OSL/oslconfig.h>
+
+#include <OSL/batched_rendererservices.h>
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/wide.h>
+
+#include <OpenImageIO/texture.h>
+
+#include "oslexec_pvt.h"
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+#include "define_opname_macros.h"
+
+namespace {
+
+// OIIO's batched calls always work on OIIO::Tex::BatchWidth lanes, so a
+// batch narrower than that only uses the lower lanes of each OIIO batch.
+static constexpr int TexWidth = OIIO::Tex::BatchWidth;
+static_assert(__OSL_WIDTH <= TexWidth,
+              "Batch is wider than OIIO's batched texture calls");
+
+// Room for up to 3 color channels plus alpha, laid out [channel][lane]
+// the way OIIO's batched calls want them.
+struct alignas(64) TexChannels {
+    float val[4 * TexWidth];
+};
+
+// Room for a float, or a Vec3 laid out [component][lane].
+struct alignas(64) TexCoords {
+    float val[3 * TexWidth];
+};
+
+
+
+OSL_FORCEINLINE void
+gather(Wide<const float> wsrc, float* dst)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            dst[lane] = wsrc[lane];
+        }
+    }
+}
+
+
+
+OSL_FORCEINLINE void
+gather(Wide<const Vec3> wsrc, float* dst)
+{
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            Vec3 v                   = wsrc[lane];
+            dst[lane]                = v.x;
+            dst[TexWidth + lane]     = v.y;
+            dst[2 * TexWidth + lane] = v.z;
+        }
+    }
+}
+
+
+
+// Copy our options into the layout OIIO's batched calls expect.  The
+// varying part is per lane, the uniform part is copied once.
+OSL_FORCEINLINE void
+to_texture_opt_batch(const BatchedTextureOptions& opt,
+                     OIIO::TextureOptBatch& oiio_opt)
+{
+    const auto& vary = opt.varying;
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            oiio_opt.sblur[lane]  = vary.sblur[lane];
+            oiio_opt.tblur[lane]  = vary.tblur[lane];
+            oiio_opt.rblur[lane]  = vary.rblur[lane];
+            oiio_opt.swidth[lane] = vary.swidth[lane];
+            oiio_opt.twidth[lane] = vary.twidth[lane];
+            oiio_opt.rwidth[lane] = vary.rwidth[lane];
+        }
+    }
+
+    const auto& uniform          = opt.uniform;
+    oiio_opt.firstchannel        = uniform.firstchannel;
+    oiio_opt.subimage            = uniform.subimage;
+    oiio_opt.subimagename        = uniform.subimagename;
+    oiio_opt.swrap               = uniform.swrap;
+    oiio_opt.twrap               = uniform.twrap;
+    oiio_opt.rwrap               = uniform.rwrap;
+    oiio_opt.mipmode             = uniform.mipmode;
+    oiio_opt.interpmode          = uniform.interpmode;
+    oiio_opt.anisotropic         = uniform.anisotropic;
+    oiio_opt.conservative_filter = uniform.conservative_filter;
+    oiio_opt.fill                = uniform.fill;
+    oiio_opt.missingcolor        = uniform.missingcolor;
+}
+
+
+
+template<typename DataT>
+OSL_FORCEINLINE void
+scatter_channels(MaskedData wdata, const float* val, const float* dx,
+                 const float* dy);
+
+template<>
+OSL_FORCEINLINE void
+scatter_channels<float>(MaskedData wdata, const float* val, const float* dx,
+                        const float* dy)
+{
+    Masked<float> wr(wdata);
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            if (wr.mask()[lane])
+                wr[ActiveLane(lane)] = val[lane];
+        }
+    }
+    if (wdata.has_derivs()) {
+        MaskedDx<float> wrdx(wdata);
+        MaskedDy<float> wrdy(wdata);
+        OSL_FORCEINLINE_BLOCK
+        {
+            OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+            for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+                if (wrdx.mask()[lane]) {
+                    wrdx[ActiveLane(lane)] = dx[lane];
+                    wrdy[ActiveLane(lane)] = dy[lane];
+                }
+            }
+        }
+    }
+}
+
+template<>
+OSL_FORCEINLINE void
+scatter_channels<Color3>(MaskedData wdata, const float* val, const float* dx,
+                         const float* dy)
+{
+    Masked<Color3> wr(wdata);
+    OSL_FORCEINLINE_BLOCK
+    {
+        OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+        for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+            if (wr.mask()[lane])
+                wr[ActiveLane(lane)] = Color3(val[lane], val[TexWidth + lane],
+                                              val[2 * TexWidth + lane]);
+        }
+    }
+    if (wdata.has_derivs()) {
+        MaskedDx<Color3> wrdx(wdata);
+        MaskedDy<Color3> wrdy(wdata);
+        OSL_FORCEINLINE_BLOCK
+        {
+            OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+            for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+                if (wrdx.mask()[lane]) {
+                    wrdx[ActiveLane(lane)]
+                        = Color3(dx[lane], dx[TexWidth + lane],
+                                 dx[2 * TexWidth + lane]);
+                    wrdy[ActiveLane(lane)]
+                        = Color3(dy[lane], dy[TexWidth + lane],
+                                 dy[2 * TexWidth + lane]);
+                }
+            }
+        }
+    }
+}
+
+
+
+// Scatter the [channel][lane] results of a batched lookup, and their
+// xy-space derivatives, into the active lanes of result and alpha.
+OSL_FORCEINLINE void
+scatter_results(BatchedTextureOutputs& outputs, const float* val,
+                const float* dx, const float* dy)
+{
+    MaskedData wresult = outputs.result();
+    int chans          = 1;
+    if (Masked<Color3>::is(wresult)) {
+        scatter_channels<Color3>(wresult, val, dx, dy);
+        chans = 3;
+    } else {
+        OSL_DASSERT(Masked<float>::is(wresult));
+        scatter_channels<float>(wresult, val, dx, dy);
+    }
+    MaskedData walpha = outputs.alpha();
+    if (walpha.valid())
+        scatter_channels<float>(walpha, val + chans * TexWidth,
+                                dx + chans * TexWidth, dy + chans * TexWidth);
+}
+
+
+
+// Number of channels to ask the TextureSystem for: the result's plus
+// alpha if the shader wants it.
+OSL_FORCEINLINE int
+lookup_channels(BatchedTextureOutputs& outputs)
+{
+    int chans = Masked<Color3>::is(outputs.result()) ? 3 : 1;
+    return outputs.alpha().valid() ? chans + 1 : chans;
+}
+
+
+
+OSL_FORCEINLINE bool
+need_derivs(BatchedTextureOutputs& outputs)
+{
+    return outputs.result().has_derivs()
+           || (outputs.alpha().valid() && outputs.alpha().has_derivs());
+}
+
+
+
+// Report the outcome of a batched lookup, mirroring what
+// RendererServices does for a single point.  OIIO reports a single status
+// for the whole batch, so a failure fails every lane of the mask, as
+// documented in BatchedRendererServices::texture.
+Mask
+finish_lookup(bool ok, TextureSystem* texsys, BatchedShaderGlobals* bsg,
+              BatchedTextureOutputs& outputs, const char* opname)
+{
+    Mask mask                = outputs.mask();
+    MaskedData werrormessage = outputs.errormessage();
+    if (ok) {
+        if (werrormessage.valid())
+            assign_all(Masked<ustring>(werrormessage), Strings::_emptystring_);
+        return mask;
+    }
+    std::string err = texsys->geterror();
+    if (err.size()) {
+        if (werrormessage.valid())
+            assign_all(Masked<ustring>(werrormessage), ustring(err));
+        else
+            bsg->uniform.context->errorf("[BatchedRendererServices::%s] %s",
+                                         opname, err);
+    } else if (werrormessage.valid()) {
+        assign_all(Masked<ustring>(werrormessage), Strings::unknown);
+    }
+    return Mask(false);
+}
+
+
+
+OSL_NOINLINE Mask
+default_texture(TextureSystem* texsys, ustring filename,
+                TextureSystem::TextureHandle* texture_handle,
+                TextureSystem::Perthread* texture_thread_info,
+                const BatchedTextureOptions& options,
+                BatchedShaderGlobals* bsg, Wide<const float> ws,
+                Wide<const float> wt, Wide<const float> wdsdx,
+                Wide<const float> wdtdx, Wide<const float> wdsdy,
+                Wide<const float> wdtdy, BatchedTextureOutputs& outputs)
+{
+    if (!texture_handle)
+        texture_handle = texsys->get_texture_handle(filename,
+                                                    texture_thread_info);
+
+    OIIO::TextureOptBatch oiio_opt;
+    to_texture_opt_batch(options, oiio_opt);
+
+    TexCoords s, t, dsdx, dtdx, dsdy, dtdy;
+    gather(ws, s.val);
+    gather(wt, t.val);
+    gather(wdsdx, dsdx.val);
+    gather(wdtdx, dtdx.val);
+    gather(wdsdy, dsdy.val);
+    gather(wdtdy, dtdy.val);
+
+    int nchannels = lookup_channels(outputs);
+    bool derivs   = need_derivs(outputs);
+    TexChannels result, dresultds, dresultdt;
+    bool ok = texsys->texture(texture_handle, texture_thread_info, oiio_opt,
+                              OIIO::Tex::RunMask(outputs.mask().value()),
+                              s.val, t.val, dsdx.val, dtdx.val, dsdy.val,
+                              dtdy.val, nchannels, result.val,
+                              derivs ? dresultds.val : nullptr,
+                              derivs ? dresultdt.val : nullptr);
+
+    // Correct our st texture space gradients into xy-space gradients
+    TexChannels dresultdx, dresultdy;
+    if (derivs) {
+        for (int c = 0; c < nchannels; ++c) {
+            float* ds = dresultds.val + c * TexWidth;
+            float* dt = dresultdt.val + c * TexWidth;
+            float* dx = dresultdx.val + c * TexWidth;
+            float* dy = dresultdy.val + c * TexWidth;
+            OSL_FORCEINLINE_BLOCK
+            {
+                OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+                for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+                    dx[lane] = ds[lane] * dsdx.val[lane]
+                               + dt[lane] * dtdx.val[lane];
+                    dy[lane] = ds[lane] * dsdy.val[lane]
+                               + dt[lane] * dtdy.val[lane];
+                }
+            }
+        }
+    }
+    scatter_results(outputs, result.val, dresultdx.val, dresultdy.val);
+    return finish_lookup(ok, texsys, bsg, outputs, "texture");
+}
+
+
+
+OSL_NOINLINE Mask
+default_texture3d(TextureSystem* texsys, ustring filename,
+                  TextureSystem::TextureHandle* texture_handle,
+                  TextureSystem::Perthread* texture_thread_info,
+                  const BatchedTextureOptions& options,
+                  BatchedShaderGlobals* bsg, Wide<const Vec3> wP,
+                  Wide<const Vec3> wdPdx, Wide<const Vec3> wdPdy,
+                  Wide<const Vec3> wdPdz, BatchedTextureOutputs& outputs)
+{
+    if (!texture_handle)
+        texture_handle = texsys->get_texture_handle(filename,
+                                                    texture_thread_info);
+
+    OIIO::TextureOptBatch oiio_opt;
+    to_texture_opt_batch(options, oiio_opt);
+
+    TexCoords P, dPdx, dPdy, dPdz;
+    gather(wP, P.val);
+    gather(wdPdx, dPdx.val);
+    gather(wdPdy, dPdy.val);
+    gather(wdPdz, dPdz.val);
+
+    int nchannels = lookup_channels(outputs);
+    bool derivs   = need_derivs(outputs);
+    TexChannels result, dresultds, dresultdt, dresultdr;
+    bool ok = texsys->texture3d(texture_handle, texture_thread_info, oiio_opt,
+                                OIIO::Tex::RunMask(outputs.mask().value()),
+                                P.val, dPdx.val, dPdy.val, dPdz.val,
+                                nchannels, result.val,
+                                derivs ? dresultds.val : nullptr,
+                                derivs ? dresultdt.val : nullptr,
+                                derivs ? dresultdr.val : nullptr);
+
+    // Correct our str texture space gradients into xyz-space gradients
+    TexChannels dresultdx, dresultdy;
+    if (derivs) {
+        for (int c = 0; c < nchannels; ++c) {
+            float* ds = dresultds.val + c * TexWidth;
+            float* dt = dresultdt.val + c * TexWidth;
+            float* dr = dresultdr.val + c * TexWidth;
+            float* dx = dresultdx.val + c * TexWidth;
+            float* dy = dresultdy.val + c * TexWidth;
+            OSL_FORCEINLINE_BLOCK
+            {
+                OSL_OMP_PRAGMA(omp simd simdlen(__OSL_WIDTH))
+                for (int lane = 0; lane < __OSL_WIDTH; ++lane) {
+                    dx[lane] = ds[lane] * dPdx.val[lane]
+                               + dt[lane] * dPdx.val[TexWidth + lane]
+                               + dr[lane] * dPdx.val[2 * TexWidth + lane];
+                    dy[lane] = ds[lane] * dPdy.val[lane]
+                               + dt[lane] * dPdy.val[TexWidth + lane]
+                               + dr[lane] * dPdy.val[2 * TexWidth + lane];
+                }
+            }
+        }
+    }
+    scatter_results(outputs, result.val, dresultdx.val, dresultdy.val);
+    return finish_lookup(ok, texsys, bsg, outputs, "texture3d");
+}
+
+
+
+OSL_NOINLINE Mask
+default_environment(TextureSystem* texsys, ustring filename,
+                    TextureSystem::TextureHandle* texture_handle,
+                    TextureSystem::Perthread* texture_thread_info,
+                    const BatchedTextureOptions& options,
+                    BatchedShaderGlobals* bsg, Wide<const Vec3> wR,
+                    Wide<const Vec3> wdRdx, Wide<const Vec3> wdRdy,
+                    BatchedTextureOutputs& outputs)
+{
+    if (!texture_handle)
+        texture_handle = texsys->get_texture_handle(filename,
+                                                    texture_thread_info);
+
+    OIIO::TextureOptBatch oiio_opt;
+    to_texture_opt_batch(options, oiio_opt);
+
+    TexCoords R, dRdx, dRdy;
+    gather(wR, R.val);
+    gather(wdRdx, dRdx.val);
+    gather(wdRdy, dRdy.val);
+
+    TexChannels result;
+    bool ok = texsys->environment(texture_handle, texture_thread_info,
+                                  oiio_opt,
+                                  OIIO::Tex::RunMask(outputs.mask().value()),
+                                  R.val, dRdx.val, dRdy.val,
+                                  lookup_channels(outputs), result.val);
+
+    // Like the scalar osl_environment, just zero the derivatives, as we
+    // don't know which projection took R to the st OIIO would give us
+    // gradients in.
+    TexChannels zero;
+    std::fill(zero.val, zero.val + 4 * TexWidth, 0.0f);
+    scatter_results(outputs, result.val, zero.val, zero.val);
+    return finish_lookup(ok, texsys, bsg, outputs, "environment");
+}
+
+}  // namespace
+
+
+
+OSL_BATCHOP int
+__OSL_MASKED_OP(texture)(void* bsg_, void* name, void* handle, void* opt_,
+                         void* s, void* t, void* dsdx, void* dtdx,
+                         void* dsdy, void* dtdy, int chans, void* result,
+                         int resultHasDerivs, void* alpha, int alphaHasDerivs,
+                         void* errormessage, unsigned int mask_value)
+{
+    Mask mask(mask_value);
+    OSL_DASSERT(mask.any_on());
+    auto* bsg           = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx = bsg->uniform.context;
+    const auto& opt     = *reinterpret_cast<const BatchedTextureOptions*>(opt_);
+
+    BatchedTextureOutputs outputs(result, (bool)resultHasDerivs, chans, alpha,
+                                  (bool)alphaHasDerivs, errormessage, mask);
+
+    auto* renderer = ctx->batched<__OSL_WIDTH>().renderer();
+    Mask ok(false);
+    if (renderer->is_overridden_texture()) {
+        ok = renderer->texture(USTR(name),
+                               (TextureSystem::TextureHandle*)handle,
+                               ctx->texture_thread_info(), opt, bsg,
+                               Wide<const float>(s), Wide<const float>(t),
+                               Wide<const float>(dsdx), Wide<const float>(dtdx),
+                               Wide<const float>(dsdy), Wide<const float>(dtdy),
+                               outputs);
+    } else {
+        ok = default_texture(renderer->texturesys(), USTR(name),
+                             (TextureSystem::TextureHandle*)handle,
+                             ctx->texture_thread_info(), opt, bsg,
+                             Wide<const float>(s), Wide<const float>(t),
+                             Wide<const float>(dsdx), Wide<const float>(dtdx),
+                             Wide<const float>(dsdy), Wide<const float>(dtdy),
+                             outputs);
+    }
+    return ok.value();
+}
+
+
+
+OSL_BATCHOP int
+__OSL_MASKED_OP(texture3d)(void* bsg_, void* name, void* handle, void* opt_,
+                           void* P, void* dPdx, void* dPdy, int chans,
+                           void* result, int resultHasDerivs, void* alpha,
+                           int alphaHasDerivs, void* errormessage,
+                           unsigned int mask_value)
+{
+    Mask mask(mask_value);
+    OSL_DASSERT(mask.any_on());
+    auto* bsg           = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx = bsg->uniform.context;
+    const auto& opt     = *reinterpret_cast<const BatchedTextureOptions*>(opt_);
+
+    BatchedTextureOutputs outputs(result, (bool)resultHasDerivs, chans, alpha,
+                                  (bool)alphaHasDerivs, errormessage, mask);
+
+    // Like the scalar osl_texture3d, there is no dPdz to pass along yet
+    Block<Vec3> dPdz;
+    for (int lane = 0; lane < __OSL_WIDTH; ++lane)
+        dPdz[lane] = Vec3(0.0f);
+
+    auto* renderer = ctx->batched<__OSL_WIDTH>().renderer();
+    Mask ok(false);
+    if (renderer->is_overridden_texture3d()) {
+        ok = renderer->texture3d(USTR(name),
+                                 (TextureSystem::TextureHandle*)handle,
+                                 ctx->texture_thread_info(), opt, bsg,
+                                 Wide<const Vec3>(P), Wide<const Vec3>(dPdx),
+                                 Wide<const Vec3>(dPdy), dPdz, outputs);
+    } else {
+        ok = default_texture3d(renderer->texturesys(), USTR(name),
+                               (TextureSystem::TextureHandle*)handle,
+                               ctx->texture_thread_info(), opt, bsg,
+                               Wide<const Vec3>(P), Wide<const Vec3>(dPdx),
+                               Wide<const Vec3>(dPdy), dPdz, outputs);
+    }
+    return ok.value();
+}
+
+
+
+OSL_BATCHOP int
+__OSL_MASKED_OP(environment)(void* bsg_, void* name, void* handle,
+                             void* opt_, void* R, void* dRdx, void* dRdy,
+                             int chans, void* result, int resultHasDerivs,
+                             void* alpha, int alphaHasDerivs,
+                             void* errormessage, unsigned int mask_value)
+{
+    Mask mask(mask_value);
+    OSL_DASSERT(mask.any_on());
+    auto* bsg           = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx = bsg->uniform.context;
+    const auto& opt     = *reinterpret_cast<const BatchedTextureOptions*>(opt_);
+
+    BatchedTextureOutputs outputs(result, (bool)resultHasDerivs, chans, alpha,
+                                  (bool)alphaHasDerivs, errormessage, mask);
+
+    // BatchedRendererServices has no environment entry point yet, so go
+    // straight to the renderer's TextureSystem.
+    auto* renderer = ctx->batched<__OSL_WIDTH>().renderer();
+    Mask ok = default_environment(renderer->texturesys(), USTR(name),
+                                  (TextureSystem::TextureHandle*)handle,
+                                  ctx->texture_thread_info(), opt, bsg,
+                                  Wide<const Vec3>(R), Wide<const Vec3>(dRdx),
+                                  Wide<const Vec3>(dRdy), outputs);
+    return ok.value();
+}
+
+
+
+OSL_BATCHOP int
+__OSL_MASKED_OP(get_textureinfo)(void* bsg_, void* wname, void* dataname,
+                                 void* typedesc_, void* wdata,
+                                 unsigned int mask_value)
+{
+    auto* bsg                = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx      = bsg->uniform.context;
+    const TypeDesc& typedesc = *reinterpret_cast<const TypeDesc*>(typedesc_);
+
+    MaskedData data(typedesc, false, Mask(mask_value), wdata);
+    Mask ok = ctx->batched<__OSL_WIDTH>().renderer()->get_texture_info(
+        bsg, ctx->texture_thread_info(), Wide<const ustring>(wname),
+        0 /*FIXME-ptex*/, USTR(dataname), data);
+    return ok.value();
+}
+
+
+
+OSL_BATCHOP int
+__OSL_OP(get_textureinfo_uniform)(void* bsg_, void* name, void* handle,
+                                  void* dataname, void* typedesc_, void* data)
+{
+    auto* bsg                = reinterpret_cast<BatchedShaderGlobals*>(bsg_);
+    ShadingContext* ctx      = bsg->uniform.context;
+    const TypeDesc& typedesc = *reinterpret_cast<const TypeDesc*>(typedesc_);
+
+    RefData val(typedesc, false, data);
+    return ctx->batched<__OSL_WIDTH>().renderer()->get_texture_info_uniform(
+        bsg, ctx->texture_thread_info(), USTR(name),
+        (TextureSystem::TextureHandle*)handle, 0 /*FIXME-ptex*/,
+        USTR(dataname), val);
+}
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
+
+#include "undef_opname_macros.h"
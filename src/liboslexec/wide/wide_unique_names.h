@@ -0,0 +1,55 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+/////////////////////////////////////////////////////////////////////////
+/// \file
+///
+/// Space, color space, texture and pattern names are almost always the
+/// same across a batch, so the shadeops taking a varying name do their
+/// work once for each distinct name, for all the lanes that share it.
+///
+/////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <OSL/oslconfig.h>
+
+#include <OSL/batched_shaderglobals.h>
+#include <OSL/wide.h>
+
+OSL_NAMESPACE_ENTER
+namespace __OSL_WIDE_PVT {
+
+OSL_USING_DATA_WIDTH(__OSL_WIDTH)
+
+// Lanes of mask whose name is the same as name
+OSL_FORCEINLINE Mask
+lanes_named(Wide<const ustring> wname, Mask mask, ustring name)
+{
+    Mask same(false);
+    mask.foreach ([&](ActiveLane lane) -> void {
+        if (wname[lane] == name)
+            same.set_on(lane);
+    });
+    return same;
+}
+
+
+
+// Call f(Mask, ustring) once for each distinct name among the active
+// lanes, with the mask of the lanes that share it.
+template<typename FunctorT>
+OSL_FORCEINLINE void
+foreach_unique_name(Wide<const ustring> wname, Mask mask, FunctorT f)
+{
+    while (mask.any_on()) {
+        ustring name = wname[mask.first_on()];
+        Mask same    = lanes_named(wname, mask, name);
+        f(same, name);
+        mask &= ~same;
+    }
+}
+
+}  // namespace __OSL_WIDE_PVT
+OSL_NAMESPACE_EXIT
@@ -0,0 +1,553 @@
+// Copyright Contributors to the Open Shading Language project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+// Load each wide target library this machine can run, and check that the
+// wide noise shadeops in it give the same results as the scalar noise
+// functors on every active lane, leave the inactive lanes alone, and time
+// both of them in lanes per second.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/plugin.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/timer.h>
+#include <OpenImageIO/unittest.h>
+
+#include <OSL/dual.h>
+#include <OSL/dual_vec.h>
+#include <OSL/llvm_util.h>
+#include <OSL/oslconfig.h>
+#include <OSL/oslnoise.h>
+#include <OSL/wide.h>
+
+#include "opnoise.h"
+
+using namespace OSL;
+
+
+static int iterations = 4000000;
+static int nbatches = 256;
+static std::string libdir = OSL_TARGET_LIB_DIR;
+static std::mt19937 rng (42);
+
+
+// The target libraries, as the batched backend names and loads them.
+// Those built with FMA may contract the noise arithmetic differently
+// from the scalar build, so their floats are only asked to be close.
+struct TargetLib {
+    const char *selector;
+    int width;
+    TargetISA isa;
+    bool fma;
+};
+
+static const TargetLib target_libs[] = {
+    { "b16_AVX512_", 16, TargetISA::AVX512, true },
+    { "b8_AVX512_",  8,  TargetISA::AVX512, true },
+    { "b8_AVX2_",    8,  TargetISA::AVX2,   true },
+    { "b8_AVX_",     8,  TargetISA::AVX,    false },
+};
+
+
+typedef void (*Kernel1)(void*, void*, unsigned int);
+typedef void (*Kernel2)(void*, void*, void*, unsigned int);
+typedef void (*Kernel4)(void*, void*, void*, void*, void*, unsigned int);
+
+
+// Look up a masked shadeop of the library by the name the batched
+// backend asks for, e.g. "osl_b8_AVX2_noise_WfWv_masked".
+template<typename KernelT>
+static KernelT
+find_kernel (OIIO::Plugin::Handle lib, const TargetLib &target,
+             const char *opname, const char *sig)
+{
+    std::string name = OIIO::Strutil::sprintf ("osl_%s%s_%s_masked",
+                                               target.selector, opname, sig);
+    KernelT kernel = reinterpret_cast<KernelT>(
+        OIIO::Plugin::getsym (lib, name, /*report_error*/ false));
+    OIIO_CHECK_ASSERT (kernel != nullptr);
+    if (!kernel)
+        std::cout << "    missing " << name << "\n";
+    return kernel;
+}
+
+
+
+static void randomize (float &f, float scale) {
+    f = std::uniform_real_distribution<float>(-scale, scale)(rng);
+}
+
+static void randomize (Vec3 &v, float scale) {
+    randomize (v.x, scale);
+    randomize (v.y, scale);
+    randomize (v.z, scale);
+}
+
+template<typename T>
+static void randomize (Dual2<T> &d, float scale) {
+    T val, dx, dy;
+    randomize (val, scale);
+    randomize (dx, 1.0f);
+    randomize (dy, 1.0f);
+    d.set (val, dx, dy);
+}
+
+// Periods are small positive whole numbers, like the ones shaders use
+static void randomize_period (float &f) {
+    f = float(std::uniform_int_distribution<int>(1, 8)(rng));
+}
+
+static void randomize_period (Vec3 &v) {
+    randomize_period (v.x);
+    randomize_period (v.y);
+    randomize_period (v.z);
+}
+
+template<typename T, int WidthT>
+static void store (Block<T, WidthT> &block, int lane, const T &value) {
+    Wide<T, WidthT> w (&block);
+    w[lane] = value;
+}
+
+
+
+// Compare every lane of the wide result against the expected values.
+// With eps == 0 they must be the same bits, otherwise every float that
+// makes up the value must be within eps, relative to its size when that
+// is more than 1.
+template<typename R, int WidthT>
+static void
+compare (const std::string &name, Block<R, WidthT> &r, const R *expected,
+         float eps)
+{
+    Wide<const R, WidthT> wr (&r);
+    for (int lane = 0;  lane < WidthT;  ++lane) {
+        R got = wr[lane];
+        const float *g = reinterpret_cast<const float *>(&got);
+        const float *e = reinterpret_cast<const float *>(&expected[lane]);
+        bool ok = true;
+        for (size_t i = 0;  i < sizeof(R) / sizeof(float);  ++i) {
+            if (eps == 0.0f)
+                ok &= (memcmp (&g[i], &e[i], sizeof(float)) == 0);
+            else
+                ok &= (std::abs (g[i] - e[i])
+                       <= eps * std::max (1.0f, std::abs (e[i])));
+        }
+        OIIO_CHECK_ASSERT (ok);
+        if (!ok)
+            std::cout << "    " << name << " lane " << lane << " differs\n";
+    }
+}
+
+
+
+// Random lanes active, and the inactive ones must keep what was there
+template<int WidthT>
+static unsigned int random_mask () {
+    return std::uniform_int_distribution<unsigned int>(0, (1u << WidthT) - 1)(rng);
+}
+
+template<typename R, int WidthT>
+static void
+fill_result (Block<R, WidthT> &r, R *expected)
+{
+    for (int lane = 0;  lane < WidthT;  ++lane) {
+        randomize (expected[lane], 100.0f);
+        store (r, lane, expected[lane]);
+    }
+}
+
+
+
+template<int WidthT, typename F, typename R, typename A>
+static void
+check (OIIO::Plugin::Handle lib, const TargetLib &target,
+       const char *opname, const char *sig, float eps)
+{
+    Kernel1 kernel = find_kernel<Kernel1> (lib, target, opname, sig);
+    if (!kernel)
+        return;
+    std::string name = OIIO::Strutil::sprintf ("%s%s %s", target.selector,
+                                               opname, sig);
+    F scalar;
+    for (int b = 0;  b < nbatches;  ++b) {
+        Block<R, WidthT> r;  Block<A, WidthT> wa;
+        R expected[WidthT];  A a[WidthT];
+        fill_result (r, expected);
+        for (int lane = 0;  lane < WidthT;  ++lane) {
+            randomize (a[lane], 16.0f);
+            store (wa, lane, a[lane]);
+        }
+        unsigned int mask = random_mask<WidthT> ();
+        kernel (&r, &wa, mask);
+        for (int lane = 0;  lane < WidthT;  ++lane)
+            if (mask & (1u << lane))
+                scalar (expected[lane], a[lane]);
+        compare (name, r, expected, eps);
+    }
+}
+
+
+
+template<int WidthT, typename F, typename R, typename A, typename B>
+static void
+check (OIIO::Plugin::Handle lib, const TargetLib &target,
+       const char *opname, const char *sig, float eps)
+{
+    Kernel2 kernel = find_kernel<Kernel2> (lib, target, opname, sig);
+    if (!kernel)
+        return;
+    std::string name = OIIO::Strutil::sprintf ("%s%s %s", target.selector,
+                                               opname, sig);
+    F scalar;
+    for (int b = 0;  b < nbatches;  ++b) {
+        Block<R, WidthT> r;  Block<A, WidthT> wa;  Block<B, WidthT> wb;
+        R expected[WidthT];  A a[WidthT];  B bb[WidthT];
+        fill_result (r, expected);
+        for (int lane = 0;  lane < WidthT;  ++lane) {
+            randomize (a[lane], 16.0f);
+            randomize (bb[lane], 16.0f);
+            store (wa, lane, a[lane]);
+            store (wb, lane, bb[lane]);
+        }
+        unsigned int mask = random_mask<WidthT> ();
+        kernel (&r, &wa, &wb, mask);
+        for (int lane = 0;  lane < WidthT;  ++lane)
+            if (mask & (1u << lane))
+                scalar (expected[lane], a[lane], bb[lane]);
+        compare (name, r, expected, eps);
+    }
+}
+
+
+
+template<int WidthT, typename F, typename R, typename A, typename PA>
+static void
+check_periodic (OIIO::Plugin::Handle lib, const TargetLib &target,
+                const char *opname, const char *sig, float eps)
+{
+    Kernel2 kernel = find_kernel<Kernel2> (lib, target, opname, sig);
+    if (!kernel)
+        return;
+    std::string name = OIIO::Strutil::sprintf ("%s%s %s", target.selector,
+                                               opname, sig);
+    F scalar;
+    for (int b = 0;  b < nbatches;  ++b) {
+        Block<R, WidthT> r;  Block<A, WidthT> wa;  Block<PA, WidthT> wpa;
+        R expected[WidthT];  A a[WidthT];  PA pa[WidthT];
+        fill_result (r, expected);
+        for (int lane = 0;  lane < WidthT;  ++lane) {
+            randomize (a[lane], 16.0f);
+            randomize_period (pa[lane]);
+            store (wa, lane, a[lane]);
+            store (wpa, lane, pa[lane]);
+        }
+        unsigned int mask = random_mask<WidthT> ();
+        kernel (&r, &wa, &wpa, mask);
+        for (int lane = 0;  lane < WidthT;  ++lane)
+            if (mask & (1u << lane))
+                scalar (expected[lane], a[lane], pa[lane]);
+        compare (name, r, expected, eps);
+    }
+}
+
+
+
+template<int WidthT, typename F, typename R, typename A, typename B,
+         typename PA, typename PB>
+static void
+check_periodic (OIIO::Plugin::Handle lib, const TargetLib &target,
+                const char *opname, const char *sig, float eps)
+{
+    Kernel4 kernel = find_kernel<Kernel4> (lib, target, opname, sig);
+    if (!kernel)
+        return;
+    std::string name = OIIO::Strutil::sprintf ("%s%s %s", target.selector,
+                                               opname, sig);
+    F scalar;
+    for (int b = 0;  b < nbatches;  ++b) {
+        Block<R, WidthT> r;  Block<A, WidthT> wa;  Block<B, WidthT> wb;
+        Block<PA, WidthT> wpa;  Block<PB, WidthT> wpb;
+        R expected[WidthT];  A a[WidthT];  B bb[WidthT];
+        PA pa[WidthT];  PB pb[WidthT];
+        fill_result (r, expected);
+        for (int lane = 0;  lane < WidthT;  ++lane) {
+            randomize (a[lane], 16.0f);
+            randomize (bb[lane], 16.0f);
+            randomize_period (pa[lane]);
+            randomize_period (pb[lane]);
+            store (wa, lane, a[lane]);
+            store (wb, lane, bb[lane]);
+            store (wpa, lane, pa[lane]);
+            store (wpb, lane, pb[lane]);
+        }
+        unsigned int mask = random_mask<WidthT> ();
+        kernel (&r, &wa, &wb, &wpa, &wpb, mask);
+        for (int lane = 0;  lane < WidthT;  ++lane)
+            if (mask & (1u << lane))
+                scalar (expected[lane], a[lane], bb[lane], pa[lane], pb[lane]);
+        compare (name, r, expected, eps);
+    }
+}
+
+
+
+// Every signature of WIDE_NOISE_IMPL, and of WIDE_NOISE_DERIV_IMPL
+#define CHECK_NOISE(opname, F, eps)                                       \
+    check<W, F, float, float>(lib, target, #opname, "WfWf", eps);        \
+    check<W, F, float, Vec3>(lib, target, #opname, "WfWv", eps);         \
+    check<W, F, Vec3, float>(lib, target, #opname, "WvWf", eps);         \
+    check<W, F, Vec3, Vec3>(lib, target, #opname, "WvWv", eps);          \
+    check<W, F, float, float, float>(lib, target, #opname, "WfWfWf", eps); \
+    check<W, F, float, Vec3, float>(lib, target, #opname, "WfWvWf", eps); \
+    check<W, F, Vec3, float, float>(lib, target, #opname, "WvWfWf", eps); \
+    check<W, F, Vec3, Vec3, float>(lib, target, #opname, "WvWvWf", eps)
+
+#define CHECK_NOISE_DERIV(opname, F, eps)                                 \
+    check<W, F, Dual2<float>, Dual2<float>>(lib, target, #opname,        \
+                                            "WdfWdf", eps);               \
+    check<W, F, Dual2<float>, Dual2<Vec3>>(lib, target, #opname,         \
+                                           "WdfWdv", eps);                \
+    check<W, F, Dual2<Vec3>, Dual2<float>>(lib, target, #opname,         \
+                                           "WdvWdf", eps);                \
+    check<W, F, Dual2<Vec3>, Dual2<Vec3>>(lib, target, #opname,          \
+                                          "WdvWdv", eps);                 \
+    check<W, F, Dual2<float>, Dual2<float>, Dual2<float>>(lib, target,   \
+                                          #opname, "WdfWdfWdf", eps);     \
+    check<W, F, Dual2<float>, Dual2<Vec3>, Dual2<float>>(lib, target,    \
+                                          #opname, "WdfWdvWdf", eps);     \
+    check<W, F, Dual2<Vec3>, Dual2<float>, Dual2<float>>(lib, target,    \
+                                          #opname, "WdvWdfWdf", eps);     \
+    check<W, F, Dual2<Vec3>, Dual2<Vec3>, Dual2<float>>(lib, target,     \
+                                          #opname, "WdvWdvWdf", eps)
+
+// Every signature of WIDE_PNOISE_IMPL, and of WIDE_PNOISE_DERIV_IMPL
+#define CHECK_PNOISE(opname, F, eps)                                      \
+    check_periodic<W, F, float, float, float>(lib, target, #opname,      \
+                                              "WfWfWf", eps);             \
+    check_periodic<W, F, float, Vec3, Vec3>(lib, target, #opname,        \
+                                            "WfWvWv", eps);               \
+    check_periodic<W, F, Vec3, float, float>(lib, target, #opname,       \
+                                             "WvWfWf", eps);              \
+    check_periodic<W, F, Vec3, Vec3, Vec3>(lib, target, #opname,         \
+                                           "WvWvWv", eps);                \
+    check_periodic<W, F, float, float, float, float, float>(lib, target, \
+                                           #opname, "WfWfWfWfWf", eps);   \
+    check_periodic<W, F, float, Vec3, float, Vec3, float>(lib, target,   \
+                                           #opname, "WfWvWfWvWf", eps);   \
+    check_periodic<W, F, Vec3, float, float, float, float>(lib, target,  \
+                                           #opname, "WvWfWfWfWf", eps);   \
+    check_periodic<W, F, Vec3, Vec3, float, Vec3, float>(lib, target,    \
+                                           #opname, "WvWvWfWvWf", eps)
+
+#define CHECK_PNOISE_DERIV(opname, F, eps)                                \
+    check_periodic<W, F, Dual2<float>, Dual2<float>, float>(lib, target, \
+                                           #opname, "WdfWdfWf", eps);     \
+    check_periodic<W, F, Dual2<float>, Dual2<Vec3>, Vec3>(lib, target,   \
+                                           #opname, "WdfWdvWv", eps);     \
+    check_periodic<W, F, Dual2<Vec3>, Dual2<float>, float>(lib, target,  \
+                                           #opname, "WdvWdfWf", eps);     \
+    check_periodic<W, F, Dual2<Vec3>, Dual2<Vec3>, Vec3>(lib, target,    \
+                                           #opname, "WdvWdvWv", eps);     \
+    check_periodic<W, F, Dual2<float>, Dual2<float>, Dual2<float>,       \
+                   float, float>(lib, target, #opname,                    \
+                                 "WdfWdfWdfWfWf", eps);                   \
+    check_periodic<W, F, Dual2<float>, Dual2<Vec3>, Dual2<float>,        \
+                   Vec3, float>(lib, target, #opname,                     \
+                                "WdfWdvWdfWvWf", eps);                    \
+    check_periodic<W, F, Dual2<Vec3>, Dual2<float>, Dual2<float>,        \
+                   float, float>(lib, target, #opname,                    \
+                                 "WdvWdfWdfWfWf", eps);                   \
+    check_periodic<W, F, Dual2<Vec3>, Dual2<Vec3>, Dual2<float>,         \
+                   Vec3, float>(lib, target, #opname,                     \
+                                "WdvWdvWdfWvWf", eps)
+
+
+
+template<int W>
+static void
+test_noise (OIIO::Plugin::Handle lib, const TargetLib &target)
+{
+    // The perlin noises must match the functors the scalar shadeops use
+    // bit for bit, unless the library was built to use FMA. The cell and
+    // hash noises only do integer math on the floor of their inputs, so
+    // they always match exactly.
+    const float eps = target.fma ? 1.0e-5f : 0.0f;
+    CHECK_NOISE (noise, pvt::Noise, eps);
+    CHECK_NOISE_DERIV (noise, pvt::Noise, eps);
+    CHECK_NOISE (snoise, pvt::SNoise, eps);
+    CHECK_NOISE_DERIV (snoise, pvt::SNoise, eps);
+    CHECK_NOISE (cellnoise, pvt::CellNoise, 0.0f);
+    CHECK_NOISE (hashnoise, pvt::HashNoise, 0.0f);
+    CHECK_NOISE (unullnoise, pvt::UNullNoise, 0.0f);
+    CHECK_PNOISE (pnoise, pvt::PeriodicNoise, eps);
+    CHECK_PNOISE_DERIV (pnoise, pvt::PeriodicNoise, eps);
+    CHECK_PNOISE (psnoise, pvt::PeriodicSNoise, eps);
+    CHECK_PNOISE_DERIV (psnoise, pvt::PeriodicSNoise, eps);
+    CHECK_PNOISE (pcellnoise, pvt::PeriodicCellNoise, 0.0f);
+    CHECK_PNOISE (phashnoise, pvt::PeriodicHashNoise, 0.0f);
+
+    // The wide simplex noise is the sfm:: version, which must match its
+    // own scalar functor just as tightly as the perlin noises do.
+    CHECK_NOISE (simplexnoise, pvt::SimplexNoiseScalar, eps);
+    CHECK_NOISE_DERIV (simplexnoise, pvt::SimplexNoiseScalar, eps);
+    CHECK_NOISE (usimplexnoise, pvt::USimplexNoiseScalar, eps);
+    CHECK_NOISE_DERIV (usimplexnoise, pvt::USimplexNoiseScalar, eps);
+
+    // The scalar shadeops call simplexnoise3 in liboslnoise instead,
+    // which looks its gradients up in a table and sums the corners in
+    // another order, so the two only agree to rounding. The results are
+    // within 1 of 0, where 1.0e-5 is some tens of ulps; the derivatives
+    // go through one more multiply and add per corner.
+    CHECK_NOISE (simplexnoise, pvt::SimplexNoise, 1.0e-5f);
+    CHECK_NOISE_DERIV (simplexnoise, pvt::SimplexNoise, 1.0e-4f);
+    CHECK_NOISE (usimplexnoise, pvt::USimplexNoise, 1.0e-5f);
+    CHECK_NOISE_DERIV (usimplexnoise, pvt::USimplexNoise, 1.0e-4f);
+}
+
+
+
+// Time the wide kernel on full batches against the scalar functor on
+// the same lanes one at a time.
+template<int WidthT, typename F, typename R, typename A>
+static void
+bench (OIIO::Plugin::Handle lib, const TargetLib &target,
+       const char *opname, const char *sig)
+{
+    Kernel1 kernel = find_kernel<Kernel1> (lib, target, opname, sig);
+    if (!kernel)
+        return;
+    Block<R, WidthT> r;  Block<A, WidthT> wa;
+    A a[WidthT];
+    for (int lane = 0;  lane < WidthT;  ++lane) {
+        randomize (a[lane], 16.0f);
+        store (wa, lane, a[lane]);
+    }
+    const unsigned int all_lanes = (1u << WidthT) - 1;
+    int batches = std::max (1, iterations / WidthT);
+
+    OIIO::Timer wide_timer;
+    for (int b = 0;  b < batches;  ++b) {
+        OIIO::clobber (wa);
+        kernel (&r, &wa, all_lanes);
+        OIIO::DoNotOptimize (r);
+    }
+    double wide_time = wide_timer();
+
+    F scalar;
+    R result;
+    OIIO::Timer scalar_timer;
+    for (int b = 0;  b < batches;  ++b) {
+        OIIO::clobber (a);
+        for (int lane = 0;  lane < WidthT;  ++lane) {
+            scalar (result, a[lane]);
+            OIIO::DoNotOptimize (result);
+        }
+    }
+    double scalar_time = scalar_timer();
+
+    double lanes = double(batches) * WidthT;
+    std::cout << OIIO::Strutil::sprintf ("  %-24s wide %8.1f Mlanes/s   scalar %8.1f Mlanes/s\n",
+                                         OIIO::Strutil::sprintf ("%s %s", opname, sig),
+                                         lanes / wide_time * 1.0e-6,
+                                         lanes / scalar_time * 1.0e-6);
+}
+
+
+
+template<int W>
+static void
+bench_noise (OIIO::Plugin::Handle lib, const TargetLib &target)
+{
+    bench<W, pvt::Noise, float, float>(lib, target, "noise", "WfWf");
+    bench<W, pvt::Noise, float, Vec3>(lib, target, "noise", "WfWv");
+    bench<W, pvt::Noise, Vec3, Vec3>(lib, target, "noise", "WvWv");
+    bench<W, pvt::Noise, Dual2<float>, Dual2<Vec3>>(lib, target, "noise", "WdfWdv");
+    bench<W, pvt::SNoise, float, Vec3>(lib, target, "snoise", "WfWv");
+    bench<W, pvt::CellNoise, float, Vec3>(lib, target, "cellnoise", "WfWv");
+    bench<W, pvt::HashNoise, float, Vec3>(lib, target, "hashnoise", "WfWv");
+    bench<W, pvt::SimplexNoise, float, Vec3>(lib, target, "simplexnoise", "WfWv");
+}
+
+
+
+static void
+getargs (int argc, char *argv[])
+{
+    bool help = false;
+    OIIO::ArgParse ap;
+    ap.options ("widenoise_test\n"
+                OIIO_INTRO_STRING "\n"
+                "Usage:  widenoise_test [options]",
+                "--help", &help, "Print help message",
+                "--iterations %d", &iterations,
+                    OIIO::Strutil::sprintf("Lanes to time per noise (default: %d)", iterations).c_str(),
+                "--batches %d", &nbatches,
+                    OIIO::Strutil::sprintf("Random batches to check per signature (default: %d)", nbatches).c_str(),
+                "--libdir %s", &libdir,
+                    "Directory holding the wide target libraries",
+                NULL);
+    if (ap.parse (argc, (const char**)argv) < 0) {
+        std::cerr << ap.geterror() << std::endl;
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+    if (help) {
+        ap.usage ();
+        exit (EXIT_FAILURE);
+    }
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+#if !defined(NDEBUG) || defined(OIIO_CI) || defined(OIIO_CODE_COVERAGE)
+    // For the sake of test time, reduce the default iterations for DEBUG,
+    // CI, and code coverage builds. Explicit use of --iterations overrides
+    // this, since it comes before the getargs() call.
+    iterations /= 10;
+#endif
+    getargs (argc, argv);
+
+    int tested = 0;
+    for (const TargetLib &target : target_libs) {
+        if (! LLVM_Util::supports_isa (target.isa)) {
+            std::cout << "Skipping " << target.selector
+                      << " libraries, not supported by this machine\n";
+            continue;
+        }
+        std::string filename = OIIO::Strutil::sprintf ("%s/lib_%soslexec.%s",
+                                   libdir, target.selector,
+                                   OIIO::Plugin::plugin_extension());
+        OIIO::Plugin::Handle lib = OIIO::Plugin::open (filename, /*global=*/false);
+        OIIO_CHECK_ASSERT (lib);
+        if (! lib) {
+            std::cout << "Could not load " << filename << ": "
+                      << OIIO::Plugin::geterror() << "\n";
+            continue;
+        }
+        std::cout << "Testing " << filename << "\n";
+        if (target.width == 16) {
+            test_noise<16> (lib, target);
+            bench_noise<16> (lib, target);
+        } else {
+            test_noise<8> (lib, target);
+            bench_noise<8> (lib, target);
+        }
+        OIIO::Plugin::close (lib);
+        ++tested;
+    }
+    if (! tested)
+        std::cout << "No wide target library runs on this machine\n";
+
+    return unit_test_failures;
+}
@@ -388,7 +388,8 @@ bool
 OSLQuery::open_bytecode(string_view buffer)
 {
     OSOReaderQuery oso(*this);
-    bool ok = oso.parse_memory(buffer);
+    bool ok = OSOReader::is_binary(buffer) ? oso.parse_binary(buffer)
+                                           : oso.parse_memory(buffer);
     return ok;
 }
 
@@ -3,6 +3,8 @@
 // https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
 
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -25,7 +27,7 @@ usage()
     std::cout
         << "oslc -- Open Shading Language compiler " OSL_LIBRARY_VERSION_STRING
            "\n" OSL_COPYRIGHT_STRING "\n"
-           "Usage:  oslc [options] file\n"
+           "Usage:  oslc [options] file [file ...]\n"
            "  Options:\n"
            "\t--help         Print this usage message\n"
            "\t-o filename    Specify output filename\n"
@@ -39,7 +41,13 @@ usage()
            "\t-E             Only preprocess the input and output to stdout\n"
            "\t-Werror        Treat all warnings as errors\n"
            "\t-embed-source  Embed preprocessed source in the oso file\n"
+           "\t-binary-oso    Also write a binary .osob that loads without parsing\n"
+           "\t-j N           Compile multiple files using N threads (0 = all cores)\n"
            "\t-buffer        (debugging) Force compile from buffer\n"
+           "\t-t target      Output target: oso (default) or artic\n"
+           "\t-artic-cache dir  Reuse transpiled Artic sources cached in dir\n"
+           "\t-artic-partial  Leave out functions Artic cannot express (warn, don't fail)\n"
+           "\t-artic-vector-width N  Lanes per packet of <shader>_batched (default 8)\n"
            "\t-MD, -MMD      Write a depfile containing headers used, to a file\n"
            "\t-M, -MM        Like -MD, but write depfile to stdout\n"
            "\t-MF filename   Specify the name of the depfile to output (for -MD, -MMD)\n"
@@ -83,6 +91,49 @@ public:
 };
 
 static OSLC_ErrorHandler default_oslc_error_handler;
+
+
+
+// Compile one shader with its own compiler. Safe to call concurrently.
+static bool
+compile_shader(const std::string& shader_path,
+               const std::vector<std::string>& args, bool compile_from_buffer,
+               bool quiet)
+{
+    static OIIO::mutex output_mutex;
+    OSLCompiler compiler(&default_oslc_error_handler);
+    bool ok = true;
+    if (compile_from_buffer) {
+        // Force a compile-from-buffer for debugging purposes
+        std::string sourcecode;
+        ok = OIIO::Filesystem::read_text_file(shader_path, sourcecode);
+        std::string osobuffer;
+        if (ok)
+            ok = compiler.compile_buffer(sourcecode, osobuffer, args, "",
+                                         shader_path);
+        if (ok) {
+            OIIO::ofstream file;
+            OIIO::Filesystem::open(file, compiler.output_filename());
+            if (file)
+                file << osobuffer;
+            ok = file.good();
+        }
+    } else {
+        // Ordinary compile from file
+        ok = compiler.compile(shader_path, args);
+    }
+
+    OIIO::lock_guard guard(output_mutex);
+    if (ok) {
+        if (!quiet)
+            std::cout << "Compiled " << shader_path << " -> "
+                      << compiler.output_filename() << "\n";
+    } else {
+        std::cout << "FAILED " << shader_path << "\n";
+    }
+    return ok;
+}
+
 }  // anonymous namespace
 
 
@@ -110,7 +161,9 @@ main(int argc, const char* argv[])
     std::vector<std::string> args;
     bool quiet               = false;
     bool compile_from_buffer = false;
-    std::string shader_path;
+    bool has_output_name     = false;
+    int nthreads             = 1;
+    std::vector<std::string> shader_paths;
 
     // Parse arguments from command line
     for (int a = 1; a < argc; ++a) {
@@ -132,6 +185,9 @@ main(int argc, const char* argv[])
                    || !strcmp(argv[a], "-Werror")
                    || !strcmp(argv[a], "-embed-source")
                    || !strcmp(argv[a], "--embed-source")
+                   || !strcmp(argv[a], "-binary-oso")
+                   || !strcmp(argv[a], "--binary-oso")
+                   || !strcmp(argv[a], "-artic-partial")
                    || !strcmp(argv[a], "-MD")
                    || !strcmp(argv[a], "--write-dependencies")
                    || !strcmp(argv[a], "-MMD")
@@ -147,6 +203,7 @@ main(int argc, const char* argv[])
             }
         } else if (!strcmp(argv[a], "-o") && a < argc - 1) {
             // Output filepath
+            has_output_name = true;
             args.emplace_back(argv[a]);
             ++a;
             args.emplace_back(argv[a]);
@@ -156,55 +213,59 @@ main(int argc, const char* argv[])
             args.emplace_back(argv[a]);
         } else if (!strcmp(argv[a], "-buffer")) {
             compile_from_buffer = true;
-        } else if(!strcmp(argv[a], "-t") && a < argc - 1) {
+        } else if ((!strcmp(argv[a], "-t")
+                    || !strcmp(argv[a], "-artic-cache")
+                    || !strcmp(argv[a], "-artic-vector-width"))
+                   && a < argc - 1) {
             args.emplace_back(argv[a]);
             ++a;
             args.emplace_back(argv[a]);
-        }
-
-        else {
+        } else if (!strcmp(argv[a], "-j") && a < argc - 1) {
+            nthreads = atoi(argv[++a]);
+        } else if (OIIO::Strutil::starts_with(argv[a], "-j")) {
+            nthreads = atoi(argv[a] + 2);
+        } else {
             // Shader to compile
-            shader_path = argv[a];
+            shader_paths.emplace_back(argv[a]);
         }
     }
 
-    if (shader_path.empty()) {
+    if (shader_paths.empty()) {
         std::cout << "ERROR: Missing shader path"
                   << "\n\n";
         usage();
         return EXIT_FAILURE;
     }
-
-    OSLCompiler compiler(&default_oslc_error_handler);
-    bool ok = true;
-    if (compile_from_buffer) {
-        // Force a compile-from-buffer for debugging purposes
-        std::string sourcecode;
-        ok = OIIO::Filesystem::read_text_file(shader_path, sourcecode);
-        std::string osobuffer;
-        if (ok)
-            ok = compiler.compile_buffer(sourcecode, osobuffer, args, "",
-                                         shader_path);
-        if (ok) {
-            OIIO::ofstream file;
-            OIIO::Filesystem::open(file, compiler.output_filename());
-            if (file)
-                file << osobuffer;
-            ok = file.good();
-        }
-    } else {
-        // Ordinary compile from file
-        ok = compiler.compile(shader_path, args);
+    if (shader_paths.size() > 1 && has_output_name) {
+        std::cout << "ERROR: -o may not be used with more than one shader"
+                  << "\n\n";
+        return EXIT_FAILURE;
     }
+    if (nthreads <= 0)
+        nthreads = std::max(1, (int)std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, (int)shader_paths.size());
 
-    if (ok) {
-        if (!quiet)
-            std::cout << "Compiled " << shader_path << " -> "
-                      << compiler.output_filename() << "\n";
+    // Each file gets its own compiler. Workers pull the next file off a
+    // shared cursor, so one slow shader doesn't hold up a whole share of
+    // the batch. The stdosl.h expansion is shared by all of them.
+    std::atomic<int> next_shader(0);
+    std::atomic<bool> all_ok(true);
+    auto compile_worker = [&]() {
+        for (int i = next_shader++; i < (int)shader_paths.size();
+             i       = next_shader++) {
+            if (!compile_shader(shader_paths[i], args, compile_from_buffer,
+                                quiet))
+                all_ok = false;
+        }
+    };
+    if (nthreads > 1) {
+        OIIO::thread_group threads;
+        for (int t = 0; t < nthreads; ++t)
+            threads.create_thread(compile_worker);
+        threads.join_all();
     } else {
-        std::cout << "FAILED " << shader_path << "\n";
-        return EXIT_FAILURE;
+        compile_worker();
     }
 
-    return EXIT_SUCCESS;
+    return all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
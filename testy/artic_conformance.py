@@ -0,0 +1,276 @@
+#!/usr/bin/env python
+
+# Copyright Contributors to the Open Shading Language project.
+# SPDX-License-Identifier: BSD-3-Clause
+# https://github.com/AcademySoftwareFoundation/OpenShadingLanguage
+
+# Run a shader through both backends on the same grid of shading points
+# and compare them: the LLVM JIT via testshade, and the Artic transpiler
+# via <shader>_batched compiled with the AnyDSL toolchain. Reports the
+# max/mean absolute error of each output and the time per point of each
+# backend. Both backends run on the same number of threads (--threads,
+# default one per core), and the time is also reported per thread.
+#
+# Usage:
+#   artic_conformance.py myshader.osl -o result -g 256 256 --iters 20 \
+#       --anydsl-runtime ~/anydsl/runtime --runtime-lib ~/anydsl/runtime/build/lib
+#
+# The shading points are testshade's defaults: u, v over [0,1] at the
+# grid corners, P = (u, v, 1), N = Ng = (0, 0, 1), dPdu = (1, 0, 0),
+# dPdv = (0, 1, 0), everything else zero. Parameters take their
+# defaults. Closure outputs are not compared.
+
+from __future__ import print_function
+
+import argparse
+import glob
+import multiprocessing
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+here = os.path.dirname(os.path.abspath(__file__))
+root = os.path.dirname(here)
+
+
+def run(cmd, cwd):
+    if args.verbose:
+        print("$", " ".join(cmd))
+    return subprocess.check_output(cmd, cwd=cwd, universal_newlines=True)
+
+
+# Parse testshade --print style output into {var: [floats per point]}.
+def parse_points(text):
+    values = {}
+    for line in text.splitlines():
+        m = re.match(r"^\s+(\w+)\s*:\s*(.*)$", line)
+        if m and not line.startswith("Pixel"):
+            values.setdefault(m.group(1), []).append(
+                [float(v) for v in m.group(2).split()])
+    return values
+
+
+# Seconds from OIIO's timeintervalformat ("1.234s", "2m 3.45s", ...).
+def parse_interval(text):
+    seconds = 0.0
+    for amount, unit in re.findall(r"([\d.]+)([hms])", text):
+        seconds += float(amount) * {"h": 3600.0, "m": 60.0, "s": 1.0}[unit]
+    return seconds
+
+
+def run_testshade(workdir):
+    oso = os.path.join(workdir, os.path.basename(args.shader)[:-4] + ".oso")
+    run([args.oslc, "-q", "-o", oso, args.shader], workdir)
+    common = [args.testshade, "-g", str(args.res[0]), str(args.res[1])]
+    outputs = []
+    for var in args.outputs:
+        outputs += ["-o", var, os.path.join(workdir, var + ".exr")]
+    printed = run(common + outputs + ["--print", oso], workdir)
+    stats = run(common + outputs + ["--iters", str(args.iters),
+                                    "-t", str(args.threads),
+                                    "--runstats", oso], workdir)
+    m = re.search(r"^Run\s*:\s*(.*)$", stats, re.M)
+    return parse_points(printed), parse_interval(m.group(1)) if m else 0.0
+
+
+driver_template = """
+static XRES = {xres};
+static YRES = {yres};
+
+fn @alloc_f32(n: i32) -> &mut [f32] {{
+    bitcast[&mut [f32]](alloc_cpu(n as i64 * sizeof[f32]()).data)
+}}
+
+fn @alloc_vector(n: i32) -> VectorSoA {{
+    VectorSoA {{ x = alloc_f32(n), y = alloc_f32(n), z = alloc_f32(n) }}
+}}
+
+fn @fill(a: &mut [f32], n: i32, value: fn(i32) -> f32) -> () {{
+    for i in range(0, n) {{ a(i) = value(i); }}
+}}
+
+fn @fill_vector(a: VectorSoA, n: i32, x: f32, y: f32, z: f32) -> () {{
+    fill(a.x, n, |_| x);
+    fill(a.y, n, |_| y);
+    fill(a.z, n, |_| z);
+}}
+
+fn @grid(i: i32, res: i32) -> f32 {{
+    if res == 1 {{ 0.5 }} else {{ (i as f32) / ((res - 1) as f32) }}
+}}
+
+#[export]
+fn main() -> i32 {{
+    let n = XRES * YRES;
+    let globals = shader_inout_soa {{
+        P = alloc_vector(n), I = alloc_vector(n), N = alloc_vector(n),
+        Ng = alloc_vector(n), u = alloc_f32(n), v = alloc_f32(n),
+        dPdu = alloc_vector(n), dPdv = alloc_vector(n), Ps = alloc_vector(n),
+        time = alloc_f32(n), dtime = alloc_f32(n), dPdtime = alloc_vector(n),
+        Ci = bitcast[&mut [Closure]](alloc_cpu(n as i64 * sizeof[Closure]()).data)
+    }};
+    let reset = || {{
+        fill(globals.u, n, |i| grid(i % XRES, XRES));
+        fill(globals.v, n, |i| grid(i / XRES, YRES));
+        fill(globals.P.x, n, |i| globals.u(i));
+        fill(globals.P.y, n, |i| globals.v(i));
+        fill(globals.P.z, n, |_| 1.0);
+        fill_vector(globals.I, n, 0.0, 0.0, 0.0);
+        fill_vector(globals.Ps, n, 0.0, 0.0, 0.0);
+        fill_vector(globals.dPdtime, n, 0.0, 0.0, 0.0);
+        fill_vector(globals.N, n, 0.0, 0.0, 1.0);
+        fill_vector(globals.Ng, n, 0.0, 0.0, 1.0);
+        fill_vector(globals.dPdu, n, 1.0, 0.0, 0.0);
+        fill_vector(globals.dPdv, n, 0.0, 1.0, 0.0);
+        fill(globals.time, n, |_| 0.0);
+        fill(globals.dtime, n, |_| 0.0);
+        for i in range(0, n) {{ globals.Ci(i) = EMPTY_CLOSURE; }}
+    }};
+    let outputs = {shader}_out_soa {{ {alloc_outputs} }};
+    reset();
+    let arg_in = make_{shader}_in(load_shader_inout(globals, 0));
+
+    ANYOSL_NUM_THREADS = {threads};
+    let start = get_micro_time();
+    for _ in range(0, {iters}) {{
+        {shader}_batched(arg_in, globals, outputs, n);
+    }}
+    let elapsed = get_micro_time() - start;
+
+    reset();
+    {shader}_batched(arg_in, globals, outputs, n);
+    for i in range(0, n) {{
+        print_string("Pixel (");
+        print_i32(i % XRES);
+        print_string(", ");
+        print_i32(i / XRES);
+        print_string("):\\n");
+        {print_outputs}
+    }}
+    print_string("Run   : ");
+    print_f32((elapsed as f32) * 1.0e-6);
+    print_string("s\\n");
+    0
+}}
+"""
+
+
+def run_artic(workdir):
+    art = os.path.join(workdir, "shader.art")
+    run([args.oslc, "-q", "-t", "artic", "-artic-vector-width",
+         str(args.vector_width), "-o", art, args.shader], workdir)
+    source = open(art).read()
+    shader = re.search(r"fn @(\w+)_batched\(", source).group(1)
+    fields = re.search(r"struct " + shader + r"_out_soa\s*\{(.*?)\}",
+                       source, re.S).group(1)
+    fields = dict(re.findall(r"(\w+)\s*:\s*([^,\n]+)", fields))
+
+    alloc, prints = [], []
+    for var, type in fields.items():
+        type = fields[var] = type.strip()
+        if type == "VectorSoA":
+            alloc.append("%s = alloc_vector(n)" % var)
+        else:
+            elem = type[len("&mut ["):-1]
+            alloc.append("%s = bitcast[%s](alloc_cpu(n as i64 * sizeof[%s]())"
+                         ".data)" % (var, type, elem))
+    for var in args.outputs:
+        if fields.get(var) not in ("VectorSoA", "&mut [f32]"):
+            print("Skipping output %s: not a float or triple" % var)
+            continue
+        prints.append('print_string("  %s :");' % var)
+        if fields[var] == "VectorSoA":
+            for c in "xyz":
+                prints.append('print_string(" "); print_f32(outputs.%s.%s(i));'
+                              % (var, c))
+        else:
+            prints.append('print_string(" "); print_f32(outputs.%s(i));' % var)
+        prints.append('print_string("\\n");')
+
+    driver = os.path.join(workdir, "driver.art")
+    with open(driver, "w") as f:
+        f.write(driver_template.format(
+            xres=args.res[0], yres=args.res[1], iters=args.iters,
+            threads=args.threads, shader=shader,
+            alloc_outputs=", ".join(alloc),
+            print_outputs="\n        ".join(prints)))
+
+    runtime = [f for f in sorted(glob.glob(os.path.join(
+                   args.anydsl_runtime, "platforms", "artic", "*.art")))
+               if os.path.basename(f) != "intrinsics_math.art"]
+    std = [os.path.join(root, f) for f in ("intrinsics_math.art",
+           "anyosl_std.art", "anyosl_integration_example.art")]
+    run([args.artic] + runtime + std + [art, driver] +
+        ["--emit-llvm", "-O3", "-o", "conformance"], workdir)
+    run([args.clang, "-O3", "-march=native", "conformance.ll",
+         "-L" + args.runtime_lib, "-lruntime", "-lm",
+         "-Wl,-rpath," + args.runtime_lib, "-o", "conformance"], workdir)
+    output = run([os.path.join(workdir, "conformance")], workdir)
+    m = re.search(r"^Run\s*:\s*(.*)$", output, re.M)
+    return parse_points(output), parse_interval(m.group(1)) if m else 0.0
+
+
+parser = argparse.ArgumentParser(
+    description="Compare the Artic and LLVM backends on a testshade grid")
+parser.add_argument("shader", help="OSL source of the shader")
+parser.add_argument("-o", dest="outputs", action="append", required=True,
+                    metavar="VAR", help="Output to compare (repeatable)")
+parser.add_argument("-g", dest="res", nargs=2, type=int, default=[64, 64],
+                    metavar=("XRES", "YRES"), help="Grid resolution")
+parser.add_argument("--iters", type=int, default=10,
+                    help="Timed iterations over the grid")
+parser.add_argument("--threads", type=int, default=0,
+                    help="Threads for both backends (default: one per core)")
+parser.add_argument("--vector-width", type=int, default=8,
+                    help="Lanes per packet of the batched entry point")
+parser.add_argument("--tolerance", type=float, default=1.0e-4,
+                    help="Max absolute error before reporting a failure")
+parser.add_argument("--oslc", default="oslc")
+parser.add_argument("--testshade", default="testshade")
+parser.add_argument("--artic", default="artic")
+parser.add_argument("--clang", default="clang")
+parser.add_argument("--anydsl-runtime", required=True,
+                    help="AnyDSL runtime source directory")
+parser.add_argument("--runtime-lib", required=True,
+                    help="Directory containing the AnyDSL runtime library")
+parser.add_argument("--keep", action="store_true",
+                    help="Keep the work directory")
+parser.add_argument("-v", dest="verbose", action="store_true")
+args = parser.parse_args()
+args.shader = os.path.abspath(args.shader)
+if args.threads < 1:
+    args.threads = multiprocessing.cpu_count()
+
+workdir = tempfile.mkdtemp(prefix="artic_conformance_")
+llvm_values, llvm_time = run_testshade(workdir)
+artic_values, artic_time = run_artic(workdir)
+
+npoints = args.res[0] * args.res[1]
+failed = False
+print("%-16s %12s %12s" % ("output", "max error", "mean error"))
+for var in args.outputs:
+    if var not in artic_values or var not in llvm_values:
+        continue
+    errors = [abs(a - b)
+              for pa, pb in zip(artic_values[var], llvm_values[var])
+              for a, b in zip(pa, pb)]
+    worst = max(errors) if errors else 0.0
+    mean = sum(errors) / len(errors) if errors else 0.0
+    failed = failed or worst > args.tolerance
+    print("%-16s %12.3g %12.3g%s" % (var, worst, mean,
+          "  FAIL" if worst > args.tolerance else ""))
+print("")
+print("%d threads %12s %18s" % (args.threads, "ns/point",
+                                "thread-ns/point"))
+for name, seconds in (("llvm", llvm_time), ("artic", artic_time)):
+    ns = 1.0e9 * seconds / (npoints * args.iters)
+    print("%-10s %12.2f %18.2f" % (name, ns, ns * args.threads))
+
+if args.keep:
+    print("Work directory: " + workdir)
+else:
+    import shutil
+    shutil.rmtree(workdir)
+sys.exit(1 if failed else 0)